@@ -0,0 +1,175 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+#include <string.h>
+
+#include "broadphase.h"
+#include "hashgrid.h"
+#include "looseoctree.h"
+#include "octree.h"
+#include "sweepandprune.h"
+
+using namespace std;
+
+namespace {
+	//Compares every pair of balls.  This is very slow with many balls, but
+	//it's simple and it's a good way to check the other kinds of BroadPhase.
+	class BruteForce : public BroadPhase {
+		private:
+			Vec3f corner1;
+			Vec3f corner2;
+			vector<Ball*> balls;
+		public:
+			BruteForce(Vec3f c1, Vec3f c2) : corner1(c1), corner2(c2) {
+				
+			}
+			
+			void add(Ball* ball) {
+				balls.push_back(ball);
+			}
+			
+			void remove(Ball* ball) {
+				for(unsigned int i = 0; i < balls.size(); i++) {
+					if (balls[i] == ball) {
+						balls[i] = balls.back();
+						balls.pop_back();
+						return;
+					}
+				}
+			}
+			
+			void ballMoved(Ball* ball, Vec3f oldPos) {
+				
+			}
+			
+			void potentialBallBallCollisions(vector<BallPair> &collisions) {
+				for(unsigned int i = 0; i < balls.size(); i++) {
+					for(unsigned int j = i + 1; j < balls.size(); j++) {
+						if (boxesTouch(balls[i], balls[j])) {
+							BallPair bp;
+							bp.ball1 = balls[i];
+							bp.ball2 = balls[j];
+							collisions.push_back(bp);
+						}
+					}
+				}
+			}
+			
+			void potentialBallWallCollisions(
+				vector<BallWallPair> &collisions) {
+				for(unsigned int i = 0; i < balls.size(); i++) {
+					addWallCollisions(balls[i], corner1, corner2, collisions);
+				}
+			}
+			
+			//This only allocates memory when a ball is added, and it doesn't
+			//keep track of where the balls are
+			long long numAllocations() const {
+				return 0;
+			}
+			
+			long long numBallUpdates() const {
+				return 0;
+			}
+			
+			void resetStats() {
+				
+			}
+	};
+}
+
+BroadPhase::~BroadPhase() {
+	
+}
+
+long long BroadPhase::numSplits() const {
+	return 0;
+}
+
+long long BroadPhase::numMerges() const {
+	return 0;
+}
+
+const char* const BROAD_PHASE_NAMES[NUM_BROAD_PHASES] =
+	{"octree", "looseoctree", "hashgrid", "sweepandprune", "bruteforce"};
+
+BroadPhase* makeBroadPhase(const char* name, Vec3f c1, Vec3f c2) {
+	if (strcmp(name, "octree") == 0) {
+		return new Octree(c1, c2);
+	}
+	else if (strcmp(name, "looseoctree") == 0) {
+		return new LooseOctree(c1, c2);
+	}
+	else if (strcmp(name, "hashgrid") == 0) {
+		return new HashGrid(c1, c2);
+	}
+	else if (strcmp(name, "sweepandprune") == 0) {
+		return new SweepAndPrune(c1, c2);
+	}
+	else if (strcmp(name, "bruteforce") == 0) {
+		return new BruteForce(c1, c2);
+	}
+	else {
+		return NULL;
+	}
+}
+
+bool boxesTouch(Ball* ball1, Ball* ball2) {
+	float r = ball1->r + ball2->r;
+	return fabs(ball1->pos[0] - ball2->pos[0]) <= r &&
+		fabs(ball1->pos[1] - ball2->pos[1]) <= r &&
+		fabs(ball1->pos[2] - ball2->pos[2]) <= r;
+}
+
+void addWallCollisions(Ball* ball,
+					   Vec3f c1,
+					   Vec3f c2,
+					   vector<BallWallPair> &collisions) {
+	//The walls in the negative and positive directions of each coordinate
+	const Wall WALLS[3][2] = {{WALL_LEFT, WALL_RIGHT},
+							  {WALL_BOTTOM, WALL_TOP},
+							  {WALL_FAR, WALL_NEAR}};
+	for(int i = 0; i < 3; i++) {
+		for(int dir = 0; dir < 2; dir++) {
+			if (dir == 0 ? ball->pos[i] - ball->r <= c1[i] :
+				ball->pos[i] + ball->r >= c2[i]) {
+				BallWallPair bwp;
+				bwp.ball = ball;
+				bwp.wall = WALLS[i][dir];
+				collisions.push_back(bwp);
+			}
+		}
+	}
+}
+
+
+
+
+
+
+
+
+
+
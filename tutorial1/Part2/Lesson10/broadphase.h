@@ -0,0 +1,97 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef BROADPHASE_H_INCLUDED
+#define BROADPHASE_H_INCLUDED
+
+#include <vector>
+
+#include "ball.h"
+#include "vec3f.h"
+
+/* Something that keeps track of where the balls in the box are, so that it
+ * can quickly find the pairs of balls that might be colliding and the balls
+ * that might be hitting the walls.  It must find all of the actual
+ * collisions, but it need not find only actual collisions.
+ */
+class BroadPhase {
+	public:
+		virtual ~BroadPhase();
+		
+		//Adds a ball to this
+		virtual void add(Ball* ball) = 0;
+		//Removes a ball from this
+		virtual void remove(Ball* ball) = 0;
+		//Changes the position of a ball in this from oldPos to ball->pos
+		virtual void ballMoved(Ball* ball, Vec3f oldPos) = 0;
+		
+		//Adds potential ball-ball collisions to the specified vector
+		virtual void potentialBallBallCollisions(
+			std::vector<BallPair> &collisions) = 0;
+		//Adds potential ball-wall collisions to the specified vector
+		virtual void potentialBallWallCollisions(
+			std::vector<BallWallPair> &collisions) = 0;
+		
+		//Returns the number of times this has allocated memory, not counting
+		//when a ball is added
+		virtual long long numAllocations() const = 0;
+		//Returns the number of times this changed where it keeps a ball
+		virtual long long numBallUpdates() const = 0;
+		//Returns the number of times this split a region of the box into
+		//smaller ones, or 0 if it doesn't use such regions
+		virtual long long numSplits() const;
+		//Returns the number of times this merged regions of the box into a
+		//larger one, or 0 if it doesn't use such regions
+		virtual long long numMerges() const;
+		virtual void resetStats() = 0;
+};
+
+const int NUM_BROAD_PHASES = 5;
+//The names of the kinds of BroadPhase, from which makeBroadPhase can make one
+extern const char* const BROAD_PHASE_NAMES[NUM_BROAD_PHASES];
+
+//Returns a new BroadPhase of the kind with the specified name for the box
+//with the corners c1 = (minX, minY, minZ) and c2 = (maxX, maxY, maxZ), or
+//NULL if there is no such kind
+BroadPhase* makeBroadPhase(const char* name, Vec3f c1, Vec3f c2);
+
+//Returns whether the boxes around the balls overlap
+bool boxesTouch(Ball* ball1, Ball* ball2);
+//Adds (ball, w) to collisions for each wall w of the box with the corners c1
+//and c2 that the ball reaches
+void addWallCollisions(Ball* ball,
+					   Vec3f c1,
+					   Vec3f c2,
+					   std::vector<BallWallPair> &collisions);
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,252 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#include "hashgrid.h"
+
+using namespace std;
+
+HashGrid::HashGrid(Vec3f c1, Vec3f c2) : corner1(c1),
+										 corner2(c2),
+										 freeEntries(-1),
+										 buckets(HASH_GRID_MIN_BUCKETS, -1),
+										 numBalls(0),
+										 allocations(0) {
+	Vec3f size = c2 - c1;
+	float cellSize = max(max(size[0], size[1]), size[2]);
+	for(int i = 0; i < HASH_GRID_LEVELS; i++) {
+		cellSizes[i] = cellSize;
+		levelBalls[i] = 0;
+		maxRadii[i] = 0;
+		cellSize /= 2;
+	}
+	resetStats();
+}
+
+int HashGrid::levelFor(Ball* ball) const {
+	int level = 0;
+	while (level + 1 < HASH_GRID_LEVELS &&
+		   cellSizes[level + 1] >= 2 * ball->r) {
+		level++;
+	}
+	return level;
+}
+
+void HashGrid::cellFor(Vec3f pos, int level, int cell[3]) const {
+	for(int i = 0; i < 3; i++) {
+		cell[i] = (int)floor((pos[i] - corner1[i]) / cellSizes[level]);
+	}
+}
+
+int HashGrid::bucketFor(const int cell[3], int level) const {
+	unsigned int hash = ((unsigned int)cell[0] * 73856093u) ^
+		((unsigned int)cell[1] * 19349663u) ^
+		((unsigned int)cell[2] * 83492791u) ^
+		((unsigned int)level * 2654435761u);
+	return (int)(hash & (buckets.size() - 1));
+}
+
+void HashGrid::store(Ball* ball, int level, const int cell[3]) {
+	//Reuse a free entry if there is one
+	int index;
+	if (freeEntries != -1) {
+		index = freeEntries;
+		freeEntries = entries[index].next;
+	}
+	else {
+		size_t capacity = entries.capacity();
+		entries.push_back(Entry());
+		if (entries.capacity() != capacity) {
+			allocations++;
+		}
+		index = (int)entries.size() - 1;
+	}
+	
+	Entry &entry = entries[index];
+	entry.ball = ball;
+	entry.level = level;
+	for(int i = 0; i < 3; i++) {
+		entry.cell[i] = cell[i];
+	}
+	int &bucket = buckets[bucketFor(cell, level)];
+	entry.next = bucket;
+	bucket = index;
+	levelBalls[level]++;
+	maxRadii[level] = max(maxRadii[level], ball->r);
+	ballUpdates++;
+}
+
+void HashGrid::unstore(Ball* ball, int level, const int cell[3]) {
+	int* link = &buckets[bucketFor(cell, level)];
+	while (*link != -1) {
+		Entry &entry = entries[*link];
+		if (entry.ball == ball) {
+			//Take the entry out of the bucket and put it on the free list
+			int index = *link;
+			*link = entry.next;
+			entry.ball = NULL;
+			entry.next = freeEntries;
+			freeEntries = index;
+			levelBalls[level]--;
+			ballUpdates++;
+			return;
+		}
+		link = &entry.next;
+	}
+}
+
+void HashGrid::growBuckets() {
+	buckets.assign(2 * buckets.size(), -1);
+	allocations++;
+	for(unsigned int i = 0; i < entries.size(); i++) {
+		Entry &entry = entries[i];
+		if (entry.ball != NULL) {
+			int &bucket = buckets[bucketFor(entry.cell, entry.level)];
+			entry.next = bucket;
+			bucket = i;
+		}
+	}
+}
+
+void HashGrid::add(Ball* ball) {
+	//Keep enough buckets that few cells share one
+	if (HASH_GRID_BUCKETS_PER_BALL * numBalls >= (int)buckets.size()) {
+		growBuckets();
+	}
+	
+	int level = levelFor(ball);
+	int cell[3];
+	cellFor(ball->pos, level, cell);
+	store(ball, level, cell);
+	numBalls++;
+}
+
+void HashGrid::remove(Ball* ball) {
+	int level = levelFor(ball);
+	int cell[3];
+	cellFor(ball->pos, level, cell);
+	unstore(ball, level, cell);
+	numBalls--;
+}
+
+void HashGrid::ballMoved(Ball* ball, Vec3f oldPos) {
+	int level = levelFor(ball);
+	int oldCell[3];
+	int cell[3];
+	cellFor(oldPos, level, oldCell);
+	cellFor(ball->pos, level, cell);
+	if (oldCell[0] != cell[0] || oldCell[1] != cell[1] ||
+		oldCell[2] != cell[2]) {
+		unstore(ball, level, oldCell);
+		store(ball, level, cell);
+	}
+}
+
+void HashGrid::potentialBallBallCollisions(const Entry &entry,
+										   int level,
+										   vector<BallPair> &collisions) {
+	//Find the cells whose balls' centers could be close enough to the
+	//ball's center
+	Ball* ball = entry.ball;
+	float reach = ball->r + maxRadii[level];
+	int low[3];
+	int high[3];
+	cellFor(ball->pos - Vec3f(reach, reach, reach), level, low);
+	cellFor(ball->pos + Vec3f(reach, reach, reach), level, high);
+	
+	int cell[3];
+	for(cell[0] = low[0]; cell[0] <= high[0]; cell[0]++) {
+		for(cell[1] = low[1]; cell[1] <= high[1]; cell[1]++) {
+			for(cell[2] = low[2]; cell[2] <= high[2]; cell[2]++) {
+				for(int i = buckets[bucketFor(cell, level)];
+					i != -1;
+					i = entries[i].next) {
+					//Skip the balls in other cells that share the bucket
+					const Entry &other = entries[i];
+					if (other.level != level || other.cell[0] != cell[0] ||
+						other.cell[1] != cell[1] ||
+						other.cell[2] != cell[2]) {
+						continue;
+					}
+					
+					if ((level != entry.level || other.ball > ball) &&
+						boxesTouch(ball, other.ball)) {
+						BallPair bp;
+						bp.ball1 = ball;
+						bp.ball2 = other.ball;
+						collisions.push_back(bp);
+					}
+				}
+			}
+		}
+	}
+}
+
+void HashGrid::potentialBallBallCollisions(vector<BallPair> &collisions) {
+	//Look for each ball's partners on its level and the levels with larger
+	//cells
+	for(unsigned int i = 0; i < entries.size(); i++) {
+		const Entry &entry = entries[i];
+		if (entry.ball == NULL) {
+			continue;
+		}
+		
+		for(int level = 0; level <= entry.level; level++) {
+			if (levelBalls[level] > 0) {
+				potentialBallBallCollisions(entry, level, collisions);
+			}
+		}
+	}
+}
+
+void HashGrid::potentialBallWallCollisions(vector<BallWallPair> &collisions) {
+	for(unsigned int i = 0; i < entries.size(); i++) {
+		if (entries[i].ball != NULL) {
+			addWallCollisions(entries[i].ball, corner1, corner2, collisions);
+		}
+	}
+}
+
+long long HashGrid::numAllocations() const {
+	return allocations;
+}
+
+long long HashGrid::numBallUpdates() const {
+	return ballUpdates;
+}
+
+void HashGrid::resetStats() {
+	ballUpdates = 0;
+}
+
+
+
+
+
+
+
+
+
+
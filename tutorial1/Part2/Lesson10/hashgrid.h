@@ -0,0 +1,141 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef HASHGRID_H_INCLUDED
+#define HASHGRID_H_INCLUDED
+
+#include <vector>
+
+#include "ball.h"
+#include "broadphase.h"
+#include "vec3f.h"
+
+//The number of levels of cells in a HashGrid
+const int HASH_GRID_LEVELS = 12;
+//The number of buckets with which a HashGrid starts
+const int HASH_GRID_MIN_BUCKETS = 1024;
+//The fewest buckets a HashGrid keeps for each ball
+const int HASH_GRID_BUCKETS_PER_BALL = 4;
+
+/* A grid of cubic cells that only stores the cells that have balls in them,
+ * in a hash table.  There are several levels of cells.  The cells on level 0
+ * are as large as the box, and each level's cells are half as large as the
+ * last level's.  Each ball is stored in just one cell, the one containing its
+ * center on the level with the smallest cells that are at least as large as
+ * the ball, so that balls of very different sizes can share the grid.
+ */
+class HashGrid : public BroadPhase {
+	private:
+		//A ball and the cell it's stored in
+		struct Entry {
+			//The ball, or NULL if this entry isn't in use
+			Ball* ball;
+			int level;
+			int cell[3];
+			//The index of the next entry in the same bucket, or of the next
+			//free entry, or -1 if there is none
+			int next;
+		};
+		
+		Vec3f corner1;
+		Vec3f corner2;
+		//The length of a side of a cell on each level
+		float cellSizes[HASH_GRID_LEVELS];
+		//The number of balls on each level
+		int levelBalls[HASH_GRID_LEVELS];
+		//The largest radius of a ball ever stored on each level
+		float maxRadii[HASH_GRID_LEVELS];
+		//The entries for all of the balls, including free ones that can be
+		//reused without allocating memory
+		std::vector<Entry> entries;
+		//The index of the first free entry, or -1 if there is none
+		int freeEntries;
+		//The hash table of cells, holding the index of the first entry in
+		//each bucket or -1.  The number of buckets is a power of two.  Cells
+		//with the same hash share a bucket.
+		std::vector<int> buckets;
+		int numBalls;
+		//The number of times this has allocated memory
+		long long allocations;
+		//The number of times a ball was stored in or taken out of a cell
+		//since the last call to resetStats
+		long long ballUpdates;
+		
+		//Returns the level on which the ball is stored
+		int levelFor(Ball* ball) const;
+		//Sets the cell on the level that contains the position
+		void cellFor(Vec3f pos, int level, int cell[3]) const;
+		//Returns the index of the bucket for the cell on the level
+		int bucketFor(const int cell[3], int level) const;
+		
+		//Stores the ball in the cell on the level
+		void store(Ball* ball, int level, const int cell[3]);
+		//Removes the ball from the cell on the level
+		void unstore(Ball* ball, int level, const int cell[3]);
+		//Doubles the number of buckets, moving the entries to their new
+		//buckets
+		void growBuckets();
+		
+		//Adds the potential collisions between the ball in the entry and the
+		//balls on the specified level, which is at most the entry's level.
+		//Pairs of balls on the same level are only found from one side.
+		void potentialBallBallCollisions(const Entry &entry,
+										 int level,
+										 std::vector<BallPair> &collisions);
+	public:
+		//Constructs a new HashGrid for a cube, where c1 is (minX, minY, minZ)
+		//and c2 is (maxX, maxY, maxZ)
+		HashGrid(Vec3f c1, Vec3f c2);
+		
+		//Adds a ball to this
+		void add(Ball* ball);
+		//Removes a ball from this
+		void remove(Ball* ball);
+		//Changes the position of a ball in this from oldPos to ball->pos
+		void ballMoved(Ball* ball, Vec3f oldPos);
+		
+		//Adds potential ball-ball collisions to the specified vector
+		void potentialBallBallCollisions(std::vector<BallPair> &collisions);
+		//Adds potential ball-wall collisions to the specified vector
+		void potentialBallWallCollisions(std::vector<BallWallPair> &collisions);
+		
+		//Returns the number of times this has allocated memory for the
+		//entries or the buckets
+		long long numAllocations() const;
+		//Returns the number of times a ball was stored in or taken out of a
+		//cell
+		long long numBallUpdates() const;
+		void resetStats();
+};
+
+
+
+
+
+
+
+
+
+
+#endif
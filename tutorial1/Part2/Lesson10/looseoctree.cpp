@@ -0,0 +1,529 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <algorithm>
+#include <math.h>
+
+#include "looseoctree.h"
+
+using namespace std;
+
+namespace {
+	//Adds the pair of balls to collisions if the boxes around them overlap
+	void addPotentialCollision(Ball* ball1,
+							   Ball* ball2,
+							   vector<BallPair> &collisions) {
+		if (boxesTouch(ball1, ball2)) {
+			BallPair bp;
+			bp.ball1 = ball1;
+			bp.ball2 = ball2;
+			collisions.push_back(bp);
+		}
+	}
+}
+
+LooseOctree::LooseOctree(Vec3f c1, Vec3f c2) : freeBlocks(NULL),
+											   allocations(0) {
+	Vec3f size = c2 - c1;
+	initNode(root,
+			 (c1 + c2) / 2,
+			 max(max(size[0], size[1]), size[2]) / 2,
+			 NULL,
+			 1);
+	resetStats();
+}
+
+LooseOctree::~LooseOctree() {
+	for(unsigned int i = 0; i < slabs.size(); i++) {
+		delete[] slabs[i];
+	}
+}
+
+void LooseOctree::initNode(Node &node,
+						   Vec3f center,
+						   float halfSize,
+						   Node* parent,
+						   int depth) {
+	node.center = center;
+	node.halfSize = halfSize;
+	node.parent = parent;
+	node.children = NULL;
+	node.depth = depth;
+	node.numBalls = 0;
+	node.balls.clear();
+}
+
+bool LooseOctree::fits(const Node &node, Ball* ball, Vec3f pos) const {
+	if (&node == &root) {
+		return true;
+	}
+	for(int i = 0; i < 3; i++) {
+		if (fabs(pos[i] - node.center[i]) + ball->r >
+			LOOSE_OCTREE_LOOSENESS * node.halfSize) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LooseOctree::touches(const Node &node, Ball* ball) {
+	for(int i = 0; i < 3; i++) {
+		if (ball->pos[i] + ball->r < node.boundsMin[i] ||
+			ball->pos[i] - ball->r > node.boundsMax[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LooseOctree::touches(const Node &node1, const Node &node2) {
+	for(int i = 0; i < 3; i++) {
+		if (node1.boundsMax[i] < node2.boundsMin[i] ||
+			node1.boundsMin[i] > node2.boundsMax[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int LooseOctree::childIndex(const Node &node, Vec3f pos) {
+	return (pos[0] >= node.center[0] ? 4 : 0) +
+		(pos[1] >= node.center[1] ? 2 : 0) +
+		(pos[2] >= node.center[2] ? 1 : 0);
+}
+
+void LooseOctree::store(Node* node, Ball* ball) {
+	size_t capacity = node->balls.capacity();
+	if (capacity == 0) {
+		node->balls.reserve(2 * MAX_BALLS_PER_OCTREE);
+	}
+	node->balls.push_back(ball);
+	if (node->balls.capacity() != capacity) {
+		allocations++;
+	}
+	ballNodes[ball] = node;
+	ballUpdates++;
+}
+
+void LooseOctree::unstore(Node* node, Ball* ball) {
+	vector<Ball*> &balls = node->balls;
+	for(unsigned int i = 0; i < balls.size(); i++) {
+		if (balls[i] == ball) {
+			//Move the last ball into the ball's place
+			balls[i] = balls.back();
+			balls.pop_back();
+			ballUpdates++;
+			return;
+		}
+	}
+}
+
+void LooseOctree::insert(Node* node, Ball* ball) {
+	while (true) {
+		node->numBalls++;
+		if (node->children == NULL && node->depth < MAX_LOOSE_OCTREE_DEPTH &&
+			node->numBalls > MAX_BALLS_PER_OCTREE) {
+			split(node);
+		}
+		
+		//Go down to the child if the ball fits in it
+		if (node->children != NULL) {
+			Node* child =
+				&node->children->nodes[childIndex(*node, ball->pos)];
+			if (fits(*child, ball, ball->pos)) {
+				node = child;
+				continue;
+			}
+		}
+		store(node, ball);
+		return;
+	}
+}
+
+void LooseOctree::split(Node* node) {
+	//Allocate more blocks if they're all in use
+	if (freeBlocks == NULL) {
+		NodeBlock* slab = new NodeBlock[OCTREE_BLOCKS_PER_SLAB];
+		slabs.push_back(slab);
+		allocations++;
+		for(int i = 0; i < OCTREE_BLOCKS_PER_SLAB; i++) {
+			slab[i].nextFree = freeBlocks;
+			freeBlocks = &slab[i];
+		}
+	}
+	NodeBlock* block = freeBlocks;
+	freeBlocks = block->nextFree;
+	splits++;
+	
+	float halfSize = node->halfSize / 2;
+	for(int i = 0; i < 8; i++) {
+		Vec3f offset((i & 4) != 0 ? halfSize : -halfSize,
+					 (i & 2) != 0 ? halfSize : -halfSize,
+					 (i & 1) != 0 ? halfSize : -halfSize);
+		initNode(block->nodes[i],
+				 node->center + offset,
+				 halfSize,
+				 node,
+				 node->depth + 1);
+	}
+	node->children = block;
+	
+	//Move down the balls that fit in the children
+	unsigned int i = 0;
+	while (i < node->balls.size()) {
+		Ball* ball = node->balls[i];
+		Node* child = &block->nodes[childIndex(*node, ball->pos)];
+		if (fits(*child, ball, ball->pos)) {
+			//This moves the last ball to index i
+			unstore(node, ball);
+			insert(child, ball);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+void LooseOctree::collectBalls(Node* node, Node* into) {
+	for(unsigned int i = 0; i < node->balls.size(); i++) {
+		store(into, node->balls[i]);
+	}
+	ballUpdates += node->balls.size();
+	node->balls.clear();
+	
+	if (node->children != NULL) {
+		for(int i = 0; i < 8; i++) {
+			collectBalls(&node->children->nodes[i], into);
+		}
+	}
+}
+
+void LooseOctree::merge(Node* node) {
+	NodeBlock* block = node->children;
+	node->children = NULL;
+	merges++;
+	for(int i = 0; i < 8; i++) {
+		collectBalls(&block->nodes[i], node);
+	}
+	freeBlock(block);
+}
+
+void LooseOctree::freeBlock(NodeBlock* block) {
+	for(int i = 0; i < 8; i++) {
+		if (block->nodes[i].children != NULL) {
+			freeBlock(block->nodes[i].children);
+		}
+	}
+	block->nextFree = freeBlocks;
+	freeBlocks = block;
+}
+
+void LooseOctree::mergeSparse(Node* node, Node* stop) {
+	Node* highest = NULL;
+	for(Node* n = node; n != stop; n = n->parent) {
+		if (n->children != NULL && n->numBalls < MIN_BALLS_PER_OCTREE) {
+			highest = n;
+		}
+	}
+	if (highest != NULL) {
+		merge(highest);
+	}
+}
+
+void LooseOctree::fitBounds(Node* node) {
+	//Start with an empty box
+	Vec3f &low = node->boundsMin;
+	Vec3f &high = node->boundsMax;
+	low = Vec3f(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+	high = Vec3f(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+	for(unsigned int i = 0; i < node->balls.size(); i++) {
+		Ball* ball = node->balls[i];
+		for(int j = 0; j < 3; j++) {
+			low[j] = min(low[j], ball->pos[j] - ball->r);
+			high[j] = max(high[j], ball->pos[j] + ball->r);
+		}
+	}
+	
+	if (node->children != NULL) {
+		for(int i = 0; i < 8; i++) {
+			Node* child = &node->children->nodes[i];
+			fitBounds(child);
+			for(int j = 0; j < 3; j++) {
+				low[j] = min(low[j], child->boundsMin[j]);
+				high[j] = max(high[j], child->boundsMax[j]);
+			}
+		}
+	}
+}
+
+void LooseOctree::potentialBallBallCollisions(Ball* ball,
+											  Node* node,
+											  vector<BallPair> &collisions) {
+	if (!touches(*node, ball)) {
+		return;
+	}
+	
+	for(unsigned int i = 0; i < node->balls.size(); i++) {
+		addPotentialCollision(ball, node->balls[i], collisions);
+	}
+	if (node->children != NULL) {
+		for(int i = 0; i < 8; i++) {
+			potentialBallBallCollisions(ball,
+										&node->children->nodes[i],
+										collisions);
+		}
+	}
+}
+
+void LooseOctree::potentialBallBallCollisions(Node* node1,
+											  Node* node2,
+											  vector<BallPair> &collisions) {
+	if (!touches(*node1, *node2)) {
+		return;
+	}
+	
+	//Compare the balls stored in each node with all of the balls in the
+	//other one
+	for(unsigned int i = 0; i < node1->balls.size(); i++) {
+		for(unsigned int j = 0; j < node2->balls.size(); j++) {
+			addPotentialCollision(node1->balls[i],
+								  node2->balls[j],
+								  collisions);
+		}
+		if (node2->children != NULL) {
+			for(int j = 0; j < 8; j++) {
+				potentialBallBallCollisions(node1->balls[i],
+											&node2->children->nodes[j],
+											collisions);
+			}
+		}
+	}
+	if (node1->children != NULL) {
+		for(unsigned int i = 0; i < node2->balls.size(); i++) {
+			for(int j = 0; j < 8; j++) {
+				potentialBallBallCollisions(node2->balls[i],
+											&node1->children->nodes[j],
+											collisions);
+			}
+		}
+	}
+	
+	//Compare the children with each other, only pairing up the children of
+	//each node that touch the other node
+	if (node1->children != NULL && node2->children != NULL) {
+		Node* children1[8];
+		Node* children2[8];
+		int numChildren1 = 0;
+		int numChildren2 = 0;
+		for(int i = 0; i < 8; i++) {
+			Node* child1 = &node1->children->nodes[i];
+			if (child1->numBalls > 0 && touches(*child1, *node2)) {
+				children1[numChildren1++] = child1;
+			}
+			Node* child2 = &node2->children->nodes[i];
+			if (child2->numBalls > 0 && touches(*child2, *node1)) {
+				children2[numChildren2++] = child2;
+			}
+		}
+		
+		for(int i = 0; i < numChildren1; i++) {
+			for(int j = 0; j < numChildren2; j++) {
+				potentialBallBallCollisions(children1[i],
+											children2[j],
+											collisions);
+			}
+		}
+	}
+}
+
+void LooseOctree::potentialBallBallCollisions(Node* node,
+											  vector<BallPair> &collisions) {
+	if (node->numBalls < 2) {
+		return;
+	}
+	
+	vector<Ball*> &balls = node->balls;
+	for(unsigned int i = 0; i < balls.size(); i++) {
+		for(unsigned int j = i + 1; j < balls.size(); j++) {
+			addPotentialCollision(balls[i], balls[j], collisions);
+		}
+	}
+	
+	if (node->children != NULL) {
+		Node* children = node->children->nodes;
+		for(unsigned int i = 0; i < balls.size(); i++) {
+			for(int j = 0; j < 8; j++) {
+				potentialBallBallCollisions(balls[i], &children[j], collisions);
+			}
+		}
+		for(int i = 0; i < 8; i++) {
+			potentialBallBallCollisions(&children[i], collisions);
+			for(int j = i + 1; j < 8; j++) {
+				potentialBallBallCollisions(&children[i],
+											&children[j],
+											collisions);
+			}
+		}
+	}
+}
+
+void LooseOctree::potentialBallWallCollisions(Node* node,
+											  vector<BallWallPair> &cs,
+											  Wall w,
+											  int coord,
+											  int dir) {
+	//Skip the node if its loose bounds don't reach the wall
+	float wall;
+	if (dir == 0) {
+		wall = root.center[coord] - root.halfSize;
+		if (node != &root &&
+			node->center[coord] - LOOSE_OCTREE_LOOSENESS * node->halfSize >
+				wall) {
+			return;
+		}
+	}
+	else {
+		wall = root.center[coord] + root.halfSize;
+		if (node != &root &&
+			node->center[coord] + LOOSE_OCTREE_LOOSENESS * node->halfSize <
+				wall) {
+			return;
+		}
+	}
+	
+	//Add (ball, w) for the balls in the node that reach the wall
+	for(unsigned int i = 0; i < node->balls.size(); i++) {
+		Ball* ball = node->balls[i];
+		if (dir == 0 ? ball->pos[coord] - ball->r <= wall :
+			ball->pos[coord] + ball->r >= wall) {
+			BallWallPair bwp;
+			bwp.ball = ball;
+			bwp.wall = w;
+			cs.push_back(bwp);
+		}
+	}
+	
+	if (node->children != NULL) {
+		for(int i = 0; i < 8; i++) {
+			potentialBallWallCollisions(&node->children->nodes[i],
+										cs,
+										w,
+										coord,
+										dir);
+		}
+	}
+}
+
+void LooseOctree::add(Ball* ball) {
+	insert(&root, ball);
+}
+
+void LooseOctree::remove(Ball* ball) {
+	unordered_map<Ball*, Node*>::iterator it = ballNodes.find(ball);
+	if (it == ballNodes.end()) {
+		return;
+	}
+	
+	Node* node = it->second;
+	unstore(node, ball);
+	ballNodes.erase(it);
+	for(Node* n = node; n != NULL; n = n->parent) {
+		n->numBalls--;
+	}
+	mergeSparse(node, NULL);
+}
+
+void LooseOctree::ballMoved(Ball* ball, Vec3f oldPos) {
+	unordered_map<Ball*, Node*>::iterator it = ballNodes.find(ball);
+	if (it == ballNodes.end()) {
+		return;
+	}
+	
+	//Usually, the ball is still in its node's loose bounds
+	Node* node = it->second;
+	if (fits(*node, ball, ball->pos)) {
+		return;
+	}
+	
+	//Take the ball out of the nodes it left, and put it back in starting
+	//from the nearest node it's still in
+	unstore(node, ball);
+	Node* ancestor = node->parent;
+	while (!fits(*ancestor, ball, ball->pos)) {
+		ancestor = ancestor->parent;
+	}
+	for(Node* n = node; n != ancestor; n = n->parent) {
+		n->numBalls--;
+	}
+	mergeSparse(node, ancestor);
+	ancestor->numBalls--;
+	insert(ancestor, ball);
+}
+
+void LooseOctree::potentialBallBallCollisions(vector<BallPair> &collisions) {
+	fitBounds(&root);
+	potentialBallBallCollisions(&root, collisions);
+}
+
+void LooseOctree::potentialBallWallCollisions(
+	vector<BallWallPair> &collisions) {
+	potentialBallWallCollisions(&root, collisions, WALL_LEFT, 0, 0);
+	potentialBallWallCollisions(&root, collisions, WALL_RIGHT, 0, 1);
+	potentialBallWallCollisions(&root, collisions, WALL_BOTTOM, 1, 0);
+	potentialBallWallCollisions(&root, collisions, WALL_TOP, 1, 1);
+	potentialBallWallCollisions(&root, collisions, WALL_FAR, 2, 0);
+	potentialBallWallCollisions(&root, collisions, WALL_NEAR, 2, 1);
+}
+
+long long LooseOctree::numAllocations() const {
+	return allocations;
+}
+
+long long LooseOctree::numBallUpdates() const {
+	return ballUpdates;
+}
+
+long long LooseOctree::numSplits() const {
+	return splits;
+}
+
+long long LooseOctree::numMerges() const {
+	return merges;
+}
+
+void LooseOctree::resetStats() {
+	ballUpdates = 0;
+	splits = 0;
+	merges = 0;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,213 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef LOOSE_OCTREE_H_INCLUDED
+#define LOOSE_OCTREE_H_INCLUDED
+
+#include <unordered_map>
+#include <vector>
+
+#include "ball.h"
+#include "broadphase.h"
+#include "octree.h"
+#include "vec3f.h"
+
+//How many times larger than a node's part of the box its loose bounds are
+const float LOOSE_OCTREE_LOOSENESS = 2.0f;
+//Balls only go as deep as they fit, so the tree can be deeper than an Octree
+const int MAX_LOOSE_OCTREE_DEPTH = 8;
+
+/* An octree whose nodes have loose bounds, which stick out past the node's
+ * part of the box by half of the node's size on every side.  Each ball is
+ * stored in just one node, the deepest one whose loose bounds it fits in.
+ * A ball that moves stays in its node until it leaves the node's loose
+ * bounds, so most moves don't change the tree at all, where an Octree takes
+ * every moved ball out of its leaves and puts it back in.
+ *
+ * Loose bounds overlap a lot, so to find potential collisions, it first
+ * works out the box around the balls in each node and its descendants, and
+ * only compares the balls in pairs of nodes whose boxes overlap.
+ *
+ * It splits and merges nodes at the same numbers of balls and depths as
+ * Octree, and like Octree, it reuses its nodes rather than freeing them.
+ */
+class LooseOctree : public BroadPhase {
+	private:
+		struct NodeBlock;
+		
+		//A part of the box
+		struct Node {
+			Vec3f center;
+			//Half of the length of a side of the node's part of the box.
+			//Its loose bounds go twice as far from the center.
+			float halfSize;
+			Node* parent;
+			//The eight children of this, or NULL if this has none.  The
+			//children are numbered as in Octree.
+			NodeBlock* children;
+			//The depth of this in the tree, which is 1 for the root
+			int depth;
+			//The number of balls in this, including those in its
+			//descendants
+			int numBalls;
+			//The balls stored in this node.  This keeps its memory when
+			//the node is reused.
+			std::vector<Ball*> balls;
+			//The corners of the box around the balls in this and its
+			//descendants, as of the last call to fitBounds
+			Vec3f boundsMin;
+			Vec3f boundsMax;
+		};
+		
+		//The children of a node, or a free block
+		struct NodeBlock {
+			Node nodes[8];
+			//The next free block, if this is free
+			NodeBlock* nextFree;
+		};
+		
+		Node root;
+		//The arrays of OCTREE_BLOCKS_PER_SLAB blocks this has allocated
+		std::vector<NodeBlock*> slabs;
+		//The first of the blocks that aren't in use
+		NodeBlock* freeBlocks;
+		//The node in which each ball is stored
+		std::unordered_map<Ball*, Node*> ballNodes;
+		//The number of times this has allocated memory
+		long long allocations;
+		//The statistics since the last call to resetStats
+		long long ballUpdates;
+		long long splits;
+		long long merges;
+		
+		//Sets up a node with no balls and no children
+		static void initNode(Node &node,
+							 Vec3f center,
+							 float halfSize,
+							 Node* parent,
+							 int depth);
+		//Returns whether the ball at the specified position fits in the
+		//node's loose bounds.  Every ball fits in the root.
+		bool fits(const Node &node, Ball* ball, Vec3f pos) const;
+		//Returns whether the box around the ball overlaps the box around
+		//the balls in the node
+		static bool touches(const Node &node, Ball* ball);
+		//Returns whether the boxes around the balls in the nodes overlap
+		static bool touches(const Node &node1, const Node &node2);
+		//Returns the index of the child of the node whose part of the box
+		//has the specified position, or the nearest part to it
+		static int childIndex(const Node &node, Vec3f pos);
+		
+		//Adds a ball to the balls stored in the node
+		void store(Node* node, Ball* ball);
+		//Removes a ball from the balls stored in the node
+		void unstore(Node* node, Ball* ball);
+		//Adds a ball to the node or the descendant in which it belongs
+		void insert(Node* node, Ball* ball);
+		//Creates children of the node, and moves the balls in the node that
+		//fit in them to them
+		void split(Node* node);
+		//Moves all balls in the descendants of node to the balls stored in
+		//"into"
+		void collectBalls(Node* node, Node* into);
+		//Destroys the children of the node, and moves all balls in its
+		//descendants to the node
+		void merge(Node* node);
+		//Puts the block and the blocks of the descendants of its nodes on the
+		//list of free blocks
+		void freeBlock(NodeBlock* block);
+		//Merges the highest node from node up to but not including stop that
+		//has children and fewer than MIN_BALLS_PER_OCTREE balls, if any
+		void mergeSparse(Node* node, Node* stop);
+		
+		//Sets boundsMin and boundsMax for the node and its descendants
+		static void fitBounds(Node* node);
+		//Adds the potential collisions between the ball and the balls in
+		//the node and its descendants
+		static void potentialBallBallCollisions(
+			Ball* ball,
+			Node* node,
+			std::vector<BallPair> &collisions);
+		//Adds the potential collisions between the balls in node1 and its
+		//descendants and those in node2 and its descendants
+		static void potentialBallBallCollisions(
+			Node* node1,
+			Node* node2,
+			std::vector<BallPair> &collisions);
+		//Adds the potential collisions among the balls in the node and its
+		//descendants
+		static void potentialBallBallCollisions(
+			Node* node,
+			std::vector<BallPair> &collisions);
+		/* Adds the balls in the node and its descendants that reach the
+		 * specified wall to cs, where coord is 0, 1, or 2 for the x, y, or
+		 * z coordinate of the wall, and dir is 0 if the wall is in the
+		 * negative direction and 1 if it is in the positive direction
+		 */
+		void potentialBallWallCollisions(Node* node,
+										 std::vector<BallWallPair> &cs,
+										 Wall w,
+										 int coord,
+										 int dir);
+	public:
+		//Constructs a new LooseOctree for a cube, where c1 is (minX, minY,
+		//minZ) and c2 is (maxX, maxY, maxZ)
+		LooseOctree(Vec3f c1, Vec3f c2);
+		~LooseOctree();
+		
+		//Adds a ball to this
+		void add(Ball* ball);
+		//Removes a ball from this
+		void remove(Ball* ball);
+		//Changes the position of a ball in this from oldPos to ball->pos
+		void ballMoved(Ball* ball, Vec3f oldPos);
+		
+		//Adds potential ball-ball collisions to the specified vector
+		void potentialBallBallCollisions(std::vector<BallPair> &collisions);
+		//Adds potential ball-wall collisions to the specified vector
+		void potentialBallWallCollisions(std::vector<BallWallPair> &collisions);
+		
+		//Returns the number of times this has allocated memory for nodes or
+		//for the balls in them, not counting when a ball is added
+		long long numAllocations() const;
+		//Returns the number of times a ball was stored in or taken out of a
+		//node
+		long long numBallUpdates() const;
+		//Returns the number of times a node was given children
+		long long numSplits() const;
+		//Returns the number of times a node's children were destroyed
+		long long numMerges() const;
+		void resetStats();
+};
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -22,11 +22,13 @@
 
 
 
+#include <chrono>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
-#include <set>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 
 #ifdef __APPLE__
@@ -36,6 +38,8 @@
 #include <GL/glut.h>
 #endif
 
+#include "ball.h"
+#include "broadphase.h"
 #include "imageloader.h"
 #include "vec3f.h"
 
@@ -53,392 +57,13 @@ const float BOX_SIZE = 12.0f; //The length of one side of the box
 const float TIME_BETWEEN_UPDATES = 0.01f;
 const int TIMER_MS = 25; //The number of milliseconds to which the timer is set
 
-//Stores information regarding a ball
-struct Ball {
-	Vec3f v; //Velocity
-	Vec3f pos; //Position
-	float r; //Radius
-	Vec3f color;
-};
-
-enum Wall {WALL_LEFT, WALL_RIGHT, WALL_FAR, WALL_NEAR, WALL_TOP, WALL_BOTTOM};
-
-//Stores a pair of balls
-struct BallPair {
-	Ball* ball1;
-	Ball* ball2;
-};
-
-//Stores a ball and a wall
-struct BallWallPair {
-	Ball* ball;
-	Wall wall;
-};
-
-const int MAX_OCTREE_DEPTH = 6;
-const int MIN_BALLS_PER_OCTREE = 3;
-const int MAX_BALLS_PER_OCTREE = 6;
-
-//Our data structure for making collision detection faster
-class Octree {
-	private:
-		Vec3f corner1; //(minX, minY, minZ)
-		Vec3f corner2; //(maxX, maxY, maxZ)
-		Vec3f center;//((minX + maxX) / 2, (minY + maxY) / 2, (minZ + maxZ) / 2)
-		
-		/* The children of this, if this has any.  children[0][*][*] are the
-		 * children with x coordinates ranging from minX to centerX.
-		 * children[1][*][*] are the children with x coordinates ranging from
-		 * centerX to maxX.  Similarly for the other two dimensions of the
-		 * children array.
-		 */
-		Octree *children[2][2][2];
-		//Whether this has children
-		bool hasChildren;
-		//The balls in this, if this doesn't have any children
-		set<Ball*> balls;
-		//The depth of this in the tree
-		int depth;
-		//The number of balls in this, including those stored in its children
-		int numBalls;
-		
-		//Adds a ball to or removes one from the children of this
-		void fileBall(Ball* ball, Vec3f pos, bool addBall) {
-			//Figure out in which child(ren) the ball belongs
-			for(int x = 0; x < 2; x++) {
-				if (x == 0) {
-					if (pos[0] - ball->r > center[0]) {
-						continue;
-					}
-				}
-				else if (pos[0] + ball->r < center[0]) {
-					continue;
-				}
-				
-				for(int y = 0; y < 2; y++) {
-					if (y == 0) {
-						if (pos[1] - ball->r > center[1]) {
-							continue;
-						}
-					}
-					else if (pos[1] + ball->r < center[1]) {
-						continue;
-					}
-					
-					for(int z = 0; z < 2; z++) {
-						if (z == 0) {
-							if (pos[2] - ball->r > center[2]) {
-								continue;
-							}
-						}
-						else if (pos[2] + ball->r < center[2]) {
-							continue;
-						}
-						
-						//Add or remove the ball
-						if (addBall) {
-							children[x][y][z]->add(ball);
-						}
-						else {
-							children[x][y][z]->remove(ball, pos);
-						}
-					}
-				}
-			}
-		}
-		
-		//Creates children of this, and moves the balls in this to the children
-		void haveChildren() {
-			for(int x = 0; x < 2; x++) {
-				float minX;
-				float maxX;
-				if (x == 0) {
-					minX = corner1[0];
-					maxX = center[0];
-				}
-				else {
-					minX = center[0];
-					maxX = corner2[0];
-				}
-				
-				for(int y = 0; y < 2; y++) {
-					float minY;
-					float maxY;
-					if (y == 0) {
-						minY = corner1[1];
-						maxY = center[1];
-					}
-					else {
-						minY = center[1];
-						maxY = corner2[1];
-					}
-					
-					for(int z = 0; z < 2; z++) {
-						float minZ;
-						float maxZ;
-						if (z == 0) {
-							minZ = corner1[2];
-							maxZ = center[2];
-						}
-						else {
-							minZ = center[2];
-							maxZ = corner2[2];
-						}
-						
-						children[x][y][z] = new Octree(Vec3f(minX, minY, minZ),
-													   Vec3f(maxX, maxY, maxZ),
-													   depth + 1);
-					}
-				}
-			}
-			
-			//Remove all balls from "balls" and add them to the new children
-			for(set<Ball*>::iterator it = balls.begin(); it != balls.end();
-					it++) {
-				Ball* ball = *it;
-				fileBall(ball, ball->pos, true);
-			}
-			balls.clear();
-			
-			hasChildren = true;
-		}
-		
-		//Adds all balls in this or one of its descendants to the specified set
-		void collectBalls(set<Ball*> &bs) {
-			if (hasChildren) {
-				for(int x = 0; x < 2; x++) {
-					for(int y = 0; y < 2; y++) {
-						for(int z = 0; z < 2; z++) {
-							children[x][y][z]->collectBalls(bs);
-						}
-					}
-				}
-			}
-			else {
-				for(set<Ball*>::iterator it = balls.begin(); it != balls.end();
-						it++) {
-					Ball* ball = *it;
-					bs.insert(ball);
-				}
-			}
-		}
-		
-		//Destroys the children of this, and moves all balls in its descendants
-		//to the "balls" set
-		void destroyChildren() {
-			//Move all balls in descendants of this to the "balls" set
-			collectBalls(balls);
-			
-			for(int x = 0; x < 2; x++) {
-				for(int y = 0; y < 2; y++) {
-					for(int z = 0; z < 2; z++) {
-						delete children[x][y][z];
-					}
-				}
-			}
-			
-			hasChildren = false;
-		}
-		
-		//Removes the specified ball at the indicated position
-		void remove(Ball* ball, Vec3f pos) {
-			numBalls--;
-			
-			if (hasChildren && numBalls < MIN_BALLS_PER_OCTREE) {
-				destroyChildren();
-			}
-			
-			if (hasChildren) {
-				fileBall(ball, pos, false);
-			}
-			else {
-				balls.erase(ball);
-			}
-		}
-		
-		/* Helper fuction for potentialBallWallCollisions(vector).  Adds
-		 * potential ball-wall collisions to cs, where w is the type of wall,
-		 * coord is the relevant coordinate of the wall ('x', 'y', or 'z'), and
-		 * dir is 0 if the wall is in the negative direction and 1 if it is in
-		 * the positive direction.  Assumes that this is in the extreme
-		 * direction of the coordinate, e.g. if w is WALL_TOP, the function
-		 * assumes that this is in the far upward direction.
-		 */
-		void potentialBallWallCollisions(vector<BallWallPair> &cs,
-										 Wall w, char coord, int dir) {
-			if (hasChildren) {
-				//Recursively call potentialBallWallCollisions on the correct
-				//half of the children (e.g. if w is WALL_TOP, call it on
-				//children above centerY)
-				for(int dir2 = 0; dir2 < 2; dir2++) {
-					for(int dir3 = 0; dir3 < 2; dir3++) {
-						Octree *child;
-						switch (coord) {
-							case 'x':
-								child = children[dir][dir2][dir3];
-								break;
-							case 'y':
-								child = children[dir2][dir][dir3];
-								break;
-							case 'z':
-								child = children[dir2][dir3][dir];
-								break;
-						}
-						
-						child->potentialBallWallCollisions(cs, w, coord, dir);
-					}
-				}
-			}
-			else {
-				//Add (ball, w) for all balls in this
-				for(set<Ball*>::iterator it = balls.begin(); it != balls.end();
-						it++) {
-					Ball* ball = *it;
-					BallWallPair bwp;
-					bwp.ball = ball;
-					bwp.wall = w;
-					cs.push_back(bwp);
-				}
-			}
-		}
-	public:
-		//Constructs a new Octree.  c1 is (minX, minY, minZ), c2 is (maxX, maxY,
-		//maxZ), and d is the depth, which starts at 1.
-		Octree(Vec3f c1, Vec3f c2, int d) {
-			corner1 = c1;
-			corner2 = c2;
-			center = (c1 + c2) / 2;
-			depth = d;
-			numBalls = 0;
-			hasChildren = false;
-		}
-		
-		//Destructor
-		~Octree() {
-			if (hasChildren) {
-				destroyChildren();
-			}
-		}
-		
-		//Adds a ball to this
-		void add(Ball* ball) {
-			numBalls++;
-			if (!hasChildren && depth < MAX_OCTREE_DEPTH &&
-				numBalls > MAX_BALLS_PER_OCTREE) {
-				haveChildren();
-			}
-			
-			if (hasChildren) {
-				fileBall(ball, ball->pos, true);
-			}
-			else {
-				balls.insert(ball);
-			}
-		}
-		
-		//Removes a ball from this
-		void remove(Ball* ball) {
-			remove(ball, ball->pos);
-		}
-		
-		//Changes the position of a ball in this from oldPos to ball->pos
-		void ballMoved(Ball* ball, Vec3f oldPos) {
-			remove(ball, oldPos);
-			add(ball);
-		}
-		
-		//Adds potential ball-ball collisions to the specified set
-		void potentialBallBallCollisions(vector<BallPair> &collisions) {
-			if (hasChildren) {
-				for(int x = 0; x < 2; x++) {
-					for(int y = 0; y < 2; y++) {
-						for(int z = 0; z < 2; z++) {
-							children[x][y][z]->
-								potentialBallBallCollisions(collisions);
-						}
-					}
-				}
-			}
-			else {
-				//Add all pairs (ball1, ball2) from balls
-				for(set<Ball*>::iterator it = balls.begin(); it != balls.end();
-						it++) {
-					Ball* ball1 = *it;
-					for(set<Ball*>::iterator it2 = balls.begin();
-							it2 != balls.end(); it2++) {
-						Ball* ball2 = *it2;
-						//This test makes sure that we only add each pair once
-						if (ball1 < ball2) {
-							BallPair bp;
-							bp.ball1 = ball1;
-							bp.ball2 = ball2;
-							collisions.push_back(bp);
-						}
-					}
-				}
-			}
-		}
-		
-		//Adds potential ball-wall collisions to the specified set
-		void potentialBallWallCollisions(vector<BallWallPair> &collisions) {
-			potentialBallWallCollisions(collisions, WALL_LEFT, 'x', 0);
-			potentialBallWallCollisions(collisions, WALL_RIGHT, 'x', 1);
-			potentialBallWallCollisions(collisions, WALL_BOTTOM, 'y', 0);
-			potentialBallWallCollisions(collisions, WALL_TOP, 'y', 1);
-			potentialBallWallCollisions(collisions, WALL_FAR, 'z', 0);
-			potentialBallWallCollisions(collisions, WALL_NEAR, 'z', 1);
-		}
-};
-
-//Puts potential ball-ball collisions in potentialCollisions.  It must return
-//all actual collisions, but it need not return only actual collisions.
-void potentialBallBallCollisions(vector<BallPair> &potentialCollisions,
-								 vector<Ball*> &balls, Octree* octree) {
-	//Fast method
-	octree->potentialBallBallCollisions(potentialCollisions);
-	
-	/*
-	//Slow method
-	for(unsigned int i = 0; i < balls.size(); i++) {
-		for(unsigned int j = i + 1; j < balls.size(); j++) {
-			BallPair bp;
-			bp.ball1 = balls[i];
-			bp.ball2 = balls[j];
-			potentialCollisions.push_back(bp);
-		}
-	}
-	*/
-}
-
-//Puts potential ball-wall collisions in potentialCollisions.  It must return
-//all actual collisions, but it need not return only actual collisions.
-void potentialBallWallCollisions(vector<BallWallPair> &potentialCollisions,
-								 vector<Ball*> &balls, Octree* octree) {
-	//Fast method
-	octree->potentialBallWallCollisions(potentialCollisions);
-	
-	/*
-	//Slow method
-	Wall walls[] =
-		{WALL_LEFT, WALL_RIGHT, WALL_FAR, WALL_NEAR, WALL_TOP, WALL_BOTTOM};
-	for(unsigned int i = 0; i < balls.size(); i++) {
-		for(int j = 0; j < 6; j++) {
-			BallWallPair bwp;
-			bwp.ball = balls[i];
-			bwp.wall = walls[j];
-			potentialCollisions.push_back(bwp);
-		}
-	}
-	*/
-}
-
 //Moves all of the balls by their velocity times dt
-void moveBalls(vector<Ball*> &balls, Octree* octree, float dt) {
+void moveBalls(vector<Ball*> &balls, BroadPhase* broadPhase, float dt) {
 	for(unsigned int i = 0; i < balls.size(); i++) {
 		Ball* ball = balls[i];
 		Vec3f oldPos = ball->pos;
 		ball->pos += ball->v * dt;
-		octree->ballMoved(ball, oldPos);
+		broadPhase->ballMoved(ball, oldPos);
 	}
 }
 
@@ -465,10 +90,9 @@ bool testBallBallCollision(Ball* b1, Ball* b2) {
 		return false;
 }
 
-//Handles all ball-ball collisions
-void handleBallBallCollisions(vector<Ball*> &balls, Octree* octree) {
-	vector<BallPair> bps;
-	potentialBallBallCollisions(bps, balls, octree);
+//Makes the balls in each of the pairs that are colliding reflect off of each
+//other
+void bounceBalls(vector<BallPair> &bps) {
 	for(unsigned int i = 0; i < bps.size(); i++) {
 		BallPair bp = bps[i];
 		
@@ -483,6 +107,13 @@ void handleBallBallCollisions(vector<Ball*> &balls, Octree* octree) {
 	}
 }
 
+//Handles all ball-ball collisions
+void handleBallBallCollisions(BroadPhase* broadPhase) {
+	vector<BallPair> bps;
+	broadPhase->potentialBallBallCollisions(bps);
+	bounceBalls(bps);
+}
+
 //Returns the direction from the origin to the wall
 Vec3f wallDirection(Wall wall) {
 	switch (wall) {
@@ -512,10 +143,9 @@ bool testBallWallCollision(Ball* ball, Wall wall) {
 			ball->v.dot(dir) > 0;
 }
 
-//Handles all ball-wall collisions
-void handleBallWallCollisions(vector<Ball*> &balls, Octree* octree) {
-	vector<BallWallPair> bwps;
-	potentialBallWallCollisions(bwps, balls, octree);
+//Makes each ball that is colliding with the wall it is paired with reflect
+//off of the wall
+void bounceOffWalls(vector<BallWallPair> &bwps) {
 	for(unsigned int i = 0; i < bwps.size(); i++) {
 		BallWallPair bwp = bwps[i];
 		
@@ -529,42 +159,185 @@ void handleBallWallCollisions(vector<Ball*> &balls, Octree* octree) {
 	}
 }
 
+//Handles all ball-wall collisions
+void handleBallWallCollisions(BroadPhase* broadPhase) {
+	vector<BallWallPair> bwps;
+	broadPhase->potentialBallWallCollisions(bwps);
+	bounceOffWalls(bwps);
+}
+
 //Applies gravity and handles all collisions.  Should be called every
 //TIME_BETWEEN_UPDATES seconds.
-void performUpdate(vector<Ball*> &balls, Octree* octree) {
+void performUpdate(vector<Ball*> &balls, BroadPhase* broadPhase) {
 	applyGravity(balls);
-	handleBallBallCollisions(balls, octree);
-	handleBallWallCollisions(balls, octree);
+	handleBallBallCollisions(broadPhase);
+	handleBallWallCollisions(broadPhase);
 }
 
 //Advances the state of the balls by t.  timeUntilUpdate is the amount of time
 //until the next call to performUpdate.
 void advance(vector<Ball*> &balls,
-			 Octree* octree,
+			 BroadPhase* broadPhase,
 			 float t,
 			 float &timeUntilUpdate) {
 	while (t > 0) {
 		if (timeUntilUpdate <= t) {
-			moveBalls(balls, octree, timeUntilUpdate);
-			performUpdate(balls, octree);
+			moveBalls(balls, broadPhase, timeUntilUpdate);
+			performUpdate(balls, broadPhase);
 			t -= timeUntilUpdate;
 			timeUntilUpdate = TIME_BETWEEN_UPDATES;
 		}
 		else {
-			moveBalls(balls, octree, t);
+			moveBalls(balls, broadPhase, t);
 			timeUntilUpdate -= t;
 			t = 0;
 		}
 	}
 }
 
+//Returns the number of milliseconds since some fixed time
+double milliseconds() {
+	return chrono::duration<double, milli>(
+		chrono::steady_clock::now().time_since_epoch()).count();
+}
 
+/* Times adding the specified balls to a BroadPhase of the kind with the
+ * specified name, moving them, and finding their potential collisions, and
+ * prints the results along with the number of times the BroadPhase changed
+ * where it keeps a ball, split or merged regions of the box, and allocated
+ * memory once the balls were moving.
+ * There is no gravity, so that the balls stay spread through the box and the
+ * BroadPhase settles into a steady state.
+ */
+void timeBroadPhase(const char* name, vector<Ball> ballData) {
+	const int NUM_WARMUP_STEPS = 10;
+	const int NUM_STEPS = 20;
+	
+	BroadPhase* broadPhase =
+		makeBroadPhase(name,
+					   Vec3f(-BOX_SIZE / 2, -BOX_SIZE / 2, -BOX_SIZE / 2),
+					   Vec3f(BOX_SIZE / 2, BOX_SIZE / 2, BOX_SIZE / 2));
+	vector<Ball*> balls(ballData.size());
+	for(unsigned int i = 0; i < ballData.size(); i++) {
+		balls[i] = &ballData[i];
+	}
+	double startTime = milliseconds();
+	for(unsigned int i = 0; i < balls.size(); i++) {
+		broadPhase->add(balls[i]);
+	}
+	double addTime = milliseconds() - startTime;
+	
+	vector<BallPair> bps;
+	vector<BallWallPair> bwps;
+	double moveTime = 0;
+	double findTime = 0;
+	long long numPairs = 0;
+	long long numAllocations = 0;
+	for(int step = 0; step < NUM_WARMUP_STEPS + NUM_STEPS; step++) {
+		if (step == NUM_WARMUP_STEPS) {
+			broadPhase->resetStats();
+		}
+		long long allocationsBefore = broadPhase->numAllocations();
+		double time1 = milliseconds();
+		moveBalls(balls, broadPhase, TIME_BETWEEN_UPDATES);
+		double time2 = milliseconds();
+		bps.clear();
+		bwps.clear();
+		broadPhase->potentialBallBallCollisions(bps);
+		broadPhase->potentialBallWallCollisions(bwps);
+		double time3 = milliseconds();
+		bounceBalls(bps);
+		bounceOffWalls(bwps);
+		
+		if (step >= NUM_WARMUP_STEPS) {
+			moveTime += time2 - time1;
+			findTime += time3 - time2;
+			numPairs += bps.size();
+			numAllocations +=
+				broadPhase->numAllocations() - allocationsBefore;
+		}
+	}
+	
+	cout << "    " << name << ": " << addTime << " ms to add, "
+		 << moveTime / NUM_STEPS << " ms per step to move, "
+		 << findTime / NUM_STEPS << " ms per step to find "
+		 << numPairs / NUM_STEPS << " potential collisions, "
+		 << broadPhase->numBallUpdates() / NUM_STEPS << " ball updates and "
+		 << (broadPhase->numSplits() + broadPhase->numMerges()) /
+			(double)NUM_STEPS
+		 << " splits and merges per step, " << numAllocations
+		 << " allocations while moving" << endl;
+	delete broadPhase;
+}
 
-
+/* Times each kind of BroadPhase with 1,000 to 1,000,000 balls and prints the
+ * results.  The more balls there are, the smaller and slower they are, so
+ * that they fill the same fraction of the box and cross it in the same
+ * number of steps.  Each number of balls is timed with balls of the usual
+ * sizes, with balls twice as large, and with one ball in 50 eight times as
+ * large, since which kind of BroadPhase is fastest depends on all of these.
+ * To keep the benchmark from taking too long, 1,000,000 balls are only timed
+ * with the usual sizes, using the octrees and the hash grid.
+ */
+void benchmark() {
+	const int NUM_BALL_COUNTS = 4;
+	const int BALL_COUNTS[NUM_BALL_COUNTS] = {1000, 10000, 100000, 1000000};
+	//The number of balls with the usual sizes and speeds
+	const float USUAL_NUM_BALLS = 1000;
+	//The most balls with which to time comparing every pair of balls
+	const int MAX_BRUTE_FORCE_BALLS = 10000;
+	//The most balls with which to time sweep and prune, and with which to
+	//time balls of other than the usual sizes
+	const int MAX_OTHER_BALLS = 100000;
+	const int NUM_DENSITIES = 3;
+	const char* DENSITY_NAMES[NUM_DENSITIES] = {"sparse", "dense", "mixed"};
+	
+	for(int i = 0; i < NUM_BALL_COUNTS; i++) {
+		int numBalls = BALL_COUNTS[i];
+		float scale = pow(USUAL_NUM_BALLS / numBalls, 1.0f / 3);
+		for(int density = 0; density < NUM_DENSITIES; density++) {
+			if (density > 0 && numBalls > MAX_OTHER_BALLS) {
+				continue;
+			}
+			
+			srand(0);
+			vector<Ball> ballData(numBalls);
+			for(int j = 0; j < numBalls; j++) {
+				Ball &ball = ballData[j];
+				ball.pos = Vec3f((BOX_SIZE - 1) * (randomFloat() - 0.5f),
+								 (BOX_SIZE - 1) * (randomFloat() - 0.5f),
+								 (BOX_SIZE - 1) * (randomFloat() - 0.5f));
+				ball.v = scale * Vec3f(8 * randomFloat() - 4,
+									   8 * randomFloat() - 4,
+									   8 * randomFloat() - 4);
+				ball.r = scale * (0.1f * randomFloat() + 0.1f);
+				if (density == 1) {
+					ball.r *= 2;
+				}
+				else if (density == 2 && j % 50 == 0) {
+					ball.r *= 8;
+				}
+				ball.color = Vec3f(1, 1, 1);
+			}
+			
+			cout << numBalls << " " << DENSITY_NAMES[density] << " balls:"
+				 << endl;
+			for(int j = 0; j < NUM_BROAD_PHASES; j++) {
+				if ((strcmp(BROAD_PHASE_NAMES[j], "bruteforce") == 0 &&
+					 numBalls > MAX_BRUTE_FORCE_BALLS) ||
+					(strcmp(BROAD_PHASE_NAMES[j], "sweepandprune") == 0 &&
+					 numBalls > MAX_OTHER_BALLS)) {
+					continue;
+				}
+				timeBroadPhase(BROAD_PHASE_NAMES[j], ballData);
+			}
+		}
+	}
+}
 
 vector<Ball*> _balls; //All of the balls in play
 float _angle = 0.0f; //The camera angle
-Octree* _octree; //An octree with all af the balls
+BroadPhase* _broadPhase; //Finds the potential collisions of the balls
 //The amount of time until performUpdate should be called
 float _timeUntilUpdate = 0;
 GLuint _textureId;
@@ -574,7 +347,7 @@ void cleanup() {
 	for(unsigned int i = 0; i < _balls.size(); i++) {
 		delete _balls[i];
 	}
-	delete _octree;
+	delete _broadPhase;
 }
 
 void handleKeypress(unsigned char key, int x, int y) {
@@ -597,7 +370,7 @@ void handleKeypress(unsigned char key, int x, int y) {
 									0.6f * randomFloat() + 0.2f,
 									0.6f * randomFloat() + 0.2f);
 				_balls.push_back(ball);
-				_octree->add(ball);
+				_broadPhase->add(ball);
 			}
 	}
 }
@@ -700,7 +473,10 @@ void drawScene() {
 
 //Called every TIMER_MS milliseconds
 void update(int value) {
-	advance(_balls, _octree, (float)TIMER_MS / 1000.0f, _timeUntilUpdate);
+	advance(_balls,
+			_broadPhase,
+			(float)TIMER_MS / 1000.0f,
+			_timeUntilUpdate);
 	_angle += (float)TIMER_MS / 100;
 	if (_angle > 360) {
 		_angle -= 360;
@@ -711,6 +487,35 @@ void update(int value) {
 }
 
 int main(int argc, char** argv) {
+	/* Usage: collisions [-bench] [-broadphase name]
+	 * -bench: Rather than showing the balls, times each way of finding
+	 *         potential collisions with different numbers and sizes of balls
+	 *         and prints the results
+	 * -broadphase: Finds potential collisions with the specified kind of
+	 *              BroadPhase, which is octree (the default), looseoctree,
+	 *              hashgrid, sweepandprune, or bruteforce
+	 */
+	const char* broadPhaseName = "octree";
+	for(int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-bench") == 0) {
+			benchmark();
+			return 0;
+		}
+		else if (strcmp(argv[i], "-broadphase") == 0 && i + 1 < argc) {
+			broadPhaseName = argv[i + 1];
+			i++;
+		}
+	}
+	
+	_broadPhase =
+		makeBroadPhase(broadPhaseName,
+					   Vec3f(-BOX_SIZE / 2, -BOX_SIZE / 2, -BOX_SIZE / 2),
+					   Vec3f(BOX_SIZE / 2, BOX_SIZE / 2, BOX_SIZE / 2));
+	if (_broadPhase == NULL) {
+		cerr << "Unknown broad phase " << broadPhaseName << endl;
+		return 1;
+	}
+	
 	srand((unsigned int)time(0)); //Seed the random number generator
 	
 	glutInit(&argc, argv);
@@ -720,9 +525,6 @@ int main(int argc, char** argv) {
 	glutCreateWindow("Collision Detection - videotutorialsrock.com");
 	initRendering();
 	
-	_octree = new Octree(Vec3f(-BOX_SIZE / 2, -BOX_SIZE / 2, -BOX_SIZE / 2),
-						 Vec3f(BOX_SIZE / 2, BOX_SIZE / 2, BOX_SIZE / 2), 1);
-	
 	glutDisplayFunc(drawScene);
 	glutKeyboardFunc(handleKeypress);
 	glutReshapeFunc(handleResize);
@@ -0,0 +1,409 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include "octree.h"
+
+using namespace std;
+
+Octree::Octree(Vec3f c1, Vec3f c2) : freeBlocks(NULL), allocations(0) {
+	initNode(root, c1, c2, 1);
+	resetStats();
+}
+
+Octree::~Octree() {
+	for(unsigned int i = 0; i < slabs.size(); i++) {
+		delete[] slabs[i];
+	}
+	for(unsigned int i = 0; i < ballLists.size(); i++) {
+		delete ballLists[i];
+	}
+}
+
+void Octree::initNode(Node &node, Vec3f c1, Vec3f c2, int depth) {
+	node.corner1 = c1;
+	node.corner2 = c2;
+	node.center = (c1 + c2) / 2;
+	node.children = NULL;
+	node.depth = depth;
+	node.numBalls = 0;
+	node.numLeafBalls = 0;
+	node.moreBalls = NULL;
+}
+
+Ball** Octree::leafBalls(Node &node) {
+	if (node.numLeafBalls <= MAX_BALLS_PER_OCTREE) {
+		return node.inlineBalls;
+	}
+	else {
+		return &(*node.moreBalls)[0];
+	}
+}
+
+void Octree::addToLeaf(Node &node, Ball* ball) {
+	if (node.numLeafBalls < MAX_BALLS_PER_OCTREE) {
+		node.inlineBalls[node.numLeafBalls] = ball;
+	}
+	else {
+		//Move to a list once the balls don't fit in inlineBalls
+		if (node.numLeafBalls == MAX_BALLS_PER_OCTREE) {
+			if (spareBallLists.empty()) {
+				//Make sure that releaseBallList never needs to allocate
+				ballLists.push_back(new vector<Ball*>());
+				spareBallLists.reserve(ballLists.capacity());
+				spareBallLists.push_back(ballLists.back());
+				allocations++;
+			}
+			node.moreBalls = spareBallLists.back();
+			spareBallLists.pop_back();
+			node.moreBalls->assign(node.inlineBalls,
+								   node.inlineBalls + MAX_BALLS_PER_OCTREE);
+		}
+		size_t capacity = node.moreBalls->capacity();
+		node.moreBalls->push_back(ball);
+		if (node.moreBalls->capacity() != capacity) {
+			allocations++;
+		}
+	}
+	node.numLeafBalls++;
+	ballUpdates++;
+}
+
+void Octree::removeFromLeaf(Node &node, Ball* ball) {
+	Ball** balls = leafBalls(node);
+	for(int i = 0; i < node.numLeafBalls; i++) {
+		if (balls[i] == ball) {
+			//Move the last ball into the ball's place
+			balls[i] = balls[node.numLeafBalls - 1];
+			if (node.numLeafBalls > MAX_BALLS_PER_OCTREE) {
+				node.moreBalls->pop_back();
+				//Move back to inlineBalls once the balls fit
+				if (node.numLeafBalls == MAX_BALLS_PER_OCTREE + 1) {
+					for(int j = 0; j < MAX_BALLS_PER_OCTREE; j++) {
+						node.inlineBalls[j] = (*node.moreBalls)[j];
+					}
+					releaseBallList(node);
+				}
+			}
+			node.numLeafBalls--;
+			ballUpdates++;
+			return;
+		}
+	}
+}
+
+void Octree::releaseBallList(Node &node) {
+	if (node.moreBalls != NULL) {
+		node.moreBalls->clear();
+		spareBallLists.push_back(node.moreBalls);
+		node.moreBalls = NULL;
+	}
+}
+
+void Octree::fileBall(Node &node, Ball* ball, Vec3f pos, bool addBall) {
+	//Figure out in which child(ren) the ball belongs
+	for(int x = 0; x < 2; x++) {
+		if (x == 0) {
+			if (pos[0] - ball->r > node.center[0]) {
+				continue;
+			}
+		}
+		else if (pos[0] + ball->r < node.center[0]) {
+			continue;
+		}
+		
+		for(int y = 0; y < 2; y++) {
+			if (y == 0) {
+				if (pos[1] - ball->r > node.center[1]) {
+					continue;
+				}
+			}
+			else if (pos[1] + ball->r < node.center[1]) {
+				continue;
+			}
+			
+			for(int z = 0; z < 2; z++) {
+				if (z == 0) {
+					if (pos[2] - ball->r > node.center[2]) {
+						continue;
+					}
+				}
+				else if (pos[2] + ball->r < node.center[2]) {
+					continue;
+				}
+				
+				//Add or remove the ball
+				Node &child = node.children->nodes[4 * x + 2 * y + z];
+				if (addBall) {
+					add(child, ball);
+				}
+				else {
+					remove(child, ball, pos);
+				}
+			}
+		}
+	}
+}
+
+void Octree::haveChildren(Node &node) {
+	//Allocate more blocks if they're all in use
+	if (freeBlocks == NULL) {
+		NodeBlock* slab = new NodeBlock[OCTREE_BLOCKS_PER_SLAB];
+		slabs.push_back(slab);
+		allocations++;
+		for(int i = 0; i < OCTREE_BLOCKS_PER_SLAB; i++) {
+			slab[i].nextFree = freeBlocks;
+			freeBlocks = &slab[i];
+		}
+	}
+	NodeBlock* block = freeBlocks;
+	freeBlocks = block->nextFree;
+	splits++;
+	
+	for(int x = 0; x < 2; x++) {
+		float minX = x == 0 ? node.corner1[0] : node.center[0];
+		float maxX = x == 0 ? node.center[0] : node.corner2[0];
+		for(int y = 0; y < 2; y++) {
+			float minY = y == 0 ? node.corner1[1] : node.center[1];
+			float maxY = y == 0 ? node.center[1] : node.corner2[1];
+			for(int z = 0; z < 2; z++) {
+				float minZ = z == 0 ? node.corner1[2] : node.center[2];
+				float maxZ = z == 0 ? node.center[2] : node.corner2[2];
+				initNode(block->nodes[4 * x + 2 * y + z],
+						 Vec3f(minX, minY, minZ),
+						 Vec3f(maxX, maxY, maxZ),
+						 node.depth + 1);
+			}
+		}
+	}
+	node.children = block;
+	
+	//Move the balls in the node to the new children.  A node with children
+	//is never deeper than MAX_OCTREE_DEPTH - 1, so its balls are all in
+	//inlineBalls.
+	for(int i = 0; i < node.numLeafBalls; i++) {
+		Ball* ball = node.inlineBalls[i];
+		fileBall(node, ball, ball->pos, true);
+	}
+	ballUpdates += node.numLeafBalls;
+	node.numLeafBalls = 0;
+}
+
+void Octree::collectBalls(Node &node, Node &into) {
+	if (node.children != NULL) {
+		for(int i = 0; i < 8; i++) {
+			collectBalls(node.children->nodes[i], into);
+		}
+	}
+	else {
+		Ball** balls = leafBalls(node);
+		for(int i = 0; i < node.numLeafBalls; i++) {
+			//A ball may be in more than one of the leaves
+			Ball** intoBalls = leafBalls(into);
+			bool found = false;
+			for(int j = 0; j < into.numLeafBalls; j++) {
+				if (intoBalls[j] == balls[i]) {
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				addToLeaf(into, balls[i]);
+			}
+		}
+	}
+}
+
+void Octree::destroyChildren(Node &node) {
+	NodeBlock* block = node.children;
+	node.children = NULL;
+	merges++;
+	for(int i = 0; i < 8; i++) {
+		collectBalls(block->nodes[i], node);
+	}
+	freeBlock(block);
+}
+
+void Octree::freeBlock(NodeBlock* block) {
+	for(int i = 0; i < 8; i++) {
+		if (block->nodes[i].children != NULL) {
+			freeBlock(block->nodes[i].children);
+		}
+		releaseBallList(block->nodes[i]);
+	}
+	block->nextFree = freeBlocks;
+	freeBlocks = block;
+}
+
+void Octree::add(Node &node, Ball* ball) {
+	node.numBalls++;
+	if (node.children == NULL && node.depth < MAX_OCTREE_DEPTH &&
+		node.numBalls > MAX_BALLS_PER_OCTREE) {
+		haveChildren(node);
+	}
+	
+	if (node.children != NULL) {
+		fileBall(node, ball, ball->pos, true);
+	}
+	else {
+		addToLeaf(node, ball);
+	}
+}
+
+void Octree::remove(Node &node, Ball* ball, Vec3f pos) {
+	node.numBalls--;
+	
+	if (node.children != NULL && node.numBalls < MIN_BALLS_PER_OCTREE) {
+		destroyChildren(node);
+	}
+	
+	if (node.children != NULL) {
+		fileBall(node, ball, pos, false);
+	}
+	else {
+		removeFromLeaf(node, ball);
+	}
+}
+
+void Octree::potentialBallBallCollisions(Node &node,
+										 vector<BallPair> &collisions) {
+	if (node.children != NULL) {
+		for(int i = 0; i < 8; i++) {
+			potentialBallBallCollisions(node.children->nodes[i], collisions);
+		}
+	}
+	else {
+		//Add all pairs (ball1, ball2) from the balls in the node
+		Ball** balls = leafBalls(node);
+		for(int i = 0; i < node.numLeafBalls; i++) {
+			for(int j = i + 1; j < node.numLeafBalls; j++) {
+				BallPair bp;
+				bp.ball1 = balls[i];
+				bp.ball2 = balls[j];
+				collisions.push_back(bp);
+			}
+		}
+	}
+}
+
+void Octree::potentialBallWallCollisions(Node &node,
+										 vector<BallWallPair> &cs,
+										 Wall w,
+										 char coord,
+										 int dir) {
+	if (node.children != NULL) {
+		//Recursively call potentialBallWallCollisions on the correct half of
+		//the children (e.g. if w is WALL_TOP, call it on children above
+		//centerY)
+		for(int dir2 = 0; dir2 < 2; dir2++) {
+			for(int dir3 = 0; dir3 < 2; dir3++) {
+				int child;
+				switch (coord) {
+					case 'x':
+						child = 4 * dir + 2 * dir2 + dir3;
+						break;
+					case 'y':
+						child = 4 * dir2 + 2 * dir + dir3;
+						break;
+					default:
+						child = 4 * dir2 + 2 * dir3 + dir;
+						break;
+				}
+				
+				potentialBallWallCollisions(node.children->nodes[child],
+											cs,
+											w,
+											coord,
+											dir);
+			}
+		}
+	}
+	else {
+		//Add (ball, w) for all balls in the node
+		Ball** balls = leafBalls(node);
+		for(int i = 0; i < node.numLeafBalls; i++) {
+			BallWallPair bwp;
+			bwp.ball = balls[i];
+			bwp.wall = w;
+			cs.push_back(bwp);
+		}
+	}
+}
+
+void Octree::add(Ball* ball) {
+	add(root, ball);
+}
+
+void Octree::remove(Ball* ball) {
+	remove(root, ball, ball->pos);
+}
+
+void Octree::ballMoved(Ball* ball, Vec3f oldPos) {
+	remove(root, ball, oldPos);
+	add(root, ball);
+}
+
+void Octree::potentialBallBallCollisions(vector<BallPair> &collisions) {
+	potentialBallBallCollisions(root, collisions);
+}
+
+void Octree::potentialBallWallCollisions(vector<BallWallPair> &collisions) {
+	potentialBallWallCollisions(root, collisions, WALL_LEFT, 'x', 0);
+	potentialBallWallCollisions(root, collisions, WALL_RIGHT, 'x', 1);
+	potentialBallWallCollisions(root, collisions, WALL_BOTTOM, 'y', 0);
+	potentialBallWallCollisions(root, collisions, WALL_TOP, 'y', 1);
+	potentialBallWallCollisions(root, collisions, WALL_FAR, 'z', 0);
+	potentialBallWallCollisions(root, collisions, WALL_NEAR, 'z', 1);
+}
+
+long long Octree::numAllocations() const {
+	return allocations;
+}
+
+long long Octree::numBallUpdates() const {
+	return ballUpdates;
+}
+
+long long Octree::numSplits() const {
+	return splits;
+}
+
+long long Octree::numMerges() const {
+	return merges;
+}
+
+void Octree::resetStats() {
+	ballUpdates = 0;
+	splits = 0;
+	merges = 0;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,191 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef OCTREE_H_INCLUDED
+#define OCTREE_H_INCLUDED
+
+#include <vector>
+
+#include "ball.h"
+#include "broadphase.h"
+#include "vec3f.h"
+
+const int MAX_OCTREE_DEPTH = 6;
+const int MIN_BALLS_PER_OCTREE = 3;
+const int MAX_BALLS_PER_OCTREE = 6;
+//The number of blocks of eight nodes that an Octree allocates at once
+const int OCTREE_BLOCKS_PER_SLAB = 64;
+
+/* Our data structure for making collision detection faster.  Each node
+ * either has eight children or is a leaf holding the balls that touch it.
+ *
+ * The eight children of a node are kept together in one block.  Blocks are
+ * allocated OCTREE_BLOCKS_PER_SLAB at a time, and the blocks of nodes whose
+ * children are destroyed are kept for reuse rather than freed.  A leaf keeps
+ * up to MAX_BALLS_PER_OCTREE balls in an array inside it.  Only leaves at
+ * MAX_OCTREE_DEPTH can outgrow that, and they borrow a list for their balls
+ * from a pool of lists that keep their memory.  So once the tree has been as
+ * large as it gets, adding, removing, and moving balls and finding potential
+ * collisions don't allocate memory.
+ */
+class Octree : public BroadPhase {
+	private:
+		struct NodeBlock;
+		
+		//A part of the box
+		struct Node {
+			Vec3f corner1; //(minX, minY, minZ)
+			Vec3f corner2; //(maxX, maxY, maxZ)
+			//((minX + maxX) / 2, (minY + maxY) / 2, (minZ + maxZ) / 2)
+			Vec3f center;
+			/* The eight children of this, or NULL if this is a leaf.
+			 * children->nodes[4 * x + 2 * y + z] is the child on the low side
+			 * of center in each dimension whose index is 0 and on the high
+			 * side in each dimension whose index is 1.
+			 */
+			NodeBlock* children;
+			//The depth of this in the tree, which is 1 for the root
+			int depth;
+			//The number of balls in this, including those stored in its
+			//children
+			int numBalls;
+			//The number of balls stored in this, if this is a leaf
+			int numLeafBalls;
+			//The balls in this, if this is a leaf with at most
+			//MAX_BALLS_PER_OCTREE balls
+			Ball* inlineBalls[MAX_BALLS_PER_OCTREE];
+			//The balls in this, if this is a leaf with more balls, or NULL
+			std::vector<Ball*>* moreBalls;
+		};
+		
+		//The children of a node, or a free block
+		struct NodeBlock {
+			Node nodes[8];
+			//The next free block, if this is free
+			NodeBlock* nextFree;
+		};
+		
+		Node root;
+		//The arrays of OCTREE_BLOCKS_PER_SLAB blocks this has allocated
+		std::vector<NodeBlock*> slabs;
+		//The first of the blocks that aren't in use
+		NodeBlock* freeBlocks;
+		//Every list this has allocated for the moreBalls of leaves
+		std::vector<std::vector<Ball*>*> ballLists;
+		//The lists in ballLists that aren't in use
+		std::vector<std::vector<Ball*>*> spareBallLists;
+		//The number of times this has allocated memory
+		long long allocations;
+		//The statistics since the last call to resetStats
+		long long ballUpdates;
+		long long splits;
+		long long merges;
+		
+		//Sets up a leaf with no balls
+		static void initNode(Node &node, Vec3f c1, Vec3f c2, int depth);
+		//Returns the balls stored in the specified leaf
+		static Ball** leafBalls(Node &node);
+		//Adds a ball to the balls stored in the specified leaf
+		void addToLeaf(Node &node, Ball* ball);
+		//Removes a ball from the balls stored in the specified leaf
+		void removeFromLeaf(Node &node, Ball* ball);
+		//Returns the node's moreBalls to spareBallLists, if it has one
+		void releaseBallList(Node &node);
+		
+		//Adds a ball to or removes one from the children of the node
+		void fileBall(Node &node, Ball* ball, Vec3f pos, bool addBall);
+		//Creates children of the node, and moves the balls in the node to the
+		//children
+		void haveChildren(Node &node);
+		//Adds all balls in node or one of its descendants to the balls stored
+		//in the leaf "into", unless they're there already
+		void collectBalls(Node &node, Node &into);
+		//Destroys the children of the node, and moves all balls in its
+		//descendants to the node
+		void destroyChildren(Node &node);
+		//Puts the block and the blocks of the descendants of its nodes on the
+		//list of free blocks
+		void freeBlock(NodeBlock* block);
+		//Adds a ball to the node
+		void add(Node &node, Ball* ball);
+		//Removes the specified ball at the indicated position from the node
+		void remove(Node &node, Ball* ball, Vec3f pos);
+		//Adds potential ball-ball collisions in the node to the specified
+		//vector
+		void potentialBallBallCollisions(Node &node,
+										 std::vector<BallPair> &collisions);
+		/* Helper fuction for potentialBallWallCollisions(vector).  Adds
+		 * potential ball-wall collisions in the node to cs, where w is the
+		 * type of wall, coord is the relevant coordinate of the wall ('x',
+		 * 'y', or 'z'), and dir is 0 if the wall is in the negative direction
+		 * and 1 if it is in the positive direction.  Assumes that the node is
+		 * in the extreme direction of the coordinate, e.g. if w is WALL_TOP,
+		 * the function assumes that the node is in the far upward direction.
+		 */
+		void potentialBallWallCollisions(Node &node,
+										 std::vector<BallWallPair> &cs,
+										 Wall w,
+										 char coord,
+										 int dir);
+	public:
+		//Constructs a new Octree.  c1 is (minX, minY, minZ) and c2 is (maxX,
+		//maxY, maxZ).
+		Octree(Vec3f c1, Vec3f c2);
+		~Octree();
+		
+		//Adds a ball to this
+		void add(Ball* ball);
+		//Removes a ball from this
+		void remove(Ball* ball);
+		//Changes the position of a ball in this from oldPos to ball->pos
+		void ballMoved(Ball* ball, Vec3f oldPos);
+		
+		//Adds potential ball-ball collisions to the specified vector
+		void potentialBallBallCollisions(std::vector<BallPair> &collisions);
+		//Adds potential ball-wall collisions to the specified vector
+		void potentialBallWallCollisions(std::vector<BallWallPair> &collisions);
+		
+		//Returns the number of times this has allocated memory for nodes or
+		//for the balls in its leaves
+		long long numAllocations() const;
+		//Returns the number of times a ball was stored in or taken out of a
+		//node
+		long long numBallUpdates() const;
+		//Returns the number of times a node was given children
+		long long numSplits() const;
+		//Returns the number of times a node's children were destroyed
+		long long numMerges() const;
+		void resetStats();
+};
+
+
+
+
+
+
+
+
+
+
+#endif
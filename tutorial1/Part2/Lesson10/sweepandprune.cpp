@@ -0,0 +1,264 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <algorithm>
+
+#include "sweepandprune.h"
+
+using namespace std;
+
+SweepAndPrune::SweepAndPrune(Vec3f c1, Vec3f c2) : corner1(c1),
+												   corner2(c2),
+												   numAdded(0) {
+	resetStats();
+}
+
+bool SweepAndPrune::comesBefore(const Endpoint &endpoint1,
+								const Endpoint &endpoint2) {
+	if (endpoint1.value != endpoint2.value) {
+		return endpoint1.value < endpoint2.value;
+	}
+	return (endpoint1.id & 1) < (endpoint2.id & 1);
+}
+
+unsigned long long SweepAndPrune::pairKey(int slot1, int slot2) {
+	if (slot1 > slot2) {
+		swap(slot1, slot2);
+	}
+	return ((unsigned long long)slot1 << 32) | (unsigned long long)slot2;
+}
+
+bool SweepAndPrune::boxesOverlap(int slot1, int slot2) {
+	const Box &box1 = boxes[slot1];
+	const Box &box2 = boxes[slot2];
+	for(int axis = 0; axis < 3; axis++) {
+		if (box1.high[axis] < box2.low[axis] ||
+			box2.high[axis] < box1.low[axis]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SweepAndPrune::updateEnds(int axis) {
+	vector<Endpoint> &ends = endpoints[axis];
+	for(unsigned int i = 0; i < ends.size(); i++) {
+		const Box &box = boxes[ends[i].id / 2];
+		ends[i].value = (ends[i].id & 1) ? box.high[axis] : box.low[axis];
+	}
+}
+
+void SweepAndPrune::sortAxis(int axis) {
+	vector<Endpoint> &ends = endpoints[axis];
+	for(int i = 1; i < (int)ends.size(); i++) {
+		Endpoint endpoint = ends[i];
+		int slot = endpoint.id / 2;
+		int j = i;
+		while (j > 0 && comesBefore(endpoint, ends[j - 1])) {
+			const Endpoint &other = ends[j - 1];
+			if ((endpoint.id & 1) == 0 && (other.id & 1) == 1) {
+				//The low end passed the other ball's high end, so the boxes
+				//may have started to overlap
+				if (boxesOverlap(slot, other.id / 2) &&
+					pairs.insert(pairKey(slot, other.id / 2)).second) {
+					allocations++;
+				}
+			}
+			else if ((endpoint.id & 1) == 1 && (other.id & 1) == 0) {
+				//The high end passed the other ball's low end, so the boxes
+				//don't overlap any more
+				pairs.erase(pairKey(slot, other.id / 2));
+			}
+			ends[j] = other;
+			j--;
+			ballUpdates++;
+		}
+		ends[j] = endpoint;
+	}
+}
+
+void SweepAndPrune::rebuild() {
+	for(int axis = 0; axis < 3; axis++) {
+		updateEnds(axis);
+		sort(endpoints[axis].begin(), endpoints[axis].end(), comesBefore);
+	}
+	
+	//Sweep along the x axis, comparing each ball with the balls whose boxes
+	//contain the low end of its box
+	pairs.clear();
+	vector<int> active;
+	vector<int> activeIndices(balls.size());
+	for(unsigned int i = 0; i < endpoints[0].size(); i++) {
+		int slot = endpoints[0][i].id / 2;
+		if ((endpoints[0][i].id & 1) == 0) {
+			for(unsigned int j = 0; j < active.size(); j++) {
+				if (boxesOverlap(slot, active[j]) &&
+					pairs.insert(pairKey(slot, active[j])).second) {
+					allocations++;
+				}
+			}
+			activeIndices[slot] = (int)active.size();
+			active.push_back(slot);
+		}
+		else {
+			int index = activeIndices[slot];
+			active[index] = active.back();
+			activeIndices[active[index]] = index;
+			active.pop_back();
+		}
+	}
+}
+
+void SweepAndPrune::update() {
+	for(unsigned int i = 0; i < balls.size(); i++) {
+		Ball* ball = balls[i];
+		if (ball != NULL) {
+			for(int axis = 0; axis < 3; axis++) {
+				boxes[i].low[axis] = ball->pos[axis] - ball->r;
+				boxes[i].high[axis] = ball->pos[axis] + ball->r;
+			}
+		}
+	}
+	
+	//Sorting many new balls into place one end at a time would be slow
+	if (numAdded > SWEEP_AND_PRUNE_MAX_INSERTS) {
+		rebuild();
+	}
+	else {
+		for(int axis = 0; axis < 3; axis++) {
+			updateEnds(axis);
+			sortAxis(axis);
+		}
+	}
+	numAdded = 0;
+}
+
+void SweepAndPrune::add(Ball* ball) {
+	int slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		balls[slot] = ball;
+	}
+	else {
+		slot = (int)balls.size();
+		balls.push_back(ball);
+		boxes.push_back(Box());
+	}
+	ballSlots[ball] = slot;
+	
+	//Put the ends after all of the others.  The next update moves them into
+	//place, adding the pairs for the ball as they go.
+	for(int axis = 0; axis < 3; axis++) {
+		Endpoint endpoint;
+		endpoint.value = 0;
+		endpoint.id = 2 * slot;
+		endpoints[axis].push_back(endpoint);
+		endpoint.id = 2 * slot + 1;
+		endpoints[axis].push_back(endpoint);
+	}
+	numAdded++;
+}
+
+void SweepAndPrune::remove(Ball* ball) {
+	unordered_map<Ball*, int>::iterator it = ballSlots.find(ball);
+	if (it == ballSlots.end()) {
+		return;
+	}
+	int slot = it->second;
+	ballSlots.erase(it);
+	
+	for(int axis = 0; axis < 3; axis++) {
+		vector<Endpoint> &ends = endpoints[axis];
+		unsigned int numKept = 0;
+		for(unsigned int i = 0; i < ends.size(); i++) {
+			if (ends[i].id / 2 != slot) {
+				ends[numKept] = ends[i];
+				numKept++;
+			}
+		}
+		ends.resize(numKept);
+	}
+	
+	for(unordered_set<unsigned long long>::iterator it2 = pairs.begin();
+		it2 != pairs.end();) {
+		if ((int)(*it2 >> 32) == slot || (int)(*it2 & 0xffffffffULL) == slot) {
+			it2 = pairs.erase(it2);
+		}
+		else {
+			it2++;
+		}
+	}
+	
+	balls[slot] = NULL;
+	freeSlots.push_back(slot);
+}
+
+void SweepAndPrune::ballMoved(Ball* ball, Vec3f oldPos) {
+	
+}
+
+void SweepAndPrune::potentialBallBallCollisions(
+	vector<BallPair> &collisions) {
+	update();
+	for(unordered_set<unsigned long long>::iterator it = pairs.begin();
+		it != pairs.end(); it++) {
+		BallPair bp;
+		bp.ball1 = balls[*it >> 32];
+		bp.ball2 = balls[*it & 0xffffffffULL];
+		collisions.push_back(bp);
+	}
+}
+
+void SweepAndPrune::potentialBallWallCollisions(
+	vector<BallWallPair> &collisions) {
+	for(unsigned int i = 0; i < balls.size(); i++) {
+		if (balls[i] != NULL) {
+			addWallCollisions(balls[i], corner1, corner2, collisions);
+		}
+	}
+}
+
+long long SweepAndPrune::numAllocations() const {
+	return allocations;
+}
+
+long long SweepAndPrune::numBallUpdates() const {
+	return ballUpdates;
+}
+
+void SweepAndPrune::resetStats() {
+	ballUpdates = 0;
+	allocations = 0;
+}
+
+
+
+
+
+
+
+
+
+
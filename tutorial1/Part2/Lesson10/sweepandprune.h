@@ -0,0 +1,144 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Collision Detection" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef SWEEPANDPRUNE_H_INCLUDED
+#define SWEEPANDPRUNE_H_INCLUDED
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ball.h"
+#include "broadphase.h"
+#include "vec3f.h"
+
+//The most balls that may be added between updates of a SweepAndPrune for it
+//to sort them into place one end at a time, rather than sorting all of the
+//ends from scratch
+const int SWEEP_AND_PRUNE_MAX_INSERTS = 64;
+
+/* Keeps the ends of the balls' boxes sorted along each of the three axes,
+ * along with the set of pairs of balls whose boxes overlap.  The balls move
+ * only a little between updates, so the order from the last update is nearly
+ * right, and an insertion sort fixes it in close to linear time.  Whenever
+ * the sort moves the low end of one box past the high end of another, the
+ * two boxes may have started to overlap, and whenever it moves a high end
+ * past a low end, they have stopped overlapping.  So the sort keeps the set
+ * of pairs up to date, without sweeping through the balls again.
+ */
+class SweepAndPrune : public BroadPhase {
+	private:
+		//One end of a ball's box along one axis
+		struct Endpoint {
+			float value;
+			//2 * slot for the low end of the ball in the slot, and
+			//2 * slot + 1 for the high end
+			int id;
+		};
+		
+		//The box around a ball as of the last update
+		struct Box {
+			float low[3];
+			float high[3];
+		};
+		
+		Vec3f corner1;
+		Vec3f corner2;
+		//The balls, indexed by slot.  Slots of removed balls are NULL until
+		//they are reused.
+		std::vector<Ball*> balls;
+		std::vector<Box> boxes;
+		std::vector<int> freeSlots;
+		std::unordered_map<Ball*, int> ballSlots;
+		//The ends of the boxes along each axis, sorted as of the last update
+		//except for those of the balls added since then, which are at the end
+		std::vector<Endpoint> endpoints[3];
+		//The number of times a ball was added since the last update
+		int numAdded;
+		//The pairs of slots whose balls' boxes overlapped as of the last
+		//update.  Each pair is stored as (slot1 << 32) | slot2, where slot1 <
+		//slot2.
+		std::unordered_set<unsigned long long> pairs;
+		//The number of times two ends switched places since the last call to
+		//resetStats
+		long long ballUpdates;
+		//The number of pairs added since the last call to resetStats
+		long long allocations;
+		
+		//Returns whether endpoint1 comes before endpoint2 along an axis.
+		//Low ends come before high ends with the same value, so that boxes
+		//that just touch count as overlapping.
+		static bool comesBefore(const Endpoint &endpoint1,
+								const Endpoint &endpoint2);
+		//Returns the key in "pairs" for the two slots
+		static unsigned long long pairKey(int slot1, int slot2);
+		//Returns whether the boxes of the balls in the two slots overlap
+		bool boxesOverlap(int slot1, int slot2);
+		//Sets the values of the ends along the specified axis from the boxes
+		void updateEnds(int axis);
+		//Sorts the ends along the specified axis with an insertion sort,
+		//updating the pairs as ends pass each other
+		void sortAxis(int axis);
+		//Sorts the ends along each axis from scratch and finds the pairs by
+		//sweeping along the x axis
+		void rebuild();
+		//Brings the order of the ends and the pairs up to date
+		void update();
+	public:
+		//Constructs a new SweepAndPrune for the box with the corners c1 =
+		//(minX, minY, minZ) and c2 = (maxX, maxY, maxZ)
+		SweepAndPrune(Vec3f c1, Vec3f c2);
+		
+		//Adds a ball to this
+		void add(Ball* ball);
+		//Removes a ball from this
+		void remove(Ball* ball);
+		//Changes the position of a ball in this from oldPos to ball->pos.
+		//This doesn't need to do anything until the next update.
+		void ballMoved(Ball* ball, Vec3f oldPos);
+		
+		//Adds potential ball-ball collisions to the specified vector
+		void potentialBallBallCollisions(std::vector<BallPair> &collisions);
+		//Adds potential ball-wall collisions to the specified vector
+		void potentialBallWallCollisions(std::vector<BallWallPair> &collisions);
+		
+		//Returns the number of times this has allocated memory, not counting
+		//when a ball is added, which it does once for each pair of balls
+		//whose boxes start to overlap
+		long long numAllocations() const;
+		//Returns the number of times two ends of boxes switched places
+		long long numBallUpdates() const;
+		void resetStats();
+};
+
+
+
+
+
+
+
+
+
+
+#endif
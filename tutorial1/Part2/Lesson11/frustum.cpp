@@ -0,0 +1,164 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "frustum.h"
+
+using namespace std;
+
+Frustum::Frustum() {
+	for(int i = 0; i < 6; i++) {
+		a[i] = 0;
+		b[i] = 0;
+		c[i] = 0;
+		d[i] = 1;
+	}
+}
+
+void Frustum::setMatrices(const float* projection, const float* modelview) {
+	//Compute the product of the matrices
+	float m[16];
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			float sum = 0;
+			for(int k = 0; k < 4; k++) {
+				sum += projection[4 * k + i] * modelview[4 * j + k];
+			}
+			m[4 * j + i] = sum;
+		}
+	}
+	
+	//Each plane is the last row of the matrix plus or minus one of the others
+	for(int i = 0; i < 6; i++) {
+		int row = i / 2;
+		float sign = i % 2 == 0 ? 1.0f : -1.0f;
+		a[i] = m[3] + sign * m[row];
+		b[i] = m[7] + sign * m[4 + row];
+		c[i] = m[11] + sign * m[8 + row];
+		d[i] = m[15] + sign * m[12 + row];
+		
+		//Normalize the plane, so that plugging in a point gives its distance
+		float length = sqrt(a[i] * a[i] + b[i] * b[i] + c[i] * c[i]);
+		if (length > 0) {
+			a[i] /= length;
+			b[i] /= length;
+			c[i] /= length;
+			d[i] /= length;
+		}
+	}
+}
+
+void Frustum::setFromOpenGL() {
+	GLfloat projection[16];
+	GLfloat modelview[16];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	setMatrices(projection, modelview);
+}
+
+bool Frustum::sphereVisible(Vec3f center, float radius) const {
+	for(int i = 0; i < 6; i++) {
+		if (a[i] * center[0] + b[i] * center[1] + c[i] * center[2] + d[i] <
+			-radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::boxVisible(Vec3f minCorner, Vec3f maxCorner) const {
+	for(int i = 0; i < 6; i++) {
+		//Test the corner that is farthest along the plane's normal
+		float x = a[i] > 0 ? maxCorner[0] : minCorner[0];
+		float y = b[i] > 0 ? maxCorner[1] : minCorner[1];
+		float z = c[i] > 0 ? maxCorner[2] : minCorner[2];
+		if (a[i] * x + b[i] * y + c[i] * z + d[i] < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int Frustum::cullSpheres(const float* xs,
+						 const float* ys,
+						 const float* zs,
+						 const float* radii,
+						 int numSpheres,
+						 bool* visible) const {
+	int numVisible = 0;
+	int i = 0;
+#ifdef __SSE__
+	//Test four spheres at a time against each plane
+	for(; i + 4 <= numSpheres; i += 4) {
+		__m128 x = _mm_loadu_ps(xs + i);
+		__m128 y = _mm_loadu_ps(ys + i);
+		__m128 z = _mm_loadu_ps(zs + i);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(),
+									  _mm_loadu_ps(radii + i));
+		__m128 inside = _mm_cmpeq_ps(x, x); //All ones, unless x is NaN
+		for(int j = 0; j < 6; j++) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[j]), x),
+						   _mm_mul_ps(_mm_set1_ps(b[j]), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[j]), z),
+						   _mm_set1_ps(d[j])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+		
+		int mask = _mm_movemask_ps(inside);
+		for(int j = 0; j < 4; j++) {
+			visible[i + j] = (mask & (1 << j)) != 0;
+			numVisible += visible[i + j];
+		}
+	}
+#endif
+	
+	for(; i < numSpheres; i++) {
+		visible[i] = sphereVisible(Vec3f(xs[i], ys[i], zs[i]), radii[i]);
+		numVisible += visible[i];
+	}
+	return numVisible;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,81 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef FRUSTUM_H_INCLUDED
+#define FRUSTUM_H_INCLUDED
+
+#include "vec3f.h"
+
+//The six planes bounding the region that the camera can see
+class Frustum {
+	private:
+		//The plane i is the set of points p with
+		//a[i] * p[0] + b[i] * p[1] + c[i] * p[2] + d[i] = 0, and the inside is
+		//where the left side is positive
+		float a[6];
+		float b[6];
+		float c[6];
+		float d[6];
+	public:
+		//Constructs a frustum that contains everything
+		Frustum();
+		
+		/* Sets the planes to those of the frustum given by the specified
+		 * projection and modelview matrices, in the column-major order used
+		 * by glGetFloatv.  The planes are in the coordinates to which the
+		 * modelview matrix is applied.
+		 */
+		void setMatrices(const float* projection, const float* modelview);
+		//Sets the planes using the current OpenGL projection and modelview
+		//matrices
+		void setFromOpenGL();
+		
+		//Returns whether any part of the specified sphere may be visible
+		bool sphereVisible(Vec3f center, float radius) const;
+		//Returns whether any part of the axis-aligned box with the specified
+		//opposite corners may be visible
+		bool boxVisible(Vec3f minCorner, Vec3f maxCorner) const;
+		/* Tests numSpheres spheres, whose centers are (xs[i], ys[i], zs[i])
+		 * and whose radii are radii[i].  Sets visible[i] to whether each
+		 * sphere may be visible and returns the number that may be visible.
+		 * Uses SSE, where available, to test four spheres at a time.
+		 */
+		int cullSpheres(const float* xs,
+						const float* ys,
+						const float* zs,
+						const float* radii,
+						int numSpheres,
+						bool* visible) const;
+};
+
+
+
+
+
+
+
+
+
+
+#endif
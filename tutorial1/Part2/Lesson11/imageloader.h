@@ -42,8 +42,34 @@ class Image {
 		int height;
 };
 
+//Represents a grayscale image with 16 bits per pixel
+class GrayImage {
+	public:
+		GrayImage(unsigned short* ps, int w, int h);
+		~GrayImage();
+		
+		/* An array indicating the brightness of each pixel, from 0 to 65535.
+		 * The array starts at the bottom-left pixel and goes row by row, in
+		 * the same order as Image's pixels.
+		 */
+		unsigned short* pixels;
+		int width;
+		int height;
+};
+
 //Reads a bitmap image from file.
 Image* loadBMP(const char* filename);
+/* Reads a bitmap image with 16 or 24 bits per pixel from file as a grayscale
+ * image.  Each pixel of a 16-bit bitmap is taken to hold a 16-bit
+ * brightness, as programs that make heightmaps write them, and the red
+ * components of a 24-bit bitmap are scaled from 0 - 255 to 0 - 65535.
+ */
+GrayImage* loadGrayBMP(const char* filename);
+/* Reads a square grayscale image from a raw file of 16-bit little-endian
+ * brightnesses, starting at the top-left pixel and going row by row, as in
+ * the ".r16" heightmaps that terrain editors write.
+ */
+GrayImage* loadR16(const char* filename);
 
 
 
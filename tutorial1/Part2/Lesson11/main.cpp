@@ -29,6 +29,7 @@
 #include <set>
 #include <sstream>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 
 #ifdef __APPLE__
@@ -38,8 +39,13 @@
 #include <GL/glut.h>
 #endif
 
+#include "frustum.h"
+#include "glstate.h"
 #include "imageloader.h"
 #include "md2model.h"
+#include "sdftext.h"
+#include "terrain.h"
+#include "terraindrawer.h"
 #include "text3d.h"
 
 using namespace std;
@@ -50,225 +56,40 @@ const int NUM_GUYS = 100;
 const float TERRAIN_WIDTH = 50.0f;
 //The amount of time between each time that we handle collisions
 const float TIME_BETWEEN_HANDLE_COLLISIONS = 0.01f;
+//The height on the screen, in pixels, at and above which guys are drawn with
+//all of their triangles
+const float FULL_DETAIL_HEIGHT = 100.0f;
+//The initial number of poses per animation that guys can share
+const int POSE_CACHE_SLOTS = 32;
+//The color of the terrain and the light shining on the scene, which stays
+//fixed relative to the terrain
+const GLfloat TERRAIN_COLOR[] = {0.3f, 0.9f, 0.0f};
+const GLfloat AMBIENT_LIGHT = 0.5f;
+const GLfloat DIFFUSE_LIGHT = 0.5f;
+const GLfloat LIGHT_DIRECTION[] = {-0.2f, 0.3f, -1.0f};
 
 //Returns a random float from 0 to < 1
 float randomFloat() {
 	return (float)rand() / ((float)RAND_MAX + 1);
 }
 
-//Represents a terrain, by storing a set of heights and normals at 2D locations
-class Terrain {
-	private:
-		int w; //Width
-		int l; //Length
-		float** hs; //Heights
-		Vec3f** normals;
-		bool computedNormals; //Whether normals is up-to-date
-	public:
-		Terrain(int w2, int l2) {
-			w = w2;
-			l = l2;
-			
-			hs = new float*[l];
-			for(int i = 0; i < l; i++) {
-				hs[i] = new float[w];
-			}
-			
-			normals = new Vec3f*[l];
-			for(int i = 0; i < l; i++) {
-				normals[i] = new Vec3f[w];
-			}
-			
-			computedNormals = false;
-		}
-		
-		~Terrain() {
-			for(int i = 0; i < l; i++) {
-				delete[] hs[i];
-			}
-			delete[] hs;
-			
-			for(int i = 0; i < l; i++) {
-				delete[] normals[i];
-			}
-			delete[] normals;
-		}
-		
-		int width() {
-			return w;
-		}
-		
-		int length() {
-			return l;
-		}
-		
-		//Sets the height at (x, z) to y
-		void setHeight(int x, int z, float y) {
-			hs[z][x] = y;
-			computedNormals = false;
-		}
-		
-		//Returns the height at (x, z)
-		float getHeight(int x, int z) {
-			return hs[z][x];
-		}
-		
-		//Computes the normals, if they haven't been computed yet
-		void computeNormals() {
-			if (computedNormals) {
-				return;
-			}
-			
-			//Compute the rough version of the normals
-			Vec3f** normals2 = new Vec3f*[l];
-			for(int i = 0; i < l; i++) {
-				normals2[i] = new Vec3f[w];
-			}
-			
-			for(int z = 0; z < l; z++) {
-				for(int x = 0; x < w; x++) {
-					Vec3f sum(0.0f, 0.0f, 0.0f);
-					
-					Vec3f out;
-					if (z > 0) {
-						out = Vec3f(0.0f, hs[z - 1][x] - hs[z][x], -1.0f);
-					}
-					Vec3f in;
-					if (z < l - 1) {
-						in = Vec3f(0.0f, hs[z + 1][x] - hs[z][x], 1.0f);
-					}
-					Vec3f left;
-					if (x > 0) {
-						left = Vec3f(-1.0f, hs[z][x - 1] - hs[z][x], 0.0f);
-					}
-					Vec3f right;
-					if (x < w - 1) {
-						right = Vec3f(1.0f, hs[z][x + 1] - hs[z][x], 0.0f);
-					}
-					
-					if (x > 0 && z > 0) {
-						sum += out.cross(left).normalize();
-					}
-					if (x > 0 && z < l - 1) {
-						sum += left.cross(in).normalize();
-					}
-					if (x < w - 1 && z < l - 1) {
-						sum += in.cross(right).normalize();
-					}
-					if (x < w - 1 && z > 0) {
-						sum += right.cross(out).normalize();
-					}
-					
-					normals2[z][x] = sum;
-				}
-			}
-			
-			//Smooth out the normals
-			const float FALLOUT_RATIO = 0.5f;
-			for(int z = 0; z < l; z++) {
-				for(int x = 0; x < w; x++) {
-					Vec3f sum = normals2[z][x];
-					
-					if (x > 0) {
-						sum += normals2[z][x - 1] * FALLOUT_RATIO;
-					}
-					if (x < w - 1) {
-						sum += normals2[z][x + 1] * FALLOUT_RATIO;
-					}
-					if (z > 0) {
-						sum += normals2[z - 1][x] * FALLOUT_RATIO;
-					}
-					if (z < l - 1) {
-						sum += normals2[z + 1][x] * FALLOUT_RATIO;
-					}
-					
-					if (sum.magnitude() == 0) {
-						sum = Vec3f(0.0f, 1.0f, 0.0f);
-					}
-					normals[z][x] = sum;
-				}
-			}
-			
-			for(int i = 0; i < l; i++) {
-				delete[] normals2[i];
-			}
-			delete[] normals2;
-			
-			computedNormals = true;
-		}
-		
-		//Returns the normal at (x, z)
-		Vec3f getNormal(int x, int z) {
-			if (!computedNormals) {
-				computeNormals();
-			}
-			return normals[z][x];
-		}
-};
-
-//Loads a terrain from a heightmap.  The heights of the terrain range from
-//-height / 2 to height / 2.
-Terrain* loadTerrain(const char* filename, float height) {
-	Image* image = loadBMP(filename);
-	Terrain* t = new Terrain(image->width, image->height);
-	for(int y = 0; y < image->height; y++) {
-		for(int x = 0; x < image->width; x++) {
-			unsigned char color =
-				(unsigned char)image->pixels[3 * (y * image->width + x)];
-			float h = height * ((color / 255.0f) - 0.5f);
-			t->setHeight(x, y, h);
-		}
-	}
-	
-	delete image;
-	t->computeNormals();
-	return t;
-}
-
-//Returns the approximate height of the terrain at the specified (x, z) position
-float heightAt(Terrain* terrain, float x, float z) {
-	//Make (x, z) lie within the bounds of the terrain
-	if (x < 0) {
-		x = 0;
-	}
-	else if (x > terrain->width() - 1) {
-		x = terrain->width() - 1;
-	}
-	if (z < 0) {
-		z = 0;
-	}
-	else if (z > terrain->length() - 1) {
-		z = terrain->length() - 1;
-	}
-	
-	//Compute the grid cell in which (x, z) lies and how close we are to the
-	//left and outward edges
-	int leftX = (int)x;
-	if (leftX == terrain->width() - 1) {
-		leftX--;
-	}
-	float fracX = x - leftX;
-	
-	int outZ = (int)z;
-	if (outZ == terrain->width() - 1) {
-		outZ--;
-	}
-	float fracZ = z - outZ;
-	
-	//Compute the four heights for the grid cell
-	float h11 = terrain->getHeight(leftX, outZ);
-	float h12 = terrain->getHeight(leftX, outZ + 1);
-	float h21 = terrain->getHeight(leftX + 1, outZ);
-	float h22 = terrain->getHeight(leftX + 1, outZ + 1);
-	
-	//Take a weighted average of the four heights
-	return (1 - fracX) * ((1 - fracZ) * h11 + fracZ * h12) +
-		fracX * ((1 - fracZ) * h21 + fracZ * h22);
-}
-
 //The amount by which the Guy class's step function advances the state of a guy
 const float GUY_STEP_TIME = 0.01f;
 
+//How guys that are drawn one at a time are drawn
+struct DrawOptions {
+	//Whether guys at full detail are drawn with triangle strips
+	bool useStrips;
+	//Shares poses among the guys, if not NULL
+	MD2PoseCache* poseCache;
+	/* Whether guys at full detail skip the clusters of triangles that face
+	 * away from the camera.  This takes precedence over useStrips and
+	 * poseCache.
+	 */
+	bool cullClusters;
+	Vec3f eye; //The position of the camera
+};
+
 //Represents a guy
 class Guy {
 	private:
@@ -277,6 +98,8 @@ class Guy {
 		float terrainScale; //The scaling factor for the terrain
 		float x0;
 		float z0;
+		//The height of the terrain at (x0, z0), as of the last call to setY
+		float y0;
 		float animTime; //The current position in the animation of the model
 		float radius0; //The approximate radius of the guy
 		float speed;
@@ -369,6 +192,8 @@ class Guy {
 			isTurningLeft = randomFloat() < 0.5f;
 			angle = 2 * PI * randomFloat();
 			timeUntilSwitchDir = randomFloat() * (20 * randomFloat() + 15);
+			y0 = terrainScale *
+				heightAt(terrain, x0 / terrainScale, z0 / terrainScale);
 		}
 		
 		//Advances the state of the guy by the specified amount of time, by
@@ -400,9 +225,14 @@ class Guy {
 			}
 		}
 		
-		void draw() {
+		/* Draws the guy using the specified level of detail of its model and
+		 * the specified options.  Returns the number of triangles drawn, and
+		 * stores the number of vertices sent to OpenGL in numVertices.
+		 */
+		int draw(int level, const DrawOptions &options, int &numVertices) {
+			numVertices = 0;
 			if (model == NULL) {
-				return;
+				return 0;
 			}
 			
 			float scale = radius0 / 2.5f;
@@ -414,8 +244,66 @@ class Guy {
 			glRotatef(180.0f, 0.0f, 1.0f, 0.0f);
 			glRotatef(-90.0f, 0.0f, 0.0f, 1.0f);
 			glScalef(scale, scale, scale);
-			model->draw(animTime);
+			int numTriangles = model->numTrianglesAt(level);
+			numVertices = 3 * numTriangles;
+			if (options.cullClusters && level == 0) {
+				numTriangles =
+					model->drawCulled(animTime, toModel(options.eye));
+				numVertices = 3 * numTriangles;
+			}
+			else if (options.poseCache != NULL) {
+				model->drawPose(options.poseCache->pose(animTime),
+								level,
+								options.useStrips);
+				if (options.useStrips && level == 0) {
+					numVertices = model->numVerticesInStrips();
+				}
+			}
+			else if (options.useStrips && level == 0) {
+				model->drawStrips(animTime);
+				numVertices = model->numVerticesInStrips();
+			}
+			else {
+				model->draw(animTime, level);
+			}
 			glPopMatrix();
+			return numTriangles;
+		}
+		
+		//Stores the rows of the 3x4 matrix that draw() applies to the model in
+		//m, in the form used by MD2Instance::transform
+		void transform(float* m) {
+			float scale = radius0 / 2.5f;
+			
+			//The rotation is the product of the rotations in draw(), which
+			//combine to a rotation about the y axis by 270 - angle degrees,
+			//following a rotation about the z axis by -90 degrees
+			float c = scale * cos(3 * PI / 2 - angle);
+			float s = scale * sin(3 * PI / 2 - angle);
+			m[0] = 0;
+			m[1] = c;
+			m[2] = s;
+			m[3] = x0;
+			m[4] = -scale;
+			m[5] = 0;
+			m[6] = 0;
+			m[7] = scale * 10.0f + y();
+			m[8] = 0;
+			m[9] = -s;
+			m[10] = c;
+			m[11] = z0;
+		}
+		
+		//Stores the transform and animation state of this guy in inst, for
+		//drawing with MD2Model::drawInstanced.  Equivalent to draw().
+		void instance(MD2Instance* inst) {
+			transform(inst->transform);
+			inst->startFrame = (float)model->animationStart();
+			inst->endFrame = (float)model->animationEnd();
+			inst->time = animTime;
+			inst->color[0] = 1;
+			inst->color[1] = 1;
+			inst->color[2] = 1;
 		}
 		
 		float x() {
@@ -426,10 +314,57 @@ class Guy {
 			return z0;
 		}
 		
-		//Returns the current height of the guy on the terrain
+		//Converts a point into the coordinates of the guy's model
+		Vec3f toModel(Vec3f point) {
+			//The upper 3x3 part of the transform is a rotation times the
+			//scale, so its inverse is its transpose divided by the scale
+			//squared
+			float m[12];
+			transform(m);
+			float scale = radius0 / 2.5f;
+			Vec3f d = point - Vec3f(m[3], m[7], m[11]);
+			return Vec3f(m[0] * d[0] + m[4] * d[1] + m[8] * d[2],
+						 m[1] * d[0] + m[5] * d[1] + m[9] * d[2],
+						 m[2] * d[0] + m[6] * d[1] + m[10] * d[2]) /
+				(scale * scale);
+		}
+		
+		//Computes a sphere containing the guy in every frame of its animation
+		void boundingSphere(Vec3f &center, float &radius) {
+			if (model == NULL) {
+				center = Vec3f(x0, y(), z0);
+				radius = height();
+				return;
+			}
+			
+			const MD2Bounds &bounds = model->animationBounds();
+			float m[12];
+			transform(m);
+			for(int i = 0; i < 3; i++) {
+				center[i] = m[4 * i] * bounds.center[0] +
+					m[4 * i + 1] * bounds.center[1] +
+					m[4 * i + 2] * bounds.center[2] + m[4 * i + 3];
+			}
+			radius = bounds.radius * radius0 / 2.5f;
+		}
+		
+		//Returns how tall the guy is.  The model is about 20 units tall before
+		//it is scaled in draw().
+		float height() {
+			return 8 * radius0;
+		}
+		
+		/* Returns the height of the guy on the terrain.  This is only
+		 * updated by setY, so that the heights of all of the guys can be
+		 * found together using heightsAt, which is much quicker than finding
+		 * them one at a time.
+		 */
 		float y() {
-			return terrainScale *
-				heightAt(terrain, x0 / terrainScale, z0 / terrainScale);
+			return y0;
+		}
+		
+		void setY(float y1) {
+			y0 = y1;
 		}
 		
 		float velocityX() {
@@ -792,24 +727,156 @@ vector<Guy*> makeGuys(int numGuys, MD2Model* model, Terrain* terrain) {
 	return guys;
 }
 
+//Sets the heights of the guys to the heights of the terrain where they are
+void updateGuyHeights(vector<Guy*> &guys, Terrain* terrain) {
+	int numGuys = (int)guys.size();
+	if (numGuys == 0) {
+		return;
+	}
+	
+	float scale = TERRAIN_WIDTH / (terrain->width() - 1);
+	vector<float> xs(numGuys);
+	vector<float> zs(numGuys);
+	vector<float> heights(numGuys);
+	for(int i = 0; i < numGuys; i++) {
+		xs[i] = guys[i]->x() / scale;
+		zs[i] = guys[i]->z() / scale;
+	}
+	parallelHeightsAt(terrain, &xs[0], &zs[0], numGuys, &heights[0]);
+	for(int i = 0; i < numGuys; i++) {
+		guys[i]->setY(scale * heights[i]);
+	}
+}
+
 //Draws the terrain
-void drawTerrain(Terrain* terrain) {
-	glDisable(GL_TEXTURE_2D);
-	glColor3f(0.3f, 0.9f, 0.0f);
-	for(int z = 0; z < terrain->length() - 1; z++) {
-		glBegin(GL_TRIANGLE_STRIP);
-		for(int x = 0; x < terrain->width(); x++) {
-			Vec3f normal = terrain->getNormal(x, z);
-			glNormal3f(normal[0], normal[1], normal[2]);
-			glVertex3f(x, terrain->getHeight(x, z), z);
-			normal = terrain->getNormal(x, z + 1);
-			glNormal3f(normal[0], normal[1], normal[2]);
-			glVertex3f(x, terrain->getHeight(x, z + 1), z + 1);
-		}
-		glEnd();
+void drawTerrain(TerrainDrawer* drawer) {
+	glsDisable(GL_TEXTURE_2D);
+	glColor3fv(TERRAIN_COLOR);
+	//The terrain's colors may already have the lighting in them
+	if (drawer->bakedLighting()) {
+		glsDisable(GL_LIGHTING);
+	}
+	drawer->draw();
+	glsEnable(GL_LIGHTING);
+}
+
+//Returns the guys whose bounding spheres are at least partly in the frustum
+vector<Guy*> cullGuys(vector<Guy*> &guys, const Frustum &frustum) {
+	int numGuys = (int)guys.size();
+	vector<float> xs(numGuys);
+	vector<float> ys(numGuys);
+	vector<float> zs(numGuys);
+	vector<float> radii(numGuys);
+	for(int i = 0; i < numGuys; i++) {
+		Vec3f center;
+		guys[i]->boundingSphere(center, radii[i]);
+		xs[i] = center[0];
+		ys[i] = center[1];
+		zs[i] = center[2];
+	}
+	
+	vector<Guy*> visibleGuys;
+	if (numGuys == 0) {
+		return visibleGuys;
+	}
+	bool* visible = new bool[numGuys];
+	int numVisible = frustum.cullSpheres(&xs[0], &ys[0], &zs[0], &radii[0],
+										 numGuys, visible);
+	visibleGuys.reserve(numVisible);
+	for(int i = 0; i < numGuys; i++) {
+		if (visible[i]) {
+			visibleGuys.push_back(guys[i]);
+		}
+	}
+	delete[] visible;
+	return visibleGuys;
+}
+
+/* Chooses the level of detail of the model at which to draw each guy, based on
+ * how tall the guy appears on the screen.  eye is the position of the camera,
+ * and screenScale is the height in pixels of an object of height 1 at a
+ * distance of 1.  If maxTriangles is positive and the guys would have more
+ * triangles than that in total, all of them are drawn with fewer triangles.
+ */
+void chooseLevelsOfDetail(vector<Guy*> &guys,
+						  MD2Model* model,
+						  Vec3f eye,
+						  float screenScale,
+						  int maxTriangles,
+						  vector<int> &levels) {
+	levels.assign(guys.size(), 0);
+	if (model == NULL) {
+		return;
+	}
+	
+	//The number of triangles that we would like to use for each guy is
+	//proportional to its height on the screen
+	vector<float> wanted(guys.size());
+	float totalWanted = 0;
+	for(unsigned int i = 0; i < guys.size(); i++) {
+		Guy* guy = guys[i];
+		Vec3f center(guy->x(), guy->y() + guy->height() / 2, guy->z());
+		float distance = (center - eye).magnitude();
+		float screenHeight = screenScale * guy->height() / distance;
+		wanted[i] =
+			model->numTrianglesAt(0) * screenHeight / FULL_DETAIL_HEIGHT;
+		totalWanted += wanted[i];
+	}
+	
+	float budgetScale = 1;
+	if (maxTriangles > 0 && totalWanted > maxTriangles) {
+		budgetScale = maxTriangles / totalWanted;
+	}
+	for(unsigned int i = 0; i < guys.size(); i++) {
+		levels[i] = model->levelForTriangleBudget(budgetScale * wanted[i]);
 	}
 }
 
+/* Draws the guys at the specified levels of detail, using one instanced draw
+ * call per level if useInstancing is true, or otherwise one at a time using
+ * the specified options.  Returns the number of triangles drawn, and stores
+ * the number of vertices sent to OpenGL in numVertices.
+ */
+int drawGuys(vector<Guy*> &guys,
+			 MD2Model* model,
+			 bool useInstancing,
+			 const DrawOptions &options,
+			 const vector<int> &levels,
+			 int &numVertices) {
+	numVertices = 0;
+	if (guys.empty() || model == NULL) {
+		return 0;
+	}
+	
+	int numTriangles = 0;
+	if (!useInstancing) {
+		for(unsigned int i = 0; i < guys.size(); i++) {
+			int guyVertices;
+			numTriangles += guys[i]->draw(levels[i], options, guyVertices);
+			numVertices += guyVertices;
+		}
+		return numTriangles;
+	}
+	
+	for(unsigned int i = 0; i < guys.size(); i++) {
+		numTriangles += model->numTrianglesAt(levels[i]);
+	}
+	numVertices = 3 * numTriangles;
+	
+	vector< vector<MD2Instance> > instances(model->numLevelsOfDetail());
+	for(unsigned int i = 0; i < guys.size(); i++) {
+		MD2Instance instance;
+		guys[i]->instance(&instance);
+		instances[levels[i]].push_back(instance);
+	}
+	for(unsigned int i = 0; i < instances.size(); i++) {
+		if (!instances[i].empty()) {
+			model->drawInstanced(&instances[i][0], (int)instances[i].size(), i);
+		}
+	}
+	return numTriangles;
+}
+
 //Draws a string at the top of the screen indicating that the specified number
 //of collisions have occurred
 void drawNumCollisions(int numCollisions) {
@@ -817,15 +884,15 @@ void drawNumCollisions(int numCollisions) {
 	oss << "Collisions: " << numCollisions;
 	string str = oss.str();
 	
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_LIGHTING);
+	glsDisable(GL_TEXTURE_2D);
+	glsDisable(GL_LIGHTING);
 	glColor3f(1.0f, 1.0f, 0.0f);
 	glPushMatrix();
 	glTranslatef(0.0f, 1.7f, -5.0f);
 	glScalef(0.2f, 0.2f, 0.2f);
-	t3dDraw2D(str, 0, 0);
+	sdfDraw2D(str, 0, 0);
 	glPopMatrix();
-	glEnable(GL_LIGHTING);
+	glsEnable(GL_LIGHTING);
 }
 
 
@@ -833,29 +900,224 @@ void drawNumCollisions(int numCollisions) {
 
 
 MD2Model* _model;
+int _numGuys = NUM_GUYS;
 vector<Guy*> _guys;
 Terrain* _terrain;
+//The order in which _terrain keeps its heights and normals in memory
+Terrain::Layout _terrainLayout = Terrain::ROW_MAJOR;
+TerrainDrawer* _terrainDrawer;
+//Whether _terrainDrawer may keep the heights in a texture rather than keeping
+//positions and normals in vertex buffers
+bool _allowHeightTexture = true;
+//The most triangles to use for the terrain, or 0 for no limit
+int _terrainTriangleBudget = 0;
 float _angle = 0;
 Quadtree* _quadtree;
 //The amount of time until we next check for and handle all collisions
 float _timeUntilHandleCollisions = 0;
 int _numCollisions; //The total number of collisions that have occurred
+//Whether the guys are drawn with MD2Model::drawInstanced
+bool _useInstancing = false;
+//Whether guys drawn one at a time use the triangle strips and fans stored in
+//the model's file
+bool _useStrips = false;
+//Shares poses among guys drawn one at a time, when _usePoseCache is true
+MD2PoseCache* _poseCache = NULL;
+bool _usePoseCache = false;
+//Whether guys drawn one at a time skip clusters of triangles that face away
+//from the camera
+bool _cullClusters = false;
+//Whether distant guys are drawn with fewer triangles
+bool _useLevelsOfDetail = true;
+//The most triangles to use for all of the guys together, or 0 for no limit
+int _triangleBudget = 0;
+int _windowWidth = 400;
+int _windowHeight = 400;
+float _fieldOfView = 45; //The vertical field of view, in degrees
+//How far the point at which the camera looks is from the center of the
+//terrain
+float _panX = 0;
+float _panZ = 0;
+//Whether we are redrawing as fast as possible and reporting the frame rate
+bool _benchmark = false;
+int _framesSinceReport = 0;
+int _lastReportTime = 0; //The value of GLUT_ELAPSED_TIME at the last report
+//The number of triangles used to draw the guys since the last report
+long long _trianglesSinceReport = 0;
+//The number of poses computed by _poseCache since the last report
+long long _posesSinceReport = 0;
+//The number of vertices sent to OpenGL for the guys since the last report
+long long _verticesSinceReport = 0;
+//The number of triangles that the guys drawn since the last report have at
+//full detail
+long long _fullTrianglesSinceReport = 0;
+//The number of guys skipped because they were out of view since the last
+//report
+long long _guysCulledSinceReport = 0;
+
+//Bakes the light into the colors of _terrainDrawer, with or without ambient
+//occlusion
+void bakeTerrainLighting(bool ambientOcclusion) {
+	_terrainDrawer->setBakedLighting(Vec3f(LIGHT_DIRECTION[0],
+										   LIGHT_DIRECTION[1],
+										   LIGHT_DIRECTION[2]),
+									 Vec3f(TERRAIN_COLOR[0],
+										   TERRAIN_COLOR[1],
+										   TERRAIN_COLOR[2]),
+									 AMBIENT_LIGHT,
+									 DIFFUSE_LIGHT,
+									 ambientOcclusion);
+}
 
 void cleanup() {
+	delete _poseCache;
 	delete _model;
 	
 	for(unsigned int i = 0; i < _guys.size(); i++) {
 		delete _guys[i];
 	}
 	
+	delete _terrainDrawer;
+	sdfCleanup();
 	t3dCleanup();
 }
 
+//Sets the projection matrix using the window size and the field of view
+void setProjection() {
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(_fieldOfView, (float)_windowWidth / (float)_windowHeight,
+				   1.0, 200.0);
+}
+
+//Moves the point at which the camera looks by the specified amounts along and
+//across the direction in which the camera faces
+void pan(float forward, float right) {
+	float angle = _angle * PI / 180;
+	_panX += forward * sin(angle) + right * cos(angle);
+	_panZ += -forward * cos(angle) + right * sin(angle);
+	_panX = max(-TERRAIN_WIDTH / 2, min(TERRAIN_WIDTH / 2, _panX));
+	_panZ = max(-TERRAIN_WIDTH / 2, min(TERRAIN_WIDTH / 2, _panZ));
+}
+
+//Digs a crater near the point at which the camera looks
+void digCrater() {
+	float scale = TERRAIN_WIDTH / (_terrain->width() - 1);
+	float x = (TERRAIN_WIDTH / 2 + _panX) / scale;
+	float z = (scale * (_terrain->length() - 1) / 2 + _panZ) / scale;
+	float radius = 3 + 5 * randomFloat();
+	makeCrater(_terrain,
+			   x + 10 * (randomFloat() - 0.5f),
+			   z + 10 * (randomFloat() - 0.5f),
+			   radius,
+			   0.6f * radius);
+}
+
 void handleKeypress(unsigned char key, int x, int y) {
 	switch (key) {
 		case 27: //Escape key
 			cleanup();
 			exit(0);
+		case 'i':
+			//Switch between instanced and per-guy drawing
+			if (_useInstancing) {
+				_useInstancing = false;
+			}
+			else if (_model != NULL && _model->initInstancing()) {
+				_useInstancing = true;
+			}
+			else {
+				cout << "Instanced drawing is not supported" << endl;
+			}
+			break;
+		case 'l':
+			//Switch between using levels of detail and always drawing the full
+			//model
+			_useLevelsOfDetail = !_useLevelsOfDetail;
+			break;
+		case 'g':
+			//Switch between drawing triangle strips and fans and separate
+			//triangles
+			_useStrips = !_useStrips;
+			break;
+		case 'b':
+			//Switch skipping back-facing clusters of triangles on and off
+			_cullClusters = !_cullClusters;
+			break;
+		case 'p':
+			//Switch between computing each guy's pose, sharing poses within
+			//each frame, and keeping shared poses across frames
+			if (_poseCache == NULL) {
+				break;
+			}
+			if (!_usePoseCache) {
+				_usePoseCache = true;
+				_poseCache->setPersistent(false);
+			}
+			else if (!_poseCache->isPersistent()) {
+				_poseCache->setPersistent(true);
+			}
+			else {
+				_usePoseCache = false;
+			}
+			break;
+		case '[':
+			//Use fewer, coarser poses
+			if (_poseCache != NULL && _poseCache->slots() > 2) {
+				_poseCache->setSlots(_poseCache->slots() / 2);
+			}
+			break;
+		case ']':
+			//Use more, finer poses
+			if (_poseCache != NULL && _poseCache->slots() < 1024) {
+				_poseCache->setSlots(_poseCache->slots() * 2);
+			}
+			break;
+		case '+':
+		case '=':
+			//Zoom in
+			_fieldOfView = max(5.0f, _fieldOfView / 1.25f);
+			setProjection();
+			break;
+		case '-':
+			//Zoom out
+			_fieldOfView = min(45.0f, _fieldOfView * 1.25f);
+			setProjection();
+			break;
+		case 'w':
+			pan(2, 0);
+			break;
+		case 's':
+			pan(-2, 0);
+			break;
+		case 'a':
+			pan(0, -2);
+			break;
+		case 'd':
+			pan(0, 2);
+			break;
+		case 'c':
+			digCrater();
+			break;
+		case 't':
+			//Switch between using levels of detail for the terrain and
+			//always drawing all of its triangles
+			_terrainDrawer->setLevelsOfDetail(
+				!_terrainDrawer->levelsOfDetail());
+			break;
+		case 'o':
+			//Cycle the terrain between baked lighting with ambient occlusion,
+			//baked lighting, and OpenGL's lighting
+			if (!_terrainDrawer->bakedLighting()) {
+				bakeTerrainLighting(true);
+			}
+			else if (_terrainDrawer->ambientOcclusion()) {
+				bakeTerrainLighting(false);
+			}
+			else {
+				_terrainDrawer->clearBakedLighting();
+			}
+			break;
 	}
 }
 
@@ -876,27 +1138,30 @@ GLuint loadTexture(Image *image) {
 }
 
 void initRendering() {
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_LIGHTING);
-	glEnable(GL_LIGHT0);
-	glEnable(GL_NORMALIZE);
-	glEnable(GL_COLOR_MATERIAL);
-	glShadeModel(GL_SMOOTH);
+	glsEnable(GL_DEPTH_TEST);
+	glsEnable(GL_LIGHTING);
+	glsEnable(GL_LIGHT0);
+	glsEnable(GL_NORMALIZE);
+	glsEnable(GL_COLOR_MATERIAL);
+	glsShadeModel(GL_SMOOTH);
 	
 	t3dInit(); //Initialize text drawing functionality
+	sdfInit(); //Build the texture used for the collision count
 	
 	//Load the model
-	_model = MD2Model::load("blockybalboa.md2");
+	_model = MD2Model::load("blockybalboa.md2", "blockybalboa.md2cache");
 	if (_model != NULL) {
 		_model->setAnimation("run");
+		_useInstancing = _model->initInstancing();
+		_poseCache = new MD2PoseCache(_model, POSE_CACHE_SLOTS, false);
 	}
 }
 
 void handleResize(int w, int h) {
 	glViewport(0, 0, w, h);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(45.0, (float)w / (float)h, 1.0, 200.0);
+	_windowWidth = w;
+	_windowHeight = h;
+	setProjection();
 }
 
 void drawScene() {
@@ -914,26 +1179,153 @@ void drawScene() {
 	glTranslatef(0, 0, -1.0f * scale * (_terrain->length() - 1));
 	glRotatef(30, 1, 0, 0);
 	glRotatef(_angle, 0, 1, 0);
-	glTranslatef(-TERRAIN_WIDTH / 2, 0, -scale * (_terrain->length() - 1) / 2);
+	glTranslatef(-TERRAIN_WIDTH / 2 - _panX,
+				 0,
+				 -scale * (_terrain->length() - 1) / 2 - _panZ);
 	
-	GLfloat ambientLight[] = {0.5f, 0.5f, 0.5f, 1.0f};
+	GLfloat ambientLight[] =
+		{AMBIENT_LIGHT, AMBIENT_LIGHT, AMBIENT_LIGHT, 1.0f};
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientLight);
 	
-	GLfloat lightColor[] = {0.5f, 0.5f, 0.5f, 1.0f};
-	GLfloat lightPos[] = {-0.2f, 0.3f, -1, 0.0f};
+	GLfloat lightColor[] = {DIFFUSE_LIGHT, DIFFUSE_LIGHT, DIFFUSE_LIGHT, 1.0f};
+	GLfloat lightPos[] = {LIGHT_DIRECTION[0],
+						  LIGHT_DIRECTION[1],
+						  LIGHT_DIRECTION[2],
+						  0.0f};
 	glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor);
 	glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
 	
+	//Find the position of the camera, by inverting the modelview matrix,
+	//which is a rotation followed by a translation
+	GLfloat modelview[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	Vec3f eye;
+	for(int i = 0; i < 3; i++) {
+		eye[i] = -(modelview[4 * i] * modelview[12] +
+				   modelview[4 * i + 1] * modelview[13] +
+				   modelview[4 * i + 2] * modelview[14]);
+	}
+	
+	//Put the guys on the terrain, which may have moved or changed beneath
+	//them
+	updateGuyHeights(_guys, _terrain);
+	
+	//Skip the guys that are out of view
+	Frustum frustum;
+	frustum.setFromOpenGL();
+	vector<Guy*> visibleGuys = cullGuys(_guys, frustum);
+	
 	//Draw the guys
-	for(unsigned int i = 0; i < _guys.size(); i++) {
-		_guys[i]->draw();
+	vector<int> levels;
+	if (_useLevelsOfDetail) {
+		float screenScale =
+			_windowHeight / (2 * tan(_fieldOfView / 2 * PI / 180));
+		chooseLevelsOfDetail(visibleGuys, _model, eye, screenScale,
+							 _triangleBudget, levels);
 	}
+	else {
+		levels.assign(visibleGuys.size(), 0);
+	}
+	DrawOptions options;
+	options.useStrips = _useStrips;
+	options.poseCache = NULL;
+	if (_usePoseCache && !_useInstancing) {
+		options.poseCache = _poseCache;
+		_poseCache->beginFrame();
+		_poseCache->resetStats();
+	}
+	options.cullClusters = _cullClusters;
+	options.eye = eye;
+	int numVertices;
+	int numTriangles = drawGuys(visibleGuys, _model, _useInstancing, options,
+								levels, numVertices);
 	
 	//Draw the terrain
 	glScalef(scale, scale, scale);
-	drawTerrain(_terrain);
+	drawTerrain(_terrainDrawer);
 	
 	glutSwapBuffers();
+	
+	if (_benchmark) {
+		//Report the frame rate every two seconds
+		_framesSinceReport++;
+		_trianglesSinceReport += numTriangles;
+		_verticesSinceReport += numVertices;
+		if (options.poseCache != NULL) {
+			_posesSinceReport += _poseCache->posesComputed();
+		}
+		else if (!_useInstancing) {
+			_posesSinceReport += visibleGuys.size();
+		}
+		if (_model != NULL) {
+			_fullTrianglesSinceReport +=
+				visibleGuys.size() * _model->numTrianglesAt(0);
+		}
+		_guysCulledSinceReport += _guys.size() - visibleGuys.size();
+		int time = glutGet(GLUT_ELAPSED_TIME);
+		if (time - _lastReportTime >= 2000) {
+			const char* method = "per-guy triangle";
+			if (_useInstancing) {
+				method = "instanced";
+			}
+			else if (_cullClusters) {
+				method = "per-guy cluster-culled";
+			}
+			else if (_useStrips) {
+				method = "per-guy strip";
+			}
+			cout << _guys.size() << " guys, " << method << " drawing: "
+				 << 1000.0f * _framesSinceReport / (time - _lastReportTime)
+				 << " fps, " << _guysCulledSinceReport / _framesSinceReport
+				 << " culled, " << _trianglesSinceReport / _framesSinceReport
+				 << " triangles per frame ("
+				 << (_fullTrianglesSinceReport - _trianglesSinceReport) /
+					_framesSinceReport
+				 << " saved by levels of detail and culling), "
+				 << _verticesSinceReport / _framesSinceReport
+				 << " vertices per frame, "
+				 << _posesSinceReport / _framesSinceReport
+				 << " poses computed per frame";
+			if (_usePoseCache && !_useInstancing) {
+				cout << " (" << _poseCache->slots() << " slots, "
+					 << (_poseCache->isPersistent() ?
+						 "persistent" : "per-frame") << ")";
+			}
+			GLStateCounts counts = glsCounts();
+			long long changes = counts.changesSkipped + counts.changesForwarded;
+			long long queries =
+				counts.queriesAnswered + counts.queriesForwarded;
+			cout << ", " << counts.changesSkipped / _framesSinceReport
+				 << " of " << changes / _framesSinceReport
+				 << " state changes and "
+				 << counts.queriesAnswered / _framesSinceReport
+				 << " of " << queries / _framesSinceReport
+				 << " state queries per frame handled without OpenGL, "
+				 << "terrain in " << _terrainDrawer->numChunksDrawn()
+				 << " of " << _terrainDrawer->numChunks()
+				 << " chunks with " << _terrainDrawer->numTrianglesDrawn()
+				 << " triangles ("
+				 << (_terrainDrawer->levelsOfDetail() ?
+					 "levels of detail" : "full detail") << ") and "
+				 << _terrainDrawer->floatsUploadedSinceReset() /
+					_framesSinceReport
+				 << " floats updated per frame" << endl;
+			glsResetCounts();
+			_terrainDrawer->resetStats();
+			_framesSinceReport = 0;
+			_trianglesSinceReport = 0;
+			_verticesSinceReport = 0;
+			_posesSinceReport = 0;
+			_fullTrianglesSinceReport = 0;
+			_guysCulledSinceReport = 0;
+			_lastReportTime = time;
+		}
+	}
+}
+
+//Redraws continuously when benchmarking
+void idle() {
+	glutPostRedisplay();
 }
 
 void update(int value) {
@@ -956,14 +1348,63 @@ int main(int argc, char** argv) {
 	srand((unsigned int)time(0)); //Seed the random number generator
 	
 	glutInit(&argc, argv);
+	
+	/* Usage: blockhead [-guys N] [-budget N] [-terrainbudget N] [-tiled]
+	 *                  [-vertexbuffers] [-bench]
+	 * -guys N: Makes N guys rather than NUM_GUYS
+	 * -budget N: Draws the guys using at most about N triangles in total
+	 * -terrainbudget N: Draws the terrain using at most about N triangles
+	 * -tiled: Stores the terrain in tiles rather than row by row
+	 * -vertexbuffers: Draws the terrain from vertex buffers with positions and
+	 *                 normals, even where it could be drawn from a texture of
+	 *                 its heights
+	 * -bench: Draws as fast as possible, periodically printing the frame rate
+	 *         and the number of triangles drawn.  Press 'i' to switch between
+	 *         instanced and per-guy drawing, 'g' to switch between
+	 *         triangle strips and separate triangles for per-guy drawing, and
+	 *         'l' to switch levels of detail on and off.  'p' cycles the
+	 *         pose cache between off, per-frame, and persistent, and '['
+	 *         and ']' halve and double its number of slots.  'b' switches
+	 *         skipping back-facing clusters of triangles on and off.  't'
+	 *         switches levels of detail for the terrain on and off.
+	 * Press '+' and '-' to zoom in and out and 'w', 'a', 's', and 'd' to pan
+	 * the camera.  Press 'c' to dig a crater.  'o' cycles the terrain's
+	 * lighting between baked with ambient occlusion, which is the default,
+	 * baked, and OpenGL's lighting.
+	 */
+	for(int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-guys") == 0 && i + 1 < argc) {
+			_numGuys = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc) {
+			_triangleBudget = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-terrainbudget") == 0 && i + 1 < argc) {
+			_terrainTriangleBudget = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-tiled") == 0) {
+			_terrainLayout = Terrain::TILED;
+		}
+		else if (strcmp(argv[i], "-vertexbuffers") == 0) {
+			_allowHeightTexture = false;
+		}
+		else if (strcmp(argv[i], "-bench") == 0) {
+			_benchmark = true;
+		}
+	}
+	
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 	glutInitWindowSize(400, 400);
 	
 	glutCreateWindow("Putting It All Together - videotutorialsrock.com");
 	initRendering();
 	
-	_terrain = loadTerrain("heightmap.bmp", 30.0f); //Load the terrain
-	_guys = makeGuys(NUM_GUYS, _model, _terrain); //Create the guys
+	//Load the terrain
+	_terrain = loadTerrain("heightmap.bmp", 30.0f, _terrainLayout);
+	_terrainDrawer = new TerrainDrawer(_terrain, _allowHeightTexture);
+	_terrainDrawer->setTriangleBudget(_terrainTriangleBudget);
+	bakeTerrainLighting(true);
+	_guys = makeGuys(_numGuys, _model, _terrain); //Create the guys
 	//Compute the scaling factor for the terrain
 	float scaledTerrainLength =
 		TERRAIN_WIDTH / (_terrain->width() - 1) * (_terrain->length() - 1);
@@ -977,6 +1418,14 @@ int main(int argc, char** argv) {
 	glutKeyboardFunc(handleKeypress);
 	glutReshapeFunc(handleResize);
 	glutTimerFunc(25, update, 0);
+	if (_benchmark) {
+		cout << "Drawing the terrain from "
+			 << (_terrainDrawer->heightTexture() ?
+				 "a height texture" : "vertex buffers") << " with "
+			 << _terrainDrawer->memorySize() / 1024 << " KB of vertex data"
+			 << endl;
+		glutIdleFunc(idle);
+	}
 	
 	glutMainLoop();
 	return 0;
@@ -990,3 +1439,4 @@ int main(int argc, char** argv) {
 
 
 
+
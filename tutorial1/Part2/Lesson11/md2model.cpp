@@ -22,10 +22,28 @@
 
 
 
+#ifndef __APPLE__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <algorithm>
+#include <float.h>
 #include <fstream>
+#include <map>
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
+#include <vector>
+#include "glstate.h"
 #include "imageloader.h"
+#include "mappedfile.h"
 #include "md2model.h"
+#include "shader.h"
+#include "threadpool.h"
+
+#ifdef __APPLE__
+#include <OpenGL/glext.h>
+#endif
 
 using namespace std;
 
@@ -242,40 +260,158 @@ namespace {
 		return f;
 	}
 	
-	//Reads the next four bytes as an integer, using little-endian form
-	int readInt(ifstream &input) {
-		char buffer[4];
-		input.read(buffer, 4);
-		return toInt(buffer);
+	//Converts a twelve-character array to a Vec3f, using little-endian form
+	Vec3f toVec3f(const char* bytes) {
+		return Vec3f(toFloat(bytes), toFloat(bytes + 4), toFloat(bytes + 8));
 	}
 	
-	//Reads the next two bytes as a short, using little-endian form
-	short readShort(ifstream &input) {
-		char buffer[2];
-		input.read(buffer, 2);
-		return toShort(buffer);
+	//Limits on the contents of MD2 files, from the Quake II source code
+	const int MAX_VERTICES = 2048;
+	const int MAX_TEX_COORDS = 2048;
+	const int MAX_TRIANGLES = 4096;
+	const int MAX_FRAMES = 512;
+	//The number of normals in NORMALS
+	const int NUM_NORMALS = 162;
+	//The sizes, in bytes, of the parts of an MD2 file
+	const int HEADER_SIZE = 68;
+	const int TEX_COORD_SIZE = 4;
+	const int TRIANGLE_SIZE = 12;
+	const int FRAME_HEADER_SIZE = 40;
+	const int FRAME_VERTEX_SIZE = 4;
+	const int STRIP_VERTEX_SIZE = 12;
+	const int TEXTURE_NAME_SIZE = 64;
+	
+	//Returns whether the count items of the given size starting at offset lie
+	//within a file of the specified length
+	bool inBounds(int offset, int count, int size, size_t length) {
+		return offset >= 0 && count >= 0 &&
+			(size_t)offset + (size_t)count * size <= length;
 	}
 	
-	//Reads the next two bytes as an unsigned short, using little-endian form
-	unsigned short readUShort(ifstream &input) {
-		char buffer[2];
-		input.read(buffer, 2);
-		return toUShort(buffer);
+	/* The cache files written by MD2Model::load have the following format,
+	 * using the byte order of the machine that wrote them:
+	 * 
+	 * CacheHeader
+	 * MD2TexCoord[numTexCoords]
+	 * MD2Triangle[numTriangles]
+	 * int stripLengths[numStrips]
+	 * MD2StripVertex[numStripVertices]
+	 * int lodSizes[numLevels]: the number of triangles in each level of
+	 *     detail after level 0
+	 * MD2Triangle[numLodTriangles]: the triangles of those levels, one level
+	 *     after another
+	 * MD2Cluster[numClusters]
+	 * MD2Triangle[numTriangles]: the triangles, in the order of the clusters
+	 * MD2ClusterCone[numFrames * numClusters]: the cones of frame 0, then
+	 *     those of frame 1, etc.
+	 * for each frame: char name[16], MD2Vertex[numVertices]
+	 * 
+	 * Every part is a multiple of four bytes long, so that a mapped cache file
+	 * can be used in place.
+	 */
+	const char CACHE_MAGIC[8] = {'M', 'D', '2', 'C', 'A', 'C', 'H', 'E'};
+	const int CACHE_VERSION = 4;
+	const int BYTE_ORDER_MARK = 0x01020304;
+	
+	struct CacheHeader {
+		char magic[8];
+		int version;
+		int byteOrderMark;
+		//The size and modification time of the MD2 file, to detect whether
+		//the cache is out of date
+		long long sourceSize;
+		long long sourceModificationTime;
+		int numVertices;
+		int numTexCoords;
+		int numTriangles;
+		int numFrames;
+		int numStrips;
+		int numStripVertices;
+		int numLevels;
+		int numLodTriangles;
+		int numClusters;
+		char textureFilename[TEXTURE_NAME_SIZE];
+	};
+	
+	//Returns the number of bytes in a cache file with the specified counts
+	size_t cacheSize(const CacheHeader* header) {
+		return sizeof(CacheHeader) +
+			header->numTexCoords * sizeof(MD2TexCoord) +
+			header->numTriangles * sizeof(MD2Triangle) +
+			header->numStrips * sizeof(int) +
+			header->numStripVertices * sizeof(MD2StripVertex) +
+			header->numLevels * sizeof(int) +
+			header->numLodTriangles * sizeof(MD2Triangle) +
+			header->numClusters * sizeof(MD2Cluster) +
+			header->numTriangles * sizeof(MD2Triangle) +
+			header->numFrames * header->numClusters * sizeof(MD2ClusterCone) +
+			header->numFrames * (16 + header->numVertices * sizeof(MD2Vertex));
 	}
 	
-	//Reads the next four bytes as a float, using little-endian form
-	float readFloat(ifstream &input) {
-		char buffer[4];
-		input.read(buffer, 4);
-		return toFloat(buffer);
+	//Returns whether the memory layout of the loaded model data matches the
+	//one expected in cache files
+	bool cacheLayoutSupported() {
+		return sizeof(MD2Vertex) == 6 * sizeof(float) &&
+			sizeof(MD2TexCoord) == 2 * sizeof(float) &&
+			sizeof(MD2Triangle) == 6 * sizeof(int) &&
+			sizeof(MD2StripVertex) == 2 * sizeof(float) + sizeof(int) &&
+			sizeof(MD2Cluster) == 2 * sizeof(int) &&
+			sizeof(MD2ClusterCone) == 8 * sizeof(float) &&
+			sizeof(CacheHeader) % 4 == 0;
+	}
+	
+	//Returns whether the triangles only refer to existing vertices and
+	//texture coordinates
+	bool trianglesValid(const MD2Triangle* triangles,
+						int numTriangles,
+						int numVertices,
+						int numTexCoords) {
+		for(int i = 0; i < numTriangles; i++) {
+			for(int j = 0; j < 3; j++) {
+				if (triangles[i].vertices[j] < 0 ||
+					triangles[i].vertices[j] >= numVertices ||
+					triangles[i].texCoords[j] < 0 ||
+					triangles[i].texCoords[j] >= numTexCoords) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	
+	//Returns whether the strip vertices only refer to existing vertices and
+	//have finite texture coordinates
+	bool stripVerticesValid(const MD2StripVertex* stripVertices,
+							int numStripVertices,
+							int numVertices) {
+		for(int i = 0; i < numStripVertices; i++) {
+			const MD2StripVertex &stripVertex = stripVertices[i];
+			//The comparisons are false for NaN as well as for infinities
+			if (stripVertex.vertex < 0 ||
+				stripVertex.vertex >= numVertices ||
+				!(fabs(stripVertex.texCoordX) <= FLT_MAX) ||
+				!(fabs(stripVertex.texCoordY) <= FLT_MAX)) {
+				return false;
+			}
+		}
+		return true;
 	}
 	
-	//Calls readFloat three times and returns the results as a Vec3f object
-	Vec3f readVec3f(ifstream &input) {
-		float x = readFloat(input);
-		float y = readFloat(input);
-		float z = readFloat(input);
-		return Vec3f(x, y, z);
+	//Returns whether all of the numbers in the cones are finite
+	bool conesValid(const MD2ClusterCone* cones, int numCones) {
+		for(int i = 0; i < numCones; i++) {
+			const MD2ClusterCone &cone = cones[i];
+			float values[8] = {cone.center[0], cone.center[1], cone.center[2],
+							   cone.radius,
+							   cone.axis[0], cone.axis[1], cone.axis[2],
+							   cone.cutoff};
+			for(int j = 0; j < 8; j++) {
+				if (!(fabs(values[j]) <= FLT_MAX)) {
+					return false;
+				}
+			}
+		}
+		return true;
 	}
 	
 	//Makes the image into a texture, and returns the id of the texture
@@ -293,21 +429,501 @@ namespace {
 					 image->pixels);
 		return textureId;
 	}
+	
+	//The vertex shader for MD2Model::drawInstanced.  It mirrors the frame
+	//selection and interpolation in MD2Model::draw.
+	const char* INSTANCED_VERTEX_SHADER =
+		"#version 120\n"
+		"uniform sampler2D frames;\n"
+		"uniform vec2 framesSize;\n"
+		"attribute vec3 corner;\n"
+		"attribute vec4 row0;\n"
+		"attribute vec4 row1;\n"
+		"attribute vec4 row2;\n"
+		"attribute vec3 anim;\n"
+		"attribute vec3 tint;\n"
+		"varying vec2 texCoord;\n"
+		"varying vec3 color;\n"
+		"vec3 fetch(float row) {\n"
+		"	vec2 st = vec2((corner.x + 0.5) / framesSize.x,\n"
+		"				   (row + 0.5) / framesSize.y);\n"
+		"	return texture2DLod(frames, st, 0.0).xyz;\n"
+		"}\n"
+		"void main() {\n"
+		"	float numAnimFrames = anim.y - anim.x + 1.0;\n"
+		"	float t = fract(anim.z) * numAnimFrames;\n"
+		"	float frame = min(floor(t), numAnimFrames - 1.0);\n"
+		"	float frac = t - frame;\n"
+		"	float frame1 = anim.x + frame;\n"
+		"	float frame2 = frame1 < anim.y ? frame1 + 1.0 : anim.x;\n"
+		"	vec3 pos = mix(fetch(2.0 * frame1), fetch(2.0 * frame2), frac);\n"
+		"	vec3 normal = mix(fetch(2.0 * frame1 + 1.0),\n"
+		"					  fetch(2.0 * frame2 + 1.0), frac);\n"
+		"	if (normal == vec3(0.0)) {\n"
+		"		normal = vec3(0.0, 0.0, 1.0);\n"
+		"	}\n"
+		"	vec4 p = vec4(pos, 1.0);\n"
+		"	p = vec4(dot(row0, p), dot(row1, p), dot(row2, p), 1.0);\n"
+		"	normal = vec3(dot(row0.xyz, normal),\n"
+		"				  dot(row1.xyz, normal),\n"
+		"				  dot(row2.xyz, normal));\n"
+		"	gl_Position = gl_ModelViewProjectionMatrix * p;\n"
+		"	vec3 n = normalize(gl_NormalMatrix * normal);\n"
+		"	vec3 l = normalize(gl_LightSource[0].position.xyz);\n"
+		"	color = tint * (gl_LightModel.ambient.rgb +\n"
+		"					gl_LightSource[0].diffuse.rgb *\n"
+		"					max(dot(n, l), 0.0));\n"
+		"	texCoord = corner.yz;\n"
+		"}\n";
+	
+	const char* INSTANCED_FRAGMENT_SHADER =
+		"#version 120\n"
+		"uniform sampler2D skin;\n"
+		"varying vec2 texCoord;\n"
+		"varying vec3 color;\n"
+		"void main() {\n"
+		"	gl_FragColor = vec4(color, 1.0) * texture2D(skin, texCoord);\n"
+		"}\n";
+	
+	//The names of the vertex attributes of INSTANCED_VERTEX_SHADER, in order
+	const char* INSTANCED_ATTRIBUTES[] =
+		{"corner", "row0", "row1", "row2", "anim", "tint", NULL};
+	
+	//The number of floats in an MD2Instance
+	const int INSTANCE_FLOATS = sizeof(MD2Instance) / sizeof(float);
+	
+	//A directed edge between two triangle corners, each identified by its
+	//vertex and texture coordinate
+	typedef pair<int, int> CornerEdge;
+	
+	/* Adds triangles to the end of a triangle strip for as long as there is an
+	 * unused triangle that continues it.  Each corner in "corners" is stored
+	 * as 3 * triangle + j for the jth corner of a triangle.  cornerKeys
+	 * identifies the vertex and texture coordinate of each corner, and
+	 * edgeTriangles lists the triangles that have each directed edge.  Marks
+	 * the added triangles as used and returns them.
+	 */
+	vector<int> extendStrip(vector<int> &corners,
+							vector<bool> &used,
+							const vector<int> &cornerKeys,
+							map<CornerEdge, vector<int> > &edgeTriangles) {
+		vector<int> added;
+		while (true) {
+			//OpenGL reverses every other triangle in a strip, so the next
+			//triangle must have the last edge in the corresponding direction
+			int n = (int)corners.size();
+			int a = cornerKeys[corners[n - 2]];
+			int b = cornerKeys[corners[n - 1]];
+			if (n % 2 == 1) {
+				swap(a, b);
+			}
+			
+			int next = -1;
+			vector<int> &candidates = edgeTriangles[CornerEdge(a, b)];
+			for(unsigned int i = 0; i < candidates.size() && next < 0; i++) {
+				int triangle = candidates[i];
+				if (used[triangle]) {
+					continue;
+				}
+				for(int j = 0; j < 3; j++) {
+					if (cornerKeys[3 * triangle + j] == a &&
+						cornerKeys[3 * triangle + (j + 1) % 3] == b) {
+						next = 3 * triangle + (j + 2) % 3;
+						break;
+					}
+				}
+			}
+			if (next < 0) {
+				return added;
+			}
+			
+			used[next / 3] = true;
+			added.push_back(next / 3);
+			corners.push_back(next);
+		}
+	}
+	
+	/* Joins the triangles into triangle strips.  Triangles are only joined
+	 * where their shared corners have the same vertices and texture
+	 * coordinates.  Each strip starts with the first unused triangle, turned
+	 * so that the strip is as long as possible.
+	 */
+	void makeStrips(const MD2Triangle* triangles,
+					int numTriangles,
+					const MD2TexCoord* texCoords,
+					int numTexCoords,
+					vector<int> &stripLengths,
+					vector<MD2StripVertex> &stripVertices) {
+		vector<int> cornerKeys(3 * numTriangles);
+		for(int i = 0; i < numTriangles; i++) {
+			for(int j = 0; j < 3; j++) {
+				cornerKeys[3 * i + j] =
+					triangles[i].vertices[j] * numTexCoords +
+					triangles[i].texCoords[j];
+			}
+		}
+		map<CornerEdge, vector<int> > edgeTriangles;
+		for(int i = 0; i < numTriangles; i++) {
+			for(int j = 0; j < 3; j++) {
+				CornerEdge edge(cornerKeys[3 * i + j],
+								cornerKeys[3 * i + (j + 1) % 3]);
+				edgeTriangles[edge].push_back(i);
+			}
+		}
+		
+		vector<bool> used(numTriangles, false);
+		for(int i = 0; i < numTriangles; i++) {
+			if (used[i]) {
+				continue;
+			}
+			
+			//Try starting the strip with each edge of the triangle
+			used[i] = true;
+			vector<int> bestCorners;
+			for(int j = 0; j < 3; j++) {
+				vector<int> corners;
+				for(int k = 0; k < 3; k++) {
+					corners.push_back(3 * i + (j + k) % 3);
+				}
+				vector<int> added =
+					extendStrip(corners, used, cornerKeys, edgeTriangles);
+				for(unsigned int k = 0; k < added.size(); k++) {
+					used[added[k]] = false;
+				}
+				if (corners.size() > bestCorners.size()) {
+					bestCorners = corners;
+				}
+			}
+			for(unsigned int j = 3; j < bestCorners.size(); j++) {
+				used[bestCorners[j] / 3] = true;
+			}
+			
+			stripLengths.push_back((int)bestCorners.size());
+			for(unsigned int j = 0; j < bestCorners.size(); j++) {
+				const MD2Triangle* triangle = triangles + bestCorners[j] / 3;
+				int corner = bestCorners[j] % 3;
+				const MD2TexCoord* texCoord =
+					texCoords + triangle->texCoords[corner];
+				MD2StripVertex vertex;
+				vertex.texCoordX = texCoord->texCoordX;
+				vertex.texCoordY = texCoord->texCoordY;
+				vertex.vertex = triangle->vertices[corner];
+				stripVertices.push_back(vertex);
+			}
+		}
+	}
+	
+	//The most frames whose vertex positions are used to choose the edge
+	//collapses for the levels of detail
+	const int LOD_SAMPLE_FRAMES = 16;
+	//The fewest triangles that a level of detail may have
+	const int LOD_MIN_TRIANGLES = 16;
+	
+	//The most triangles in a cluster used by MD2Model::drawCulled
+	const int CLUSTER_SIZE = 64;
+	//How closely, from 0 to 1, the normals of the triangles in a cluster must
+	//agree with those of the cluster's first triangle, on average
+	const float MIN_CLUSTER_SIMILARITY = 0.95f;
+	
+	//Returns the normal of the triangle with the specified vertices, scaled by
+	//twice the triangle's area
+	Vec3f faceNormal(const MD2Vertex* vertices, const MD2Triangle &triangle) {
+		Vec3f v0 = vertices[triangle.vertices[0]].pos;
+		Vec3f v1 = vertices[triangle.vertices[1]].pos;
+		Vec3f v2 = vertices[triangle.vertices[2]].pos;
+		return (v1 - v0).cross(v2 - v0);
+	}
+	
+	//Returns whether every triangle in the cluster with the specified cone
+	//faces away from the point "eye"
+	bool facesAway(const MD2ClusterCone &cone, Vec3f eye) {
+		Vec3f toCenter = cone.center - eye;
+		return toCenter.dot(cone.axis) >=
+			cone.cutoff * toCenter.magnitude() + cone.radius;
+	}
+	
+	/* Simplifies a mesh by repeatedly collapsing the cheapest edge, as in
+	 * Stan Melax's "A Simple, Fast, and Effective Polygon Reduction
+	 * Algorithm".  The cost of an edge is its length times the curvature
+	 * around it, averaged over several frames of the animation.
+	 */
+	class EdgeCollapser {
+		private:
+			int numVertices;
+			int numTriangles;
+			//The vertices of each of the sampled frames
+			vector<const MD2Vertex*> samples;
+			//The current vertices of each triangle, three per triangle
+			vector<int> corners;
+			//The live triangles that use each vertex
+			vector< vector<int> > faces;
+			vector<bool> removed;
+			//The cost of collapsing each vertex onto its target
+			vector<float> costs;
+			//The vertex onto which each vertex would best be collapsed, or -1
+			//if it is not used by any live triangle
+			vector<int> targets;
+			
+			//Returns whether the specified triangle uses the specified vertex
+			bool uses(int triangle, int vertex) {
+				return corners[3 * triangle] == vertex ||
+					corners[3 * triangle + 1] == vertex ||
+					corners[3 * triangle + 2] == vertex;
+			}
+			
+			//Returns the unit normal of the specified triangle in the
+			//specified sampled frame, or the zero vector if it has no area
+			Vec3f normal(int triangle, int sample) {
+				const MD2Vertex* vertices = samples[sample];
+				Vec3f v0 = vertices[corners[3 * triangle]].pos;
+				Vec3f v1 = vertices[corners[3 * triangle + 1]].pos;
+				Vec3f v2 = vertices[corners[3 * triangle + 2]].pos;
+				Vec3f n = (v1 - v0).cross(v2 - v0);
+				float magnitude = n.magnitude();
+				if (magnitude == 0) {
+					return Vec3f(0, 0, 0);
+				}
+				return n / magnitude;
+			}
+			
+			//Returns the vertices that share a live triangle with vertex
+			vector<int> neighbors(int vertex) {
+				vector<int> result;
+				for(unsigned int i = 0; i < faces[vertex].size(); i++) {
+					int triangle = faces[vertex][i];
+					for(int j = 0; j < 3; j++) {
+						int other = corners[3 * triangle + j];
+						if (other != vertex &&
+							find(result.begin(), result.end(), other) ==
+								result.end()) {
+							result.push_back(other);
+						}
+					}
+				}
+				return result;
+			}
+			
+			//Returns whether vertex lies on an edge that only one live
+			//triangle uses
+			bool onBorder(int vertex) {
+				vector<int> others = neighbors(vertex);
+				for(unsigned int i = 0; i < others.size(); i++) {
+					int numSides = 0;
+					for(unsigned int j = 0; j < faces[vertex].size(); j++) {
+						if (uses(faces[vertex][j], others[i])) {
+							numSides++;
+						}
+					}
+					if (numSides < 2) {
+						return true;
+					}
+				}
+				return false;
+			}
+			
+			/* Returns the cost of collapsing u onto v.  faceNormals holds the
+			 * normal of each of u's triangles in each sampled frame, with the
+			 * normals for each frame stored together.
+			 */
+			float edgeCost(int u, int v, bool border,
+						   const vector<Vec3f> &faceNormals) {
+				int numFaces = (int)faces[u].size();
+				vector<int> sides;
+				for(int i = 0; i < numFaces; i++) {
+					if (uses(faces[u][i], v)) {
+						sides.push_back(i);
+					}
+				}
+				
+				float cost = 0;
+				for(unsigned int s = 0; s < samples.size(); s++) {
+					float length = (samples[s][v].pos - samples[s][u].pos).
+						magnitude();
+					//Removing a vertex from the border of the mesh changes
+					//its outline, so give it the highest curvature
+					float curvature = 1;
+					if (!border) {
+						const Vec3f* normals = &faceNormals[s * numFaces];
+						curvature = 0;
+						for(int i = 0; i < numFaces; i++) {
+							float minCurvature = 1;
+							for(unsigned int j = 0; j < sides.size(); j++) {
+								float c =
+									(1 - normals[i].dot(normals[sides[j]])) / 2;
+								if (c < minCurvature) {
+									minCurvature = c;
+								}
+							}
+							if (minCurvature > curvature) {
+								curvature = minCurvature;
+							}
+						}
+					}
+					cost += length * curvature;
+				}
+				return cost / samples.size();
+			}
+			
+			//Computes the cheapest collapse of the specified vertex
+			void updateCost(int vertex) {
+				vector<int> others = neighbors(vertex);
+				if (others.empty()) {
+					//Unused vertices can be removed for free
+					costs[vertex] = -1;
+					targets[vertex] = -1;
+					return;
+				}
+				
+				bool border = onBorder(vertex);
+				int numFaces = (int)faces[vertex].size();
+				vector<Vec3f> faceNormals(samples.size() * numFaces);
+				for(unsigned int s = 0; s < samples.size(); s++) {
+					for(int i = 0; i < numFaces; i++) {
+						faceNormals[s * numFaces + i] =
+							normal(faces[vertex][i], s);
+					}
+				}
+				
+				costs[vertex] = 0;
+				targets[vertex] = -1;
+				for(unsigned int i = 0; i < others.size(); i++) {
+					float cost = edgeCost(vertex, others[i], border,
+										  faceNormals);
+					if (targets[vertex] < 0 || cost < costs[vertex]) {
+						costs[vertex] = cost;
+						targets[vertex] = others[i];
+					}
+				}
+			}
+		public:
+			EdgeCollapser(const MD2Frame* frames,
+						  int numFrames,
+						  int numVertices1,
+						  const MD2Triangle* triangles,
+						  int numTriangles1) :
+				numVertices(numVertices1), numTriangles(numTriangles1),
+				corners(3 * numTriangles1), faces(numVertices1),
+				removed(numVertices1, false),
+				costs(numVertices1), targets(numVertices1) {
+				int numSamples = min(numFrames, LOD_SAMPLE_FRAMES);
+				for(int i = 0; i < numSamples; i++) {
+					samples.push_back(
+						frames[i * numFrames / numSamples].vertices);
+				}
+				
+				for(int i = 0; i < numTriangles; i++) {
+					for(int j = 0; j < 3; j++) {
+						int vertex = triangles[i].vertices[j];
+						corners[3 * i + j] = vertex;
+						vector<int> &f = faces[vertex];
+						if (find(f.begin(), f.end(), i) == f.end()) {
+							f.push_back(i);
+						}
+					}
+				}
+			}
+			
+			/* Removes all of the vertices, one collapse at a time.  Stores the
+			 * vertex removed by each collapse in removalOrder, the vertex
+			 * onto which each vertex was collapsed (or -1 if it was unused) in
+			 * collapseTo, and in triangleDeaths the number of collapses after
+			 * which each triangle disappears, or numVertices + 1 if it never
+			 * does.
+			 */
+			void collapseAll(vector<int> &removalOrder,
+							 vector<int> &collapseTo,
+							 vector<int> &triangleDeaths) {
+				removalOrder.clear();
+				collapseTo.assign(numVertices, -1);
+				triangleDeaths.assign(numTriangles, numVertices + 1);
+				for(int i = 0; i < numVertices; i++) {
+					updateCost(i);
+				}
+				
+				for(int step = 0; step < numVertices; step++) {
+					//Find the cheapest collapse
+					int u = -1;
+					for(int i = 0; i < numVertices; i++) {
+						if (!removed[i] && (u < 0 || costs[i] < costs[u])) {
+							u = i;
+						}
+					}
+					int v = targets[u];
+					removed[u] = true;
+					removalOrder.push_back(u);
+					collapseTo[u] = v;
+					if (v < 0) {
+						continue;
+					}
+					
+					vector<int> affected = neighbors(u);
+					vector<int> uFaces = faces[u];
+					faces[u].clear();
+					for(unsigned int i = 0; i < uFaces.size(); i++) {
+						int triangle = uFaces[i];
+						if (uses(triangle, v)) {
+							//The triangle becomes degenerate
+							triangleDeaths[triangle] = step + 1;
+							for(int j = 0; j < 3; j++) {
+								int vertex = corners[3 * triangle + j];
+								vector<int> &f = faces[vertex];
+								f.erase(remove(f.begin(), f.end(), triangle),
+										f.end());
+							}
+						}
+						else {
+							for(int j = 0; j < 3; j++) {
+								if (corners[3 * triangle + j] == u) {
+									corners[3 * triangle + j] = v;
+								}
+							}
+							faces[v].push_back(triangle);
+						}
+					}
+					
+					for(unsigned int i = 0; i < affected.size(); i++) {
+						updateCost(affected[i]);
+					}
+				}
+			}
+	};
 }
 
 MD2Model::~MD2Model() {
-	if (frames != NULL) {
-		for(int i = 0; i < numFrames; i++) {
-			delete[] frames[i].vertices;
-		}
+	if (cacheFile != NULL) {
+		//The vertices, texture coordinates, and triangles are in the
+		//mapped cache file
 		delete[] frames;
+		delete cacheFile;
 	}
-	
-	if (texCoords != NULL) {
-		delete[] texCoords;
+	else {
+		if (frames != NULL) {
+			for(int i = 0; i < numFrames; i++) {
+				delete[] frames[i].vertices;
+			}
+			delete[] frames;
+		}
+		
+		if (texCoords != NULL) {
+			delete[] texCoords;
+		}
+		if (triangles != NULL) {
+			delete[] triangles;
+		}
+		if (stripLengths != NULL) {
+			delete[] stripLengths;
+		}
+		if (stripVertices != NULL) {
+			delete[] stripVertices;
+		}
 	}
-	if (triangles != NULL) {
-		delete[] triangles;
+	
+	if (instancingReady) {
+		glDeleteTextures(1, &framesTextureId);
+		glsForgetTexture(framesTextureId);
+		glDeleteBuffers(1, &cornerBufferId);
+		glDeleteBuffers(1, &instanceBufferId);
+		glDeleteProgram(programId);
 	}
 }
 
@@ -315,114 +931,950 @@ MD2Model::MD2Model() {
 	frames = NULL;
 	texCoords = NULL;
 	triangles = NULL;
+	stripLengths = NULL;
+	numStrips = 0;
+	stripVertices = NULL;
+	numStripVertices = 0;
+	cacheFile = NULL;
+	instancingReady = false;
+}
+
+void MD2Model::loadSkin(const char* filename) {
+	Image* image = loadBMP(filename);
+	textureId = loadTexture(image);
+	delete image;
 }
 
 //Loads the MD2 model
-MD2Model* MD2Model::load(const char* filename) {
-	ifstream input;
-	input.open(filename, istream::binary);
-	
-	char buffer[64];
-	input.read(buffer, 4); //Should be "IPD2", if this is an MD2 file
-	if (buffer[0] != 'I' || buffer[1] != 'D' ||
-		buffer[2] != 'P' || buffer[3] != '2') {
+MD2Model* MD2Model::load(const char* filename, const char* cacheFilename) {
+	if (cacheFilename != NULL) {
+		MD2Model* model = loadCache(filename, cacheFilename);
+		if (model != NULL) {
+			return model;
+		}
+	}
+	
+	MappedFile* file = MappedFile::open(filename);
+	if (file == NULL) {
+		return NULL;
+	}
+	MD2Model* model = parse(file->data(), file->size());
+	if (model != NULL && cacheFilename != NULL) {
+		model->writeCache(cacheFilename, file->size(),
+						  file->modificationTime());
+	}
+	delete file;
+	return model;
+}
+
+MD2Model* MD2Model::parse(const char* data, size_t length) {
+	if (length < (size_t)HEADER_SIZE) {
 		return NULL;
 	}
-	if (readInt(input) != 8) { //The version number
+	if (data[0] != 'I' || data[1] != 'D' ||  //Should be "IDP2", if this is an
+		data[2] != 'P' || data[3] != '2') {  //MD2 file
+		return NULL;
+	}
+	if (toInt(data + 4) != 8) { //The version number
 		return NULL;
 	}
 	
-	int textureWidth = readInt(input);   //The width of the textures
-	int textureHeight = readInt(input);  //The height of the textures
-	readInt(input);                      //The number of bytes per frame
-	int numTextures = readInt(input);    //The number of textures
+	int textureWidth = toInt(data + 8);    //The width of the textures
+	int textureHeight = toInt(data + 12);  //The height of the textures
+	int frameSize = toInt(data + 16);      //The number of bytes per frame
+	int numTextures = toInt(data + 20);    //The number of textures
 	if (numTextures != 1) {
 		return NULL;
 	}
-	int numVertices = readInt(input);    //The number of vertices
-	int numTexCoords = readInt(input);   //The number of texture coordinates
-	int numTriangles = readInt(input);   //The number of triangles
-	readInt(input);                      //The number of OpenGL commands
-	int numFrames = readInt(input);      //The number of frames
+	int numVertices = toInt(data + 24);    //The number of vertices
+	int numTexCoords = toInt(data + 28);   //The number of texture coordinates
+	int numTriangles = toInt(data + 32);   //The number of triangles
+	int numGLCommands = toInt(data + 36);  //The number of OpenGL commands
+	int numFrames = toInt(data + 40);      //The number of frames
 	
 	//Offsets (number of bytes after the beginning of the file to the beginning
 	//of where certain data appear)
-	int textureOffset = readInt(input);  //The offset to the textures
-	int texCoordOffset = readInt(input); //The offset to the texture coordinates
-	int triangleOffset = readInt(input); //The offset to the triangles
-	int frameOffset = readInt(input);    //The offset to the frames
-	readInt(input);                      //The offset to the OpenGL commands
-	readInt(input);                      //The offset to the end of the file
-	
-	//Load the texture
-	input.seekg(textureOffset, ios_base::beg);
-	input.read(buffer, 64);
-	if (strlen(buffer) < 5 ||
-		strcmp(buffer + strlen(buffer) - 4, ".bmp") != 0) {
+	int textureOffset = toInt(data + 44);  //The offset to the textures
+	int texCoordOffset = toInt(data + 48); //The offset to the texture
+	                                       //coordinates
+	int triangleOffset = toInt(data + 52); //The offset to the triangles
+	int frameOffset = toInt(data + 56);    //The offset to the frames
+	int glCommandOffset = toInt(data + 60); //The offset to the OpenGL
+	                                        //commands
+	                                        //(64: the offset to the end of
+	                                        //the file)
+	
+	//Check every count and offset against the size of the file, so that a
+	//damaged file can't make us read outside of it
+	if (textureWidth <= 0 || textureHeight <= 0 ||
+		numVertices <= 0 || numVertices > MAX_VERTICES ||
+		numTexCoords <= 0 || numTexCoords > MAX_TEX_COORDS ||
+		numTriangles <= 0 || numTriangles > MAX_TRIANGLES ||
+		numFrames <= 0 || numFrames > MAX_FRAMES ||
+		frameSize != FRAME_HEADER_SIZE + FRAME_VERTEX_SIZE * numVertices ||
+		!inBounds(textureOffset, 1, TEXTURE_NAME_SIZE, length) ||
+		!inBounds(texCoordOffset, numTexCoords, TEX_COORD_SIZE, length) ||
+		!inBounds(triangleOffset, numTriangles, TRIANGLE_SIZE, length) ||
+		!inBounds(frameOffset, numFrames, frameSize, length) ||
+		!inBounds(glCommandOffset, numGLCommands, 4, length)) {
 		return NULL;
 	}
-	Image* image = loadBMP(buffer);
-	GLuint textureId = loadTexture(image);
-	delete image;
+	
+	//Check the texture's filename
+	char textureFilename[TEXTURE_NAME_SIZE];
+	memcpy(textureFilename, data + textureOffset, TEXTURE_NAME_SIZE);
+	if (memchr(textureFilename, '\0', TEXTURE_NAME_SIZE) == NULL) {
+		return NULL;
+	}
+	int nameLength = strlen(textureFilename);
+	if (nameLength < 5 ||
+		strcmp(textureFilename + nameLength - 4, ".bmp") != 0) {
+		return NULL;
+	}
+	
+	//Load the triangles, checking that they refer to existing vertices and
+	//texture coordinates
+	MD2Triangle* triangles = new MD2Triangle[numTriangles];
+	for(int i = 0; i < numTriangles; i++) {
+		MD2Triangle* triangle = triangles + i;
+		const char* bytes = data + triangleOffset + TRIANGLE_SIZE * i;
+		for(int j = 0; j < 3; j++) {
+			triangle->vertices[j] = toUShort(bytes + 2 * j);
+			triangle->texCoords[j] = toUShort(bytes + 6 + 2 * j);
+			if (triangle->vertices[j] >= numVertices ||
+				triangle->texCoords[j] >= numTexCoords) {
+				delete[] triangles;
+				return NULL;
+			}
+		}
+	}
+	
+	/* The OpenGL commands are a sequence of triangle strips and fans, ending
+	 * with a zero.  Each starts with the number of vertices in a strip, or
+	 * minus the number in a fan, followed by a texture coordinate (two floats)
+	 * and a vertex index for each vertex.  Count the strips and fans, checking
+	 * that they lie within the commands and refer to existing vertices.
+	 */
+	const char* commands = data + glCommandOffset;
+	int numStrips = 0;
+	int numStripVertices = 0;
+	bool stripsHaveTexCoords = false;
+	int position = 0; //The index of the next command
+	while (position < numGLCommands) {
+		int count = toInt(commands + 4 * position);
+		if (count == 0) {
+			break;
+		}
+		count = abs(count);
+		if (count < 3 || count > (numGLCommands - position - 1) / 3) {
+			delete[] triangles;
+			return NULL;
+		}
+		for(int i = 0; i < count; i++) {
+			const char* bytes = commands + 4 * (position + 1 + 3 * i);
+			int vertex = toInt(bytes + 8);
+			if (vertex < 0 || vertex >= numVertices) {
+				delete[] triangles;
+				return NULL;
+			}
+			if (toFloat(bytes) != 0 || toFloat(bytes + 4) != 0) {
+				stripsHaveTexCoords = true;
+			}
+		}
+		numStrips++;
+		numStripVertices += count;
+		position += 1 + 3 * count;
+	}
+	
 	MD2Model* model = new MD2Model();
-	model->textureId = textureId;
+	model->triangles = triangles;
+	model->numTriangles = numTriangles;
+	model->loadSkin(textureFilename);
 	
 	//Load the texture coordinates
-	input.seekg(texCoordOffset, ios_base::beg);
 	model->texCoords = new MD2TexCoord[numTexCoords];
+	model->numTexCoords = numTexCoords;
 	for(int i = 0; i < numTexCoords; i++) {
 		MD2TexCoord* texCoord = model->texCoords + i;
-		texCoord->texCoordX = (float)readShort(input) / textureWidth;
-		texCoord->texCoordY = 1 - (float)readShort(input) / textureHeight;
+		const char* bytes = data + texCoordOffset + TEX_COORD_SIZE * i;
+		texCoord->texCoordX = (float)toShort(bytes) / textureWidth;
+		texCoord->texCoordY = 1 - (float)toShort(bytes + 2) / textureHeight;
 	}
 	
-	//Load the triangles
-	input.seekg(triangleOffset, ios_base::beg);
-	model->triangles = new MD2Triangle[numTriangles];
-	model->numTriangles = numTriangles;
-	for(int i = 0; i < numTriangles; i++) {
-		MD2Triangle* triangle = model->triangles + i;
-		for(int j = 0; j < 3; j++) {
-			triangle->vertices[j] = readUShort(input);
-		}
-		for(int j = 0; j < 3; j++) {
-			triangle->texCoords[j] = readUShort(input);
+	/* Use the strips and fans from the file if they save vertices and have
+	 * texture coordinates.  Some exporters write each triangle as a separate
+	 * strip with no texture coordinates, in which case we make our own strips.
+	 */
+	if (numStrips > 0 && numStripVertices < 3 * numTriangles &&
+		stripsHaveTexCoords) {
+		model->stripLengths = new int[numStrips];
+		model->numStrips = numStrips;
+		model->stripVertices = new MD2StripVertex[numStripVertices];
+		model->numStripVertices = numStripVertices;
+		position = 0;
+		MD2StripVertex* stripVertex = model->stripVertices;
+		for(int i = 0; i < numStrips; i++) {
+			int count = toInt(commands + 4 * position);
+			model->stripLengths[i] = count;
+			const char* bytes = commands + 4 * (position + 1);
+			for(int j = 0; j < abs(count); j++) {
+				//The file's t coordinates go down from the top of the skin,
+				//as with the texture coordinates above
+				stripVertex->texCoordX = toFloat(bytes);
+				stripVertex->texCoordY = 1 - toFloat(bytes + 4);
+				stripVertex->vertex = toInt(bytes + 8);
+				stripVertex++;
+				bytes += STRIP_VERTEX_SIZE;
+			}
+			position += 1 + 3 * abs(count);
 		}
 	}
+	else {
+		vector<int> stripLengths;
+		vector<MD2StripVertex> stripVertices;
+		makeStrips(triangles, numTriangles, model->texCoords, numTexCoords,
+				   stripLengths, stripVertices);
+		model->numStrips = (int)stripLengths.size();
+		model->stripLengths = new int[model->numStrips];
+		copy(stripLengths.begin(), stripLengths.end(), model->stripLengths);
+		model->numStripVertices = (int)stripVertices.size();
+		model->stripVertices = new MD2StripVertex[model->numStripVertices];
+		copy(stripVertices.begin(), stripVertices.end(),
+			 model->stripVertices);
+	}
 	
-	//Load the frames
-	input.seekg(frameOffset, ios_base::beg);
+	//Load the frames.  They are independent of each other, so they are
+	//decoded in parallel.
 	model->frames = new MD2Frame[numFrames];
 	model->numFrames = numFrames;
+	model->numVertices = numVertices;
 	for(int i = 0; i < numFrames; i++) {
-		MD2Frame* frame = model->frames + i;
-		frame->vertices = new MD2Vertex[numVertices];
-		Vec3f scale = readVec3f(input);
-		Vec3f translation = readVec3f(input);
-		input.read(frame->name, 16);
+		model->frames[i].vertices = new MD2Vertex[numVertices];
+	}
+	MD2Frame* frames = model->frames;
+	defaultThreadPool()->parallelFor(numFrames, [=](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			MD2Frame* frame = frames + i;
+			const char* bytes = data + frameOffset + frameSize * i;
+			Vec3f scale = toVec3f(bytes);
+			Vec3f translation = toVec3f(bytes + 12);
+			memcpy(frame->name, bytes + 24, 16);
+			frame->name[15] = '\0';
+			
+			bytes += FRAME_HEADER_SIZE;
+			for(int j = 0; j < numVertices; j++) {
+				MD2Vertex* vertex = frame->vertices + j;
+				vertex->pos = translation +
+					Vec3f(scale[0] * (unsigned char)bytes[0],
+						  scale[1] * (unsigned char)bytes[1],
+						  scale[2] * (unsigned char)bytes[2]);
+				int normalIndex = (int)((unsigned char)bytes[3]);
+				if (normalIndex >= NUM_NORMALS) {
+					normalIndex = 0;
+				}
+				vertex->normal = Vec3f(NORMALS[3 * normalIndex],
+									   NORMALS[3 * normalIndex + 1],
+									   NORMALS[3 * normalIndex + 2]);
+				bytes += FRAME_VERTEX_SIZE;
+			}
+		}
+	});
+	
+	memcpy(model->textureFilename, textureFilename, TEXTURE_NAME_SIZE);
+	model->buildLevelsOfDetail();
+	model->buildClusters();
+	model->finishLoading();
+	return model;
+}
+
+MD2Model* MD2Model::loadCache(const char* filename,
+							  const char* cacheFilename) {
+	size_t sourceSize;
+	long long sourceModificationTime;
+	if (!cacheLayoutSupported() ||
+		!fileStats(filename, sourceSize, sourceModificationTime)) {
+		return NULL;
+	}
+	
+	MappedFile* file = MappedFile::open(cacheFilename);
+	if (file == NULL) {
+		return NULL;
+	}
+	
+	//Check that the cache is for this version of the MD2 file and that its
+	//counts match its size
+	const CacheHeader* header = (const CacheHeader*)file->data();
+	if (file->size() < sizeof(CacheHeader) ||
+		memcmp(header->magic, CACHE_MAGIC, 8) != 0 ||
+		header->version != CACHE_VERSION ||
+		header->byteOrderMark != BYTE_ORDER_MARK ||
+		header->sourceSize != (long long)sourceSize ||
+		header->sourceModificationTime != sourceModificationTime ||
+		header->numVertices <= 0 || header->numVertices > MAX_VERTICES ||
+		header->numTexCoords <= 0 || header->numTexCoords > MAX_TEX_COORDS ||
+		header->numTriangles <= 0 || header->numTriangles > MAX_TRIANGLES ||
+		header->numFrames <= 0 || header->numFrames > MAX_FRAMES ||
+		header->numStrips < 0 ||
+		header->numStripVertices < 3 * header->numStrips ||
+		(header->numStrips == 0 && header->numStripVertices != 0) ||
+		header->numLevels < 0 || header->numLodTriangles < 0 ||
+		header->numClusters < 0 ||
+		memchr(header->textureFilename, '\0', TEXTURE_NAME_SIZE) == NULL ||
+		file->size() != cacheSize(header)) {
+		delete file;
+		return NULL;
+	}
+	
+	//Use the data in place; the model keeps the file mapped
+	MD2Model* model = new MD2Model();
+	model->cacheFile = file;
+	model->numVertices = header->numVertices;
+	model->numTexCoords = header->numTexCoords;
+	model->numTriangles = header->numTriangles;
+	model->numFrames = header->numFrames;
+	const char* data = file->data() + sizeof(CacheHeader);
+	model->texCoords = (MD2TexCoord*)data;
+	data += model->numTexCoords * sizeof(MD2TexCoord);
+	model->triangles = (MD2Triangle*)data;
+	data += model->numTriangles * sizeof(MD2Triangle);
+	if (!trianglesValid(model->triangles, model->numTriangles,
+						model->numVertices, model->numTexCoords)) {
+		//The cache is damaged, so load the MD2 file instead
+		delete model;
+		return NULL;
+	}
+	if (header->numStrips > 0) {
+		//Check that the strips and fans add up to the stored vertices
+		const int* stripLengths = (const int*)data;
+		int numStripVertices = 0;
+		for(int i = 0; i < header->numStrips; i++) {
+			int count = abs(stripLengths[i]);
+			if (count < 3 || count > header->numStripVertices) {
+				numStripVertices = -1;
+				break;
+			}
+			numStripVertices += count;
+		}
+		if (numStripVertices != header->numStripVertices ||
+			!stripVerticesValid((const MD2StripVertex*)
+								(data + header->numStrips * sizeof(int)),
+								numStripVertices,
+								model->numVertices)) {
+			delete model;
+			return NULL;
+		}
 		
-		for(int j = 0; j < numVertices; j++) {
-			MD2Vertex* vertex = frame->vertices + j;
-			input.read(buffer, 3);
-			Vec3f v((unsigned char)buffer[0],
-					(unsigned char)buffer[1],
-					(unsigned char)buffer[2]);
-			vertex->pos = translation + Vec3f(scale[0] * v[0],
-											  scale[1] * v[1],
-											  scale[2] * v[2]);
-			input.read(buffer, 1);
-			int normalIndex = (int)((unsigned char)buffer[0]);
-			vertex->normal = Vec3f(NORMALS[3 * normalIndex],
-								   NORMALS[3 * normalIndex + 1],
-								   NORMALS[3 * normalIndex + 2]);
-		}
-	}
-	
-	model->startFrame = 0;
-	model->endFrame = numFrames - 1;
+		model->stripLengths = (int*)data;
+		model->numStrips = header->numStrips;
+		data += model->numStrips * sizeof(int);
+		model->stripVertices = (MD2StripVertex*)data;
+		model->numStripVertices = header->numStripVertices;
+		data += model->numStripVertices * sizeof(MD2StripVertex);
+	}
+	
+	//Copy the levels of detail, checking that they add up to the stored
+	//triangles and refer to existing vertices and texture coordinates
+	const int* lodSizes = (const int*)data;
+	data += header->numLevels * sizeof(int);
+	const MD2Triangle* lodData = (const MD2Triangle*)data;
+	data += header->numLodTriangles * sizeof(MD2Triangle);
+	int numLodTriangles = 0;
+	for(int i = 0; i < header->numLevels; i++) {
+		if (lodSizes[i] <= 0 ||
+			lodSizes[i] > header->numLodTriangles - numLodTriangles) {
+			numLodTriangles = -1;
+			break;
+		}
+		numLodTriangles += lodSizes[i];
+	}
+	if (numLodTriangles != header->numLodTriangles ||
+		!trianglesValid(lodData, numLodTriangles,
+						model->numVertices, model->numTexCoords)) {
+		delete model;
+		return NULL;
+	}
+	model->lodTriangles.resize(header->numLevels);
+	for(int i = 0; i < header->numLevels; i++) {
+		model->lodTriangles[i].assign(lodData, lodData + lodSizes[i]);
+		lodData += lodSizes[i];
+	}
+	
+	//Copy the clusters, checking that they cover the stored triangles one
+	//after another
+	const MD2Cluster* clusters = (const MD2Cluster*)data;
+	data += header->numClusters * sizeof(MD2Cluster);
+	const MD2Triangle* clusterTriangles = (const MD2Triangle*)data;
+	data += model->numTriangles * sizeof(MD2Triangle);
+	const MD2ClusterCone* clusterCones = (const MD2ClusterCone*)data;
+	int numCones = model->numFrames * header->numClusters;
+	data += numCones * sizeof(MD2ClusterCone);
+	int numClusterTriangles = 0;
+	for(int i = 0; i < header->numClusters; i++) {
+		if (clusters[i].firstTriangle != numClusterTriangles ||
+			clusters[i].numTriangles <= 0 ||
+			clusters[i].numTriangles >
+				model->numTriangles - numClusterTriangles) {
+			numClusterTriangles = -1;
+			break;
+		}
+		numClusterTriangles += clusters[i].numTriangles;
+	}
+	if (numClusterTriangles != model->numTriangles ||
+		!trianglesValid(clusterTriangles, numClusterTriangles,
+						model->numVertices, model->numTexCoords) ||
+		!conesValid(clusterCones, numCones)) {
+		delete model;
+		return NULL;
+	}
+	model->clusters.assign(clusters, clusters + header->numClusters);
+	model->clusterTriangles.assign(clusterTriangles,
+								   clusterTriangles + numClusterTriangles);
+	model->clusterCones.assign(clusterCones, clusterCones + numCones);
+	
+	model->frames = new MD2Frame[model->numFrames];
+	for(int i = 0; i < model->numFrames; i++) {
+		memcpy(model->frames[i].name, data, 16);
+		model->frames[i].name[15] = '\0';
+		model->frames[i].vertices = (MD2Vertex*)(data + 16);
+		data += 16 + model->numVertices * sizeof(MD2Vertex);
+	}
+	
+	memcpy(model->textureFilename, header->textureFilename, TEXTURE_NAME_SIZE);
+	model->loadSkin(model->textureFilename);
+	model->finishLoading();
 	return model;
 }
 
+void MD2Model::writeCache(const char* cacheFilename,
+						  size_t sourceSize,
+						  long long sourceModificationTime) {
+	if (!cacheLayoutSupported()) {
+		return;
+	}
+	
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, 8);
+	header.version = CACHE_VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.sourceSize = (long long)sourceSize;
+	header.sourceModificationTime = sourceModificationTime;
+	header.numVertices = numVertices;
+	header.numTexCoords = numTexCoords;
+	header.numTriangles = numTriangles;
+	header.numFrames = numFrames;
+	header.numStrips = numStrips;
+	header.numStripVertices = numStripVertices;
+	header.numLevels = (int)lodTriangles.size();
+	header.numLodTriangles = 0;
+	for(unsigned int i = 0; i < lodTriangles.size(); i++) {
+		header.numLodTriangles += (int)lodTriangles[i].size();
+	}
+	header.numClusters = (int)clusters.size();
+	memcpy(header.textureFilename, textureFilename, TEXTURE_NAME_SIZE);
+	
+	ofstream output;
+	output.open(cacheFilename, ios_base::binary | ios_base::trunc);
+	output.write((const char*)&header, sizeof(header));
+	output.write((const char*)texCoords, numTexCoords * sizeof(MD2TexCoord));
+	output.write((const char*)triangles, numTriangles * sizeof(MD2Triangle));
+	if (numStrips > 0) {
+		output.write((const char*)stripLengths, numStrips * sizeof(int));
+		output.write((const char*)stripVertices,
+					 numStripVertices * sizeof(MD2StripVertex));
+	}
+	for(unsigned int i = 0; i < lodTriangles.size(); i++) {
+		int size = (int)lodTriangles[i].size();
+		output.write((const char*)&size, sizeof(int));
+	}
+	for(unsigned int i = 0; i < lodTriangles.size(); i++) {
+		output.write((const char*)&lodTriangles[i][0],
+					 lodTriangles[i].size() * sizeof(MD2Triangle));
+	}
+	if (!clusters.empty()) {
+		output.write((const char*)&clusters[0],
+					 clusters.size() * sizeof(MD2Cluster));
+		output.write((const char*)&clusterTriangles[0],
+					 clusterTriangles.size() * sizeof(MD2Triangle));
+		output.write((const char*)&clusterCones[0],
+					 clusterCones.size() * sizeof(MD2ClusterCone));
+	}
+	for(int i = 0; i < numFrames; i++) {
+		output.write(frames[i].name, 16);
+		output.write((const char*)frames[i].vertices,
+					 numVertices * sizeof(MD2Vertex));
+	}
+	output.close();
+	
+	if (output.fail()) {
+		//Don't leave a partial cache behind
+		remove(cacheFilename);
+	}
+}
+
+void MD2Model::finishLoading() {
+	frameBounds.resize(numFrames);
+	for(int i = 0; i < numFrames; i++) {
+		frameBounds[i] = computeBounds(i, i);
+	}
+	
+	startFrame = 0;
+	endFrame = numFrames - 1;
+	animBounds = computeBounds(startFrame, endFrame);
+	
+	culledPose.resize(numVertices);
+	culledPoseStamps.assign(numVertices, 0);
+	numCulledDraws = 0;
+}
+
+MD2Bounds MD2Model::computeBounds(int firstFrame, int lastFrame) {
+	MD2Bounds bounds;
+	bounds.minCorner = frames[firstFrame].vertices[0].pos;
+	bounds.maxCorner = bounds.minCorner;
+	for(int i = firstFrame; i <= lastFrame; i++) {
+		for(int j = 0; j < numVertices; j++) {
+			Vec3f pos = frames[i].vertices[j].pos;
+			for(int k = 0; k < 3; k++) {
+				if (pos[k] < bounds.minCorner[k]) {
+					bounds.minCorner[k] = pos[k];
+				}
+				if (pos[k] > bounds.maxCorner[k]) {
+					bounds.maxCorner[k] = pos[k];
+				}
+			}
+		}
+	}
+	
+	//Center the sphere on the box, and make it just large enough to hold all
+	//of the vertices
+	bounds.center = (bounds.minCorner + bounds.maxCorner) / 2;
+	float radiusSquared = 0;
+	for(int i = firstFrame; i <= lastFrame; i++) {
+		for(int j = 0; j < numVertices; j++) {
+			float distanceSquared =
+				(frames[i].vertices[j].pos - bounds.center).magnitudeSquared();
+			if (distanceSquared > radiusSquared) {
+				radiusSquared = distanceSquared;
+			}
+		}
+	}
+	bounds.radius = sqrt(radiusSquared);
+	return bounds;
+}
+
+void MD2Model::buildLevelsOfDetail() {
+	vector<int> removalOrder;
+	vector<int> collapseTo;
+	vector<int> triangleDeaths;
+	EdgeCollapser collapser(frames, numFrames, numVertices,
+							triangles, numTriangles);
+	collapser.collapseAll(removalOrder, collapseTo, triangleDeaths);
+	
+	//Count the live triangles after each number of collapses
+	vector<int> numLive(numVertices + 1, numTriangles);
+	for(int i = 0; i < numTriangles; i++) {
+		for(int j = triangleDeaths[i]; j <= numVertices; j++) {
+			numLive[j]--;
+		}
+	}
+	
+	//Each level has about half as many triangles as the one before it
+	lodTriangles.clear();
+	vector<int> vertexMap(numVertices);
+	int numCollapses = 0;
+	for(int target = numTriangles / 2; target >= LOD_MIN_TRIANGLES;
+		target /= 2) {
+		while (numCollapses < numVertices && numLive[numCollapses] > target) {
+			numCollapses++;
+		}
+		
+		//Find where each vertex ends up after numCollapses collapses.  A
+		//vertex is always collapsed onto one that is removed later, if at all.
+		for(int i = 0; i < numVertices; i++) {
+			vertexMap[i] = i;
+		}
+		for(int i = numCollapses - 1; i >= 0; i--) {
+			int vertex = removalOrder[i];
+			if (collapseTo[vertex] >= 0) {
+				vertexMap[vertex] = vertexMap[collapseTo[vertex]];
+			}
+		}
+		
+		//Each corner keeps its texture coordinate
+		vector<MD2Triangle> level;
+		for(int i = 0; i < numTriangles; i++) {
+			if (triangleDeaths[i] <= numCollapses) {
+				continue;
+			}
+			MD2Triangle triangle = triangles[i];
+			for(int j = 0; j < 3; j++) {
+				triangle.vertices[j] = vertexMap[triangle.vertices[j]];
+			}
+			if (triangle.vertices[0] != triangle.vertices[1] &&
+				triangle.vertices[1] != triangle.vertices[2] &&
+				triangle.vertices[2] != triangle.vertices[0]) {
+				level.push_back(triangle);
+			}
+		}
+		
+		if (level.empty() ||
+			(int)level.size() >= numTrianglesAt(numLevelsOfDetail() - 1)) {
+			break;
+		}
+		lodTriangles.push_back(level);
+	}
+}
+
+void MD2Model::buildClusters() {
+	//Find out whether the triangles' vertices go clockwise or counterclockwise
+	//around their outward normals, using the vertex normals
+	float orientation = 0;
+	for(int i = 0; i < numTriangles; i++) {
+		Vec3f vertexNormals(0, 0, 0);
+		for(int j = 0; j < 3; j++) {
+			int vertex = triangles[i].vertices[j];
+			vertexNormals += frames[0].vertices[vertex].normal;
+		}
+		orientation += faceNormal(frames[0].vertices, triangles[i]).
+			dot(vertexNormals);
+	}
+	float sign = orientation < 0 ? -1.0f : 1.0f;
+	
+	//Compute the unit normals of the triangles in several frames, spread
+	//over all of the animations
+	int numSamples = min(numFrames, LOD_SAMPLE_FRAMES);
+	vector<Vec3f> normals(numSamples * numTriangles);
+	for(int i = 0; i < numSamples; i++) {
+		const MD2Vertex* vertices = frames[i * numFrames / numSamples].vertices;
+		for(int j = 0; j < numTriangles; j++) {
+			Vec3f normal = sign * faceNormal(vertices, triangles[j]);
+			if (normal.magnitude() > 0) {
+				normals[i * numTriangles + j] = normal.normalize();
+			}
+			else {
+				normals[i * numTriangles + j] = Vec3f(0, 0, 0);
+			}
+		}
+	}
+	
+	//Find the triangles that share an edge with each triangle
+	map<pair<int, int>, vector<int> > edgeTriangles;
+	for(int i = 0; i < numTriangles; i++) {
+		for(int j = 0; j < 3; j++) {
+			int vertex1 = triangles[i].vertices[j];
+			int vertex2 = triangles[i].vertices[(j + 1) % 3];
+			edgeTriangles[pair<int, int>(min(vertex1, vertex2),
+										 max(vertex1, vertex2))].push_back(i);
+		}
+	}
+	vector<vector<int> > neighbors(numTriangles);
+	for(map<pair<int, int>, vector<int> >::iterator it = edgeTriangles.begin();
+		it != edgeTriangles.end(); it++) {
+		const vector<int> &edge = it->second;
+		for(unsigned int i = 0; i < edge.size(); i++) {
+			for(unsigned int j = 0; j < edge.size(); j++) {
+				if (edge[i] != edge[j]) {
+					neighbors[edge[i]].push_back(edge[j]);
+				}
+			}
+		}
+	}
+	
+	/* Starting with each triangle not yet in a cluster, grow a cluster across
+	 * shared edges.  Of the triangles next to the cluster whose normals agree
+	 * closely enough with the first triangle's, the one that agrees most
+	 * closely is added next, so that each cluster is a connected patch of the
+	 * surface.
+	 */
+	clusters.clear();
+	clusterTriangles.clear();
+	vector<bool> inCluster(numTriangles, false);
+	vector<pair<float, int> > frontier;
+	for(int i = 0; i < numTriangles; i++) {
+		if (inCluster[i]) {
+			continue;
+		}
+		
+		MD2Cluster cluster;
+		cluster.firstTriangle = (int)clusterTriangles.size();
+		cluster.numTriangles = 0;
+		frontier.clear();
+		frontier.push_back(pair<float, int>(2.0f, i));
+		while (!frontier.empty() && cluster.numTriangles < CLUSTER_SIZE) {
+			pop_heap(frontier.begin(), frontier.end());
+			int triangle = frontier.back().second;
+			frontier.pop_back();
+			if (inCluster[triangle]) {
+				continue;
+			}
+			
+			inCluster[triangle] = true;
+			clusterTriangles.push_back(triangles[triangle]);
+			cluster.numTriangles++;
+			for(unsigned int j = 0; j < neighbors[triangle].size(); j++) {
+				int neighbor = neighbors[triangle][j];
+				if (inCluster[neighbor]) {
+					continue;
+				}
+				float similarity = 0;
+				for(int k = 0; k < numSamples; k++) {
+					similarity += normals[k * numTriangles + i].dot(
+						normals[k * numTriangles + neighbor]);
+				}
+				similarity /= numSamples;
+				if (similarity >= MIN_CLUSTER_SIMILARITY) {
+					frontier.push_back(pair<float, int>(similarity, neighbor));
+					push_heap(frontier.begin(), frontier.end());
+				}
+			}
+		}
+		clusters.push_back(cluster);
+	}
+	
+	//Compute the cone of each cluster in each frame
+	int numClusters = (int)clusters.size();
+	clusterCones.resize(numFrames * numClusters);
+	defaultThreadPool()->parallelFor(numFrames, [=](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			const MD2Vertex* vertices = frames[i].vertices;
+			for(int j = 0; j < numClusters; j++) {
+				const MD2Cluster &cluster = clusters[j];
+				const MD2Triangle* clusterStart =
+					&clusterTriangles[cluster.firstTriangle];
+				MD2ClusterCone &cone = clusterCones[i * numClusters + j];
+				
+				//Find the average normal and a bounding box
+				Vec3f axis(0, 0, 0);
+				Vec3f minCorner = vertices[clusterStart->vertices[0]].pos;
+				Vec3f maxCorner = minCorner;
+				for(int k = 0; k < cluster.numTriangles; k++) {
+					Vec3f normal = sign * faceNormal(vertices, clusterStart[k]);
+					if (normal.magnitude() > 0) {
+						axis += normal.normalize();
+					}
+					for(int l = 0; l < 3; l++) {
+						Vec3f pos = vertices[clusterStart[k].vertices[l]].pos;
+						for(int m = 0; m < 3; m++) {
+							minCorner[m] = min(minCorner[m], pos[m]);
+							maxCorner[m] = max(maxCorner[m], pos[m]);
+						}
+					}
+				}
+				
+				//Find the widest angle between a normal and the axis
+				float minDot = -1;
+				if (axis.magnitude() > 0) {
+					axis = axis.normalize();
+					minDot = 1;
+					for(int k = 0; k < cluster.numTriangles; k++) {
+						Vec3f normal = sign * faceNormal(vertices,
+														 clusterStart[k]);
+						float dot = 0;
+						if (normal.magnitude() > 0) {
+							dot = normal.normalize().dot(axis);
+						}
+						minDot = min(minDot, dot);
+					}
+				}
+				cone.axis = axis;
+				if (minDot > 0) {
+					cone.cutoff = sqrt(1 - minDot * minDot);
+				}
+				else {
+					cone.cutoff = 2;
+				}
+				
+				cone.center = (minCorner + maxCorner) / 2;
+				cone.radius = 0;
+				for(int k = 0; k < cluster.numTriangles; k++) {
+					for(int l = 0; l < 3; l++) {
+						Vec3f pos = vertices[clusterStart[k].vertices[l]].pos;
+						cone.radius =
+							max(cone.radius, (pos - cone.center).magnitude());
+					}
+				}
+			}
+		}
+	});
+}
+
+const MD2Triangle* MD2Model::trianglesAt(int level) {
+	if (level == 0) {
+		return triangles;
+	}
+	return &lodTriangles[level - 1][0];
+}
+
+void MD2Model::drawStrips(float time) {
+	if (numStrips == 0) {
+		draw(time);
+		return;
+	}
+	
+	stripsPose.resize(numVertices);
+	computePose(time, &stripsPose[0]);
+	drawPose(&stripsPose[0], 0, true);
+}
+
+void MD2Model::computePose(float time, MD2Vertex* pose) {
+	int frameIndex1;
+	int frameIndex2;
+	float frac;
+	findFrames(time, frameIndex1, frameIndex2, frac);
+	MD2Frame* frame1 = frames + frameIndex1;
+	MD2Frame* frame2 = frames + frameIndex2;
+	
+	//Interpolate each vertex once
+	for(int i = 0; i < numVertices; i++) {
+		MD2Vertex* v1 = frame1->vertices + i;
+		MD2Vertex* v2 = frame2->vertices + i;
+		pose[i].pos = v1->pos * (1 - frac) + v2->pos * frac;
+		pose[i].normal = v1->normal * (1 - frac) + v2->normal * frac;
+		if (pose[i].normal[0] == 0 && pose[i].normal[1] == 0 &&
+			pose[i].normal[2] == 0) {
+			pose[i].normal = Vec3f(0, 0, 1);
+		}
+	}
+}
+
+int MD2Model::numVerticesInPose() {
+	return numVertices;
+}
+
+void MD2Model::drawPose(const MD2Vertex* pose, int level, bool useStrips) {
+	glsEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glsTextureFilters(textureId, GL_LINEAR, GL_LINEAR);
+	
+	if (!useStrips || level != 0 || numStrips == 0) {
+		const MD2Triangle* levelTriangles = trianglesAt(level);
+		int numLevelTriangles = numTrianglesAt(level);
+		glBegin(GL_TRIANGLES);
+		for(int i = 0; i < numLevelTriangles; i++) {
+			const MD2Triangle* triangle = levelTriangles + i;
+			for(int j = 0; j < 3; j++) {
+				const MD2Vertex* vertex = pose + triangle->vertices[j];
+				glNormal3f(vertex->normal[0],
+						   vertex->normal[1],
+						   vertex->normal[2]);
+				MD2TexCoord* texCoord = texCoords + triangle->texCoords[j];
+				glTexCoord2f(texCoord->texCoordX, texCoord->texCoordY);
+				glVertex3f(vertex->pos[0], vertex->pos[1], vertex->pos[2]);
+			}
+		}
+		glEnd();
+		return;
+	}
+	
+	const MD2StripVertex* stripVertex = stripVertices;
+	for(int i = 0; i < numStrips; i++) {
+		int count = stripLengths[i];
+		if (count > 0) {
+			glBegin(GL_TRIANGLE_STRIP);
+		}
+		else {
+			glBegin(GL_TRIANGLE_FAN);
+			count = -count;
+		}
+		for(int j = 0; j < count; j++) {
+			const MD2Vertex* vertex = pose + stripVertex->vertex;
+			glNormal3f(vertex->normal[0], vertex->normal[1], vertex->normal[2]);
+			glTexCoord2f(stripVertex->texCoordX, stripVertex->texCoordY);
+			glVertex3f(vertex->pos[0], vertex->pos[1], vertex->pos[2]);
+			stripVertex++;
+		}
+		glEnd();
+	}
+}
+
+int MD2Model::drawCulled(float time, Vec3f eye) {
+	int frameIndex1;
+	int frameIndex2;
+	float frac;
+	findFrames(time, frameIndex1, frameIndex2, frac);
+	MD2Frame* frame1 = frames + frameIndex1;
+	MD2Frame* frame2 = frames + frameIndex2;
+	const MD2ClusterCone* cones1 = &clusterCones[frameIndex1 * clusters.size()];
+	const MD2ClusterCone* cones2 = &clusterCones[frameIndex2 * clusters.size()];
+	numCulledDraws++;
+	
+	glsEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glsTextureFilters(textureId, GL_LINEAR, GL_LINEAR);
+	
+	int numDrawn = 0;
+	glBegin(GL_TRIANGLES);
+	for(unsigned int i = 0; i < clusters.size(); i++) {
+		if (facesAway(cones1[i], eye) && facesAway(cones2[i], eye)) {
+			continue;
+		}
+		
+		const MD2Triangle* clusterStart =
+			&clusterTriangles[clusters[i].firstTriangle];
+		for(int j = 0; j < clusters[i].numTriangles; j++) {
+			const MD2Triangle* triangle = clusterStart + j;
+			for(int k = 0; k < 3; k++) {
+				//Interpolate the vertex, unless we already have this time
+				int index = triangle->vertices[k];
+				MD2Vertex* vertex = &culledPose[index];
+				if (culledPoseStamps[index] != numCulledDraws) {
+					culledPoseStamps[index] = numCulledDraws;
+					MD2Vertex* v1 = frame1->vertices + index;
+					MD2Vertex* v2 = frame2->vertices + index;
+					vertex->pos = v1->pos * (1 - frac) + v2->pos * frac;
+					vertex->normal =
+						v1->normal * (1 - frac) + v2->normal * frac;
+					if (vertex->normal[0] == 0 && vertex->normal[1] == 0 &&
+						vertex->normal[2] == 0) {
+						vertex->normal = Vec3f(0, 0, 1);
+					}
+				}
+				
+				glNormal3f(vertex->normal[0],
+						   vertex->normal[1],
+						   vertex->normal[2]);
+				MD2TexCoord* texCoord = texCoords + triangle->texCoords[k];
+				glTexCoord2f(texCoord->texCoordX, texCoord->texCoordY);
+				glVertex3f(vertex->pos[0], vertex->pos[1], vertex->pos[2]);
+			}
+		}
+		numDrawn += clusters[i].numTriangles;
+	}
+	glEnd();
+	return numDrawn;
+}
+
+int MD2Model::numClusters() {
+	return (int)clusters.size();
+}
+
+int MD2Model::numVerticesInStrips() {
+	if (numStrips == 0) {
+		return 3 * numTriangles;
+	}
+	return numStripVertices;
+}
+
+int MD2Model::numLevelsOfDetail() {
+	return 1 + (int)lodTriangles.size();
+}
+
+int MD2Model::numTrianglesAt(int level) {
+	if (level == 0) {
+		return numTriangles;
+	}
+	return (int)lodTriangles[level - 1].size();
+}
+
+int MD2Model::levelForTriangleBudget(float maxTriangles) {
+	for(int i = 0; i < numLevelsOfDetail(); i++) {
+		if (numTrianglesAt(i) <= maxTriangles) {
+			return i;
+		}
+	}
+	return numLevelsOfDetail() - 1;
+}
+
 void MD2Model::setAnimation(const char* name) {
 	/* The names of frames normally begin with the name of the animation in
 	 * which they are, e.g. "run", and are followed by a non-alphabetical
@@ -447,9 +1899,20 @@ void MD2Model::setAnimation(const char* name) {
 			break;
 		}
 	}
+	
+	if (found && endFrame >= startFrame) {
+		animBounds = computeBounds(startFrame, endFrame);
+	}
 }
 
 void MD2Model::draw(float time) {
+	draw(time, 0);
+}
+
+void MD2Model::findFrames(float time,
+						  int &frameIndex1,
+						  int &frameIndex2,
+						  float &frac) {
 	if (time > -100000000 && time < 1000000000) {
 		time -= (int)time;
 		if (time < 0) {
@@ -460,18 +1923,12 @@ void MD2Model::draw(float time) {
 		time = 0;
 	}
 	
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, textureId);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	
 	//Figure out the two frames between which we are interpolating
-	int frameIndex1 = (int)(time * (endFrame - startFrame + 1)) + startFrame;
+	frameIndex1 = (int)(time * (endFrame - startFrame + 1)) + startFrame;
 	if (frameIndex1 > endFrame) {
 		frameIndex1 = startFrame;
 	}
 	
-	int frameIndex2;
 	if (frameIndex1 < endFrame) {
 		frameIndex2 = frameIndex1 + 1;
 	}
@@ -479,18 +1936,30 @@ void MD2Model::draw(float time) {
 		frameIndex2 = startFrame;
 	}
 	
-	MD2Frame* frame1 = frames + frameIndex1;
-	MD2Frame* frame2 = frames + frameIndex2;
-	
 	//Figure out the fraction that we are between the two frames
-	float frac =
+	frac =
 		(time - (float)(frameIndex1 - startFrame) /
 		 (float)(endFrame - startFrame + 1)) * (endFrame - startFrame + 1);
+}
+
+void MD2Model::draw(float time, int level) {
+	int frameIndex1;
+	int frameIndex2;
+	float frac;
+	findFrames(time, frameIndex1, frameIndex2, frac);
+	MD2Frame* frame1 = frames + frameIndex1;
+	MD2Frame* frame2 = frames + frameIndex2;
+	
+	glsEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glsTextureFilters(textureId, GL_LINEAR, GL_LINEAR);
 	
 	//Draw the model as an interpolation between the two frames
+	const MD2Triangle* levelTriangles = trianglesAt(level);
+	int numLevelTriangles = numTrianglesAt(level);
 	glBegin(GL_TRIANGLES);
-	for(int i = 0; i < numTriangles; i++) {
-		MD2Triangle* triangle = triangles + i;
+	for(int i = 0; i < numLevelTriangles; i++) {
+		const MD2Triangle* triangle = levelTriangles + i;
 		for(int j = 0; j < 3; j++) {
 			MD2Vertex* v1 = frame1->vertices + triangle->vertices[j];
 			MD2Vertex* v2 = frame2->vertices + triangle->vertices[j];
@@ -509,6 +1978,259 @@ void MD2Model::draw(float time) {
 	glEnd();
 }
 
+const MD2Bounds &MD2Model::boundsOfFrame(int frame) {
+	return frameBounds[frame];
+}
+
+const MD2Bounds &MD2Model::animationBounds() {
+	return animBounds;
+}
+
+int MD2Model::animationStart() {
+	return startFrame;
+}
+
+int MD2Model::animationEnd() {
+	return endFrame;
+}
+
+bool MD2Model::instancingSupported() {
+	if (!shadersSupported() ||
+		!glutExtensionSupported("GL_ARB_instanced_arrays") ||
+		!glutExtensionSupported("GL_ARB_draw_instanced") ||
+		!glutExtensionSupported("GL_ARB_texture_float")) {
+		return false;
+	}
+	
+	//The frames are read from a texture in the vertex shader
+	GLint numVertexTextureUnits;
+	glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &numVertexTextureUnits);
+	return numVertexTextureUnits > 0;
+}
+
+bool MD2Model::initInstancing() {
+	if (instancingReady) {
+		return true;
+	}
+	if (!instancingSupported()) {
+		return false;
+	}
+	
+	GLint maxTextureSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	if (numVertices > maxTextureSize || 2 * numFrames > maxTextureSize) {
+		return false;
+	}
+	
+	programId = loadShaderProgram(INSTANCED_VERTEX_SHADER,
+								  INSTANCED_FRAGMENT_SHADER,
+								  INSTANCED_ATTRIBUTES);
+	if (programId == 0) {
+		return false;
+	}
+	glUseProgram(programId);
+	glUniform1i(glGetUniformLocation(programId, "skin"), 0);
+	glUniform1i(glGetUniformLocation(programId, "frames"), 1);
+	glUniform2f(glGetUniformLocation(programId, "framesSize"),
+				(float)numVertices, (float)(2 * numFrames));
+	glUseProgram(0);
+	
+	//Bake the frames into a texture.  Row 2 * i holds the positions of the
+	//vertices in frame i, and row 2 * i + 1 holds their normals.
+	vector<float> texels(3 * numVertices * 2 * numFrames);
+	for(int i = 0; i < numFrames; i++) {
+		float* posRow = &texels[3 * numVertices * 2 * i];
+		float* normalRow = posRow + 3 * numVertices;
+		for(int j = 0; j < numVertices; j++) {
+			MD2Vertex* vertex = frames[i].vertices + j;
+			for(int k = 0; k < 3; k++) {
+				posRow[3 * j + k] = vertex->pos[k];
+				normalRow[3 * j + k] = vertex->normal[k];
+			}
+		}
+	}
+	glGenTextures(1, &framesTextureId);
+	glBindTexture(GL_TEXTURE_2D, framesTextureId);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D,
+				 0,
+				 GL_RGBA32F_ARB,
+				 numVertices, 2 * numFrames,
+				 0,
+				 GL_RGB,
+				 GL_FLOAT,
+				 &texels[0]);
+	
+	//Store the vertex index and texture coordinate of each triangle corner,
+	//for all of the levels of detail one after another
+	vector<float> corners;
+	lodFirstCorners.clear();
+	for(int level = 0; level < numLevelsOfDetail(); level++) {
+		lodFirstCorners.push_back((int)corners.size() / 3);
+		const MD2Triangle* levelTriangles = trianglesAt(level);
+		for(int i = 0; i < numTrianglesAt(level); i++) {
+			const MD2Triangle* triangle = levelTriangles + i;
+			for(int j = 0; j < 3; j++) {
+				MD2TexCoord* texCoord = texCoords + triangle->texCoords[j];
+				corners.push_back((float)triangle->vertices[j]);
+				corners.push_back(texCoord->texCoordX);
+				corners.push_back(texCoord->texCoordY);
+			}
+		}
+	}
+	glGenBuffers(1, &cornerBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, cornerBufferId);
+	glBufferData(GL_ARRAY_BUFFER,
+				 corners.size() * sizeof(float),
+				 &corners[0],
+				 GL_STATIC_DRAW);
+	
+	glGenBuffers(1, &instanceBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	instancingReady = true;
+	return true;
+}
+
+void MD2Model::drawInstanced(const MD2Instance* instances,
+							 int numInstances,
+							 int level) {
+	if (numInstances <= 0) {
+		return;
+	}
+	
+	glUseProgram(programId);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, framesTextureId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glsTextureFilters(textureId, GL_LINEAR, GL_LINEAR);
+	
+	//The per-corner attribute
+	glBindBuffer(GL_ARRAY_BUFFER, cornerBufferId);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	
+	//The per-instance attributes, which are re-sent every frame
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+	glBufferData(GL_ARRAY_BUFFER,
+				 numInstances * sizeof(MD2Instance),
+				 instances,
+				 GL_STREAM_DRAW);
+	const int sizes[] = {4, 4, 4, 3, 3};
+	int offset = 0;
+	for(int i = 0; i < 5; i++) {
+		glEnableVertexAttribArray(i + 1);
+		glVertexAttribPointer(i + 1, sizes[i], GL_FLOAT, GL_FALSE,
+							  INSTANCE_FLOATS * sizeof(float),
+							  (const GLvoid*)(offset * sizeof(float)));
+		glVertexAttribDivisorARB(i + 1, 1);
+		offset += sizes[i];
+	}
+	
+	glDrawArraysInstancedARB(GL_TRIANGLES,
+							 lodFirstCorners[level],
+							 3 * numTrianglesAt(level),
+							 numInstances);
+	
+	for(int i = 0; i < 6; i++) {
+		if (i > 0) {
+			glVertexAttribDivisorARB(i, 0);
+		}
+		glDisableVertexAttribArray(i);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+}
+
+
+
+MD2PoseCache::MD2PoseCache(MD2Model* model1, int numSlots1, bool persistent1) {
+	model = model1;
+	numSlots = numSlots1;
+	persistent = persistent1;
+	numPosesUsed = 0;
+	resetStats();
+}
+
+void MD2PoseCache::beginFrame() {
+	if (!persistent) {
+		poseIndices.clear();
+		numPosesUsed = 0;
+	}
+}
+
+const MD2Vertex* MD2PoseCache::pose(float time) {
+	numPoseRequests++;
+	
+	//Round the time to the nearest slot
+	if (time > -100000000 && time < 1000000000) {
+		time -= (int)time;
+		if (time < 0) {
+			time += 1;
+		}
+	}
+	else {
+		time = 0;
+	}
+	int slot = (int)(time * numSlots + 0.5f);
+	if (slot >= numSlots) {
+		slot = 0;
+	}
+	
+	pair<pair<int, int>, int> key(pair<int, int>(model->animationStart(),
+												 model->animationEnd()),
+								  slot);
+	map<pair<pair<int, int>, int>, int>::iterator it = poseIndices.find(key);
+	if (it != poseIndices.end()) {
+		return &poses[it->second][0];
+	}
+	
+	//Compute the pose, reusing the memory of a forgotten pose if possible
+	if (numPosesUsed == (int)poses.size()) {
+		poses.push_back(vector<MD2Vertex>(model->numVerticesInPose()));
+	}
+	int index = numPosesUsed;
+	numPosesUsed++;
+	model->computePose((float)slot / numSlots, &poses[index][0]);
+	poseIndices[key] = index;
+	numPosesComputed++;
+	return &poses[index][0];
+}
+
+int MD2PoseCache::slots() {
+	return numSlots;
+}
+
+void MD2PoseCache::setSlots(int numSlots1) {
+	numSlots = numSlots1;
+	poseIndices.clear();
+	numPosesUsed = 0;
+}
+
+bool MD2PoseCache::isPersistent() {
+	return persistent;
+}
+
+void MD2PoseCache::setPersistent(bool persistent1) {
+	persistent = persistent1;
+}
+
+int MD2PoseCache::posesComputed() {
+	return numPosesComputed;
+}
+
+int MD2PoseCache::poseRequests() {
+	return numPoseRequests;
+}
+
+void MD2PoseCache::resetStats() {
+	numPosesComputed = 0;
+	numPoseRequests = 0;
+}
+
+
 
 
 
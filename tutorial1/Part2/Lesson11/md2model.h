@@ -32,8 +32,14 @@
 #include <GL/glut.h>
 #endif
 
+#include <map>
+#include <stddef.h>
+#include <vector>
+
 #include "vec3f.h"
 
+class MappedFile;
+
 struct MD2Vertex {
 	Vec3f pos;
 	Vec3f normal;
@@ -54,19 +60,153 @@ struct MD2Triangle {
 	int texCoords[3]; //The indices of the texture coordinates of the triangle
 };
 
+//A vertex of one of the triangle strips or fans given by an MD2 file's OpenGL
+//commands
+struct MD2StripVertex {
+	float texCoordX;
+	float texCoordY;
+	int vertex; //The index of the vertex in each frame
+};
+
+//A bounding box and bounding sphere, in the coordinates of a model
+struct MD2Bounds {
+	Vec3f minCorner; //The corner of the box with the smallest coordinates
+	Vec3f maxCorner; //The corner of the box with the largest coordinates
+	Vec3f center;    //The center of the sphere
+	float radius;    //The radius of the sphere
+};
+
+//A group of triangles of a model that face in similar directions
+struct MD2Cluster {
+	int firstTriangle; //The index of the first triangle in clusterTriangles
+	int numTriangles;
+};
+
+/* The bounds and normals of a cluster of triangles in one frame.  Every
+ * triangle's normal is within a cone around "axis", whose half-angle has the
+ * sine "cutoff"; a cutoff of more than 1 means that there is no such cone.
+ */
+struct MD2ClusterCone {
+	Vec3f center; //The center of a sphere containing the triangles
+	float radius;
+	Vec3f axis;
+	float cutoff;
+};
+
+//The state of one copy of a model drawn using MD2Model::drawInstanced
+struct MD2Instance {
+	/* The rows of a 3x4 matrix transforming the model into the coordinates of
+	 * the current modelview matrix.  The fourth column is the translation.
+	 * The upper 3x3 part must be a rotation times a uniform scale.
+	 */
+	float transform[12];
+	float startFrame; //The first frame of the instance's animation
+	float endFrame;   //The last frame of the instance's animation
+	float time;       //The time in the animation, as in MD2Model::draw
+	float color[3];   //The color by which the instance's skin is multiplied
+};
+
 class MD2Model {
 	private:
 		MD2Frame* frames;
 		int numFrames;
 		MD2TexCoord* texCoords;
+		int numTexCoords;
 		MD2Triangle* triangles;
 		int numTriangles;
+		//The triangle strips and fans from the OpenGL commands in the MD2
+		//file.  Each element of stripLengths is the number of vertices in a
+		//strip, or minus the number of vertices in a fan, and the vertices of
+		//the strips and fans are stored one after another in stripVertices.
+		int* stripLengths;
+		int numStrips;
+		MD2StripVertex* stripVertices;
+		int numStripVertices;
 		GLuint textureId;
+		char textureFilename[64];
+		//The cache file whose contents are used in place, or NULL if the
+		//model was parsed from an MD2 file
+		MappedFile* cacheFile;
 		
 		int startFrame; //The first frame of the current animation
 		int endFrame;   //The last frame of the current animation
 		
+		//The bounds of each frame
+		std::vector<MD2Bounds> frameBounds;
+		//The bounds of all of the frames of the current animation
+		MD2Bounds animBounds;
+		
+		int numVertices;
+		//The interpolated vertices used by drawStrips
+		std::vector<MD2Vertex> stripsPose;
+		//The triangles, reordered so that each cluster's are together
+		std::vector<MD2Triangle> clusterTriangles;
+		std::vector<MD2Cluster> clusters;
+		//The cone of each cluster in each frame; the cones for frame i start
+		//at index i * clusters.size()
+		std::vector<MD2ClusterCone> clusterCones;
+		//The interpolated vertices used by drawCulled, and for each vertex,
+		//the value of numCulledDraws when it was last interpolated
+		std::vector<MD2Vertex> culledPose;
+		std::vector<int> culledPoseStamps;
+		int numCulledDraws;
+		//The triangles of each level of detail after level 0, which uses
+		//"triangles".  Each level has about half as many triangles as the last.
+		std::vector<std::vector<MD2Triangle> > lodTriangles;
+		//The index in cornerBufferId of the first corner of each level of
+		//detail
+		std::vector<int> lodFirstCorners;
+		//The resources for drawInstanced, which are set up by
+		//initInstancing()
+		bool instancingReady;
+		GLuint framesTextureId; //All of the frames, stored in a float texture
+		GLuint cornerBufferId;  //The vertex index and texture coordinate of
+		                        //each corner of each triangle
+		GLuint instanceBufferId;
+		GLuint programId;
+		
 		MD2Model();
+		
+		//Loads the texture with the specified filename into textureId
+		void loadSkin(const char* filename);
+		//Parses the contents of an MD2 file.  Returns NULL if they are invalid.
+		static MD2Model* parse(const char* data, size_t length);
+		//Loads the model from a cache file written by writeCache.  Returns
+		//NULL if the cache file is missing, invalid, or out of date.
+		static MD2Model* loadCache(const char* filename,
+								   const char* cacheFilename);
+		//Writes the model to the specified cache file
+		void writeCache(const char* cacheFilename,
+						size_t sourceSize,
+						long long sourceModificationTime);
+		//Computes the data that are derived from the frames and triangles,
+		//other than the levels of detail and clusters, which are stored in
+		//cache files
+		void finishLoading();
+		//Computes the bounds of the vertices in frames firstFrame to
+		//lastFrame
+		MD2Bounds computeBounds(int firstFrame, int lastFrame);
+		/* Computes lodTriangles from a single sequence of edge collapses,
+		 * which is shared by all of the frames.  The vertices that the
+		 * collapses remove are chosen using their positions in several frames,
+		 * so that no one pose is favored.
+		 */
+		void buildLevelsOfDetail();
+		//Returns the triangles of the specified level of detail
+		const MD2Triangle* trianglesAt(int level);
+		/* Computes clusters, clusterTriangles, and clusterCones.  Each
+		 * cluster is grown from one triangle across shared edges, taking
+		 * triangles whose normals agree with it over frames from all of the
+		 * animations, so that each cluster's cones stay small and narrow as
+		 * the model animates.
+		 */
+		void buildClusters();
+		/* Finds the two frames of the current animation between which to
+		 * interpolate at the specified time, as described in draw(float), and
+		 * the fraction of the way from the first frame to the second.
+		 */
+		void findFrames(float time, int &frameIndex1, int &frameIndex2,
+						float &frac);
 	public:
 		~MD2Model();
 		
@@ -78,12 +218,137 @@ class MD2Model {
 		 * animation.
 		 */
 		void draw(float time);
+		//Draws the model like draw(float), but using the specified level of
+		//detail, which must be from 0 to numLevelsOfDetail() - 1
+		void draw(float time, int level);
 		
-		//Loads an MD2Model from the specified file.  Returns NULL if there was
-		//an error loading it.
-		static MD2Model* load(const char* filename);
+		/* Draws the model like draw(float), but using the triangle strips and
+		 * fans from the MD2 file, which send each vertex about half as many
+		 * times as separate triangles do.  Each vertex is interpolated once.
+		 * If the file has no strips or fans, this is the same as draw(float).
+		 */
+		void drawStrips(float time);
+		//Stores the vertices of the model at the specified time in pose,
+		//which must have room for numVerticesInPose() vertices
+		void computePose(float time, MD2Vertex* pose);
+		//Returns the number of vertices in a pose
+		int numVerticesInPose();
+		/* Draws the model in a pose computed by computePose, at the specified
+		 * level of detail.  If useStrips is true and the level is 0, the
+		 * triangle strips and fans are used, as in drawStrips.
+		 */
+		void drawPose(const MD2Vertex* pose, int level, bool useStrips);
+		//Returns the number of vertices that drawStrips sends to OpenGL
+		int numVerticesInStrips();
+		
+		/* Draws the model like draw(float), but skips the clusters of
+		 * triangles that face away from the camera, which is at the point
+		 * "eye" in the model's coordinates.  A cluster is skipped if it faces
+		 * away in both of the frames between which we are interpolating, and
+		 * only the vertices of the other clusters are interpolated.  Returns
+		 * the number of triangles drawn.
+		 */
+		int drawCulled(float time, Vec3f eye);
+		//Returns the number of clusters of triangles used by drawCulled
+		int numClusters();
+		
+		//Returns the number of levels of detail.  Level 0 is the full model,
+		//and each level has fewer triangles than the one before it.
+		int numLevelsOfDetail();
+		//Returns the number of triangles at the specified level of detail
+		int numTrianglesAt(int level);
+		//Returns the most detailed level with at most maxTriangles triangles,
+		//or the least detailed level if there is no such level
+		int levelForTriangleBudget(float maxTriangles);
+		
+		//Returns the bounds of the specified frame, which are computed when
+		//the model is loaded
+		const MD2Bounds &boundsOfFrame(int frame);
+		//Returns bounds that contain every frame of the current animation
+		const MD2Bounds &animationBounds();
+		
+		//Returns the first frame of the current animation
+		int animationStart();
+		//Returns the last frame of the current animation
+		int animationEnd();
+		
+		//Returns whether the OpenGL implementation supports drawInstanced
+		static bool instancingSupported();
+		/* Bakes the frames of the model into a texture and sets up the shader
+		 * used by drawInstanced.  Returns false if instancing is not supported
+		 * or there was an error.  Calling this more than once has no effect.
+		 */
+		bool initInstancing();
+		/* Draws numInstances copies of the model at the specified level of
+		 * detail, using a single draw call.  The frames of each copy are
+		 * interpolated in a vertex shader, and each copy is lit by GL_LIGHT0,
+		 * which must be a directional light.  initInstancing() must have
+		 * returned true.
+		 */
+		void drawInstanced(const MD2Instance* instances,
+						   int numInstances,
+						   int level = 0);
+		
+		/* Loads an MD2Model from the specified file.  Returns NULL if there was
+		 * an error loading it.  If cacheFilename is not NULL, the model is
+		 * loaded from that cache file if it is up to date, and otherwise the
+		 * cache file is (re)written after loading the MD2 file.
+		 */
+		static MD2Model* load(const char* filename,
+							  const char* cacheFilename = NULL);
 };
 
+/* Shares poses of a model among the copies of it that are at nearly the same
+ * point in the same animation.  Each animation is divided into a number of
+ * evenly spaced slots, and times are rounded to the nearest slot, so that
+ * each pose is computed once, however many copies use it.  More slots give
+ * smoother animation, and fewer slots mean fewer poses to compute.
+ */
+class MD2PoseCache {
+	private:
+		MD2Model* model;
+		int numSlots;
+		//Whether poses are kept from one frame to the next
+		bool persistent;
+		//The index in poses of the pose for each animation and slot, where
+		//an animation is given by its first and last frames
+		std::map<std::pair<std::pair<int, int>, int>, int> poseIndices;
+		//The poses, including ones from earlier frames that may be reused
+		std::vector<std::vector<MD2Vertex> > poses;
+		int numPosesUsed; //The number of elements of poses in use
+		int numPosesComputed;
+		int numPoseRequests;
+	public:
+		/* Constructs a cache for the specified model, with the given number of
+		 * slots per animation.  If persistent is false, the poses are only
+		 * kept until the next call to beginFrame().
+		 */
+		MD2PoseCache(MD2Model* model1, int numSlots1, bool persistent1);
+		
+		//Forgets the poses, unless the cache is persistent.  This should be
+		//called at the beginning of each frame.
+		void beginFrame();
+		/* Returns the pose of the model's current animation at the specified
+		 * time, rounded to the nearest slot.  The pose is valid until the
+		 * number of slots changes, or until the next call to beginFrame() if
+		 * the cache isn't persistent.
+		 */
+		const MD2Vertex* pose(float time);
+		
+		int slots();
+		//Changes the number of slots per animation, which forgets the poses
+		void setSlots(int numSlots1);
+		bool isPersistent();
+		//Changes whether the poses are kept from one frame to the next
+		void setPersistent(bool persistent1);
+		
+		//Returns the number of poses computed since the last resetStats()
+		int posesComputed();
+		//Returns the number of calls to pose(float) since the last
+		//resetStats()
+		int poseRequests();
+		void resetStats();
+};
 
 
 
@@ -0,0 +1,524 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef __APPLE__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include "sdftext.h"
+#include "shader.h"
+#include "text3d.h"
+#include "threadpool.h"
+
+#ifdef __APPLE__
+#include <OpenGL/glext.h>
+#endif
+
+using namespace std;
+
+namespace {
+	//The number of atlas texels per unit of font height
+	const int TEXELS_PER_UNIT = 32;
+	//The number of texels over which the distances go from the edge of a
+	//character to 0 or 255
+	const int SPREAD = 4;
+	//The number of samples along each axis of a texel used to find the
+	//distances
+	const int SUPERSAMPLING = 4;
+	//The width of the atlas texture
+	const int ATLAS_WIDTH = 512;
+	//The number of floats per vertex in the batch: texture coordinates
+	//followed by a position
+	const int FLOATS_PER_VERTEX = 4;
+	//Used in place of an infinite squared distance in the distance transform
+	const float FAR_AWAY = 1e20f;
+	
+	const char* VERTEX_SHADER =
+		"#version 120\n"
+		"varying vec2 texCoord;\n"
+		"varying vec4 color;\n"
+		"void main() {\n"
+		"	gl_Position = ftransform();\n"
+		"	texCoord = gl_MultiTexCoord0.st;\n"
+		"	color = gl_Color;\n"
+		"}\n";
+	
+	//Blends over about one pixel around the edge, however large the text is
+	const char* FRAGMENT_SHADER =
+		"#version 120\n"
+		"uniform sampler2D atlas;\n"
+		"varying vec2 texCoord;\n"
+		"varying vec4 color;\n"
+		"void main() {\n"
+		"	float distance = texture2D(atlas, texCoord).a;\n"
+		"	float w = 0.7 * fwidth(distance);\n"
+		"	float alpha = smoothstep(0.5 - w, 0.5 + w, distance);\n"
+		"	gl_FragColor = vec4(color.rgb, color.a * alpha);\n"
+		"}\n";
+	
+	//Where a character is in the atlas and how large its quad is
+	struct SDFGlyph {
+		//The corners of the quad, relative to the center of the character
+		float minX;
+		float minY;
+		float maxX;
+		float maxY;
+		//The corners of the character in the atlas
+		float minS;
+		float minT;
+		float maxS;
+		float maxT;
+	};
+	
+	float charWidths[256];
+	SDFGlyph glyphs[256];
+	bool hasGlyph[256];
+	GLuint atlasId = 0;
+	GLuint programId = 0;
+	bool useSmoothEdges = true;
+	//The vertices of the quads added since the last call to sdfDrawBatch
+	vector<float> batch;
+	
+	/* Computes the squared distance from each of the n elements of f to the
+	 * nearest element, where the squared distance from element i to element j
+	 * is (i - j)^2 + f[j], and stores the results in d.  v and z are temporary
+	 * arrays of sizes n and n + 1.  This is the one-dimensional distance
+	 * transform of Felzenszwalb and Huttenlocher.
+	 */
+	void distanceTransform1D(const float* f, int n,
+							 float* d, int* v, float* z) {
+		int k = 0;
+		v[0] = 0;
+		z[0] = -FAR_AWAY;
+		z[1] = FAR_AWAY;
+		for(int q = 1; q < n; q++) {
+			//Find where the parabola from q intersects the lower envelope,
+			//removing the parabolas that it hides
+			float s;
+			while (true) {
+				int p = v[k];
+				s = ((f[q] + q * q) - (f[p] + p * p)) / (2 * q - 2 * p);
+				if (s > z[k]) {
+					break;
+				}
+				k--;
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = FAR_AWAY;
+		}
+		
+		k = 0;
+		for(int q = 0; q < n; q++) {
+			while (z[k + 1] < q) {
+				k++;
+			}
+			d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+	
+	//Replaces each element of the width x height grid, which is 0 or
+	//FAR_AWAY, with its squared distance to the nearest 0
+	void distanceTransform2D(vector<float> &grid, int width, int height) {
+		int n = max(width, height);
+		vector<float> f(n);
+		vector<float> d(n);
+		vector<int> v(n);
+		vector<float> z(n + 1);
+		for(int x = 0; x < width; x++) {
+			for(int y = 0; y < height; y++) {
+				f[y] = grid[y * width + x];
+			}
+			distanceTransform1D(&f[0], height, &d[0], &v[0], &z[0]);
+			for(int y = 0; y < height; y++) {
+				grid[y * width + x] = d[y];
+			}
+		}
+		for(int y = 0; y < height; y++) {
+			distanceTransform1D(&grid[y * width], width, &d[0], &v[0], &z[0]);
+			copy(d.begin(), d.begin() + width, grid.begin() + y * width);
+		}
+	}
+	
+	//Returns the signed area of the parallelogram formed by b - a and c - a
+	float cross(float ax, float ay, float bx, float by, float cx, float cy) {
+		return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+	}
+	
+	/* Renders the triangles into a width x height texel cell of signed
+	 * distances, where texel (0, 0) is centered at (x0, y0) + 0.5 texels.  The
+	 * distances are mapped so that 128 is the edge of the character and 0 and
+	 * 255 are SPREAD texels outside and inside it.
+	 */
+	void renderDistances(const vector<float> &triangles,
+						 float x0, float y0,
+						 int width, int height,
+						 unsigned char* cell) {
+		//Find which samples are inside the character
+		int sampleWidth = width * SUPERSAMPLING;
+		int sampleHeight = height * SUPERSAMPLING;
+		float samplesPerUnit = (float)(TEXELS_PER_UNIT * SUPERSAMPLING);
+		vector<unsigned char> inside(sampleWidth * sampleHeight, 0);
+		for(int i = 0; i + 5 < (int)triangles.size(); i += 6) {
+			float xs[3];
+			float ys[3];
+			for(int j = 0; j < 3; j++) {
+				xs[j] = (triangles[i + 2 * j] - x0) * samplesPerUnit - 0.5f;
+				ys[j] = (triangles[i + 2 * j + 1] - y0) * samplesPerUnit - 0.5f;
+			}
+			float area = cross(xs[0], ys[0], xs[1], ys[1], xs[2], ys[2]);
+			if (area == 0) {
+				continue;
+			}
+			
+			int minX = max((int)ceil(min(xs[0], min(xs[1], xs[2]))), 0);
+			int minY = max((int)ceil(min(ys[0], min(ys[1], ys[2]))), 0);
+			int maxX = min((int)floor(max(xs[0], max(xs[1], xs[2]))),
+						   sampleWidth - 1);
+			int maxY = min((int)floor(max(ys[0], max(ys[1], ys[2]))),
+						   sampleHeight - 1);
+			for(int y = minY; y <= maxY; y++) {
+				for(int x = minX; x <= maxX; x++) {
+					float e0 = cross(xs[1], ys[1], xs[2], ys[2], x, y) * area;
+					float e1 = cross(xs[2], ys[2], xs[0], ys[0], x, y) * area;
+					float e2 = cross(xs[0], ys[0], xs[1], ys[1], x, y) * area;
+					if (e0 >= 0 && e1 >= 0 && e2 >= 0) {
+						inside[y * sampleWidth + x] = 1;
+					}
+				}
+			}
+		}
+		
+		//Find the squared distances from each sample to the nearest sample on
+		//the other side of the edge
+		vector<float> distancesOut(sampleWidth * sampleHeight);
+		vector<float> distancesIn(sampleWidth * sampleHeight);
+		for(int i = 0; i < sampleWidth * sampleHeight; i++) {
+			distancesOut[i] = inside[i] ? 0 : FAR_AWAY;
+			distancesIn[i] = inside[i] ? FAR_AWAY : 0;
+		}
+		distanceTransform2D(distancesOut, sampleWidth, sampleHeight);
+		distanceTransform2D(distancesIn, sampleWidth, sampleHeight);
+		
+		//Average the signed distances of each texel's samples.  The edge is
+		//half a sample from the nearest sample on the other side.
+		for(int y = 0; y < height; y++) {
+			for(int x = 0; x < width; x++) {
+				float total = 0;
+				for(int sy = 0; sy < SUPERSAMPLING; sy++) {
+					for(int sx = 0; sx < SUPERSAMPLING; sx++) {
+						int i = (y * SUPERSAMPLING + sy) * sampleWidth +
+							x * SUPERSAMPLING + sx;
+						if (inside[i]) {
+							total += sqrt(distancesIn[i]) - 0.5f;
+						}
+						else {
+							total -= sqrt(distancesOut[i]) - 0.5f;
+						}
+					}
+				}
+				float distance =
+					total / (SUPERSAMPLING * SUPERSAMPLING * SUPERSAMPLING);
+				float value = 127.5f * (1 + distance / SPREAD);
+				cell[y * width + x] =
+					(unsigned char)max(0.0f, min(255.0f, value + 0.5f));
+			}
+		}
+	}
+	
+	//Adds the quads for the specified string to the batch
+	void addString(const string &str,
+				   float x, float y,
+				   float height,
+				   int hAlign, int vAlign,
+				   float lineHeight) {
+		//Measure each line
+		vector<float> lineWidths;
+		float width = 0;
+		for(int i = 0; i < (int)str.size(); i++) {
+			if (str[i] == '\n') {
+				lineWidths.push_back(width);
+				width = 0;
+			}
+			else {
+				width += charWidths[(unsigned char)str[i]];
+			}
+		}
+		lineWidths.push_back(width);
+		
+		float lineY = -0.5f;
+		if (vAlign >= 0) {
+			float totalHeight = lineHeight * (lineWidths.size() - 1) + 1;
+			lineY += vAlign > 0 ? totalHeight : totalHeight / 2;
+		}
+		
+		int line = 0;
+		float lineX = 0;
+		if (hAlign >= 0) {
+			lineX = hAlign > 0 ? -lineWidths[0] : -lineWidths[0] / 2;
+		}
+		for(int i = 0; i < (int)str.size(); i++) {
+			unsigned char c = (unsigned char)str[i];
+			if (c == '\n') {
+				line++;
+				lineY -= lineHeight;
+				lineX = 0;
+				if (hAlign >= 0) {
+					lineX = hAlign > 0 ?
+						-lineWidths[line] : -lineWidths[line] / 2;
+				}
+				continue;
+			}
+			
+			float charX = lineX + charWidths[c] / 2;
+			lineX += charWidths[c];
+			if (!hasGlyph[c]) {
+				continue;
+			}
+			
+			const SDFGlyph &glyph = glyphs[c];
+			float x1 = x + height * (charX + glyph.minX);
+			float y1 = y + height * (lineY + glyph.minY);
+			float x2 = x + height * (charX + glyph.maxX);
+			float y2 = y + height * (lineY + glyph.maxY);
+			float quad[4 * FLOATS_PER_VERTEX] =
+				{glyph.minS, glyph.minT, x1, y1,
+				 glyph.maxS, glyph.minT, x2, y1,
+				 glyph.maxS, glyph.maxT, x2, y2,
+				 glyph.minS, glyph.maxT, x1, y2};
+			batch.insert(batch.end(), quad, quad + 4 * FLOATS_PER_VERTEX);
+		}
+	}
+}
+
+void sdfInit() {
+	if (atlasId != 0) {
+		return;
+	}
+	
+	//Find the size of each character's cell
+	vector<vector<float> > triangles(256);
+	vector<vector<unsigned char> > cells(256);
+	int cellWidths[256];
+	int cellHeights[256];
+	for(int c = 0; c < 256; c++) {
+		charWidths[c] = t3dCharTriangles((char)c, triangles[c]);
+		hasGlyph[c] = !triangles[c].empty() && c != '\n';
+		if (!hasGlyph[c]) {
+			continue;
+		}
+		
+		const vector<float> &vertices = triangles[c];
+		float minX = vertices[0];
+		float minY = vertices[1];
+		float maxX = minX;
+		float maxY = minY;
+		for(int i = 2; i < (int)vertices.size(); i += 2) {
+			minX = min(minX, vertices[i]);
+			maxX = max(maxX, vertices[i]);
+			minY = min(minY, vertices[i + 1]);
+			maxY = max(maxY, vertices[i + 1]);
+		}
+		
+		//Leave room for the distances outside the character
+		SDFGlyph &glyph = glyphs[c];
+		glyph.minX = minX - (float)SPREAD / TEXELS_PER_UNIT;
+		glyph.minY = minY - (float)SPREAD / TEXELS_PER_UNIT;
+		cellWidths[c] = (int)ceil((maxX - minX) * TEXELS_PER_UNIT) + 2 * SPREAD;
+		cellHeights[c] =
+			(int)ceil((maxY - minY) * TEXELS_PER_UNIT) + 2 * SPREAD;
+		glyph.maxX = glyph.minX + (float)cellWidths[c] / TEXELS_PER_UNIT;
+		glyph.maxY = glyph.minY + (float)cellHeights[c] / TEXELS_PER_UNIT;
+		cells[c].resize(cellWidths[c] * cellHeights[c]);
+	}
+	
+	//Render the characters into their cells
+	defaultThreadPool()->parallelFor(256, [&](int begin, int end) {
+		for(int c = begin; c < end; c++) {
+			if (hasGlyph[c]) {
+				renderDistances(triangles[c],
+								glyphs[c].minX, glyphs[c].minY,
+								cellWidths[c], cellHeights[c],
+								&cells[c][0]);
+			}
+		}
+	});
+	
+	//Pack the cells into rows, leaving a texel between them so that they
+	//don't bleed into each other
+	int cellXs[256];
+	int cellYs[256];
+	int rowX = 1;
+	int rowY = 1;
+	int rowHeight = 0;
+	for(int c = 0; c < 256; c++) {
+		if (!hasGlyph[c]) {
+			continue;
+		}
+		if (rowX + cellWidths[c] + 1 > ATLAS_WIDTH) {
+			rowX = 1;
+			rowY += rowHeight + 1;
+			rowHeight = 0;
+		}
+		cellXs[c] = rowX;
+		cellYs[c] = rowY;
+		rowX += cellWidths[c] + 1;
+		rowHeight = max(rowHeight, cellHeights[c]);
+	}
+	int atlasHeight = 1;
+	while (atlasHeight < rowY + rowHeight + 1) {
+		atlasHeight *= 2;
+	}
+	
+	vector<unsigned char> atlas(ATLAS_WIDTH * atlasHeight, 0);
+	for(int c = 0; c < 256; c++) {
+		if (!hasGlyph[c]) {
+			continue;
+		}
+		for(int y = 0; y < cellHeights[c]; y++) {
+			copy(cells[c].begin() + y * cellWidths[c],
+				 cells[c].begin() + (y + 1) * cellWidths[c],
+				 atlas.begin() + (cellYs[c] + y) * ATLAS_WIDTH + cellXs[c]);
+		}
+		
+		SDFGlyph &glyph = glyphs[c];
+		glyph.minS = (float)cellXs[c] / ATLAS_WIDTH;
+		glyph.minT = (float)cellYs[c] / atlasHeight;
+		glyph.maxS = (float)(cellXs[c] + cellWidths[c]) / ATLAS_WIDTH;
+		glyph.maxT = (float)(cellYs[c] + cellHeights[c]) / atlasHeight;
+	}
+	
+	glGenTextures(1, &atlasId);
+	glBindTexture(GL_TEXTURE_2D, atlasId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D,
+				 0,
+				 GL_ALPHA,
+				 ATLAS_WIDTH, atlasHeight,
+				 0,
+				 GL_ALPHA,
+				 GL_UNSIGNED_BYTE,
+				 &atlas[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	
+	if (shadersSupported()) {
+		programId = loadShaderProgram(VERTEX_SHADER, FRAGMENT_SHADER, NULL);
+		if (programId != 0) {
+			glUseProgram(programId);
+			glUniform1i(glGetUniformLocation(programId, "atlas"), 0);
+			glUseProgram(0);
+		}
+	}
+}
+
+void sdfCleanup() {
+	if (atlasId != 0) {
+		glDeleteTextures(1, &atlasId);
+		atlasId = 0;
+	}
+	if (programId != 0) {
+		glDeleteProgram(programId);
+		programId = 0;
+	}
+	vector<float>().swap(batch);
+}
+
+void sdfAdd(string str,
+			float x, float y,
+			float height,
+			int hAlign, int vAlign,
+			float lineHeight) {
+	addString(str, x, y, height, hAlign, vAlign, lineHeight);
+}
+
+void sdfDrawBatch() {
+	if (batch.empty()) {
+		return;
+	}
+	
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, atlasId);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	
+	bool smooth = useSmoothEdges && programId != 0;
+	glEnable(GL_ALPHA_TEST);
+	if (smooth) {
+		//Skip the fully transparent fragments, so that they don't write to
+		//the depth buffer
+		glAlphaFunc(GL_GREATER, 0);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glUseProgram(programId);
+	}
+	else {
+		glAlphaFunc(GL_GEQUAL, 0.5f);
+	}
+	
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, FLOATS_PER_VERTEX * sizeof(float),
+					  &batch[0]);
+	glVertexPointer(2, GL_FLOAT, FLOATS_PER_VERTEX * sizeof(float),
+					&batch[2]);
+	glDrawArrays(GL_QUADS, 0, (GLsizei)batch.size() / FLOATS_PER_VERTEX);
+	glPopClientAttrib();
+	
+	if (smooth) {
+		glUseProgram(0);
+	}
+	glPopAttrib();
+	batch.clear();
+}
+
+void sdfDraw2D(string str, int hAlign, int vAlign, float lineHeight) {
+	addString(str, 0, 0, 1, hAlign, vAlign, lineHeight);
+	sdfDrawBatch();
+}
+
+void sdfSetSmoothEdges(bool smoothEdges) {
+	useSmoothEdges = smoothEdges;
+}
+
+
+
+
+
+
+
+
+
+
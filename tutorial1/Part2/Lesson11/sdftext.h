@@ -0,0 +1,75 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef SDF_TEXT_H_INCLUDED
+#define SDF_TEXT_H_INCLUDED
+
+#include <string>
+
+/* Initializes signed distance field text, which draws the same characters as
+ * t3dDraw2D using one textured quad per character.  The characters are
+ * rendered into a texture atlas of signed distances to their edges, which
+ * keeps them sharp at any size.  t3dInit must be called before this function,
+ * and it must be called before the other functions in this header.
+ */
+void sdfInit();
+//Frees the memory allocated for signed distance field text.  No other
+//functions in this header may be called after this one.
+void sdfCleanup();
+/* Adds the specified string to the strings that the next call to sdfDrawBatch
+ * will draw.  The string is laid out like t3dDraw2D would lay it out, after
+ * scaling by height and translating by (x, y).  hAlign, vAlign, and lineHeight
+ * have the same meanings as for t3dDraw2D.
+ */
+void sdfAdd(std::string str,
+			float x, float y,
+			float height,
+			int hAlign, int vAlign,
+			float lineHeight = 1.5f);
+/* Draws all of the strings added using sdfAdd since the last call to this
+ * function, with a single draw call, in the x-y plane.  The strings are drawn
+ * using the current color.
+ */
+void sdfDrawBatch();
+//Draws the specified string like t3dDraw2D would draw it, except with
+//signed distance field text
+void sdfDraw2D(std::string str,
+			   int hAlign, int vAlign,
+			   float lineHeight = 1.5f);
+/* Sets whether the edges of the characters are smoothed using a shader, rather
+ * than drawn using the alpha test.  Smoothing is only used if shaders are
+ * supported.  It is on by default.
+ */
+void sdfSetSmoothEdges(bool smoothEdges);
+
+
+
+
+
+
+
+
+
+
+#endif
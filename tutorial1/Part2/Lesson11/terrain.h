@@ -0,0 +1,415 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_H_INCLUDED
+#define TERRAIN_H_INCLUDED
+
+#include <stddef.h>
+
+#include "vec3f.h"
+
+//The base 2 logarithm of the width and length of the tiles used by Terrain's
+//TILED layout
+const int TERRAIN_TILE_SHIFT = 3;
+const int TERRAIN_TILE_SIZE = 1 << TERRAIN_TILE_SHIFT;
+
+//Represents a terrain, by storing a set of heights and normals at 2D locations
+class Terrain {
+	public:
+		//The orders in which a terrain can keep its samples in memory
+		enum Layout {
+			//Row by row, with the samples for each row next to each other
+			ROW_MAJOR,
+			/* In TERRAIN_TILE_SIZE x TERRAIN_TILE_SIZE tiles, stored row by
+			 * row, with the samples in each tile in Z-order (Morton order).
+			 * Nearby samples are then usually near each other in memory,
+			 * whichever direction they are in.
+			 */
+			TILED
+		};
+		
+		//The ways in which a terrain can store each sample
+		enum Storage {
+			//A float for the height and a Vec3f for the normal, 16 bytes
+			FLOATS,
+			/* A 16-bit integer for the height, scaled to the terrain's range
+			 * of heights, and the normal's direction packed into 16 bits by
+			 * an octahedral mapping, 4 bytes.  Heights are rounded to the
+			 * nearest of 65536 levels, and normals are off by at most about
+			 * a degree.
+			 */
+			QUANTIZED
+		};
+	private:
+		//The rough normals of a band of rows of samples, from which
+		//computeNormals computes the normals
+		struct RoughNormals {
+			//The x, y, and z coordinates, row by row
+			float* xs;
+			float* ys;
+			float* zs;
+			//The position of the first sample in the band
+			int minX;
+			int minZ;
+			int stride; //The distance between rows in xs, ys, and zs
+		};
+		
+		int w; //Width
+		int l; //Length
+		Layout layout_;
+		Storage storage_;
+		//The number of elements in the arrays of heights and normals
+		int numSlots;
+		//For FLOATS, the heights and normals, each in one array, in the order
+		//given by layout_, and otherwise NULL
+		float* hs;
+		Vec3f* normals;
+		//For QUANTIZED, the heights and normals in the same order, and
+		//otherwise NULL
+		unsigned short* quantizedHeights;
+		unsigned short* packedNormals;
+		//For QUANTIZED, each height is heightOffset + heightScale times its
+		//quantized height
+		float heightOffset;
+		float heightScale;
+		/* The smallest rectangle containing the samples whose heights
+		 * changed since the normals were last computed.  The normals are
+		 * up-to-date when dirtyMinX > dirtyMaxX.
+		 */
+		int dirtyMinX;
+		int dirtyMinZ;
+		int dirtyMaxX;
+		int dirtyMaxZ;
+		//The smallest rectangle containing the samples whose heights or
+		//normals changed since the last call to takeChangedRegion
+		int changedMinX;
+		int changedMinZ;
+		int changedMaxX;
+		int changedMaxZ;
+		/* For TILED, tileRowOffset is the distance in the arrays of heights
+		 * and normals from a tile to the tile below it, and xOffsets[x] +
+		 * zOffsets[z] is the offset of the sample at (x, z) within a tile.
+		 * The last element of xOffsets and zOffsets is the offset to the
+		 * first sample of the next tile over, so that we can find a
+		 * neighboring sample without checking whether it is in another tile.
+		 */
+		int tileRowOffset;
+		int xOffsets[TERRAIN_TILE_SIZE + 1];
+		int zOffsets[TERRAIN_TILE_SIZE + 1];
+		
+		//Returns the index in the arrays of heights and normals of the start
+		//of the tile containing (x, z), for TILED
+		int tileIndex(int x, int z) const {
+			return (z >> TERRAIN_TILE_SHIFT) * tileRowOffset +
+				((x >> TERRAIN_TILE_SHIFT) << (2 * TERRAIN_TILE_SHIFT));
+		}
+		
+		//Returns the index in the arrays of heights and normals of the sample
+		//at (x, z)
+		int indexOf(int x, int z) const {
+			if (layout_ == ROW_MAJOR) {
+				return z * w + x;
+			}
+			return tileIndex(x, z) + xOffsets[x & (TERRAIN_TILE_SIZE - 1)] +
+				zOffsets[z & (TERRAIN_TILE_SIZE - 1)];
+		}
+		
+		//Sets indices[0] through indices[3] to the indices of the corners of
+		//a grid cell, in the same order as getCellHeights
+		void cellIndices(int x, int z, int* indices) const {
+			if (layout_ == ROW_MAJOR) {
+				indices[0] = z * w + x;
+				indices[1] = indices[0] + 1;
+				indices[2] = indices[0] + w;
+				indices[3] = indices[0] + w + 1;
+				return;
+			}
+			
+			int i = tileIndex(x, z);
+			int x2 = x & (TERRAIN_TILE_SIZE - 1);
+			int z2 = z & (TERRAIN_TILE_SIZE - 1);
+			indices[0] = i + xOffsets[x2] + zOffsets[z2];
+			indices[1] = i + xOffsets[x2 + 1] + zOffsets[z2];
+			indices[2] = i + xOffsets[x2] + zOffsets[z2 + 1];
+			indices[3] = i + xOffsets[x2 + 1] + zOffsets[z2 + 1];
+		}
+		
+		//Returns the height with the specified index
+		float heightWithIndex(int i) const {
+			if (storage_ == QUANTIZED) {
+				return heightOffset + heightScale * quantizedHeights[i];
+			}
+			return hs[i];
+		}
+		
+		//Does what getCellHeights does, for QUANTIZED
+		void getQuantizedCellHeights(int x, int z, float* heights) const;
+		//Does what getCellNormals does, for QUANTIZED
+		void getPackedCellNormals(int x, int z, float* cellNormals) const;
+		//Sets normal to the normal with the specified index
+		void normalWithIndex(int i, float* normal) const;
+		//Sets the normal with the specified index to (x, y, z), which must
+		//not be the zero vector
+		void setNormalWithIndex(int i, float x, float y, float z);
+		
+		/* Returns a pointer to the height at (minX, z), such that the
+		 * heights at (minX, z) through (maxX, z) follow it.  Unless the
+		 * terrain is ROW_MAJOR and FLOATS, this copies those heights into
+		 * buffer.
+		 */
+		const float* heightRow(int z, int minX, int maxX, float* buffer) const;
+		//Sets the rough normal at (x, z) without using SIMD instructions, for
+		//samples on the edges of the terrain
+		void computeRoughNormal(RoughNormals &rough, int x, int z);
+		//Sets the rough normals at (minX, z) through (maxX, z), using buffer
+		//to hold 3 * (maxX - minX + 3) heights
+		void computeRoughNormals(RoughNormals &rough,
+								 int z,
+								 int minX,
+								 int maxX,
+								 float* buffer);
+		/* Sets the normal at (x, z) from the rough normals without using
+		 * SIMD instructions, for samples on the edges of the terrain.  The
+		 * rough normals must include the neighbors of (x, z).
+		 */
+		void smoothNormal(const RoughNormals &rough, int x, int z);
+		//Sets the normals at (minX, z) through (maxX, z) from the rough
+		//normals, using buffer to hold 3 * (maxX - minX + 1) coordinates
+		void smoothNormals(const RoughNormals &rough,
+						   int z,
+						   int minX,
+						   int maxX,
+						   float* buffer);
+	public:
+		/* Makes a flat terrain at height 0.  For QUANTIZED, the terrain's
+		 * heights are clamped to the range from minHeight to maxHeight.
+		 */
+		Terrain(int w2,
+				int l2,
+				Layout layout2 = ROW_MAJOR,
+				Storage storage2 = FLOATS,
+				float minHeight = -128,
+				float maxHeight = 128);
+		~Terrain();
+		
+		int width() const {
+			return w;
+		}
+		
+		int length() const {
+			return l;
+		}
+		
+		Layout layout() const {
+			return layout_;
+		}
+		
+		Storage storage() const {
+			return storage_;
+		}
+		
+		//Returns the number of bytes used by the heights and normals
+		size_t memorySize() const;
+		
+		//Sets the height at (x, z) to y
+		void setHeight(int x, int z, float y) {
+			if (storage_ == QUANTIZED) {
+				//Round to the nearest level, clamping to the range of heights
+				float q = (y - heightOffset) / heightScale + 0.5f;
+				if (q < 0) {
+					q = 0;
+				}
+				else if (q > 65535) {
+					q = 65535;
+				}
+				quantizedHeights[indexOf(x, z)] = (unsigned short)q;
+			}
+			else {
+				hs[indexOf(x, z)] = y;
+			}
+			if (x < dirtyMinX) {
+				dirtyMinX = x;
+			}
+			if (x > dirtyMaxX) {
+				dirtyMaxX = x;
+			}
+			if (z < dirtyMinZ) {
+				dirtyMinZ = z;
+			}
+			if (z > dirtyMaxZ) {
+				dirtyMaxZ = z;
+			}
+		}
+		
+		//Returns the height at (x, z)
+		float getHeight(int x, int z) const {
+			return heightWithIndex(indexOf(x, z));
+		}
+		
+		/* Sets heights[0], heights[1], heights[2], and heights[3] to the
+		 * heights at (x, z), (x + 1, z), (x, z + 1), and (x + 1, z + 1), the
+		 * corners of a grid cell.  This is quicker than four calls to
+		 * getHeight.
+		 */
+		void getCellHeights(int x, int z, float* heights) const {
+			if (storage_ == QUANTIZED) {
+				getQuantizedCellHeights(x, z, heights);
+				return;
+			}
+			
+			if (layout_ == ROW_MAJOR) {
+				const float* h = hs + z * w + x;
+				heights[0] = h[0];
+				heights[1] = h[1];
+				heights[2] = h[w];
+				heights[3] = h[w + 1];
+				return;
+			}
+			
+			const float* h = hs + tileIndex(x, z);
+			int x2 = x & (TERRAIN_TILE_SIZE - 1);
+			int z2 = z & (TERRAIN_TILE_SIZE - 1);
+			heights[0] = h[xOffsets[x2] + zOffsets[z2]];
+			heights[1] = h[xOffsets[x2 + 1] + zOffsets[z2]];
+			heights[2] = h[xOffsets[x2] + zOffsets[z2 + 1]];
+			heights[3] = h[xOffsets[x2 + 1] + zOffsets[z2 + 1]];
+		}
+		
+		/* Sets cellNormals[3 * i] through cellNormals[3 * i + 2] to the
+		 * coordinates of the normal at the ith corner of a grid cell, for i
+		 * from 0 to 3, in the same order as getCellHeights.  Unlike
+		 * getNormal, this doesn't compute the normals, so they must be
+		 * up-to-date.
+		 */
+		void getCellNormals(int x, int z, float* cellNormals) const {
+			if (storage_ == QUANTIZED) {
+				getPackedCellNormals(x, z, cellNormals);
+				return;
+			}
+			
+			//A Vec3f holds nothing but its coordinates, and reading them
+			//directly avoids calling its functions, which aren't inline
+			int indices[4];
+			cellIndices(x, z, indices);
+			for(int i = 0; i < 4; i++) {
+				const float* normal = (const float*)(normals + indices[i]);
+				cellNormals[3 * i] = normal[0];
+				cellNormals[3 * i + 1] = normal[1];
+				cellNormals[3 * i + 2] = normal[2];
+			}
+		}
+		
+		/* Computes the normals that changed since they were last computed,
+		 * if any.  This only recomputes the normals within two samples of
+		 * heights that changed, and it uses SIMD instructions, where
+		 * available.  It uses the default thread pool if useThreads is true;
+		 * a task already running on the pool should pass false rather than
+		 * splitting its work again.
+		 */
+		void computeNormals(bool useThreads = true);
+		
+		/* Computes the normals, then sets (minX, minZ) and (maxX, maxZ) to the
+		 * corners of the smallest rectangle containing the samples whose
+		 * heights or normals changed since the last call and returns true, or
+		 * returns false if none changed.  The first call reports the whole
+		 * terrain.  This is meant for the one object that keeps a copy of the
+		 * terrain, such as a vertex buffer for drawing it.
+		 */
+		bool takeChangedRegion(int &minX, int &minZ, int &maxX, int &maxZ);
+		
+		//Returns the normal at (x, z)
+		Vec3f getNormal(int x, int z) {
+			if (dirtyMinX <= dirtyMaxX) {
+				computeNormals();
+			}
+			if (storage_ == QUANTIZED) {
+				float normal[3];
+				normalWithIndex(indexOf(x, z), normal);
+				return Vec3f(normal[0], normal[1], normal[2]);
+			}
+			return normals[indexOf(x, z)];
+		}
+};
+
+/* Loads a terrain from a heightmap, which is either a bitmap with 16 or 24
+ * bits per pixel or, if the file name ends in ".r16", a raw 16-bit grayscale
+ * image, as loadGrayBMP and loadR16 read them.  The heights of the terrain
+ * range from -height / 2 to height / 2.  A QUANTIZED terrain can hold
+ * heights from -height to height, leaving room to dig craters.
+ */
+Terrain* loadTerrain(const char* filename,
+					 float height,
+					 Terrain::Layout layout = Terrain::ROW_MAJOR,
+					 Terrain::Storage storage = Terrain::FLOATS);
+//Returns the approximate height of the terrain at the specified (x, z) position
+float heightAt(Terrain* terrain, float x, float z);
+/* Sets heights[i] to heightAt(terrain, xs[i], zs[i]) for each i from 0 to
+ * count - 1, using SIMD instructions where available.  If normals isn't NULL,
+ * this also sets normals[i] to the normal at (xs[i], zs[i]), interpolated in
+ * the same way as the height, computing the terrain's normals first if they
+ * are out of date.  This is much quicker than calling heightAt count times.
+ * It may be called from several threads at once, as long as the terrain
+ * doesn't change meanwhile and, when asking for normals, its normals are
+ * already up-to-date.
+ */
+void heightsAt(Terrain* terrain,
+			   const float* xs,
+			   const float* zs,
+			   int count,
+			   float* heights,
+			   Vec3f* normals = NULL);
+//Does what heightsAt does, splitting the points among the threads of the
+//default thread pool
+void parallelHeightsAt(Terrain* terrain,
+					   const float* xs,
+					   const float* zs,
+					   int count,
+					   float* heights,
+					   Vec3f* normals = NULL);
+/* Digs a bowl-shaped crater of the specified radius and depth, centered at
+ * (x, z), with a raised rim.  The radius is in samples, and it may be
+ * fractional.
+ */
+void makeCrater(Terrain* terrain, float x, float z, float radius, float depth);
+
+
+
+
+
+
+
+
+
+
+#endif
+
+
+
+
+
+
+
+
+
+
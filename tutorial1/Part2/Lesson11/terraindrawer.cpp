@@ -0,0 +1,1323 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef __APPLE__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <math.h>
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <OpenGL/glext.h>
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "frustum.h"
+#include "shader.h"
+#include "terraindrawer.h"
+#include "threadpool.h"
+
+using namespace std;
+
+namespace {
+	//The number of floats for each vertex: a normal, or a color if the
+	//lighting is baked, then a position
+	const int FLOATS_PER_VERTEX = 6;
+	//The number of chunks whose new vertices update keeps at once
+	const int UPDATE_BATCH_SIZE = 64;
+	
+	//The directions, in grid cells, in which ambient occlusion looks for the
+	//horizon
+	const int OCCLUSION_DIRECTIONS[8][2] = {
+		{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+	};
+	//The multiples of each direction at which ambient occlusion samples the
+	//terrain.  They spread out with distance, since a distant sample needs to
+	//be much higher to raise the horizon.
+	const int OCCLUSION_STEPS[] = {1, 2, 3, 4, 6, 8, 12, 16};
+	const int NUM_OCCLUSION_STEPS = 8;
+	//How far ambient occlusion looks along each axis, in grid cells
+	const int OCCLUSION_REACH = 16;
+	//About how many samples updateTexture copies to a texture at once
+	const int TEXTURE_BAND_SAMPLES = 1 << 18;
+	
+	/* The vertex shader for drawing a chunk from the height texture.  The
+	 * vertex ids follow the layout of the chunks' vertex buffers, which
+	 * indicesFor describes, so the shader can use the same indices.  It
+	 * computes the normals the same way as Terrain.  Without baked lighting,
+	 * it lights the terrain as OpenGL's lighting would with
+	 * GL_COLOR_MATERIAL, light 0 as a directional light, and GL_NORMALIZE.
+	 */
+	const char* HEIGHT_VERTEX_SHADER =
+		"#version 120\n"
+		"#extension GL_EXT_gpu_shader4 : require\n"
+		"uniform sampler2D heights;\n"
+		"uniform sampler2D occlusion;\n"
+		"uniform ivec2 origin;\n"
+		"uniform ivec2 cells;\n"
+		"uniform vec4 skirtDepths;\n"
+		"uniform bool baked;\n"
+		"uniform bool useOcclusion;\n"
+		"uniform vec3 lightDirection;\n"
+		"uniform vec3 bakedColor;\n"
+		"uniform float ambient;\n"
+		"uniform float diffuse;\n"
+		"attribute float unused;\n"
+		"varying vec3 color;\n"
+		"ivec2 size;\n"
+		"float heightAt(ivec2 p) {\n"
+		"	return texelFetch2D(heights, clamp(p, ivec2(0), size - 1), 0).r;\n"
+		"}\n"
+		"bvec4 hasNeighbors(ivec2 p) {\n"
+		"	return bvec4(p.x > 0, p.x < size.x - 1,\n"
+		"				 p.y > 0, p.y < size.y - 1);\n"
+		"}\n"
+		"vec3 roughNormal(ivec2 p) {\n"
+		"	float h = heightAt(p);\n"
+		"	float left = heightAt(p - ivec2(1, 0)) - h;\n"
+		"	float right = heightAt(p + ivec2(1, 0)) - h;\n"
+		"	float back = heightAt(p - ivec2(0, 1)) - h;\n"
+		"	float front = heightAt(p + ivec2(0, 1)) - h;\n"
+		"	bvec4 has = hasNeighbors(p);\n"
+		"	vec3 sum = vec3(0.0);\n"
+		"	if (has.x && has.z) {\n"
+		"		sum += normalize(vec3(left, 1.0, back));\n"
+		"	}\n"
+		"	if (has.x && has.w) {\n"
+		"		sum += normalize(vec3(left, 1.0, -front));\n"
+		"	}\n"
+		"	if (has.y && has.w) {\n"
+		"		sum += normalize(vec3(-right, 1.0, -front));\n"
+		"	}\n"
+		"	if (has.y && has.z) {\n"
+		"		sum += normalize(vec3(-right, 1.0, back));\n"
+		"	}\n"
+		"	return sum;\n"
+		"}\n"
+		"void main() {\n"
+		"	size = textureSize2D(heights, 0);\n"
+		"	int id = gl_VertexID;\n"
+		"	int rowLength = cells.x + 1;\n"
+		"	int columnLength = cells.y + 1;\n"
+		"	ivec2 p;\n"
+		"	float depth = 0.0;\n"
+		"	if (id < rowLength * columnLength) {\n"
+		"		p = ivec2(id - id / rowLength * rowLength, id / rowLength);\n"
+		"	}\n"
+		"	else if (id < rowLength * (columnLength + 2)) {\n"
+		"		id -= rowLength * columnLength;\n"
+		"		bool far = id >= rowLength;\n"
+		"		p = far ? ivec2(id - rowLength, cells.y) : ivec2(id, 0);\n"
+		"		depth = far ? skirtDepths.y : skirtDepths.x;\n"
+		"	}\n"
+		"	else {\n"
+		"		id -= rowLength * (columnLength + 2);\n"
+		"		bool far = id >= columnLength;\n"
+		"		p = far ? ivec2(cells.x, id - columnLength) : ivec2(0, id);\n"
+		"		depth = far ? skirtDepths.w : skirtDepths.z;\n"
+		"	}\n"
+		"	p += origin;\n"
+		"	gl_Position = gl_ModelViewProjectionMatrix *\n"
+		"		vec4(float(p.x), heightAt(p) - depth, float(p.y), 1.0);\n"
+		"	vec3 normal = roughNormal(p);\n"
+		"	bvec4 has = hasNeighbors(p);\n"
+		"	if (has.x) {\n"
+		"		normal += 0.5 * roughNormal(p - ivec2(1, 0));\n"
+		"	}\n"
+		"	if (has.y) {\n"
+		"		normal += 0.5 * roughNormal(p + ivec2(1, 0));\n"
+		"	}\n"
+		"	if (has.z) {\n"
+		"		normal += 0.5 * roughNormal(p - ivec2(0, 1));\n"
+		"	}\n"
+		"	if (has.w) {\n"
+		"		normal += 0.5 * roughNormal(p + ivec2(0, 1));\n"
+		"	}\n"
+		"	float sky = 1.0;\n"
+		"	if (useOcclusion) {\n"
+		"		sky = texelFetch2D(occlusion, p, 0).r;\n"
+		"	}\n"
+		"	if (baked) {\n"
+		"		float light = ambient * sky + diffuse *\n"
+		"			max(dot(normalize(normal), lightDirection), 0.0);\n"
+		"		color = min(bakedColor * light, 1.0);\n"
+		"	}\n"
+		"	else {\n"
+		"		vec3 n = normalize(gl_NormalMatrix * normal);\n"
+		"		vec3 l = normalize(gl_LightSource[0].position.xyz);\n"
+		"		color = min(gl_Color.rgb *\n"
+		"					(gl_LightModel.ambient.rgb * sky +\n"
+		"					 gl_LightSource[0].diffuse.rgb *\n"
+		"					 max(dot(n, l), 0.0)),\n"
+		"					1.0);\n"
+		"	}\n"
+		"}\n";
+	
+	const char* HEIGHT_FRAGMENT_SHADER =
+		"#version 120\n"
+		"varying vec3 color;\n"
+		"void main() {\n"
+		"	gl_FragColor = vec4(color, 1.0);\n"
+		"}\n";
+	
+	const char* HEIGHT_ATTRIBUTES[] = {"unused", NULL};
+	
+	//Returns the number of levels of detail for a chunk with the specified
+	//numbers of grid cells
+	int numLevelsFor(int cellsX, int cellsZ) {
+		int numLevels = 1;
+		while (numLevels < TERRAIN_NUM_LEVELS &&
+			   (1 << (numLevels - 1)) < max(cellsX, cellsZ)) {
+			numLevels++;
+		}
+		return numLevels;
+	}
+	
+	//Returns the positions, relative to a chunk with the specified number of
+	//grid cells, of the rows or columns of samples used at a level of detail
+	vector<int> samplesAt(int level, int numCells) {
+		vector<int> positions;
+		for(int i = 0; i < numCells; i += 1 << level) {
+			positions.push_back(i);
+		}
+		positions.push_back(numCells);
+		return positions;
+	}
+	
+	//Returns the position of the row or column of samples before the last one
+	//used at a level of detail for a chunk with the specified number of grid
+	//cells
+	int samplesBefore(int level, int numCells) {
+		return (numCells - 1) >> level << level;
+	}
+	
+	//Appends a triangle strip to another, joining them with degenerate
+	//triangles
+	void appendStrip(vector<GLushort> &strip, const vector<GLushort> &strip2) {
+		if (!strip.empty()) {
+			strip.push_back(strip.back());
+			strip.push_back(strip2[0]);
+		}
+		strip.insert(strip.end(), strip2.begin(), strip2.end());
+	}
+	
+	/* Returns the height at (u, v) of the two triangles that immediate mode
+	 * strips would use for a grid cell with the specified heights at (0, 0),
+	 * (0, 1), (1, 0), and (1, 1).  The triangles meet along the line from
+	 * (0, 1) to (1, 0).
+	 */
+	float heightInCell(float h00,
+					   float h01,
+					   float h10,
+					   float h11,
+					   float u,
+					   float v) {
+		if (u + v <= 1) {
+			return h00 + u * (h10 - h00) + v * (h01 - h00);
+		}
+		else {
+			return h11 + (1 - u) * (h01 - h11) + (1 - v) * (h10 - h11);
+		}
+	}
+	
+	/* Returns the fraction of the sky visible from the sample at (x, z).  In
+	 * each direction, we find the elevation angle t of the horizon, and the
+	 * terrain hides the part of the sky below it, or sin(t) of the light
+	 * from a sky of uniform brightness.
+	 */
+	float skyVisibility(const Terrain* terrain, int x, int z) {
+		float height = terrain->getHeight(x, z);
+		float hidden = 0;
+		for(int i = 0; i < 8; i++) {
+			int dx = OCCLUSION_DIRECTIONS[i][0];
+			int dz = OCCLUSION_DIRECTIONS[i][1];
+			float stepLength = (dx != 0 && dz != 0) ? sqrtf(2.0f) : 1.0f;
+			float maxSlope = 0;
+			for(int j = 0; j < NUM_OCCLUSION_STEPS; j++) {
+				int x2 = x + dx * OCCLUSION_STEPS[j];
+				int z2 = z + dz * OCCLUSION_STEPS[j];
+				if (x2 < 0 || x2 >= terrain->width() ||
+					z2 < 0 || z2 >= terrain->length()) {
+					break;
+				}
+				float slope = (terrain->getHeight(x2, z2) - height) /
+					(stepLength * OCCLUSION_STEPS[j]);
+				maxSlope = max(maxSlope, slope);
+			}
+			hidden += maxSlope / sqrtf(1 + maxSlope * maxSlope);
+		}
+		return 1 - hidden / 8;
+	}
+}
+
+TerrainDrawer::TerrainDrawer(Terrain* terrain2, bool allowHeightTexture) {
+	terrain = terrain2;
+	useBuffers = glutExtensionSupported("GL_ARB_vertex_buffer_object") != 0;
+	heightTextureId = 0;
+	occlusionTextureId = 0;
+	programId = 0;
+	dummyBufferId = 0;
+	useHeightTexture = allowHeightTexture && initHeightTexture();
+	useLevelsOfDetail = true;
+	maxPixelError = 1.5f;
+	triangleBudget = 0;
+	trianglesDrawn = 0;
+	floatsUploaded = 0;
+	useBakedLighting = false;
+	useAmbientOcclusion = false;
+	ambient = 0;
+	diffuse = 0;
+	
+	//Split the terrain into chunks.  Neighboring chunks share the samples on
+	//the edges between them.
+	chunksPerRow = 0;
+	for(int z = 0; z < terrain->length() - 1; z += TERRAIN_CHUNK_SIZE) {
+		chunksPerRow = 0;
+		for(int x = 0; x < terrain->width() - 1; x += TERRAIN_CHUNK_SIZE) {
+			Chunk chunk;
+			chunk.x = x;
+			chunk.z = z;
+			chunk.cellsX = min(TERRAIN_CHUNK_SIZE, terrain->width() - 1 - x);
+			chunk.cellsZ = min(TERRAIN_CHUNK_SIZE, terrain->length() - 1 - z);
+			chunk.bufferId = 0;
+			chunk.numLevels = numLevelsFor(chunk.cellsX, chunk.cellsZ);
+			chunk.minHeight = 0;
+			chunk.maxHeight = 0;
+			chunk.updateMinZ = 0;
+			chunk.updateMaxZ = -1;
+			chunk.updateSkirt = false;
+			fill(chunk.errors, chunk.errors + TERRAIN_NUM_LEVELS, 0.0f);
+			ChunkIndices* indices = indicesFor(chunk.cellsX, chunk.cellsZ);
+			for(int i = 0; i < TERRAIN_NUM_LEVELS; i++) {
+				chunk.indices[i] = indices + i;
+			}
+			chunks.push_back(chunk);
+			chunksPerRow++;
+		}
+	}
+	
+	//Make room for each chunk's samples, followed by its skirt
+	for(unsigned int i = 0; i < chunks.size() && !useHeightTexture; i++) {
+		Chunk &chunk = chunks[i];
+		int numVertices = (chunk.cellsX + 1) * (chunk.cellsZ + 1) +
+			2 * (chunk.cellsX + 1) + 2 * (chunk.cellsZ + 1);
+		if (useBuffers) {
+			glGenBuffers(1, &chunk.bufferId);
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.bufferId);
+			glBufferData(GL_ARRAY_BUFFER,
+						 numVertices * FLOATS_PER_VERTEX * sizeof(float),
+						 NULL,
+						 GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		else {
+			chunk.vertices.resize(numVertices * FLOATS_PER_VERTEX);
+		}
+	}
+	
+	if (!chunks.empty()) {
+		int chunksPerColumn = (int)chunks.size() / chunksPerRow;
+		addNode(0, 0, chunksPerRow, chunksPerColumn, chunksPerRow);
+	}
+	
+	//Fill in the chunks with the whole terrain
+	int minX, minZ, maxX, maxZ;
+	terrain->takeChangedRegion(minX, minZ, maxX, maxZ);
+	update(0, 0, terrain->width() - 1, terrain->length() - 1);
+	floatsUploaded = 0;
+}
+
+TerrainDrawer::~TerrainDrawer() {
+	for(unsigned int i = 0; i < chunks.size(); i++) {
+		if (chunks[i].bufferId != 0) {
+			glDeleteBuffers(1, &chunks[i].bufferId);
+		}
+	}
+	if (heightTextureId != 0) {
+		glDeleteTextures(1, &heightTextureId);
+	}
+	if (occlusionTextureId != 0) {
+		glDeleteTextures(1, &occlusionTextureId);
+	}
+	if (programId != 0) {
+		glDeleteProgram(programId);
+	}
+	if (dummyBufferId != 0) {
+		glDeleteBuffers(1, &dummyBufferId);
+	}
+	
+	for(map<pair<int, int>, ChunkIndices*>::iterator it = chunkIndices.begin();
+		it != chunkIndices.end(); it++) {
+		for(int i = 0; i < TERRAIN_NUM_LEVELS; i++) {
+			if (it->second[i].bufferId != 0) {
+				glDeleteBuffers(1, &it->second[i].bufferId);
+			}
+		}
+		delete[] it->second;
+	}
+}
+
+bool TerrainDrawer::initHeightTexture() {
+	GLint maxTextureSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	if (!heightTextureSupported() ||
+		terrain->width() > maxTextureSize ||
+		terrain->length() > maxTextureSize) {
+		return false;
+	}
+	
+	programId = loadShaderProgram(HEIGHT_VERTEX_SHADER,
+								  HEIGHT_FRAGMENT_SHADER,
+								  HEIGHT_ATTRIBUTES);
+	if (programId == 0) {
+		return false;
+	}
+	glUseProgram(programId);
+	glUniform1i(glGetUniformLocation(programId, "heights"), 0);
+	glUniform1i(glGetUniformLocation(programId, "occlusion"), 1);
+	glUseProgram(0);
+	originLocation = glGetUniformLocation(programId, "origin");
+	cellsLocation = glGetUniformLocation(programId, "cells");
+	skirtDepthsLocation = glGetUniformLocation(programId, "skirtDepths");
+	
+	glGenTextures(1, &heightTextureId);
+	glBindTexture(GL_TEXTURE_2D, heightTextureId);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D,
+				 0,
+				 GL_LUMINANCE32F_ARB,
+				 terrain->width(), terrain->length(),
+				 0,
+				 GL_LUMINANCE,
+				 GL_FLOAT,
+				 NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	
+	int maxVertices = (TERRAIN_CHUNK_SIZE + 1) * (TERRAIN_CHUNK_SIZE + 5);
+	vector<float> zeros(maxVertices, 0.0f);
+	glGenBuffers(1, &dummyBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, dummyBufferId);
+	glBufferData(GL_ARRAY_BUFFER,
+				 maxVertices * sizeof(float),
+				 &zeros[0],
+				 GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+TerrainDrawer::ChunkIndices* TerrainDrawer::indicesFor(int cellsX,
+													   int cellsZ) {
+	pair<int, int> key(cellsX, cellsZ);
+	map<pair<int, int>, ChunkIndices*>::iterator it = chunkIndices.find(key);
+	if (it != chunkIndices.end()) {
+		return it->second;
+	}
+	
+	/* The vertices are the samples of the chunk, row by row, followed by the
+	 * bottoms of the skirt along the edges at z = 0, z = cellsZ, x = 0, and
+	 * x = cellsX.
+	 */
+	int gridSize = (cellsX + 1) * (cellsZ + 1);
+	int skirtStarts[4] = {gridSize,
+						  gridSize + cellsX + 1,
+						  gridSize + 2 * (cellsX + 1),
+						  gridSize + 2 * (cellsX + 1) + cellsZ + 1};
+	
+	ChunkIndices* indices = new ChunkIndices[TERRAIN_NUM_LEVELS];
+	int numLevels = numLevelsFor(cellsX, cellsZ);
+	for(int level = 0; level < TERRAIN_NUM_LEVELS; level++) {
+		ChunkIndices &levelIndices = indices[level];
+		levelIndices.bufferId = 0;
+		levelIndices.numTriangles = 0;
+		if (level >= numLevels) {
+			continue;
+		}
+		
+		/* Make one triangle strip for each row of grid cells, in the order
+		 * that immediate mode drawing would use, and one for each side of
+		 * the skirt, and join them into a single strip.  Each strip has an
+		 * even number of indices, so every strip starts with the same
+		 * winding.
+		 */
+		vector<int> xs = samplesAt(level, cellsX);
+		vector<int> zs = samplesAt(level, cellsZ);
+		vector<GLushort> &v = levelIndices.indices;
+		for(unsigned int j = 0; j + 1 < zs.size(); j++) {
+			vector<GLushort> row;
+			for(unsigned int i = 0; i < xs.size(); i++) {
+				row.push_back((GLushort)(zs[j] * (cellsX + 1) + xs[i]));
+				row.push_back((GLushort)(zs[j + 1] * (cellsX + 1) + xs[i]));
+			}
+			appendStrip(v, row);
+		}
+		for(int side = 0; side < 4; side++) {
+			vector<GLushort> skirt;
+			const vector<int> &positions = side < 2 ? xs : zs;
+			for(unsigned int i = 0; i < positions.size(); i++) {
+				int p = positions[i];
+				int top;
+				if (side < 2) {
+					top = (side == 0 ? 0 : cellsZ) * (cellsX + 1) + p;
+				}
+				else {
+					top = p * (cellsX + 1) + (side == 2 ? 0 : cellsX);
+				}
+				skirt.push_back((GLushort)top);
+				skirt.push_back((GLushort)(skirtStarts[side] + p));
+			}
+			appendStrip(v, skirt);
+		}
+		
+		for(unsigned int i = 2; i < v.size(); i++) {
+			if (v[i - 2] != v[i - 1] && v[i - 2] != v[i] && v[i - 1] != v[i]) {
+				levelIndices.numTriangles++;
+			}
+		}
+		if (useBuffers) {
+			glGenBuffers(1, &levelIndices.bufferId);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, levelIndices.bufferId);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+						 v.size() * sizeof(GLushort),
+						 &v[0],
+						 GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
+	}
+	chunkIndices[key] = indices;
+	return indices;
+}
+
+void TerrainDrawer::shade(int x, int z, float* out) {
+	Vec3f normal = terrain->getNormal(x, z);
+	if (!useBakedLighting) {
+		out[0] = normal[0];
+		out[1] = normal[1];
+		out[2] = normal[2];
+		return;
+	}
+	
+	//The terrain's normals aren't necessarily unit vectors, which OpenGL's
+	//lighting takes care of with GL_NORMALIZE
+	float light =
+		diffuse * max(normal.normalize().dot(lightDirection), 0.0f);
+	if (useAmbientOcclusion) {
+		light += ambient * skyVisibility(terrain, x, z);
+	}
+	else {
+		light += ambient;
+	}
+	for(int i = 0; i < 3; i++) {
+		out[i] = min(color[i] * light, 1.0f);
+	}
+}
+
+void TerrainDrawer::makeVertices(const Chunk &chunk,
+								 int minZ,
+								 int maxZ,
+								 vector<float> &out) {
+	out.resize((maxZ - minZ + 1) * (chunk.cellsX + 1) * FLOATS_PER_VERTEX);
+	float* v = out.empty() ? NULL : &out[0];
+	for(int z = chunk.z + minZ; z <= chunk.z + maxZ; z++) {
+		for(int x = chunk.x; x <= chunk.x + chunk.cellsX; x++) {
+			shade(x, z, v);
+			v[3] = (float)x;
+			v[4] = terrain->getHeight(x, z);
+			v[5] = (float)z;
+			v += FLOATS_PER_VERTEX;
+		}
+	}
+}
+
+int TerrainDrawer::neighbor(const Chunk &chunk, int side) const {
+	int chunkX = chunk.x / TERRAIN_CHUNK_SIZE;
+	int chunkZ = chunk.z / TERRAIN_CHUNK_SIZE;
+	int chunksPerColumn = (int)chunks.size() / chunksPerRow;
+	switch (side) {
+		case 0:
+			return chunkZ > 0 ? (chunkZ - 1) * chunksPerRow + chunkX : -1;
+		case 1:
+			return chunkZ + 1 < chunksPerColumn ?
+				(chunkZ + 1) * chunksPerRow + chunkX : -1;
+		case 2:
+			return chunkX > 0 ? chunkZ * chunksPerRow + chunkX - 1 : -1;
+		default:
+			return chunkX + 1 < chunksPerRow ?
+				chunkZ * chunksPerRow + chunkX + 1 : -1;
+	}
+}
+
+float TerrainDrawer::skirtDepth(const Chunk &chunk, int side) const {
+	/* Along an edge between two chunks, the chunk drawn with more samples
+	 * uses every sample that the other one uses, so the gap between them is
+	 * at most the error of the other one.  Thus a skirt as deep as the
+	 * greater of the two chunks' largest errors covers the gap.  The edges
+	 * of the terrain have nothing to hide, so their skirts have no depth.
+	 */
+	int other = neighbor(chunk, side);
+	if (other < 0) {
+		return 0;
+	}
+	return max(chunk.errors[TERRAIN_NUM_LEVELS - 1],
+			   chunks[other].errors[TERRAIN_NUM_LEVELS - 1]);
+}
+
+void TerrainDrawer::makeSkirtVertices(const Chunk &chunk, vector<float> &out) {
+	out.clear();
+	for(int side = 0; side < 4; side++) {
+		float depth = skirtDepth(chunk, side);
+		int numCells = side < 2 ? chunk.cellsX : chunk.cellsZ;
+		for(int i = 0; i <= numCells; i++) {
+			int x;
+			int z;
+			if (side < 2) {
+				x = chunk.x + i;
+				z = chunk.z + (side == 0 ? 0 : chunk.cellsZ);
+			}
+			else {
+				x = chunk.x + (side == 2 ? 0 : chunk.cellsX);
+				z = chunk.z + i;
+			}
+			float shading[3];
+			shade(x, z, shading);
+			out.insert(out.end(), shading, shading + 3);
+			out.push_back((float)x);
+			out.push_back(terrain->getHeight(x, z) - depth);
+			out.push_back((float)z);
+		}
+	}
+}
+
+void TerrainDrawer::copyVertices(Chunk &chunk,
+								 int offset,
+								 const float* vertices,
+								 int numFloats) {
+	if (numFloats == 0) {
+		return;
+	}
+	
+	if (chunk.bufferId != 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.bufferId);
+		glBufferSubData(GL_ARRAY_BUFFER,
+						offset * sizeof(float),
+						numFloats * sizeof(float),
+						vertices);
+		floatsUploaded += numFloats;
+	}
+	else {
+		copy(vertices, vertices + numFloats, chunk.vertices.begin() + offset);
+	}
+}
+
+void TerrainDrawer::measureChunk(Chunk &chunk) {
+	chunk.minHeight = terrain->getHeight(chunk.x, chunk.z);
+	chunk.maxHeight = chunk.minHeight;
+	for(int z = chunk.z; z <= chunk.z + chunk.cellsZ; z++) {
+		for(int x = chunk.x; x <= chunk.x + chunk.cellsX; x++) {
+			float h = terrain->getHeight(x, z);
+			chunk.minHeight = min(chunk.minHeight, h);
+			chunk.maxHeight = max(chunk.maxHeight, h);
+		}
+	}
+	
+	//Find how far each sample is from the surface drawn at each level of
+	//detail
+	chunk.errors[0] = 0;
+	for(int level = 1; level < TERRAIN_NUM_LEVELS; level++) {
+		float error = chunk.errors[level - 1];
+		if (level >= chunk.numLevels) {
+			chunk.errors[level] = error;
+			continue;
+		}
+		
+		int step = 1 << level;
+		for(int z = 0; z <= chunk.cellsZ; z++) {
+			int z0 = z < chunk.cellsZ ? z / step * step :
+				samplesBefore(level, chunk.cellsZ);
+			int z1 = min(z0 + step, chunk.cellsZ);
+			for(int x = 0; x <= chunk.cellsX; x++) {
+				int x0 = x < chunk.cellsX ? x / step * step :
+					samplesBefore(level, chunk.cellsX);
+				int x1 = min(x0 + step, chunk.cellsX);
+				float h = heightInCell(
+					terrain->getHeight(chunk.x + x0, chunk.z + z0),
+					terrain->getHeight(chunk.x + x0, chunk.z + z1),
+					terrain->getHeight(chunk.x + x1, chunk.z + z0),
+					terrain->getHeight(chunk.x + x1, chunk.z + z1),
+					x1 > x0 ? (float)(x - x0) / (x1 - x0) : 0,
+					z1 > z0 ? (float)(z - z0) / (z1 - z0) : 0);
+				error = max(error,
+							fabs(h - terrain->getHeight(chunk.x + x,
+														chunk.z + z)));
+			}
+		}
+		chunk.errors[level] = error;
+	}
+}
+
+int TerrainDrawer::addNode(int minChunkX,
+						   int minChunkZ,
+						   int maxChunkX,
+						   int maxChunkZ,
+						   int chunksPerRow) {
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+	Node &node = nodes.back();
+	for(int i = 0; i < 4; i++) {
+		node.children[i] = -1;
+	}
+	node.chunk = -1;
+	
+	if (maxChunkX - minChunkX == 1 && maxChunkZ - minChunkZ == 1) {
+		nodes[index].chunk = minChunkZ * chunksPerRow + minChunkX;
+	}
+	else {
+		//Split the chunks into up to four groups
+		int middleX = (minChunkX + maxChunkX + 1) / 2;
+		int middleZ = (minChunkZ + maxChunkZ + 1) / 2;
+		int xs[3] = {minChunkX, middleX, maxChunkX};
+		int zs[3] = {minChunkZ, middleZ, maxChunkZ};
+		for(int i = 0; i < 4; i++) {
+			int x = i % 2;
+			int z = i / 2;
+			if (xs[x] < xs[x + 1] && zs[z] < zs[z + 1]) {
+				int child = addNode(xs[x], zs[z], xs[x + 1], zs[z + 1],
+									chunksPerRow);
+				nodes[index].children[i] = child;
+			}
+		}
+	}
+	
+	updateBoxes(index);
+	return index;
+}
+
+void TerrainDrawer::updateBoxes(int index) {
+	Node &node = nodes[index];
+	if (node.chunk >= 0) {
+		const Chunk &chunk = chunks[node.chunk];
+		node.minCorner = Vec3f((float)chunk.x,
+							   chunk.minHeight,
+							   (float)chunk.z);
+		node.maxCorner = Vec3f((float)(chunk.x + chunk.cellsX),
+							   chunk.maxHeight,
+							   (float)(chunk.z + chunk.cellsZ));
+		return;
+	}
+	
+	bool first = true;
+	for(int i = 0; i < 4; i++) {
+		int child = node.children[i];
+		if (child < 0) {
+			continue;
+		}
+		
+		updateBoxes(child);
+		Node &childNode = nodes[child];
+		for(int j = 0; j < 3; j++) {
+			if (first || childNode.minCorner[j] < node.minCorner[j]) {
+				node.minCorner[j] = childNode.minCorner[j];
+			}
+			if (first || childNode.maxCorner[j] > node.maxCorner[j]) {
+				node.maxCorner[j] = childNode.maxCorner[j];
+			}
+		}
+		first = false;
+	}
+}
+
+void TerrainDrawer::update(int minX, int minZ, int maxX, int maxZ) {
+	//Measure the chunks that include the change, on the threads
+	vector<int> measured;
+	vector<bool> changed(chunks.size(), false);
+	for(unsigned int i = 0; i < chunks.size(); i++) {
+		const Chunk &chunk = chunks[i];
+		if (chunk.x <= maxX && chunk.x + chunk.cellsX >= minX &&
+			chunk.z <= maxZ && chunk.z + chunk.cellsZ >= minZ) {
+			measured.push_back(i);
+			changed[i] = true;
+		}
+	}
+	defaultThreadPool()->parallelFor((int)measured.size(), [&](int begin,
+															   int end) {
+		for(int i = begin; i < end; i++) {
+			measureChunk(chunks[measured[i]]);
+		}
+	});
+	
+	//The ambient occlusion of the samples around the change depends on it
+	int reach = useBakedLighting && useAmbientOcclusion ? OCCLUSION_REACH : 0;
+	if (useHeightTexture) {
+		updateTexture(heightTextureId, false, minX, minZ, maxX, maxZ);
+		if (occlusionTextureId != 0) {
+			updateTexture(occlusionTextureId,
+						  true,
+						  minX - reach,
+						  minZ - reach,
+						  maxX + reach,
+						  maxZ + reach);
+		}
+	}
+	else {
+		updateVertices(minX - reach,
+					   minZ - reach,
+					   maxX + reach,
+					   maxZ + reach,
+					   changed);
+	}
+	
+	if (!nodes.empty()) {
+		updateBoxes(0);
+	}
+}
+
+void TerrainDrawer::updateVertices(int minX,
+								   int minZ,
+								   int maxX,
+								   int maxZ,
+								   const vector<bool> &measured) {
+	/* Find the rows of each chunk whose vertices changed, which are next to
+	 * each other in its buffer.  The skirts depend on those vertices and on
+	 * the errors of the chunks on both sides of them.
+	 */
+	vector<int> updated;
+	for(unsigned int i = 0; i < chunks.size(); i++) {
+		Chunk &chunk = chunks[i];
+		bool rowsChanged =
+			chunk.x <= maxX && chunk.x + chunk.cellsX >= minX &&
+			chunk.z <= maxZ && chunk.z + chunk.cellsZ >= minZ;
+		bool skirtChanged = rowsChanged || measured[i];
+		for(int side = 0; side < 4; side++) {
+			int other = neighbor(chunk, side);
+			if (other >= 0 && measured[other]) {
+				skirtChanged = true;
+			}
+		}
+		if (!skirtChanged) {
+			continue;
+		}
+		
+		chunk.updateMinZ = rowsChanged ? max(minZ - chunk.z, 0) : 0;
+		chunk.updateMaxZ =
+			rowsChanged ? min(maxZ - chunk.z, chunk.cellsZ) : -1;
+		chunk.updateSkirt = skirtChanged;
+		updated.push_back(i);
+	}
+	
+	//Make the new vertices on the threads, a batch of chunks at a time, and
+	//copy them to the chunks
+	for(unsigned int start = 0; start < updated.size();
+		start += UPDATE_BATCH_SIZE) {
+		int batchSize = min((int)updated.size() - (int)start,
+							UPDATE_BATCH_SIZE);
+		defaultThreadPool()->parallelFor(batchSize, [&](int begin, int end) {
+			vector<float> skirtVertices;
+			for(int i = begin; i < end; i++) {
+				Chunk &chunk = chunks[updated[start + i]];
+				makeVertices(chunk,
+							 chunk.updateMinZ,
+							 chunk.updateMaxZ,
+							 chunk.newVertices);
+				if (chunk.updateSkirt) {
+					makeSkirtVertices(chunk, skirtVertices);
+					chunk.newVertices.insert(chunk.newVertices.end(),
+											 skirtVertices.begin(),
+											 skirtVertices.end());
+				}
+			}
+		});
+		
+		for(int i = 0; i < batchSize; i++) {
+			Chunk &chunk = chunks[updated[start + i]];
+			int rowFloats = (chunk.cellsX + 1) * FLOATS_PER_VERTEX;
+			int numRowFloats =
+				(chunk.updateMaxZ - chunk.updateMinZ + 1) * rowFloats;
+			const float* vertices =
+				chunk.newVertices.empty() ? NULL : &chunk.newVertices[0];
+			copyVertices(chunk,
+						 chunk.updateMinZ * rowFloats,
+						 vertices,
+						 numRowFloats);
+			copyVertices(chunk,
+						 (chunk.cellsZ + 1) * rowFloats,
+						 vertices + numRowFloats,
+						 (int)chunk.newVertices.size() - numRowFloats);
+			vector<float>().swap(chunk.newVertices);
+		}
+	}
+	if (useBuffers) {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+void TerrainDrawer::updateTexture(GLuint textureId,
+								  bool occlusion,
+								  int minX,
+								  int minZ,
+								  int maxX,
+								  int maxZ) {
+	minX = max(minX, 0);
+	minZ = max(minZ, 0);
+	maxX = min(maxX, terrain->width() - 1);
+	maxZ = min(maxZ, terrain->length() - 1);
+	if (minX > maxX || minZ > maxZ) {
+		return;
+	}
+	
+	//Copy a band of rows at a time, which we fill in on the threads
+	int width = maxX - minX + 1;
+	int bandRows = max(TEXTURE_BAND_SAMPLES / width, 1);
+	vector<float> heights;
+	vector<GLubyte> visibilities;
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for(int startZ = minZ; startZ <= maxZ; startZ += bandRows) {
+		int numRows = min(bandRows, maxZ - startZ + 1);
+		if (occlusion) {
+			visibilities.resize(numRows * width);
+		}
+		else {
+			heights.resize(numRows * width);
+		}
+		defaultThreadPool()->parallelFor(numRows, [&](int begin, int end) {
+			for(int i = begin; i < end; i++) {
+				int z = startZ + i;
+				for(int x = minX; x <= maxX; x++) {
+					int index = i * width + x - minX;
+					if (occlusion) {
+						visibilities[index] = (GLubyte)(
+							255 * skyVisibility(terrain, x, z) + 0.5f);
+					}
+					else {
+						heights[index] = terrain->getHeight(x, z);
+					}
+				}
+			}
+		});
+		
+		glTexSubImage2D(GL_TEXTURE_2D,
+						0,
+						minX, startZ,
+						width, numRows,
+						GL_LUMINANCE,
+						occlusion ? GL_UNSIGNED_BYTE : GL_FLOAT,
+						occlusion ? (const GLvoid*)&visibilities[0] :
+							(const GLvoid*)&heights[0]);
+		//Count every four bytes of occlusion as a float
+		floatsUploaded += occlusion ? (numRows * width + 3) / 4 :
+			numRows * width;
+	}
+	glPopClientAttrib();
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TerrainDrawer::chooseChunks() {
+	drawnChunks.clear();
+	drawnLevels.clear();
+	if (nodes.empty()) {
+		return;
+	}
+	
+	GLfloat projection[16];
+	GLfloat modelview[16];
+	GLint viewport[4];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	Frustum frustum;
+	frustum.setMatrices(projection, modelview);
+	
+	/* Find the position of the camera in the terrain's coordinates.  The
+	 * modelview matrix takes a point p to Ap + t, where A is its upper left
+	 * 3 x 3 part and t is its last column, so the camera is at -A^-1 t,
+	 * which we compute using the cofactors of A.
+	 */
+	const GLfloat* m = modelview;
+	float cofactors[9] = {
+		m[5] * m[10] - m[6] * m[9],
+		m[2] * m[9] - m[1] * m[10],
+		m[1] * m[6] - m[2] * m[5],
+		m[6] * m[8] - m[4] * m[10],
+		m[0] * m[10] - m[2] * m[8],
+		m[2] * m[4] - m[0] * m[6],
+		m[4] * m[9] - m[5] * m[8],
+		m[1] * m[8] - m[0] * m[9],
+		m[0] * m[5] - m[1] * m[4]
+	};
+	float determinant =
+		m[0] * cofactors[0] + m[4] * cofactors[1] + m[8] * cofactors[2];
+	Vec3f eye;
+	for(int i = 0; i < 3; i++) {
+		eye[i] = -(cofactors[i] * m[12] +
+				   cofactors[3 + i] * m[13] +
+				   cofactors[6 + i] * m[14]) / determinant;
+	}
+	
+	//The height in pixels of an object of height 1 at a distance of 1
+	float screenScale = viewport[3] / 2.0f * projection[5];
+	
+	//Find the visible chunks, skipping the nodes outside the frustum
+	vector<float> distances;
+	vector<int> stack;
+	stack.push_back(0);
+	while (!stack.empty()) {
+		const Node &node = nodes[stack.back()];
+		stack.pop_back();
+		if (!frustum.boxVisible(node.minCorner, node.maxCorner)) {
+			continue;
+		}
+		
+		if (node.chunk < 0) {
+			for(int i = 0; i < 4; i++) {
+				if (node.children[i] >= 0) {
+					stack.push_back(node.children[i]);
+				}
+			}
+			continue;
+		}
+		
+		Vec3f nearest;
+		for(int i = 0; i < 3; i++) {
+			nearest[i] =
+				max(node.minCorner[i], min(node.maxCorner[i], eye[i]));
+		}
+		distances.push_back(max((nearest - eye).magnitude(), 0.001f));
+		drawnChunks.push_back(node.chunk);
+	}
+	
+	//Use the fewest samples that keep the errors small enough on the screen
+	int numTriangles = 0;
+	for(unsigned int i = 0; i < drawnChunks.size(); i++) {
+		const Chunk &chunk = chunks[drawnChunks[i]];
+		int level = 0;
+		if (useLevelsOfDetail) {
+			while (level + 1 < chunk.numLevels &&
+				   chunk.errors[level + 1] * screenScale <=
+				   maxPixelError * distances[i]) {
+				level++;
+			}
+		}
+		drawnLevels.push_back(level);
+		numTriangles += chunk.indices[level]->numTriangles;
+	}
+	if (!useLevelsOfDetail || triangleBudget <= 0 ||
+		numTriangles <= triangleBudget) {
+		return;
+	}
+	
+	//Until we are within the budget, use fewer samples for the chunk whose
+	//error would look smallest with fewer samples
+	priority_queue< pair<float, int>,
+					vector< pair<float, int> >,
+					greater< pair<float, int> > > coarser;
+	for(unsigned int i = 0; i < drawnChunks.size(); i++) {
+		const Chunk &chunk = chunks[drawnChunks[i]];
+		int level = drawnLevels[i];
+		if (level + 1 < chunk.numLevels) {
+			coarser.push(make_pair(chunk.errors[level + 1] / distances[i],
+								   (int)i));
+		}
+	}
+	while (numTriangles > triangleBudget && !coarser.empty()) {
+		int i = coarser.top().second;
+		coarser.pop();
+		const Chunk &chunk = chunks[drawnChunks[i]];
+		int level = drawnLevels[i];
+		numTriangles += chunk.indices[level + 1]->numTriangles -
+			chunk.indices[level]->numTriangles;
+		level++;
+		drawnLevels[i] = level;
+		if (level + 1 < chunk.numLevels) {
+			coarser.push(make_pair(chunk.errors[level + 1] / distances[i],
+								   i));
+		}
+	}
+}
+
+void TerrainDrawer::draw() {
+	int minX, minZ, maxX, maxZ;
+	if (terrain->takeChangedRegion(minX, minZ, maxX, maxZ)) {
+		update(minX, minZ, maxX, maxZ);
+	}
+	chooseChunks();
+	if (useHeightTexture) {
+		drawFromHeightTexture();
+		return;
+	}
+	
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	if (useBakedLighting) {
+		//Drawing from a color array leaves the current color undefined
+		glPushAttrib(GL_CURRENT_BIT);
+		glEnableClientState(GL_COLOR_ARRAY);
+	}
+	else {
+		glEnableClientState(GL_NORMAL_ARRAY);
+	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	trianglesDrawn = 0;
+	for(unsigned int i = 0; i < drawnChunks.size(); i++) {
+		Chunk &chunk = chunks[drawnChunks[i]];
+		ChunkIndices* indices = chunk.indices[drawnLevels[i]];
+		//The normals or colors, and the positions, which follow them in
+		//each vertex
+		const GLvoid* shading;
+		const GLvoid* positions;
+		const GLushort* indexPointer;
+		if (chunk.bufferId != 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.bufferId);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices->bufferId);
+			shading = (const GLvoid*)0;
+			positions = (const GLvoid*)(3 * sizeof(float));
+			indexPointer = NULL;
+		}
+		else {
+			shading = &chunk.vertices[0];
+			positions = &chunk.vertices[3];
+			indexPointer = &indices->indices[0];
+		}
+		if (useBakedLighting) {
+			glColorPointer(3,
+						   GL_FLOAT,
+						   FLOATS_PER_VERTEX * sizeof(float),
+						   shading);
+		}
+		else {
+			glNormalPointer(GL_FLOAT,
+							FLOATS_PER_VERTEX * sizeof(float),
+							shading);
+		}
+		glVertexPointer(3, GL_FLOAT, FLOATS_PER_VERTEX * sizeof(float),
+						positions);
+		glDrawElements(GL_TRIANGLE_STRIP,
+					   (GLsizei)indices->indices.size(),
+					   GL_UNSIGNED_SHORT,
+					   indexPointer);
+		trianglesDrawn += indices->numTriangles;
+	}
+	if (useBuffers) {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	if (useBakedLighting) {
+		glPopAttrib();
+	}
+	glPopClientAttrib();
+}
+
+void TerrainDrawer::drawFromHeightTexture() {
+	glUseProgram(programId);
+	glUniform1i(glGetUniformLocation(programId, "baked"), useBakedLighting);
+	glUniform1i(glGetUniformLocation(programId, "useOcclusion"),
+				occlusionTextureId != 0);
+	glUniform3f(glGetUniformLocation(programId, "lightDirection"),
+				lightDirection[0], lightDirection[1], lightDirection[2]);
+	glUniform3f(glGetUniformLocation(programId, "bakedColor"),
+				color[0], color[1], color[2]);
+	glUniform1f(glGetUniformLocation(programId, "ambient"), ambient);
+	glUniform1f(glGetUniformLocation(programId, "diffuse"), diffuse);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, occlusionTextureId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, heightTextureId);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, dummyBufferId);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, 0);
+	trianglesDrawn = 0;
+	for(unsigned int i = 0; i < drawnChunks.size(); i++) {
+		const Chunk &chunk = chunks[drawnChunks[i]];
+		ChunkIndices* indices = chunk.indices[drawnLevels[i]];
+		glUniform2i(originLocation, chunk.x, chunk.z);
+		glUniform2i(cellsLocation, chunk.cellsX, chunk.cellsZ);
+		glUniform4f(skirtDepthsLocation,
+					skirtDepth(chunk, 0),
+					skirtDepth(chunk, 1),
+					skirtDepth(chunk, 2),
+					skirtDepth(chunk, 3));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices->bufferId);
+		glDrawElements(GL_TRIANGLE_STRIP,
+					   (GLsizei)indices->indices.size(),
+					   GL_UNSIGNED_SHORT,
+					   NULL);
+		trianglesDrawn += indices->numTriangles;
+	}
+	glDisableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
+
+void TerrainDrawer::makeOcclusionTexture(bool make) {
+	make = make && useHeightTexture;
+	if (!make && occlusionTextureId != 0) {
+		glDeleteTextures(1, &occlusionTextureId);
+		occlusionTextureId = 0;
+	}
+	else if (make && occlusionTextureId == 0) {
+		glGenTextures(1, &occlusionTextureId);
+		glBindTexture(GL_TEXTURE_2D, occlusionTextureId);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D,
+					 0,
+					 GL_LUMINANCE8,
+					 terrain->width(), terrain->length(),
+					 0,
+					 GL_LUMINANCE,
+					 GL_UNSIGNED_BYTE,
+					 NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+void TerrainDrawer::setLevelsOfDetail(bool useLevelsOfDetail2) {
+	useLevelsOfDetail = useLevelsOfDetail2;
+}
+
+bool TerrainDrawer::levelsOfDetail() const {
+	return useLevelsOfDetail;
+}
+
+void TerrainDrawer::setMaxPixelError(float maxPixelError2) {
+	maxPixelError = maxPixelError2;
+}
+
+void TerrainDrawer::setTriangleBudget(int triangleBudget2) {
+	triangleBudget = triangleBudget2;
+}
+
+void TerrainDrawer::setBakedLighting(Vec3f lightDirection2,
+									 Vec3f color2,
+									 float ambient2,
+									 float diffuse2,
+									 bool ambientOcclusion) {
+	useBakedLighting = true;
+	useAmbientOcclusion = ambientOcclusion;
+	lightDirection = lightDirection2.normalize();
+	color = color2;
+	ambient = ambient2;
+	diffuse = diffuse2;
+	makeOcclusionTexture(ambientOcclusion);
+	
+	//Rebake the whole terrain, which covers any changes to it
+	int minX, minZ, maxX, maxZ;
+	terrain->takeChangedRegion(minX, minZ, maxX, maxZ);
+	update(0, 0, terrain->width() - 1, terrain->length() - 1);
+}
+
+void TerrainDrawer::clearBakedLighting() {
+	if (!useBakedLighting) {
+		return;
+	}
+	
+	useBakedLighting = false;
+	makeOcclusionTexture(false);
+	int minX, minZ, maxX, maxZ;
+	terrain->takeChangedRegion(minX, minZ, maxX, maxZ);
+	update(0, 0, terrain->width() - 1, terrain->length() - 1);
+}
+
+bool TerrainDrawer::bakedLighting() const {
+	return useBakedLighting;
+}
+
+bool TerrainDrawer::ambientOcclusion() const {
+	return useAmbientOcclusion;
+}
+
+bool TerrainDrawer::heightTextureSupported() {
+	if (!shadersSupported() ||
+		!glutExtensionSupported("GL_EXT_gpu_shader4") ||
+		!glutExtensionSupported("GL_ARB_texture_float") ||
+		!glutExtensionSupported("GL_ARB_vertex_buffer_object")) {
+		return false;
+	}
+	
+	GLint numVertexTextureUnits;
+	glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &numVertexTextureUnits);
+	return numVertexTextureUnits >= 2;
+}
+
+bool TerrainDrawer::heightTexture() const {
+	return useHeightTexture;
+}
+
+long long TerrainDrawer::memorySize() const {
+	long long numSamples = (long long)terrain->width() * terrain->length();
+	if (useHeightTexture) {
+		return numSamples * sizeof(float) +
+			(occlusionTextureId != 0 ? numSamples : 0);
+	}
+	
+	long long size = 0;
+	for(unsigned int i = 0; i < chunks.size(); i++) {
+		const Chunk &chunk = chunks[i];
+		int numVertices = (chunk.cellsX + 1) * (chunk.cellsZ + 1) +
+			2 * (chunk.cellsX + 1) + 2 * (chunk.cellsZ + 1);
+		size += numVertices * FLOATS_PER_VERTEX * sizeof(float);
+	}
+	return size;
+}
+
+int TerrainDrawer::numChunks() const {
+	return (int)chunks.size();
+}
+
+int TerrainDrawer::numChunksDrawn() const {
+	return (int)drawnChunks.size();
+}
+
+int TerrainDrawer::numTrianglesDrawn() const {
+	return trianglesDrawn;
+}
+
+long long TerrainDrawer::floatsUploadedSinceReset() const {
+	return floatsUploaded;
+}
+
+void TerrainDrawer::resetStats() {
+	floatsUploaded = 0;
+}
+
+
+
+
+
+
+
+
+
+
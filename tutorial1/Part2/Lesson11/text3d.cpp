@@ -90,16 +90,28 @@
  * of the model, counterclockwise order is relative to the front face.
  */
 
+#ifndef __APPLE__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
 #include <fstream>
+#include <list>
+#include <map>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
 
 #ifdef __APPLE__
 #include <OpenGL/OpenGL.h>
+#include <OpenGL/glext.h>
 #include <GLUT/glut.h>
 #else
 #include <GL/glut.h>
 #endif
 
+#include "glstate.h"
+#include "mappedfile.h"
 #include "text3d.h"
 
 using namespace std;
@@ -217,201 +229,335 @@ namespace {
 	
 	const float PI_TIMES_2_OVER_65536 = 2 * 3.1415926535f / 65536.0f;
 	
+	//The number of floats per vertex in the character and string meshes: a
+	//normal followed by a position, as in GL_N3F_V3F
+	const int FLOATS_PER_VERTEX = 6;
+	//The maximum number of laid-out strings whose meshes are kept around
+	const int MAX_CACHED_STRINGS = 64;
+	
+	//Adds the triangle abc, each of which is FLOATS_PER_VERTEX floats, to the
+	//end of mesh.  If reversed is true, the triangle's winding order is
+	//reversed.
+	void addTriangle(vector<float> &mesh,
+					 const float* a, const float* b, const float* c,
+					 bool reversed) {
+		if (reversed) {
+			const float* temp = a;
+			a = b;
+			b = temp;
+		}
+		mesh.insert(mesh.end(), a, a + FLOATS_PER_VERTEX);
+		mesh.insert(mesh.end(), b, b + FLOATS_PER_VERTEX);
+		mesh.insert(mesh.end(), c, c + FLOATS_PER_VERTEX);
+	}
+	
+	//Adds the triangles of a GL_TRIANGLES or GL_TRIANGLE_STRIP primitive with
+	//the specified vertices to the end of mesh
+	void addPrimitive(vector<float> &mesh,
+					  const vector<float> &vertices,
+					  bool isStrip,
+					  bool reversed) {
+		int numVertices = (int)vertices.size() / FLOATS_PER_VERTEX;
+		const float* v = numVertices > 0 ? &vertices[0] : NULL;
+		if (isStrip) {
+			for(int i = 2; i < numVertices; i++) {
+				const float* a = v + (i - 2) * FLOATS_PER_VERTEX;
+				const float* b = v + (i - 1) * FLOATS_PER_VERTEX;
+				const float* c = v + i * FLOATS_PER_VERTEX;
+				//Every other triangle in a strip has its first two vertices
+				//swapped, so that they all have the same winding order
+				addTriangle(mesh, a, b, c, reversed != (i % 2 == 1));
+			}
+		}
+		else {
+			for(int i = 0; i + 2 < numVertices; i += 3) {
+				addTriangle(mesh,
+							v + i * FLOATS_PER_VERTEX,
+							v + (i + 1) * FLOATS_PER_VERTEX,
+							v + (i + 2) * FLOATS_PER_VERTEX,
+							reversed);
+			}
+		}
+	}
+	
+	//Returns a pointer to the next n bytes of the font file, which run from
+	//pos to end, and moves pos past them
+	const char* take(const char* &pos, const char* end, int n) {
+		if (end - pos < n) {
+			throw T3DLoadException("Invalid font file");
+		}
+		const char* bytes = pos;
+		pos += n;
+		return bytes;
+	}
+	
+	/* Reads one part of a character model from the font file, which runs from
+	 * pos to end, and adds its triangles to the end of mesh.  If mesh is NULL,
+	 * the part is only checked and skipped.  verts has the numVerts 2D
+	 * vertices of the character.  Each vertex's z coordinate is multiplied by
+	 * zScale, which is 1 or -1, and then added to zOffset; the z coordinates of
+	 * the normals are multiplied by zScale as well.  If reversed is true, the
+	 * triangles' winding orders are reversed.  The back face vertices and
+	 * normals are only available if is3D is true.
+	 */
+	void readPart(const char* &pos, const char* end,
+				  const float* verts, int numVerts,
+				  bool is3D,
+				  float zScale, float zOffset,
+				  bool reversed,
+				  vector<float>* mesh) {
+		unsigned short opcode = toUShort(take(pos, end, 2));
+		if (opcode != OP_TRIANGLES && opcode != OP_TRIANGLE_STRIP) {
+			throw T3DLoadException("Invalid font file");
+		}
+		bool isStrip = opcode == OP_TRIANGLE_STRIP;
+		
+		float normal[3] = {0, 0, zScale};
+		vector<float> vertices;
+		
+		//Prevents excessive iteration or infinite loops on invalid font files
+		int limit = 10000;
+		
+		while(true) {
+			opcode = toUShort(take(pos, end, 2));
+			if (opcode == OP_END_PART) {
+				break;
+			}
+			
+			switch(opcode) {
+				case OP_TRIANGLES:
+				case OP_TRIANGLE_STRIP:
+					if (mesh != NULL) {
+						addPrimitive(*mesh, vertices, isStrip, reversed);
+						vertices.clear();
+					}
+					isStrip = opcode == OP_TRIANGLE_STRIP;
+					break;
+				case OP_NORMAL:
+					if (!is3D) {
+						throw T3DLoadException("Invalid font file");
+					}
+					float angle;
+					angle = toUShort(take(pos, end, 2)) * PI_TIMES_2_OVER_65536;
+					normal[0] = cos(angle);
+					normal[1] = sin(angle);
+					normal[2] = 0;
+					break;
+				default:
+					if (opcode >= (is3D ? 2 * numVerts : numVerts)) {
+						throw T3DLoadException("Invalid font file");
+					}
+					if (mesh == NULL) {
+						break;
+					}
+					
+					float z;
+					if (opcode < numVerts) {
+						z = 0;
+					}
+					else {
+						opcode -= numVerts;
+						z = -1;
+					}
+					vertices.insert(vertices.end(), normal, normal + 3);
+					vertices.push_back(verts[2 * opcode]);
+					vertices.push_back(verts[2 * opcode + 1]);
+					vertices.push_back(zScale * z + zOffset);
+					break;
+			}
+			
+			if (--limit == 0) {
+				throw T3DLoadException("Invalid font file");
+			}
+		}
+		
+		if (mesh != NULL) {
+			addPrimitive(*mesh, vertices, isStrip, reversed);
+		}
+	}
+	
+	/* The layout of the file "charset.cache", which holds the triangles of the
+	 * characters so that they don't have to be rebuilt from "charset" each
+	 * time the program starts:
+	 * 
+	 * CacheHeader
+	 * for each character: float[FLOATS_PER_VERTEX * numVertices2D] for the 2D
+	 *     part, then float[FLOATS_PER_VERTEX * numVertices3D] for the 3D part
+	 * 
+	 * The cache is only used if the size and modification time of "charset"
+	 * match the ones in its header.
+	 */
+	const char CACHE_MAGIC[8] = {'T', '3', 'D', 'C', 'A', 'C', 'H', 'E'};
+	const int CACHE_VERSION = 1;
+	const int BYTE_ORDER_MARK = 0x01020304;
+	//The largest number of vertices in one part of a character, given the
+	//limit on the number of opcodes in readPart
+	const int MAX_PART_VERTICES = 3 * 10000;
+	
+	struct CacheHeader {
+		char magic[8];
+		int version;
+		int byteOrderMark;
+		//The size and modification time of the font file, to detect whether
+		//the cache is out of date
+		long long sourceSize;
+		long long sourceModificationTime;
+		float spaceWidth;
+		float widths[94];
+		int numVertices2D[94];
+		int numVertices3D[94];
+	};
+	
 	class T3DFont {
 		private:
 			float spaceWidth;
 			float widths[94];
-			GLuint displayListId2D;
-			GLuint displayListId3D;
-		public:
-			//Loads the specified font file into a new T3DFont object
-			T3DFont(ifstream &input) {
-				char buffer[8];
-				input.read(buffer, 8);
-				if (input.fail()) {
-					throw T3DLoadException("Invalid font file");
-				}
+			//The font file, or NULL if the font was loaded from a cache
+			MappedFile* file;
+			//The cache file, or NULL if the font was loaded from "charset"
+			MappedFile* cacheFile;
+			//Where each character's vertices start in the font file, and how
+			//many there are
+			const char* charVerts[94];
+			unsigned short charNumVerts[94];
+			//The scale for each character's vertices
+			float charScales[94];
+			//The triangles for each character, with FLOATS_PER_VERTEX floats
+			//per vertex.  They point into the cache file, or into
+			//built2D and built3D once the characters are first used.
+			const float* meshes2D[94];
+			const float* meshes3D[94];
+			int numVertices2D[94];
+			int numVertices3D[94];
+			bool isBuilt[94];
+			vector<float> built2D[94];
+			vector<float> built3D[94];
+			
+			T3DFont() : file(NULL), cacheFile(NULL) {
+				
+			}
+			
+			//Reads the character data of the font file, checking that it is
+			//valid, without building the characters' triangles
+			void readIndex() {
+				const char* pos = file->data();
+				const char* end = pos + file->size();
 				
 				const char header[9] = "VTR\0FNT\0";
-				for(int i = 0; i < 8; i++) {
-					if (buffer[i] != header[i]) {
-						throw T3DLoadException("Invalid font file");
-					}
+				if (memcmp(take(pos, end, 8), header, 8) != 0) {
+					throw T3DLoadException("Invalid font file");
 				}
 				
-				input.read(buffer, 5);
-				spaceWidth = toFloat(buffer);
+				spaceWidth = toFloat(take(pos, end, 5));
 				
-				displayListId2D = glGenLists(94);
-				displayListId3D = glGenLists(94);
 				for(int i = 0; i < 94; i++) {
-					input.read(buffer, 5);
-					float scale = toFloat(buffer) / 65536;
-					input.read(buffer, 2);
-					float width = scale * toUShort(buffer);
-					input.read(buffer, 2);
-					float height = scale * toUShort(buffer);
-					scale /= height;
+					float scale = toFloat(take(pos, end, 5)) / 65536;
+					float width = scale * toUShort(take(pos, end, 2));
+					float height = scale * toUShort(take(pos, end, 2));
+					charScales[i] = scale / height;
 					widths[i] = width / height;
-					input.read(buffer, 2);
-					unsigned short numVerts = toUShort(buffer);
-					auto_array<float> verts(new float[2 * numVerts]);
-					float* verts2 = verts.get();
-					for(int j = 0; j < numVerts; j++) {
-						input.read(buffer, 2);
-						verts2[2 * j] = scale * ((int)toUShort(buffer) - 32768);
-						input.read(buffer, 2);
-						verts2[2 * j + 1] =
-							scale * ((int)toUShort(buffer) - 32768);
-					}
-					
-					//Face part of the model
-					glNewList(displayListId2D + i, GL_COMPILE);
-					
-					glNormal3f(0, 0, 1);
-					
-					input.read(buffer, 2);
-					unsigned short opcode = toUShort(buffer);
-					switch(opcode) {
-						case OP_TRIANGLES:
-							glBegin(GL_TRIANGLES);
-							break;
-						case OP_TRIANGLE_STRIP:
-							glBegin(GL_TRIANGLE_STRIP);
-							break;
-						default:
-							throw T3DLoadException("Invalid font file");
-					}
-					
-					//Prevents excessive iteration or infinite loops on invalid
-					//font files
-					int limit = 10000;
+					unsigned short numVerts = toUShort(take(pos, end, 2));
+					charNumVerts[i] = numVerts;
+					charVerts[i] = take(pos, end, 4 * numVerts);
 					
-					while(true) {
-						input.read(buffer, 2);
-						opcode = toUShort(buffer);
-						switch(opcode) {
-							case OP_TRIANGLES:
-								glEnd();
-								glBegin(GL_TRIANGLES);
-								break;
-							case OP_TRIANGLE_STRIP:
-								glEnd();
-								glBegin(GL_TRIANGLE_STRIP);
-								break;
-							case OP_END_PART:
-								goto BreakOuter;
-							default:
-								glVertex3f(verts2[2 * opcode],
-										   verts2[2 * opcode + 1],
-										   0);
-								break;
-						}
-						
-						if (--limit == 0) {
-							glEndList();
-							throw T3DLoadException("Invalid font file");
-						}
-					}
-BreakOuter:
-					glEnd();
-					glEndList();
-					
-					//3D part of the model
-					glNewList(displayListId3D + i, GL_COMPILE);
-					glPushMatrix();
-					glTranslatef(0, 0, 0.5f);
-					glFrontFace(GL_CW);
-					glCallList(displayListId2D + i);
-					glTranslatef(0, 0, -1);
-					glScalef(1, 1, -1);
-					glFrontFace(GL_CCW);
-					glCallList(displayListId2D + i);
-					glFrontFace(GL_CW);
-					
-					input.read(buffer, 2);
-					opcode = toUShort(buffer);
-					switch(opcode) {
-						case OP_TRIANGLES:
-							glBegin(GL_TRIANGLES);
-							break;
-						case OP_TRIANGLE_STRIP:
-							glBegin(GL_TRIANGLE_STRIP);
-							break;
-						default:
-							throw T3DLoadException("Invalid font file");
-					}
-					
-					limit = 10000;
-					while(true) {
-						input.read(buffer, 2);
-						opcode = toUShort(buffer);
-						switch(opcode) {
-							case OP_TRIANGLES:
-								glEnd();
-								glBegin(GL_TRIANGLES);
-								break;
-							case OP_TRIANGLE_STRIP:
-								glEnd();
-								glBegin(GL_TRIANGLE_STRIP);
-								break;
-							case OP_NORMAL:
-								input.read(buffer, 2);
-								float angle;
-								angle = toUShort(buffer) *
-									PI_TIMES_2_OVER_65536;
-								float x, y;
-								x = cos(angle);
-								y = sin(angle);
-								glNormal3f(x, y, 0);
-								break;
-							case OP_END_PART:
-								goto BreakOuter2;
-							default:
-								if (opcode < numVerts) {
-									glVertex3f(verts2[2 * opcode],
-											   verts2[2 * opcode + 1],
-											   0);
-								}
-								else {
-									glVertex3f(verts2[2 * (opcode - numVerts)],
-											   verts2[2 * (opcode - numVerts) +
-													  1],
-											   -1);
-								}
-								break;
-						}
-						
-						if (--limit == 0) {
-							glEndList();
-							throw T3DLoadException("Invalid font file");
-						}
-					}
-BreakOuter2:
-					glEnd();
-					glPopMatrix();
-					glEndList();
+					readPart(pos, end, NULL, numVerts, false, 1, 0, false,
+							 NULL);
+					readPart(pos, end, NULL, numVerts, true, -1, -0.5f, true,
+							 NULL);
+					isBuilt[i] = false;
 				}
 				
-				if (input.fail()) {
-					throw T3DLoadException("Invalid font file");
-				}
-				input.read(buffer, 1);
-				if (!input.eof()) {
+				if (pos != end) {
 					throw T3DLoadException("Invalid font file");
 				}
 			}
 			
-			void draw2D(char c) {
-				if (c >= 33 && c <= 126) {
-					glCallList(displayListId2D + c - '!');
+			//Builds the triangles for the specified character from the font
+			//file
+			void build(int i) {
+				unsigned short numVerts = charNumVerts[i];
+				float scale = charScales[i];
+				auto_array<float> verts(new float[2 * numVerts]);
+				float* verts2 = verts.get();
+				const char* pos = charVerts[i];
+				for(int j = 0; j < numVerts; j++) {
+					verts2[2 * j] = scale * ((int)toUShort(pos) - 32768);
+					verts2[2 * j + 1] =
+						scale * ((int)toUShort(pos + 2) - 32768);
+					pos += 4;
 				}
+				//readIndex already checked the parts
+				const char* end = file->data() + file->size();
+				
+				//Face part of the model
+				vector<float> &mesh2D = built2D[i];
+				readPart(pos, end, verts2, numVerts, false, 1, 0, false,
+						 &mesh2D);
+				
+				//3D part of the model.  The front face is the face part moved
+				//to z = 0.5 and the back face is the face part mirrored to
+				//z = -0.5.  The front face and the sides are wound clockwise in
+				//the file, so we reverse them to make all of the triangles
+				//counterclockwise.
+				vector<float> &mesh3D = built3D[i];
+				for(int j = 0; j < 2; j++) {
+					for(int k = 0; k < (int)mesh2D.size();
+						k += 3 * FLOATS_PER_VERTEX) {
+						float triangle[3 * FLOATS_PER_VERTEX];
+						for(int l = 0; l < 3; l++) {
+							float* v = triangle + l * FLOATS_PER_VERTEX;
+							const float* source =
+								&mesh2D[k + l * FLOATS_PER_VERTEX];
+							for(int m = 0; m < FLOATS_PER_VERTEX; m++) {
+								v[m] = source[m];
+							}
+							v[2] = j == 0 ? 1 : -1;
+							v[5] = j == 0 ? 0.5f : -0.5f;
+						}
+						addTriangle(mesh3D,
+									triangle,
+									triangle + FLOATS_PER_VERTEX,
+									triangle + 2 * FLOATS_PER_VERTEX,
+									j == 0);
+					}
+				}
+				readPart(pos, end, verts2, numVerts, true, -1, -0.5f, true,
+						 &mesh3D);
+				
+				meshes2D[i] = mesh2D.empty() ? NULL : &mesh2D[0];
+				meshes3D[i] = mesh3D.empty() ? NULL : &mesh3D[0];
+				numVertices2D[i] = (int)mesh2D.size() / FLOATS_PER_VERTEX;
+				numVertices3D[i] = (int)mesh3D.size() / FLOATS_PER_VERTEX;
+				isBuilt[i] = true;
+			}
+		public:
+			~T3DFont() {
+				delete file;
+				delete cacheFile;
 			}
 			
-			void draw3D(char c) {
-				if (c >= 33 && c <= 126) {
-					glCallList(displayListId3D + c - '!');
+			//Returns whether the font was loaded from a cache file
+			bool isFromCache() {
+				return cacheFile != NULL;
+			}
+			
+			/* Returns the triangles for the specified character, with
+			 * FLOATS_PER_VERTEX floats per vertex, and sets numVertices to
+			 * the number of vertices.  Returns NULL if the character is drawn
+			 * as a space.
+			 */
+			const float* mesh(char c, bool is3D, int &numVertices) {
+				numVertices = 0;
+				if (c < 33 || c > 126) {
+					return NULL;
+				}
+				
+				int i = c - 33;
+				if (!isBuilt[i]) {
+					build(i);
 				}
+				numVertices = is3D ? numVertices3D[i] : numVertices2D[i];
+				return is3D ? meshes3D[i] : meshes2D[i];
 			}
 			
 			float width(char c) {
@@ -422,134 +568,484 @@ BreakOuter2:
 					return spaceWidth;
 				}
 			}
+			
+			//Writes all of the characters' triangles to the specified cache
+			//file, so that the next program to use the font can load it
+			//quickly
+			void writeCache(const char* filename, const char* cacheFilename) {
+				CacheHeader header;
+				memset(&header, 0, sizeof(header));
+				memcpy(header.magic, CACHE_MAGIC, 8);
+				header.version = CACHE_VERSION;
+				header.byteOrderMark = BYTE_ORDER_MARK;
+				size_t sourceSize;
+				if (sizeof(header) % 4 != 0 ||
+					!fileStats(filename,
+							   sourceSize,
+							   header.sourceModificationTime)) {
+					return;
+				}
+				header.sourceSize = (long long)sourceSize;
+				header.spaceWidth = spaceWidth;
+				for(int i = 0; i < 94; i++) {
+					if (!isBuilt[i]) {
+						build(i);
+					}
+					header.widths[i] = widths[i];
+					header.numVertices2D[i] = numVertices2D[i];
+					header.numVertices3D[i] = numVertices3D[i];
+				}
+				
+				ofstream output;
+				output.open(cacheFilename, ios_base::binary | ios_base::trunc);
+				output.write((const char*)&header, sizeof(header));
+				for(int i = 0; i < 94; i++) {
+					output.write((const char*)meshes2D[i],
+								 numVertices2D[i] * FLOATS_PER_VERTEX *
+									sizeof(float));
+					output.write((const char*)meshes3D[i],
+								 numVertices3D[i] * FLOATS_PER_VERTEX *
+									sizeof(float));
+				}
+				output.close();
+				
+				if (output.fail()) {
+					//Don't leave a partial cache behind
+					remove(cacheFilename);
+				}
+			}
+			
+			//Loads the specified font file, or throws a T3DLoadException if
+			//it's invalid.  The characters' triangles are built when they are
+			//first used.
+			static T3DFont* load(const char* filename) {
+				MappedFile* file = MappedFile::open(filename);
+				if (file == NULL) {
+					throw T3DLoadException("Could not open font file");
+				}
+				
+				T3DFont* font = new T3DFont();
+				font->file = file;
+				try {
+					font->readIndex();
+				}
+				catch (...) {
+					delete font;
+					throw;
+				}
+				return font;
+			}
+			
+			//Loads the font from the specified cache file.  Returns NULL if
+			//the cache file doesn't exist or is invalid or out of date.
+			static T3DFont* loadCache(const char* filename,
+									  const char* cacheFilename) {
+				size_t sourceSize;
+				long long sourceModificationTime;
+				if (sizeof(CacheHeader) % 4 != 0 ||
+					!fileStats(filename, sourceSize, sourceModificationTime)) {
+					return NULL;
+				}
+				
+				MappedFile* cacheFile = MappedFile::open(cacheFilename);
+				if (cacheFile == NULL) {
+					return NULL;
+				}
+				
+				//Check that the cache is for this font file and that its
+				//counts match its size
+				const CacheHeader* header =
+					(const CacheHeader*)cacheFile->data();
+				bool isValid = cacheFile->size() >= sizeof(CacheHeader) &&
+					memcmp(header->magic, CACHE_MAGIC, 8) == 0 &&
+					header->version == CACHE_VERSION &&
+					header->byteOrderMark == BYTE_ORDER_MARK &&
+					header->sourceSize == (long long)sourceSize &&
+					header->sourceModificationTime == sourceModificationTime;
+				size_t size = sizeof(CacheHeader);
+				for(int i = 0; isValid && i < 94; i++) {
+					if (header->numVertices2D[i] < 0 ||
+						header->numVertices2D[i] > MAX_PART_VERTICES ||
+						header->numVertices3D[i] < 0 ||
+						header->numVertices3D[i] > 3 * MAX_PART_VERTICES) {
+						isValid = false;
+					}
+					size += (header->numVertices2D[i] +
+							 header->numVertices3D[i]) *
+						FLOATS_PER_VERTEX * sizeof(float);
+				}
+				if (!isValid || cacheFile->size() != size) {
+					delete cacheFile;
+					return NULL;
+				}
+				
+				//Use the triangles in place
+				T3DFont* font = new T3DFont();
+				font->cacheFile = cacheFile;
+				font->spaceWidth = header->spaceWidth;
+				const float* data =
+					(const float*)(cacheFile->data() + sizeof(CacheHeader));
+				for(int i = 0; i < 94; i++) {
+					font->widths[i] = header->widths[i];
+					font->numVertices2D[i] = header->numVertices2D[i];
+					font->numVertices3D[i] = header->numVertices3D[i];
+					font->meshes2D[i] = data;
+					data += header->numVertices2D[i] * FLOATS_PER_VERTEX;
+					font->meshes3D[i] = data;
+					data += header->numVertices3D[i] * FLOATS_PER_VERTEX;
+					font->isBuilt[i] = true;
+				}
+				return font;
+			}
 	};
 	
 	T3DFont* font = NULL; //The font used to draw 2D and 3D characters
 	
-	void draw2D(char c) {
-		font->draw2D(c);
-	}
+	//Identifies a laid-out string
+	struct StringKey {
+		string str;
+		int hAlign;
+		int vAlign;
+		float lineHeight;
+		bool is3D;
+		float depth; //Always 0 for 2D strings
+		
+		//Returns whether the two keys give the same triangles for each
+		//character, relative to the start of the character's line
+		bool sameCharMeshes(const StringKey &key) const {
+			return is3D == key.is3D && depth == key.depth;
+		}
+		
+		bool operator<(const StringKey &key) const {
+			if (str != key.str) {
+				return str < key.str;
+			}
+			else if (hAlign != key.hAlign) {
+				return hAlign < key.hAlign;
+			}
+			else if (vAlign != key.vAlign) {
+				return vAlign < key.vAlign;
+			}
+			else if (lineHeight != key.lineHeight) {
+				return lineHeight < key.lineHeight;
+			}
+			else if (is3D != key.is3D) {
+				return is3D < key.is3D;
+			}
+			else {
+				return depth < key.depth;
+			}
+		}
+	};
 	
-	void draw3D(char c) {
-		font->draw3D(c);
-	}
+	//The triangles for a laid-out string
+	struct StringMesh {
+		StringKey key;
+		//FLOATS_PER_VERTEX floats per vertex.  The positions are relative to
+		//the start of each vertex's line.
+		vector<float> vertices;
+		//The number of vertices for the characters up to and including each
+		//character in the string
+		vector<int> charEnds;
+		//The position of the start of each line, and the number of vertices
+		//for the lines up to and including each line
+		vector<float> lineXs;
+		vector<float> lineYs;
+		vector<int> lineEnds;
+		GLuint bufferId; //The vertex buffer, or 0 if buffers aren't used
+		int bufferSize; //The number of floats the vertex buffer can hold
+	};
+	
+	//The cached string meshes, from the most to the least recently drawn
+	list<StringMesh*> stringMeshes;
+	map<StringKey, list<StringMesh*>::iterator> stringMeshIndices;
+	//1 if vertex buffers are used for the string meshes, 0 if not, and -1 if
+	//we haven't checked yet
+	int useBuffers = -1;
 	
-	void drawLine(const char* str, int hAlign, void (*drawFunc)(char)) {
-		glPushMatrix();
-		if (hAlign >= 0) {
-			float width = 0;
-			for(int i = 0; str[i] != '\n' && str[i] != '\0'; i++) {
-				width += font->width(str[i]);
+	/* Computes the center of each character in the specified string, relative
+	 * to the start of its line, and the position of the start of each line, as
+	 * laid out by t3dDraw2D and t3dDraw3D.  The characters' positions don't
+	 * depend on the alignment or the line height.
+	 */
+	void layOut(const string &str,
+				int hAlign, int vAlign,
+				float lineHeight,
+				vector<float> &charXs,
+				vector<float> &lineXs, vector<float> &lineYs) {
+		//Measure each line once
+		charXs.resize(str.size());
+		vector<float> lineWidths;
+		float width = 0;
+		for(int i = 0; i < (int)str.size(); i++) {
+			if (str[i] == '\n') {
+				charXs[i] = width;
+				lineWidths.push_back(width);
+				width = 0;
+			}
+			else {
+				float charWidth = font->width(str[i]);
+				charXs[i] = width + charWidth / 2;
+				width += charWidth;
 			}
-			glTranslatef(hAlign > 0 ? -width : -width / 2, 0, 0);
 		}
+		lineWidths.push_back(width);
 		
-		for(int i = 0; str[i] != '\n' && str[i] != '\0'; i++) {
-			float width = font->width(str[i]);
-			glTranslatef(width / 2, 0, 0);
-			drawFunc(str[i]);
-			glTranslatef(width / 2, 0, 0);
+		float y = -0.5f;
+		if (vAlign >= 0) {
+			float height = lineHeight * (lineWidths.size() - 1) + 1;
+			y += vAlign > 0 ? height : height / 2;
 		}
 		
-		glPopMatrix();
+		lineXs.resize(lineWidths.size());
+		lineYs.resize(lineWidths.size());
+		for(int i = 0; i < (int)lineWidths.size(); i++) {
+			lineXs[i] = 0;
+			if (hAlign >= 0) {
+				lineXs[i] = hAlign > 0 ? -lineWidths[i] : -lineWidths[i] / 2;
+			}
+			lineYs[i] = y;
+			y -= lineHeight;
+		}
 	}
 	
-	void draw(const char* str,
-			  int hAlign, int vAlign,
-			  float lineHeight,
-			  void (*drawFunc)(char)) {
-		GLint shadeModel;
-		glGetIntegerv(GL_SHADE_MODEL, &shadeModel);
-		glShadeModel(GL_SMOOTH);
-		GLboolean lightsEnabled;
-		glGetBooleanv(GL_LIGHTING, &lightsEnabled);
-		GLboolean normalsWereNormalized;
-		glGetBooleanv(GL_NORMALIZE, &normalsWereNormalized);
-		if (lightsEnabled) {
-			glEnable(GL_NORMALIZE);
-		}
-		else {
-			glDisable(GL_NORMALIZE);
+	/* Lays out the string for the specified key into mesh.  If mesh was
+	 * previously used for a string that starts with the same characters, only
+	 * the characters after those are rebuilt and sent to the vertex buffer.
+	 * Because each line is moved into place when it is drawn, this works
+	 * even if the alignment moves the line, as with a centered counter.
+	 */
+	void buildStringMesh(StringMesh* mesh, const StringKey &key) {
+		vector<float> xs;
+		layOut(key.str, key.hAlign, key.vAlign, key.lineHeight,
+			   xs, mesh->lineXs, mesh->lineYs);
+		
+		int numKept = 0;
+		if (mesh->key.sameCharMeshes(key)) {
+			const string &oldStr = mesh->key.str;
+			while (numKept < (int)oldStr.size() &&
+				   numKept < (int)key.str.size() &&
+				   oldStr[numKept] == key.str[numKept]) {
+				numKept++;
+			}
 		}
 		
-		glPushMatrix();
-		if (vAlign >= 0) {
-			int numLines = 1;
-			for(int i = 0; str[i] != '\0'; i++) {
-				if (str[i] == '\n') {
-					numLines++;
+		int numKeptFloats =
+			numKept > 0 ? mesh->charEnds[numKept - 1] * FLOATS_PER_VERTEX : 0;
+		vector<float> &vertices = mesh->vertices;
+		vertices.resize(numKeptFloats);
+		mesh->charEnds.resize(numKept);
+		
+		//The z scale for the normals, which is the inverse of the scale for the
+		//positions
+		float normalZScale = key.depth != 0 ? 1 / key.depth : 1;
+		for(int i = numKept; i < (int)key.str.size(); i++) {
+			int numCharVertices;
+			const float* charMesh =
+				font->mesh(key.str[i], key.is3D, numCharVertices);
+			for(int j = 0; j < numCharVertices; j++) {
+				const float* v = charMesh + j * FLOATS_PER_VERTEX;
+				if (key.is3D) {
+					float nz = v[2] * normalZScale;
+					float length = sqrt(v[0] * v[0] + v[1] * v[1] + nz * nz);
+					vertices.push_back(v[0] / length);
+					vertices.push_back(v[1] / length);
+					vertices.push_back(nz / length);
 				}
+				else {
+					vertices.insert(vertices.end(), v, v + 3);
+				}
+				vertices.push_back(v[3] + xs[i]);
+				vertices.push_back(v[4]);
+				vertices.push_back(v[5] * key.depth);
 			}
-			
-			float height = lineHeight * (numLines - 1) + 1;
-			glTranslatef(0, vAlign > 0 ? height : height / 2, 0);
+			mesh->charEnds.push_back((int)vertices.size() / FLOATS_PER_VERTEX);
 		}
 		
-		glTranslatef(0, -0.5f, 0);
-		drawLine(str, hAlign, drawFunc);
-		for(int i = 0; str[i] != '\0'; i++) {
-			if (str[i] == '\n') {
-				glTranslatef(0, -lineHeight, 0);
-				drawLine(str + i + 1, hAlign, drawFunc);
+		mesh->lineEnds.clear();
+		for(int i = 0; i < (int)key.str.size(); i++) {
+			if (key.str[i] == '\n') {
+				mesh->lineEnds.push_back(mesh->charEnds[i]);
 			}
 		}
+		mesh->lineEnds.push_back((int)vertices.size() / FLOATS_PER_VERTEX);
+		mesh->key = key;
 		
-		glPopMatrix();
+		if (mesh->bufferId != 0 && !vertices.empty()) {
+			glBindBuffer(GL_ARRAY_BUFFER, mesh->bufferId);
+			if ((int)vertices.size() > mesh->bufferSize) {
+				glBufferData(GL_ARRAY_BUFFER,
+							 vertices.size() * sizeof(float),
+							 &vertices[0],
+							 GL_DYNAMIC_DRAW);
+				mesh->bufferSize = (int)vertices.size();
+			}
+			else if ((int)vertices.size() > numKeptFloats) {
+				glBufferSubData(GL_ARRAY_BUFFER,
+								numKeptFloats * sizeof(float),
+								(vertices.size() - numKeptFloats) *
+									sizeof(float),
+								&vertices[numKeptFloats]);
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	}
+	
+	//Returns the mesh for the specified laid-out string, building it if it
+	//isn't cached
+	StringMesh* stringMesh(const StringKey &key) {
+		map<StringKey, list<StringMesh*>::iterator>::iterator it =
+			stringMeshIndices.find(key);
+		if (it != stringMeshIndices.end()) {
+			//Move the mesh to the front of the list
+			stringMeshes.splice(stringMeshes.begin(), stringMeshes, it->second);
+			return *(it->second);
+		}
 		
-		glShadeModel(shadeModel);
-		if (normalsWereNormalized) {
-			glEnable(GL_NORMALIZE);
+		if (useBuffers < 0) {
+			useBuffers =
+				glutExtensionSupported("GL_ARB_vertex_buffer_object") ? 1 : 0;
+		}
+		
+		//Recycle the least recently drawn mesh if the cache is full.  This is
+		//usually an older version of a string that keeps changing, like a
+		//counter, so most of its characters can be kept.
+		StringMesh* mesh;
+		if ((int)stringMeshes.size() < MAX_CACHED_STRINGS) {
+			mesh = new StringMesh();
+			mesh->key.hAlign = 0;
+			mesh->key.vAlign = 0;
+			mesh->key.lineHeight = 0;
+			mesh->key.is3D = false;
+			mesh->key.depth = 0;
+			mesh->bufferId = 0;
+			mesh->bufferSize = 0;
+			if (useBuffers) {
+				glGenBuffers(1, &mesh->bufferId);
+			}
 		}
 		else {
-			glDisable(GL_NORMALIZE);
+			mesh = stringMeshes.back();
+			stringMeshIndices.erase(mesh->key);
+			stringMeshes.pop_back();
 		}
+		
+		buildStringMesh(mesh, key);
+		stringMeshes.push_front(mesh);
+		stringMeshIndices[key] = stringMeshes.begin();
+		return mesh;
+	}
+	
+	void draw(const string &str,
+			  int hAlign, int vAlign,
+			  float lineHeight,
+			  bool is3D, float depth) {
+		StringKey key;
+		key.str = str;
+		key.hAlign = hAlign;
+		key.vAlign = vAlign;
+		key.lineHeight = lineHeight;
+		key.is3D = is3D;
+		key.depth = is3D ? depth : 0;
+		StringMesh* mesh = stringMesh(key);
+		if (mesh->vertices.empty()) {
+			return;
+		}
+		
+		GLenum shadeModel = glsGetShadeModel();
+		glsShadeModel(GL_SMOOTH);
+		bool normalsWereNormalized = glsIsEnabled(GL_NORMALIZE);
+		glsSetEnabled(GL_NORMALIZE, glsIsEnabled(GL_LIGHTING));
+		
+		//Draw each line with one call, moving it into place
+		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+		const GLvoid* normals;
+		const GLvoid* positions;
+		if (mesh->bufferId != 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, mesh->bufferId);
+			normals = (const GLvoid*)0;
+			positions = (const GLvoid*)(3 * sizeof(float));
+		}
+		else {
+			normals = &mesh->vertices[0];
+			positions = &mesh->vertices[3];
+		}
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glNormalPointer(GL_FLOAT, FLOATS_PER_VERTEX * sizeof(float), normals);
+		glVertexPointer(3, GL_FLOAT, FLOATS_PER_VERTEX * sizeof(float),
+						positions);
+		int firstVertex = 0;
+		for(int i = 0; i < (int)mesh->lineEnds.size(); i++) {
+			if (mesh->lineEnds[i] > firstVertex) {
+				glPushMatrix();
+				glTranslatef(mesh->lineXs[i], mesh->lineYs[i], 0);
+				glDrawArrays(GL_TRIANGLES,
+							 firstVertex,
+							 mesh->lineEnds[i] - firstVertex);
+				glPopMatrix();
+			}
+			firstVertex = mesh->lineEnds[i];
+		}
+		if (mesh->bufferId != 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		glPopClientAttrib();
+		
+		glsShadeModel(shadeModel);
+		glsSetEnabled(GL_NORMALIZE, normalsWereNormalized);
 	}
 }
 
 void t3dInit() {
 	if (font == NULL) {
-		ifstream input;
-		input.open("charset", istream::binary);
-		font = new T3DFont(input);
-		input.close();
+		font = T3DFont::loadCache("charset", "charset.cache");
+		if (font == NULL) {
+			font = T3DFont::load("charset");
+		}
 	}
 }
 
 void t3dCleanup() {
+	for(list<StringMesh*>::iterator it = stringMeshes.begin();
+		it != stringMeshes.end(); it++) {
+		if ((*it)->bufferId != 0) {
+			glDeleteBuffers(1, &(*it)->bufferId);
+		}
+		delete *it;
+	}
+	stringMeshes.clear();
+	stringMeshIndices.clear();
+	
+	if (font != NULL && !font->isFromCache()) {
+		font->writeCache("charset", "charset.cache");
+	}
 	delete font;
+	font = NULL;
 }
 
 void t3dDraw2D(string str, int hAlign, int vAlign, float lineHeight) {
-	GLboolean wasCulling;
-	glGetBooleanv(GL_CULL_FACE, &wasCulling);
-	glDisable(GL_CULL_FACE);
+	bool wasCulling = glsIsEnabled(GL_CULL_FACE);
+	glsDisable(GL_CULL_FACE);
 	
-	draw(str.c_str(), hAlign, vAlign, lineHeight, draw2D);
+	draw(str, hAlign, vAlign, lineHeight, false, 0);
 	
-	if (wasCulling) {
-		glEnable(GL_CULL_FACE);
-	}
+	glsSetEnabled(GL_CULL_FACE, wasCulling);
 }
 
 void t3dDraw3D(string str,
 			   int hAlign, int vAlign,
 			   float depth,
 			   float lineHeight) {
-	GLboolean wasCulling;
-	glGetBooleanv(GL_CULL_FACE, &wasCulling);
-	glEnable(GL_CULL_FACE);
-	GLint frontFace;
-	glGetIntegerv(GL_FRONT_FACE, &frontFace);
+	bool wasCulling = glsIsEnabled(GL_CULL_FACE);
+	glsEnable(GL_CULL_FACE);
+	GLenum frontFace = glsGetFrontFace();
+	glsFrontFace(GL_CCW);
 	
-	glPushMatrix();
-	glScalef(1, 1, depth);
-	draw(str.c_str(), hAlign, vAlign, lineHeight, draw3D);
-	glPopMatrix();
+	draw(str, hAlign, vAlign, lineHeight, true, depth);
 	
-	if (!wasCulling) {
-		glDisable(GL_CULL_FACE);
-	}
-	glFrontFace(frontFace);
+	glsSetEnabled(GL_CULL_FACE, wasCulling);
+	glsFrontFace(frontFace);
 }
 
 float t3dDrawWidth(string str) {
@@ -582,6 +1078,18 @@ float t3dDrawHeight(string str, float lineHeight) {
 	return (numLines - 1) * lineHeight + 1;
 }
 
+float t3dCharTriangles(char c, vector<float> &vertices) {
+	vertices.clear();
+	int numVertices;
+	const float* mesh = font->mesh(c, false, numVertices);
+	for(int i = 0; i < numVertices; i++) {
+		vertices.push_back(mesh[i * FLOATS_PER_VERTEX + 3]);
+		vertices.push_back(mesh[i * FLOATS_PER_VERTEX + 4]);
+	}
+	return font->width(c);
+}
+
+
 
 
 
@@ -0,0 +1,164 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include "threadpool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int numThreads) : stopping(false) {
+	if (numThreads <= 0) {
+		numThreads = (int)thread::hardware_concurrency();
+		if (numThreads <= 0) {
+			numThreads = 1;
+		}
+	}
+	for(int i = 0; i < numThreads; i++) {
+		workers.push_back(thread(&ThreadPool::work, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		unique_lock<mutex> lock(tasksMutex);
+		stopping = true;
+	}
+	taskAdded.notify_all();
+	for(unsigned int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+void ThreadPool::work() {
+	while (true) {
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(tasksMutex);
+			while (tasks.empty() && !stopping) {
+				taskAdded.wait(lock);
+			}
+			if (tasks.empty()) {
+				return;
+			}
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+bool ThreadPool::runQueuedTask() {
+	function<void()> task;
+	{
+		unique_lock<mutex> lock(tasksMutex);
+		if (tasks.empty()) {
+			return false;
+		}
+		task = tasks.front();
+		tasks.pop_front();
+	}
+	task();
+	return true;
+}
+
+int ThreadPool::numThreads() {
+	return (int)workers.size();
+}
+
+void ThreadPool::submit(const function<void()> &func) {
+	{
+		unique_lock<mutex> lock(tasksMutex);
+		tasks.push_back(func);
+	}
+	taskAdded.notify_one();
+}
+
+void ThreadPool::parallelFor(int count,
+							 const function<void(int, int)> &func,
+							 int minRangeSize) {
+	if (count <= 0) {
+		return;
+	}
+	if (minRangeSize < 1) {
+		minRangeSize = 1;
+	}
+	
+	//Use a few ranges per thread, so that uneven ranges balance out
+	int numRanges = 4 * (numThreads() + 1);
+	if (numRanges > (count + minRangeSize - 1) / minRangeSize) {
+		numRanges = (count + minRangeSize - 1) / minRangeSize;
+	}
+	if (numRanges == 1) {
+		func(0, count);
+		return;
+	}
+	
+	//The number of ranges that have not finished yet
+	int remaining = numRanges;
+	std::mutex doneMutex;
+	condition_variable done;
+	for(int i = 0; i < numRanges; i++) {
+		int begin = (int)((long long)count * i / numRanges);
+		int end = (int)((long long)count * (i + 1) / numRanges);
+		submit([&, begin, end]() {
+			func(begin, end);
+			unique_lock<std::mutex> lock(doneMutex);
+			if (--remaining == 0) {
+				done.notify_all();
+			}
+		});
+	}
+	
+	//Help with the queued tasks rather than sitting idle
+	while (true) {
+		{
+			unique_lock<std::mutex> lock(doneMutex);
+			if (remaining == 0) {
+				return;
+			}
+		}
+		if (!runQueuedTask()) {
+			break;
+		}
+	}
+	
+	unique_lock<std::mutex> lock(doneMutex);
+	while (remaining > 0) {
+		done.wait(lock);
+	}
+}
+
+ThreadPool* defaultThreadPool() {
+	static ThreadPool pool;
+	return &pool;
+}
+
+
+
+
+
+
+
+
+
+
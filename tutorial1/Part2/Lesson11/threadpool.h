@@ -0,0 +1,84 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Putting It All Together" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of worker threads that run tasks from a shared queue
+class ThreadPool {
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()> > tasks;
+		std::mutex tasksMutex;
+		std::condition_variable taskAdded;
+		bool stopping;
+		
+		//The loop run by each worker thread
+		void work();
+		//Runs one queued task on the calling thread.  Returns false if there
+		//were no queued tasks.
+		bool runQueuedTask();
+	public:
+		//Starts numThreads worker threads, or one per hardware thread if
+		//numThreads is 0
+		ThreadPool(int numThreads = 0);
+		//Waits for the queued tasks to finish, then stops the workers
+		~ThreadPool();
+		
+		//Returns the number of worker threads
+		int numThreads();
+		//Queues func to run on a worker thread
+		void submit(const std::function<void()> &func);
+		/* Calls func(begin, end) for disjoint ranges that together cover
+		 * [0, count), in parallel, and returns once all of the calls have
+		 * returned.  Each range has at least minRangeSize elements, except
+		 * possibly the last.  The calling thread helps run the calls, so this
+		 * may be called from a task running on the pool.
+		 */
+		void parallelFor(int count,
+						 const std::function<void(int, int)> &func,
+						 int minRangeSize = 1);
+};
+
+//Returns a pool with one thread per hardware thread, shared by the whole
+//program
+ThreadPool* defaultThreadPool();
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -24,6 +24,7 @@
 
 #include <assert.h>
 #include <fstream>
+#include <math.h>
 
 #include "imageloader.h"
 
@@ -37,6 +38,15 @@ Image::~Image() {
 	delete[] pixels;
 }
 
+GrayImage::GrayImage(unsigned short* ps, int w, int h) :
+	pixels(ps), width(w), height(h) {
+	
+}
+
+GrayImage::~GrayImage() {
+	delete[] pixels;
+}
+
 namespace {
 	//Converts a four-character array to an integer, using little-endian form
 	int toInt(const char* bytes) {
@@ -200,6 +210,106 @@ Image* loadBMP(const char* filename) {
 	return new Image(pixels2.release(), width, height);
 }
 
+GrayImage* loadGrayBMP(const char* filename) {
+	ifstream input;
+	input.open(filename, ifstream::binary);
+	assert(!input.fail() || !"Could not find file");
+	char buffer[2];
+	input.read(buffer, 2);
+	assert(buffer[0] == 'B' && (buffer[1] == 'M' || !"Not a bitmap file"));
+	input.ignore(8);
+	int dataOffset = readInt(input);
+	
+	//Read the header.  The V4 and V5 headers that many programs write for
+	//16-bit bitmaps start with the same fields as the V3 header.
+	int headerSize = readInt(input);
+	int width;
+	int height;
+	int bitsPerPixel;
+	switch(headerSize) {
+		case 40:
+		case 108:
+		case 124:
+			//V3, Windows V4, or Windows V5
+			width = readInt(input);
+			height = readInt(input);
+			input.ignore(2);
+			bitsPerPixel = readShort(input);
+			{
+				//Uncompressed, or with bit masks for the color components,
+				//which we ignore
+				int compression = readInt(input);
+				assert(compression == 0 || compression == 3 ||
+					   !"Image is compressed");
+			}
+			break;
+		case 12:
+			//OS/2 V1
+			width = readShort(input);
+			height = readShort(input);
+			input.ignore(2);
+			bitsPerPixel = readShort(input);
+			break;
+		default:
+			assert(!"Unknown bitmap format");
+	}
+	assert(bitsPerPixel == 16 || bitsPerPixel == 24 ||
+		   !"Image is not 16 or 24 bits per pixel");
+	
+	//Read the data
+	int bytesPerPixel = bitsPerPixel / 8;
+	int bytesPerRow = (width * bytesPerPixel + 3) / 4 * 4;
+	int size = bytesPerRow * height;
+	auto_array<char> pixels(new char[size]);
+	input.seekg(dataOffset, ios_base::beg);
+	input.read(pixels.get(), size);
+	
+	//Get the data into the right format
+	auto_array<unsigned short> pixels2(new unsigned short[width * height]);
+	for(int y = 0; y < height; y++) {
+		for(int x = 0; x < width; x++) {
+			const char* pixel = pixels + (bytesPerRow * y + bytesPerPixel * x);
+			if (bytesPerPixel == 2) {
+				pixels2[width * y + x] = (unsigned short)toShort(pixel);
+			}
+			else {
+				pixels2[width * y + x] =
+					(unsigned short)(257 * (unsigned char)pixel[2]);
+			}
+		}
+	}
+	
+	input.close();
+	return new GrayImage(pixels2.release(), width, height);
+}
+
+GrayImage* loadR16(const char* filename) {
+	ifstream input;
+	input.open(filename, ifstream::binary);
+	assert(!input.fail() || !"Could not find file");
+	input.seekg(0, ios_base::end);
+	long long size = input.tellg();
+	input.seekg(0, ios_base::beg);
+	
+	int width = (int)(sqrt((double)(size / 2)) + 0.5);
+	assert((long long)width * width * 2 == size || !"Image is not square");
+	auto_array<char> data(new char[size]);
+	input.read(data.get(), size);
+	
+	//Flip the rows, so that the image starts at the bottom-left pixel
+	auto_array<unsigned short> pixels(new unsigned short[width * width]);
+	for(int y = 0; y < width; y++) {
+		for(int x = 0; x < width; x++) {
+			const char* pixel = data + 2 * (width * (width - 1 - y) + x);
+			pixels[width * y + x] = (unsigned short)toShort(pixel);
+		}
+	}
+	
+	input.close();
+	return new GrayImage(pixels.release(), width, width);
+}
+
+
 
 
 
@@ -22,8 +22,14 @@
 
 
 
+#include <chrono>
 #include <iostream>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
 
 #ifdef __APPLE__
 #include <OpenGL/OpenGL.h>
@@ -32,185 +38,99 @@
 #include <GL/glut.h>
 #endif
 
-#include "imageloader.h"
+#include "pagedterrain.h"
+#include "terrain.h"
+#include "terraindrawer.h"
+#include "terrainnoise.h"
+#include "terrainraycaster.h"
 #include "vec3f.h"
 
 using namespace std;
 
-//Represents a terrain, by storing a set of heights and normals at 2D locations
-class Terrain {
-	private:
-		int w; //Width
-		int l; //Length
-		float** hs; //Heights
-		Vec3f** normals;
-		bool computedNormals; //Whether normals is up-to-date
-	public:
-		Terrain(int w2, int l2) {
-			w = w2;
-			l = l2;
-			
-			hs = new float*[l];
-			for(int i = 0; i < l; i++) {
-				hs[i] = new float[w];
-			}
-			
-			normals = new Vec3f*[l];
-			for(int i = 0; i < l; i++) {
-				normals[i] = new Vec3f[w];
-			}
-			
-			computedNormals = false;
-		}
-		
-		~Terrain() {
-			for(int i = 0; i < l; i++) {
-				delete[] hs[i];
-			}
-			delete[] hs;
-			
-			for(int i = 0; i < l; i++) {
-				delete[] normals[i];
-			}
-			delete[] normals;
-		}
-		
-		int width() {
-			return w;
-		}
-		
-		int length() {
-			return l;
-		}
-		
-		//Sets the height at (x, z) to y
-		void setHeight(int x, int z, float y) {
-			hs[z][x] = y;
-			computedNormals = false;
-		}
-		
-		//Returns the height at (x, z)
-		float getHeight(int x, int z) {
-			return hs[z][x];
-		}
-		
-		//Computes the normals, if they haven't been computed yet
-		void computeNormals() {
-			if (computedNormals) {
-				return;
-			}
-			
-			//Compute the rough version of the normals
-			Vec3f** normals2 = new Vec3f*[l];
-			for(int i = 0; i < l; i++) {
-				normals2[i] = new Vec3f[w];
-			}
-			
-			for(int z = 0; z < l; z++) {
-				for(int x = 0; x < w; x++) {
-					Vec3f sum(0.0f, 0.0f, 0.0f);
-					
-					Vec3f out;
-					if (z > 0) {
-						out = Vec3f(0.0f, hs[z - 1][x] - hs[z][x], -1.0f);
-					}
-					Vec3f in;
-					if (z < l - 1) {
-						in = Vec3f(0.0f, hs[z + 1][x] - hs[z][x], 1.0f);
-					}
-					Vec3f left;
-					if (x > 0) {
-						left = Vec3f(-1.0f, hs[z][x - 1] - hs[z][x], 0.0f);
-					}
-					Vec3f right;
-					if (x < w - 1) {
-						right = Vec3f(1.0f, hs[z][x + 1] - hs[z][x], 0.0f);
-					}
-					
-					if (x > 0 && z > 0) {
-						sum += out.cross(left).normalize();
-					}
-					if (x > 0 && z < l - 1) {
-						sum += left.cross(in).normalize();
-					}
-					if (x < w - 1 && z < l - 1) {
-						sum += in.cross(right).normalize();
-					}
-					if (x < w - 1 && z > 0) {
-						sum += right.cross(out).normalize();
-					}
-					
-					normals2[z][x] = sum;
-				}
-			}
-			
-			//Smooth out the normals
-			const float FALLOUT_RATIO = 0.5f;
-			for(int z = 0; z < l; z++) {
-				for(int x = 0; x < w; x++) {
-					Vec3f sum = normals2[z][x];
-					
-					if (x > 0) {
-						sum += normals2[z][x - 1] * FALLOUT_RATIO;
-					}
-					if (x < w - 1) {
-						sum += normals2[z][x + 1] * FALLOUT_RATIO;
-					}
-					if (z > 0) {
-						sum += normals2[z - 1][x] * FALLOUT_RATIO;
-					}
-					if (z < l - 1) {
-						sum += normals2[z + 1][x] * FALLOUT_RATIO;
-					}
-					
-					if (sum.magnitude() == 0) {
-						sum = Vec3f(0.0f, 1.0f, 0.0f);
-					}
-					normals[z][x] = sum;
-				}
-			}
-			
-			for(int i = 0; i < l; i++) {
-				delete[] normals2[i];
-			}
-			delete[] normals2;
-			
-			computedNormals = true;
-		}
-		
-		//Returns the normal at (x, z)
-		Vec3f getNormal(int x, int z) {
-			if (!computedNormals) {
-				computeNormals();
-			}
-			return normals[z][x];
-		}
-};
-
-//Loads a terrain from a heightmap.  The heights of the terrain range from
-//-height / 2 to height / 2.
-Terrain* loadTerrain(const char* filename, float height) {
-	Image* image = loadBMP(filename);
-	Terrain* t = new Terrain(image->width, image->height);
-	for(int y = 0; y < image->height; y++) {
-		for(int x = 0; x < image->width; x++) {
-			unsigned char color =
-				(unsigned char)image->pixels[3 * (y * image->width + x)];
-			float h = height * ((color / 255.0f) - 0.5f);
-			t->setHeight(x, y, h);
-		}
-	}
-	
-	delete image;
-	t->computeNormals();
-	return t;
+//Returns a random float from 0 to < 1
+float randomFloat() {
+	return (float)rand() / ((float)RAND_MAX + 1);
 }
 
 float _angle = 60.0f;
-Terrain* _terrain;
+//The color of the terrain and the light shining on it, which stays fixed
+//relative to the terrain
+const GLfloat TERRAIN_COLOR[] = {0.3f, 0.9f, 0.0f};
+const GLfloat AMBIENT_LIGHT = 0.4f;
+const GLfloat DIFFUSE_LIGHT = 0.6f;
+const GLfloat LIGHT_DIRECTION[] = {-0.5f, 0.8f, 0.1f};
+Terrain* _terrain = NULL;
+//The order in which _terrain keeps its heights and normals in memory
+Terrain::Layout _terrainLayout = Terrain::ROW_MAJOR;
+//How _terrain stores its heights and normals
+Terrain::Storage _terrainStorage = Terrain::FLOATS;
+//The heightmap from which we load _terrain
+const char* _heightmapFilename = "heightmap.bmp";
+TerrainDrawer* _terrainDrawer = NULL;
+//Whether _terrainDrawer may keep the heights in a texture rather than keeping
+//positions and normals in vertex buffers
+bool _allowHeightTexture = true;
+TerrainRaycaster* _terrainRaycaster = NULL;
+//The matrices and viewport with which _terrain was last drawn, for picking
+GLdouble _modelviewMatrix[16];
+GLdouble _projectionMatrix[16];
+GLint _viewport[4];
+
+//The most tiles a PagedTerrain keeps in memory at once
+const int MAX_PAGED_TILES = 64;
+//How fast the view moves over a paged terrain, in grid cells per second
+const float PAGED_FOCUS_SPEED = 40;
+//The number of tiles along each side of a generated terrain, which makes it
+//more than a million samples across
+const int PROCEDURAL_TILES = 16384;
+//If we're showing a paged terrain rather than _terrain, the terrain we're
+//showing
+PagedTerrain* _pagedTerrain = NULL;
+//The point on _pagedTerrain at the center of the view
+float _focusX;
+float _focusZ;
+//The direction in which the view is moving over _pagedTerrain
+float _focusDirX = 0.8f;
+float _focusDirZ = 0.6f;
+
+//Bakes the light into the colors of _terrainDrawer, with or without ambient
+//occlusion
+void bakeLighting(bool ambientOcclusion) {
+	_terrainDrawer->setBakedLighting(Vec3f(LIGHT_DIRECTION[0],
+										   LIGHT_DIRECTION[1],
+										   LIGHT_DIRECTION[2]),
+									 Vec3f(TERRAIN_COLOR[0],
+										   TERRAIN_COLOR[1],
+										   TERRAIN_COLOR[2]),
+									 AMBIENT_LIGHT,
+									 DIFFUSE_LIGHT,
+									 ambientOcclusion);
+}
 
 void cleanup() {
+	delete _terrainRaycaster;
+	delete _terrainDrawer;
 	delete _terrain;
+	delete _pagedTerrain;
+}
+
+//Digs a crater of a random size centered at (x, z)
+void digCrater(float x, float z) {
+	float radius = 2 + 3 * randomFloat();
+	makeCrater(_terrain, x, z, radius, radius);
+	
+	//The crater's rim reaches out to less than twice its radius
+	int reach = (int)ceil(2 * radius);
+	_terrainRaycaster->heightsChanged((int)x - reach,
+									  (int)z - reach,
+									  (int)x + reach,
+									  (int)z + reach);
+}
+
+//Digs a crater somewhere on the terrain
+void digCrater() {
+	digCrater(randomFloat() * (_terrain->width() - 1),
+			  randomFloat() * (_terrain->length() - 1));
 }
 
 void handleKeypress(unsigned char key, int x, int y) {
@@ -218,6 +138,60 @@ void handleKeypress(unsigned char key, int x, int y) {
 		case 27: //Escape key
 			cleanup();
 			exit(0);
+		case 'c':
+			if (_terrain != NULL) {
+				digCrater();
+			}
+			break;
+		case 'l':
+			//Switch between using levels of detail and always drawing all of
+			//the terrain's triangles
+			if (_terrainDrawer != NULL) {
+				_terrainDrawer->setLevelsOfDetail(
+					!_terrainDrawer->levelsOfDetail());
+			}
+			break;
+		case 'o':
+			//Cycle between baked lighting with ambient occlusion, baked
+			//lighting, and OpenGL's lighting
+			if (_terrainDrawer != NULL) {
+				if (!_terrainDrawer->bakedLighting()) {
+					bakeLighting(true);
+				}
+				else if (_terrainDrawer->ambientOcclusion()) {
+					bakeLighting(false);
+				}
+				else {
+					_terrainDrawer->clearBakedLighting();
+				}
+			}
+			break;
+	}
+}
+
+//Digs a crater where the ray through the clicked pixel hits the terrain
+void handleMouse(int button, int state, int x, int y) {
+	if (_terrain == NULL || button != GLUT_LEFT_BUTTON || state != GLUT_DOWN) {
+		return;
+	}
+	
+	//Find the points on the near and far planes under the pixel
+	GLdouble winY = _viewport[3] - 1 - y;
+	GLdouble nearPos[3];
+	GLdouble farPos[3];
+	gluUnProject(x, winY, 0, _modelviewMatrix, _projectionMatrix, _viewport,
+				 &nearPos[0], &nearPos[1], &nearPos[2]);
+	gluUnProject(x, winY, 1, _modelviewMatrix, _projectionMatrix, _viewport,
+				 &farPos[0], &farPos[1], &farPos[2]);
+	
+	Vec3f origin(nearPos[0], nearPos[1], nearPos[2]);
+	Vec3f direction(farPos[0] - nearPos[0],
+					farPos[1] - nearPos[1],
+					farPos[2] - nearPos[2]);
+	float distance;
+	if (_terrainRaycaster->castRay(origin, direction, 1, distance)) {
+		Vec3f hit = origin + direction * distance;
+		digCrater(hit[0], hit[2]);
 	}
 }
 
@@ -237,6 +211,49 @@ void handleResize(int w, int h) {
 	gluPerspective(45.0, (double)w / (double)h, 1.0, 200.0);
 }
 
+//Draws the tiles of _pagedTerrain within 1.5 tiles of the focus
+void drawPagedTerrain() {
+	int tileCells = _pagedTerrain->tileCells();
+	int minTileX = max((int)((_focusX - 1.5f * tileCells) / tileCells), 0);
+	int minTileZ = max((int)((_focusZ - 1.5f * tileCells) / tileCells), 0);
+	int maxTileX = min((int)((_focusX + 1.5f * tileCells) / tileCells),
+					   _pagedTerrain->numTilesX() - 1);
+	int maxTileZ = min((int)((_focusZ + 1.5f * tileCells) / tileCells),
+					   _pagedTerrain->numTilesZ() - 1);
+	for(int tileZ = minTileZ; tileZ <= maxTileZ; tileZ++) {
+		for(int tileX = minTileX; tileX <= maxTileX; tileX++) {
+			const float* heights;
+			const Vec3f* normals;
+			_pagedTerrain->getTile(tileX, tileZ, heights, normals);
+			
+			//Don't draw the repeated samples past the edges of the terrain
+			int startX = tileX * tileCells;
+			int startZ = tileZ * tileCells;
+			int cellsX = min(tileCells, _pagedTerrain->width() - 1 - startX);
+			int cellsZ = min(tileCells, _pagedTerrain->length() - 1 - startZ);
+			
+			//Position each tile relative to the focus, so that the
+			//vertices stay precise far from the origin of a large terrain
+			glPushMatrix();
+			glTranslatef((float)startX - _focusX,
+						 0.0f,
+						 (float)startZ - _focusZ);
+			for(int z = 0; z < cellsZ; z++) {
+				glBegin(GL_TRIANGLE_STRIP);
+				for(int x = 0; x <= cellsX; x++) {
+					for(int z2 = z; z2 <= z + 1; z2++) {
+						int i = z2 * (tileCells + 1) + x;
+						glNormal3f(normals[i][0], normals[i][1], normals[i][2]);
+						glVertex3f(x, heights[i], z2);
+					}
+				}
+				glEnd();
+			}
+			glPopMatrix();
+		}
+	}
+}
+
 void drawScene() {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	
@@ -246,49 +263,634 @@ void drawScene() {
 	glRotatef(30.0f, 1.0f, 0.0f, 0.0f);
 	glRotatef(-_angle, 0.0f, 1.0f, 0.0f);
 	
-	GLfloat ambientColor[] = {0.4f, 0.4f, 0.4f, 1.0f};
+	GLfloat ambientColor[] =
+		{AMBIENT_LIGHT, AMBIENT_LIGHT, AMBIENT_LIGHT, 1.0f};
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientColor);
 	
-	GLfloat lightColor0[] = {0.6f, 0.6f, 0.6f, 1.0f};
-	GLfloat lightPos0[] = {-0.5f, 0.8f, 0.1f, 0.0f};
+	GLfloat lightColor0[] = {DIFFUSE_LIGHT, DIFFUSE_LIGHT, DIFFUSE_LIGHT, 1.0f};
+	GLfloat lightPos0[] = {LIGHT_DIRECTION[0],
+						   LIGHT_DIRECTION[1],
+						   LIGHT_DIRECTION[2],
+						   0.0f};
 	glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor0);
 	glLightfv(GL_LIGHT0, GL_POSITION, lightPos0);
 	
-	float scale = 5.0f / max(_terrain->width() - 1, _terrain->length() - 1);
-	glScalef(scale, scale, scale);
-	glTranslatef(-(float)(_terrain->width() - 1) / 2,
-				 0.0f,
-				 -(float)(_terrain->length() - 1) / 2);
-	
-	glColor3f(0.3f, 0.9f, 0.0f);
-	for(int z = 0; z < _terrain->length() - 1; z++) {
-		//Makes OpenGL draw a triangle at every three consecutive vertices
-		glBegin(GL_TRIANGLE_STRIP);
-		for(int x = 0; x < _terrain->width(); x++) {
-			Vec3f normal = _terrain->getNormal(x, z);
-			glNormal3f(normal[0], normal[1], normal[2]);
-			glVertex3f(x, _terrain->getHeight(x, z), z);
-			normal = _terrain->getNormal(x, z + 1);
-			glNormal3f(normal[0], normal[1], normal[2]);
-			glVertex3f(x, _terrain->getHeight(x, z + 1), z + 1);
+	glColor3fv(TERRAIN_COLOR);
+	if (_pagedTerrain != NULL) {
+		float scale = 5.0f / (3 * _pagedTerrain->tileCells());
+		glScalef(scale, scale, scale);
+		drawPagedTerrain();
+	}
+	else {
+		float scale =
+			5.0f / max(_terrain->width() - 1, _terrain->length() - 1);
+		glScalef(scale, scale, scale);
+		glTranslatef(-(float)(_terrain->width() - 1) / 2,
+					 0.0f,
+					 -(float)(_terrain->length() - 1) / 2);
+		glGetDoublev(GL_MODELVIEW_MATRIX, _modelviewMatrix);
+		glGetDoublev(GL_PROJECTION_MATRIX, _projectionMatrix);
+		glGetIntegerv(GL_VIEWPORT, _viewport);
+		
+		//The terrain's colors may already have the lighting in them
+		if (_terrainDrawer->bakedLighting()) {
+			glDisable(GL_LIGHTING);
 		}
-		glEnd();
+		_terrainDrawer->draw();
+		glEnable(GL_LIGHTING);
 	}
 	
 	glutSwapBuffers();
 }
 
+//Moves the focus of _pagedTerrain by the specified number of seconds'
+//worth of movement, turning around at the edges of the terrain
+void moveFocus(float seconds) {
+	_focusX += PAGED_FOCUS_SPEED * _focusDirX * seconds;
+	_focusZ += PAGED_FOCUS_SPEED * _focusDirZ * seconds;
+	if ((_focusX < 0 && _focusDirX < 0) ||
+		(_focusX > _pagedTerrain->width() - 1 && _focusDirX > 0)) {
+		_focusDirX = -_focusDirX;
+	}
+	if ((_focusZ < 0 && _focusDirZ < 0) ||
+		(_focusZ > _pagedTerrain->length() - 1 && _focusDirZ > 0)) {
+		_focusDirZ = -_focusDirZ;
+	}
+	_pagedTerrain->setFocus(_focusX,
+							_focusZ,
+							PAGED_FOCUS_SPEED * _focusDirX,
+							PAGED_FOCUS_SPEED * _focusDirZ);
+}
+
 void update(int value) {
 	_angle += 1.0f;
 	if (_angle > 360) {
 		_angle -= 360;
 	}
 	
+	if (_pagedTerrain != NULL) {
+		moveFocus(0.025f);
+	}
+	
 	glutPostRedisplay();
 	glutTimerFunc(25, update, 0);
 }
 
+//Returns the number of milliseconds since some fixed time
+double milliseconds() {
+	return chrono::duration<double, milli>(
+		chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Keeps the compiler from optimizing away the work that the benchmark times
+volatile float _benchmarkSink;
+
+/* Moves numAgents agents, starting at (xs[i], zs[i]) and moving (dxs[i],
+ * dzs[i]) per step, over numSteps steps, finding the height of the terrain
+ * under each agent after each step in the specified way: 0 for heightAt, 1
+ * for heightsAt, 2 for heightsAt with normals, and 3 for parallelHeightsAt.
+ * Returns the average number of microseconds each step took to find the
+ * heights.
+ */
+double timeAgents(Terrain* terrain,
+				  const vector<float> &startXs,
+				  const vector<float> &startZs,
+				  const vector<float> &dxs,
+				  const vector<float> &dzs,
+				  int numSteps,
+				  int method) {
+	int numAgents = (int)startXs.size();
+	vector<float> xs = startXs;
+	vector<float> zs = startZs;
+	vector<float> heights(numAgents);
+	vector<Vec3f> normals(numAgents);
+	float maxX = (float)(terrain->width() - 1);
+	float maxZ = (float)(terrain->length() - 1);
+	double time = 0;
+	float sum = 0;
+	for(int step = 0; step < numSteps; step++) {
+		for(int i = 0; i < numAgents; i++) {
+			xs[i] = min(max(xs[i] + dxs[i], 0.0f), maxX);
+			zs[i] = min(max(zs[i] + dzs[i], 0.0f), maxZ);
+		}
+		
+		double startTime = milliseconds();
+		switch (method) {
+			case 0:
+				for(int i = 0; i < numAgents; i++) {
+					heights[i] = heightAt(terrain, xs[i], zs[i]);
+				}
+				break;
+			case 1:
+				heightsAt(terrain, &xs[0], &zs[0], numAgents, &heights[0]);
+				break;
+			case 2:
+				heightsAt(terrain, &xs[0], &zs[0], numAgents, &heights[0],
+						  &normals[0]);
+				break;
+			default:
+				parallelHeightsAt(terrain, &xs[0], &zs[0], numAgents,
+								  &heights[0]);
+				break;
+		}
+		time += milliseconds() - startTime;
+		sum += heights[step % numAgents];
+	}
+	_benchmarkSink = sum;
+	return 1000 * time / numSteps;
+}
+
+/* Returns whether the ray from origin in direction goes below the terrain
+ * within maxDistance times the length of direction, by checking heightAt
+ * every step times the length of direction, as one would without a
+ * TerrainRaycaster.  This takes time linear in the length of the ray.
+ */
+bool marchRay(Terrain* terrain,
+			  Vec3f origin,
+			  Vec3f direction,
+			  float maxDistance,
+			  float step) {
+	for(float t = 0; t <= maxDistance; t += step) {
+		float x = origin[0] + t * direction[0];
+		float y = origin[1] + t * direction[1];
+		float z = origin[2] + t * direction[2];
+		if (y <= heightAt(terrain, x, z)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Walks a focus over the specified paged terrain for numFrames frames of 1/60
+ * of a second at the specified speed in grid cells per second, sampling the
+ * tiles around it and the heights of numSamples points near it each frame, as
+ * a game would.  If lookAheadTime is negative, this doesn't call setFocus, so
+ * that all of the tiles are loaded when they're first used.  If paced is
+ * true, each frame waits out the rest of its 1/60 of a second, so that the
+ * worker threads have the time they would have in a game.  Prints the
+ * average and the longest time per frame and the terrain's statistics.
+ */
+void timePagedWalk(PagedTerrain* terrain,
+				   const char* name,
+				   float lookAheadTime,
+				   int numFrames,
+				   float speed,
+				   int numSamples,
+				   bool paced = false) {
+	const float FRAME_TIME = 1.0f / 60;
+	terrain->resetStats();
+	if (lookAheadTime >= 0) {
+		terrain->setLookAheadTime(lookAheadTime);
+	}
+	int tileCells = terrain->tileCells();
+	float x = tileCells;
+	float z = tileCells;
+	float dirX = 0.8f;
+	float dirZ = 0.6f;
+	double totalTime = 0;
+	double maxTime = 0;
+	float sum = 0;
+	srand(0);
+	for(int frame = 0; frame < numFrames; frame++) {
+		x += speed * dirX * FRAME_TIME;
+		z += speed * dirZ * FRAME_TIME;
+		if ((x < 0 && dirX < 0) || (x > terrain->width() - 1 && dirX > 0)) {
+			dirX = -dirX;
+		}
+		if ((z < 0 && dirZ < 0) || (z > terrain->length() - 1 && dirZ > 0)) {
+			dirZ = -dirZ;
+		}
+		
+		double startTime = milliseconds();
+		if (lookAheadTime >= 0) {
+			terrain->setFocus(x, z, speed * dirX, speed * dirZ);
+		}
+		int tileX = (int)(x / tileCells);
+		int tileZ = (int)(z / tileCells);
+		for(int tz = max(tileZ - 1, 0);
+			tz <= min(tileZ + 1, terrain->numTilesZ() - 1); tz++) {
+			for(int tx = max(tileX - 1, 0);
+				tx <= min(tileX + 1, terrain->numTilesX() - 1); tx++) {
+				const float* heights;
+				const Vec3f* normals;
+				terrain->getTile(tx, tz, heights, normals);
+				sum += heights[0] + normals[tileCells][1];
+			}
+		}
+		for(int i = 0; i < numSamples; i++) {
+			sum += terrain->heightAt(x + (randomFloat() - 0.5f) * tileCells,
+									 z + (randomFloat() - 0.5f) * tileCells);
+		}
+		double time = milliseconds() - startTime;
+		totalTime += time;
+		maxTime = max(maxTime, time);
+		if (paced && time < 1000 * FRAME_TIME) {
+			this_thread::sleep_for(
+				chrono::duration<double, milli>(1000 * FRAME_TIME - time));
+		}
+	}
+	_benchmarkSink = sum;
+	
+	cout << "    " << name << ": " << totalTime / numFrames
+		 << " ms per frame, " << maxTime << " ms longest frame, "
+		 << terrain->numHits() << " hits, " << terrain->numMisses()
+		 << " misses, " << terrain->numPrefetches() << " prefetches, "
+		 << terrain->numPrefetchHits() << " prefetch hits, "
+		 << terrain->numWaits() << " waits, " << terrain->numEvictions()
+		 << " evictions, " << terrain->tileMemory() / (1024 * 1024)
+		 << " MB of tiles" << endl;
+}
+
+/* Writes a 4097 x 4097 terrain to a paged terrain file, then times walking
+ * over it with only MAX_PAGED_TILES tiles in memory, with and without
+ * loading tiles ahead of time, and prints the results
+ */
+void benchmarkPaged() {
+	const int SIZE = 4097;
+	const int NUM_FRAMES = 1000;
+	const float SPEED = 240;
+	const int NUM_SAMPLES = 1000;
+	const char* FILENAME = "benchmark.tiles";
+	
+	Terrain* t = new Terrain(SIZE, SIZE);
+	srand(0);
+	for(int z = 0; z < SIZE; z++) {
+		for(int x = 0; x < SIZE; x++) {
+			t->setHeight(x, z, 10 * sin(0.05f * x) * cos(0.03f * z) +
+							   randomFloat());
+		}
+	}
+	double startTime = milliseconds();
+	bool written = writePagedTerrain(t, FILENAME);
+	double writeTime = milliseconds() - startTime;
+	delete t;
+	if (!written) {
+		cout << "Couldn't write " << FILENAME << endl;
+		return;
+	}
+	
+	PagedTerrain* paged = PagedTerrain::open(FILENAME, MAX_PAGED_TILES);
+	if (paged == NULL) {
+		cout << "Couldn't open " << FILENAME << endl;
+		remove(FILENAME);
+		return;
+	}
+	cout << SIZE << " x " << SIZE << " paged, " << paged->numTilesX() << " x "
+		 << paged->numTilesZ() << " tiles of " << paged->tileCells()
+		 << " x " << paged->tileCells() << " cells, at most "
+		 << paged->maxTiles() << " in memory: " << writeTime
+		 << " ms to write" << endl;
+	timePagedWalk(paged, "loading on use", -1, NUM_FRAMES, SPEED,
+				  NUM_SAMPLES);
+	timePagedWalk(paged, "setFocus", 0, NUM_FRAMES, SPEED, NUM_SAMPLES);
+	timePagedWalk(paged, "setFocus with look-ahead", 1, NUM_FRAMES, SPEED,
+				  NUM_SAMPLES);
+	delete paged;
+	remove(FILENAME);
+}
+
+//Returns the noise for the generated terrains with the specified seed
+TerrainNoise proceduralNoise(unsigned int seed) {
+	return TerrainNoise(seed, 20, 128, 6, 32);
+}
+
+/* Times the noise for generated terrains, with and without SSE2, and
+ * generating tiles, then walks over a generated terrain more than a million
+ * samples across with only MAX_PAGED_TILES tiles in memory, generating the
+ * tiles as they're used and then, for 15 seconds at the pace of a game,
+ * generating them ahead of time on worker threads, and prints the results
+ */
+void benchmarkProcedural() {
+	const int ROW_SIZE = 1024;
+	const int NUM_ROWS = 256;
+	const int NUM_TILES = 64;
+	const int NUM_FRAMES = 900;
+	const float SPEED = 480;
+	const int NUM_SAMPLES = 1000;
+	
+	TerrainNoise noise = proceduralNoise(0);
+	vector<float> row(ROW_SIZE);
+	float sum = 0;
+	double startTime = milliseconds();
+	for(int z = 0; z < NUM_ROWS; z++) {
+		for(int x = 0; x < ROW_SIZE; x++) {
+			sum += noise.heightAt((float)x, (float)z);
+		}
+	}
+	double scalarTime = milliseconds() - startTime;
+	startTime = milliseconds();
+	for(int z = 0; z < NUM_ROWS; z++) {
+		noise.heightRow(0, z, ROW_SIZE, &row[0]);
+		sum += row[z];
+	}
+	double rowTime = milliseconds() - startTime;
+	double numSamples = (double)ROW_SIZE * NUM_ROWS;
+	cout << "Noise: " << numSamples / scalarTime / 1000
+		 << " million samples per second one at a time, "
+		 << numSamples / rowTime / 1000
+		 << " million a row at a time" << endl;
+	
+	PagedTerrain* paged = PagedTerrain::generate(noise,
+												 PROCEDURAL_TILES,
+												 PROCEDURAL_TILES,
+												 MAX_PAGED_TILES);
+	
+	//Generate tiles far from where the walks go, on this thread
+	startTime = milliseconds();
+	for(int i = 0; i < NUM_TILES; i++) {
+		const float* heights;
+		const Vec3f* normals;
+		paged->getTile(PROCEDURAL_TILES / 2 + i % 8,
+					   PROCEDURAL_TILES / 2 + i / 8,
+					   heights,
+					   normals);
+		sum += heights[0];
+	}
+	double tileTime = (milliseconds() - startTime) / NUM_TILES;
+	_benchmarkSink = sum;
+	
+	cout << paged->width() << " x " << paged->length() << " generated, "
+		 << paged->numTilesX() << " x " << paged->numTilesZ()
+		 << " tiles of " << paged->tileCells() << " x "
+		 << paged->tileCells() << " cells, at most " << paged->maxTiles()
+		 << " in memory: " << tileTime << " ms to generate a tile" << endl;
+	timePagedWalk(paged, "generating on use", -1, NUM_FRAMES, SPEED,
+				  NUM_SAMPLES);
+	timePagedWalk(paged, "setFocus with look-ahead", 1, NUM_FRAMES, SPEED,
+				  NUM_SAMPLES, true);
+	delete paged;
+}
+
+/* Times filling, computing the normals of, sampling heights from, walking the
+ * mesh of, and digging craters in terrains from 256 x 256 to 8192 x 8192 in
+ * each layout and storage, and prints the results
+ */
+void benchmark() {
+	const int NUM_SAMPLES = 1000000;
+	const int NUM_AGENTS = 100000;
+	const int NUM_AGENT_STEPS = 20;
+	const int NUM_CRATERS = 100;
+	const float CRATER_RADIUS = 8;
+	const int NUM_RAYS = 100000;
+	const int NUM_MARCHED_RAYS = 1000;
+	const int NUM_CONFIGURATIONS = 4;
+	const Terrain::Layout LAYOUTS[] = {Terrain::ROW_MAJOR, Terrain::TILED,
+									   Terrain::ROW_MAJOR, Terrain::TILED};
+	const Terrain::Storage STORAGES[] = {Terrain::FLOATS, Terrain::FLOATS,
+										 Terrain::QUANTIZED,
+										 Terrain::QUANTIZED};
+	const char* CONFIGURATION_NAMES[] = {"row-major", "tiled",
+										 "row-major quantized",
+										 "tiled quantized"};
+	
+	for(int size = 256; size <= 8192; size *= 2) {
+		vector<float> xs;
+		vector<float> zs;
+		for(int i = 0; i < NUM_SAMPLES; i++) {
+			xs.push_back(randomFloat() * (size - 1));
+			zs.push_back(randomFloat() * (size - 1));
+		}
+		vector<float> agentDxs;
+		vector<float> agentDzs;
+		for(int i = 0; i < NUM_AGENTS; i++) {
+			agentDxs.push_back(randomFloat() - 0.5f);
+			agentDzs.push_back(randomFloat() - 0.5f);
+		}
+		vector<float> agentXs(xs.begin(), xs.begin() + NUM_AGENTS);
+		vector<float> agentZs(zs.begin(), zs.begin() + NUM_AGENTS);
+		vector<float> craterXs;
+		vector<float> craterZs;
+		for(int i = 0; i < NUM_CRATERS; i++) {
+			craterXs.push_back(randomFloat() * (size - 1));
+			craterZs.push_back(randomFloat() * (size - 1));
+		}
+		
+		//Lines of sight from above the hills, sloping slightly downward, as
+		//far as the size of the terrain
+		vector<Vec3f> rayOrigins;
+		vector<Vec3f> rayDirections;
+		for(int i = 0; i < NUM_RAYS; i++) {
+			rayOrigins.push_back(Vec3f(xs[i], 12, zs[i]));
+			float angle = 2 * 3.1415926535f * randomFloat();
+			rayDirections.push_back(Vec3f(cos(angle),
+										  -0.02f * randomFloat(),
+										  sin(angle)));
+		}
+		vector<float> rayDistances(NUM_RAYS);
+		
+		for(int i = 0; i < NUM_CONFIGURATIONS; i++) {
+			//Make some random hills
+			double startTime = milliseconds();
+			Terrain* t = new Terrain(size, size, LAYOUTS[i], STORAGES[i], -64,
+									 64);
+			srand(0);
+			for(int z = 0; z < size; z++) {
+				for(int x = 0; x < size; x++) {
+					t->setHeight(x, z, 10 * sin(0.05f * x) * cos(0.03f * z) +
+									   randomFloat());
+				}
+			}
+			double fillTime = milliseconds() - startTime;
+			
+			startTime = milliseconds();
+			t->computeNormals();
+			double normalsTime = milliseconds() - startTime;
+			
+			startTime = milliseconds();
+			float sum = 0;
+			for(int j = 0; j < NUM_SAMPLES; j++) {
+				sum += heightAt(t, xs[j], zs[j]);
+			}
+			double heightAtTime = milliseconds() - startTime;
+			
+			//Find the heights under many moving agents, as a simulation
+			//would each frame
+			double agentTimes[4];
+			for(int method = 0; method < 4; method++) {
+				agentTimes[method] = timeAgents(t, agentXs, agentZs, agentDxs,
+												agentDzs, NUM_AGENT_STEPS,
+												method);
+			}
+			
+			//Visit the vertices in the order that drawScene does
+			startTime = milliseconds();
+			for(int z = 0; z < size - 1; z++) {
+				for(int x = 0; x < size; x++) {
+					sum += t->getNormal(x, z)[1] + t->getHeight(x, z);
+					sum += t->getNormal(x, z + 1)[1] + t->getHeight(x, z + 1);
+				}
+			}
+			double meshTime = milliseconds() - startTime;
+			_benchmarkSink = sum;
+			
+			//Cast the rays with a TerrainRaycaster, then march some of them
+			//without one
+			startTime = milliseconds();
+			TerrainRaycaster* raycaster = new TerrainRaycaster(t);
+			double pyramidTime = milliseconds() - startTime;
+			
+			startTime = milliseconds();
+			raycaster->castRays(&rayOrigins[0], &rayDirections[0], NUM_RAYS,
+								size, &rayDistances[0]);
+			double castTime = milliseconds() - startTime;
+			
+			startTime = milliseconds();
+			raycaster->parallelCastRays(&rayOrigins[0], &rayDirections[0],
+										NUM_RAYS, size, &rayDistances[0]);
+			double parallelCastTime = milliseconds() - startTime;
+			int numHits = 0;
+			for(int j = 0; j < NUM_RAYS; j++) {
+				if (rayDistances[j] >= 0) {
+					numHits++;
+				}
+			}
+			
+			startTime = milliseconds();
+			int numMarchedHits = 0;
+			for(int j = 0; j < NUM_MARCHED_RAYS; j++) {
+				if (marchRay(t, rayOrigins[j], rayDirections[j], size,
+							 0.5f)) {
+					numMarchedHits++;
+				}
+			}
+			double marchTime = milliseconds() - startTime;
+			
+			//Dig craters, recomputing the normals after each one as though
+			//we were redrawing the terrain
+			startTime = milliseconds();
+			for(int j = 0; j < NUM_CRATERS; j++) {
+				makeCrater(t, craterXs[j], craterZs[j], CRATER_RADIUS, 5);
+				t->computeNormals();
+			}
+			double craterTime = milliseconds() - startTime;
+			
+			//Update the pyramid after each crater, as handleMouse does
+			startTime = milliseconds();
+			int reach = (int)ceil(2 * CRATER_RADIUS);
+			for(int j = 0; j < NUM_CRATERS; j++) {
+				int x = (int)craterXs[j];
+				int z = (int)craterZs[j];
+				raycaster->heightsChanged(x - reach, z - reach, x + reach,
+										  z + reach);
+			}
+			double pyramidUpdateTime = milliseconds() - startTime;
+			delete raycaster;
+			
+			cout << size << " x " << size << ", " << CONFIGURATION_NAMES[i]
+				 << ", " << t->memorySize() / (1024 * 1024) << " MB: "
+				 << fillTime << " ms to fill, "
+				 << normalsTime << " ms to compute normals, "
+				 << 1000000 * heightAtTime / NUM_SAMPLES
+				 << " ns per heightAt, " << meshTime
+				 << " ms to walk the mesh, "
+				 << 1000 * craterTime / NUM_CRATERS
+				 << " us to dig a crater and update the normals" << endl;
+			cout << "    " << NUM_AGENTS << " agents: " << agentTimes[0]
+				 << " us per step with heightAt, " << agentTimes[1]
+				 << " us with heightsAt, " << agentTimes[2]
+				 << " us with heightsAt and normals, " << agentTimes[3]
+				 << " us with parallelHeightsAt" << endl;
+			cout << "    " << NUM_RAYS << " rays: " << pyramidTime
+				 << " ms to build the pyramid, "
+				 << 1000 * castTime / NUM_RAYS << " us per ray with castRays, "
+				 << 1000 * parallelCastTime / NUM_RAYS
+				 << " us with parallelCastRays, "
+				 << 1000 * marchTime / NUM_MARCHED_RAYS
+				 << " us marching with heightAt, "
+				 << 1000 * pyramidUpdateTime / NUM_CRATERS
+				 << " us to update the pyramid after a crater; " << numHits
+				 << " hits, " << numMarchedHits << " of the first "
+				 << NUM_MARCHED_RAYS << " when marching" << endl;
+			delete t;
+		}
+	}
+}
+
 int main(int argc, char** argv) {
+	/* Usage: terrain [-tiled] [-quantized] [-heightmap file] [-vertexbuffers]
+	 *                [-bench] [-convert heightmap.bmp file.tiles]
+	 *                [-paged file.tiles] [-procedural seed]
+	 * -tiled: Stores the terrain in tiles rather than row by row
+	 * -quantized: Stores the terrain's heights and normals in 16 bits each
+	 * -heightmap: Loads the terrain from the specified 16- or 24-bit bitmap
+	 *             or .r16 file rather than heightmap.bmp
+	 * -vertexbuffers: Draws the terrain from vertex buffers with positions and
+	 *                 normals, even where it could be drawn from a texture of
+	 *                 its heights
+	 * -bench: Rather than showing the terrain, times the terrain code on
+	 *         terrains of different sizes and prints the results
+	 * -convert: Rather than showing the terrain, converts a heightmap to a
+	 *           paged terrain file
+	 * -paged: Shows the terrain in a paged terrain file, moving over it and
+	 *         keeping only the tiles near the view in memory
+	 * -procedural: Shows a terrain more than a million samples across,
+	 *              generated from noise with the specified seed a tile at a
+	 *              time around the view
+	 * Press 'c' to dig a crater and 'l' to switch levels of detail on and off,
+	 * and click on the terrain to dig a crater there.  'o' cycles the lighting
+	 * between baked with ambient occlusion, which is the default, baked, and
+	 * OpenGL's lighting.
+	 */
+	const char* pagedFilename = NULL;
+	bool procedural = false;
+	unsigned int seed = 0;
+	for(int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-tiled") == 0) {
+			_terrainLayout = Terrain::TILED;
+		}
+		else if (strcmp(argv[i], "-quantized") == 0) {
+			_terrainStorage = Terrain::QUANTIZED;
+		}
+		else if (strcmp(argv[i], "-heightmap") == 0 && i + 1 < argc) {
+			_heightmapFilename = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "-vertexbuffers") == 0) {
+			_allowHeightTexture = false;
+		}
+		else if (strcmp(argv[i], "-bench") == 0) {
+			benchmark();
+			benchmarkPaged();
+			benchmarkProcedural();
+			return 0;
+		}
+		else if (strcmp(argv[i], "-convert") == 0 && i + 2 < argc) {
+			if (!convertHeightmap(argv[i + 1], 20, argv[i + 2])) {
+				cerr << "Couldn't write " << argv[i + 2] << endl;
+				return 1;
+			}
+			return 0;
+		}
+		else if (strcmp(argv[i], "-paged") == 0 && i + 1 < argc) {
+			pagedFilename = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "-procedural") == 0 && i + 1 < argc) {
+			procedural = true;
+			seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+			i++;
+		}
+	}
+	
+	if (procedural) {
+		_pagedTerrain = PagedTerrain::generate(proceduralNoise(seed),
+											   PROCEDURAL_TILES,
+											   PROCEDURAL_TILES,
+											   MAX_PAGED_TILES);
+	}
+	else if (pagedFilename != NULL) {
+		_pagedTerrain = PagedTerrain::open(pagedFilename, MAX_PAGED_TILES);
+		if (_pagedTerrain == NULL) {
+			cerr << "Couldn't open " << pagedFilename << endl;
+			return 1;
+		}
+	}
+	if (_pagedTerrain != NULL) {
+		_focusX = (float)(_pagedTerrain->width() - 1) / 2;
+		_focusZ = (float)(_pagedTerrain->length() - 1) / 2;
+		moveFocus(0);
+	}
+	
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 	glutInitWindowSize(400, 400);
@@ -296,10 +898,19 @@ int main(int argc, char** argv) {
 	glutCreateWindow("Terrain - videotutorialsrock.com");
 	initRendering();
 	
-	_terrain = loadTerrain("heightmap.bmp", 20);
+	if (_pagedTerrain == NULL) {
+		_terrain = loadTerrain(_heightmapFilename,
+							   20,
+							   _terrainLayout,
+							   _terrainStorage);
+		_terrainDrawer = new TerrainDrawer(_terrain, _allowHeightTexture);
+		bakeLighting(true);
+		_terrainRaycaster = new TerrainRaycaster(_terrain);
+	}
 	
 	glutDisplayFunc(drawScene);
 	glutKeyboardFunc(handleKeypress);
+	glutMouseFunc(handleMouse);
 	glutReshapeFunc(handleResize);
 	glutTimerFunc(25, update, 0);
 	
@@ -315,3 +926,4 @@ int main(int argc, char** argv) {
 
 
 
+
@@ -0,0 +1,645 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <algorithm>
+#include <fstream>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+#include "pagedterrain.h"
+#include "threadpool.h"
+
+using namespace std;
+
+namespace {
+	/* The files written by writePagedTerrain have the following format,
+	 * using the byte order of the machine that wrote them:
+	 * 
+	 * FileHeader, padded to TILE_ALIGNMENT bytes
+	 * for each tile, row by row:
+	 *     float heights[(tileCells + 1) * (tileCells + 1)]
+	 *     float normals[3 * (tileCells + 1) * (tileCells + 1)]
+	 *     padding to a multiple of TILE_ALIGNMENT bytes
+	 * 
+	 * Each tile starts on a new page, so that PagedTerrain can tell the
+	 * operating system to drop a tile's pages once it has read them.
+	 */
+	const char FILE_MAGIC[8] = {'T', 'E', 'R', 'R', 'T', 'I', 'L', 'E'};
+	const int FILE_VERSION = 1;
+	const int BYTE_ORDER_MARK = 0x01020304;
+	const size_t TILE_ALIGNMENT = 4096;
+	const int MAX_TILE_CELLS = 1024;
+	//The number of samples generated past each edge of a generated tile
+	const int GENERATED_BORDER = 2;
+	
+	struct FileHeader {
+		char magic[8];
+		int version;
+		int byteOrderMark;
+		int width;
+		int length;
+		int tileCells;
+	};
+	
+	//Returns the number of samples in each tile with the specified number of
+	//grid cells along each side
+	int samplesPerTile(int tileCells) {
+		return (tileCells + 1) * (tileCells + 1);
+	}
+	
+	//Returns the number of bytes for each tile with the specified number of
+	//grid cells along each side
+	size_t tileSizeFor(int tileCells) {
+		size_t size = samplesPerTile(tileCells) * 4 * sizeof(float);
+		return (size + TILE_ALIGNMENT - 1) / TILE_ALIGNMENT * TILE_ALIGNMENT;
+	}
+	
+	//Returns the number of tiles with the specified number of grid cells
+	//needed to cover the specified number of samples
+	int numTilesFor(int numSamples, int tileCells) {
+		return (numSamples - 2) / tileCells + 1;
+	}
+	
+	//Returns the distance from (x, z) to the nearest point in the specified
+	//rectangle
+	float distanceToRect(float x,
+						 float z,
+						 float minX,
+						 float minZ,
+						 float maxX,
+						 float maxZ) {
+		float dx = max(max(minX - x, x - maxX), 0.0f);
+		float dz = max(max(minZ - z, z - maxZ), 0.0f);
+		return sqrt(dx * dx + dz * dz);
+	}
+}
+
+PagedTerrain::PagedTerrain() : file(NULL),
+							   noise(NULL),
+							   numLoading(0),
+							   useCount(0),
+							   focusUseCount(0),
+							   lookAheadTime(1) {
+	resetStats();
+}
+
+PagedTerrain::~PagedTerrain() {
+	//Wait for the worker threads to finish with the tiles
+	{
+		unique_lock<mutex> lock(loadingMutex);
+		while (numLoading > 0) {
+			tileLoaded.wait(lock);
+		}
+	}
+	delete file;
+	delete noise;
+}
+
+int PagedTerrain::width() const {
+	return w;
+}
+
+int PagedTerrain::length() const {
+	return l;
+}
+
+int PagedTerrain::tileCells() const {
+	return cellsPerTile;
+}
+
+int PagedTerrain::numTilesX() const {
+	return tilesX;
+}
+
+int PagedTerrain::numTilesZ() const {
+	return tilesZ;
+}
+
+int PagedTerrain::maxTiles() const {
+	return (int)slots.size();
+}
+
+size_t PagedTerrain::tileMemory() const {
+	size_t size = 0;
+	for(unsigned int i = 0; i < slots.size(); i++) {
+		size += slots[i].heights.size() * sizeof(float) +
+			slots[i].normals.size() * sizeof(Vec3f);
+	}
+	return size;
+}
+
+void PagedTerrain::loadTile(long long tile, int slot) {
+	if (noise != NULL) {
+		generateTile(tile, slot);
+	}
+	else {
+		readTile(tile, slot);
+	}
+}
+
+void PagedTerrain::readTile(long long tile, int slot) {
+	size_t offset = TILE_ALIGNMENT + tile * tileSize;
+	int numSamples = samplesPerTile(cellsPerTile);
+	const float* data = (const float*)(file->data() + offset);
+	Slot &s = slots[slot];
+	memcpy(&s.heights[0], data, numSamples * sizeof(float));
+	const float* normalData = data + numSamples;
+	for(int i = 0; i < numSamples; i++) {
+		s.normals[i] = Vec3f(normalData[3 * i],
+							 normalData[3 * i + 1],
+							 normalData[3 * i + 2]);
+	}
+	
+	//We have our own copy, so the mapped pages aren't needed
+	file->discard(offset, tileSize);
+}
+
+void PagedTerrain::generateTile(long long tile, int slot) {
+	/* The smoothed normals depend on the heights up to two samples away, so
+	 * generate a border of two extra samples around the tile, and let
+	 * Terrain compute the normals in its usual way.  This usually runs on the
+	 * thread pool, so the normals are computed on this thread.
+	 */
+	int minX = (int)(tile % tilesX) * cellsPerTile - GENERATED_BORDER;
+	int minZ = (int)(tile / tilesX) * cellsPerTile - GENERATED_BORDER;
+	int size = cellsPerTile + 1 + 2 * GENERATED_BORDER;
+	Terrain terrain(size, size);
+	vector<float> row(size);
+	for(int z = 0; z < size; z++) {
+		noise->heightRow(minX, minZ + z, size, &row[0]);
+		for(int x = 0; x < size; x++) {
+			terrain.setHeight(x, z, row[x]);
+		}
+	}
+	terrain.computeNormals(false);
+	
+	Slot &s = slots[slot];
+	int i = 0;
+	for(int z = 0; z <= cellsPerTile; z++) {
+		for(int x = 0; x <= cellsPerTile; x++) {
+			s.heights[i] = terrain.getHeight(x + GENERATED_BORDER,
+											 z + GENERATED_BORDER);
+			s.normals[i] = terrain.getNormal(x + GENERATED_BORDER,
+											 z + GENERATED_BORDER);
+			i++;
+		}
+	}
+}
+
+int PagedTerrain::chooseSlot(long long minLastUse) {
+	int best = -1;
+	for(unsigned int i = 0; i < slots.size(); i++) {
+		const Slot &s = slots[i];
+		if (s.tile < 0) {
+			return i;
+		}
+		if (!s.loading && s.lastUse < minLastUse &&
+			(best < 0 || s.lastUse < slots[best].lastUse)) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+void PagedTerrain::assignSlot(long long tile, int slot) {
+	Slot &s = slots[slot];
+	if (s.tile >= 0) {
+		tileSlots.erase(s.tile);
+		evictions++;
+	}
+	else {
+		s.heights.resize(samplesPerTile(cellsPerTile));
+		s.normals.resize(samplesPerTile(cellsPerTile));
+	}
+	s.tile = tile;
+	s.prefetched = false;
+	tileSlots[tile] = slot;
+}
+
+int PagedTerrain::claimSlot(long long tile, long long minLastUse) {
+	int slot;
+	{
+		lock_guard<mutex> lock(loadingMutex);
+		slot = chooseSlot(minLastUse);
+	}
+	if (slot >= 0) {
+		assignSlot(tile, slot);
+	}
+	return slot;
+}
+
+int PagedTerrain::slotFor(int tileX, int tileZ) {
+	long long tile = (long long)tileZ * tilesX + tileX;
+	useCount++;
+	int slot;
+	unordered_map<long long, int>::iterator it = tileSlots.find(tile);
+	if (it != tileSlots.end()) {
+		slot = it->second;
+		Slot &s = slots[slot];
+		unique_lock<mutex> lock(loadingMutex);
+		if (s.loading) {
+			waits++;
+			while (s.loading) {
+				tileLoaded.wait(lock);
+			}
+		}
+		else {
+			hits++;
+		}
+		lock.unlock();
+		
+		if (s.prefetched) {
+			prefetchHits++;
+			s.prefetched = false;
+		}
+	}
+	else {
+		/* Find room for the tile, waiting for a tile to finish loading if
+		 * they all are.  The check and the wait happen under one lock, so
+		 * that a load that finishes in between isn't missed.  Only this
+		 * thread starts loads, so the chosen slot stays free once the lock
+		 * is released.
+		 */
+		misses++;
+		{
+			unique_lock<mutex> lock(loadingMutex);
+			while ((slot = chooseSlot(useCount)) < 0) {
+				tileLoaded.wait(lock);
+			}
+		}
+		assignSlot(tile, slot);
+		loadTile(tile, slot);
+	}
+	slots[slot].lastUse = useCount;
+	return slot;
+}
+
+void PagedTerrain::getTile(int tileX,
+						   int tileZ,
+						   const float* &heights,
+						   const Vec3f* &normals) {
+	Slot &s = slots[slotFor(tileX, tileZ)];
+	heights = &s.heights[0];
+	normals = &s.normals[0];
+}
+
+float PagedTerrain::getHeight(int x, int z) {
+	int tileX = min(x / cellsPerTile, tilesX - 1);
+	int tileZ = min(z / cellsPerTile, tilesZ - 1);
+	const Slot &s = slots[slotFor(tileX, tileZ)];
+	return s.heights[(z - tileZ * cellsPerTile) * (cellsPerTile + 1) +
+					 x - tileX * cellsPerTile];
+}
+
+Vec3f PagedTerrain::getNormal(int x, int z) {
+	int tileX = min(x / cellsPerTile, tilesX - 1);
+	int tileZ = min(z / cellsPerTile, tilesZ - 1);
+	const Slot &s = slots[slotFor(tileX, tileZ)];
+	return s.normals[(z - tileZ * cellsPerTile) * (cellsPerTile + 1) +
+					 x - tileX * cellsPerTile];
+}
+
+float PagedTerrain::heightAt(float x, float z) {
+	//Make (x, z) lie within the bounds of the terrain
+	if (x < 0) {
+		x = 0;
+	}
+	else if (x > w - 1) {
+		x = w - 1;
+	}
+	if (z < 0) {
+		z = 0;
+	}
+	else if (z > l - 1) {
+		z = l - 1;
+	}
+	
+	//Compute the grid cell in which (x, z) lies and how close we are to the
+	//left and outward edges
+	int leftX = (int)x;
+	if (leftX == w - 1) {
+		leftX--;
+	}
+	float fracX = x - leftX;
+	
+	int outZ = (int)z;
+	if (outZ == l - 1) {
+		outZ--;
+	}
+	float fracZ = z - outZ;
+	
+	//The whole cell is in one tile
+	int tileX = leftX / cellsPerTile;
+	int tileZ = outZ / cellsPerTile;
+	const Slot &s = slots[slotFor(tileX, tileZ)];
+	const float* h = &s.heights[0] +
+		(outZ - tileZ * cellsPerTile) * (cellsPerTile + 1) +
+		leftX - tileX * cellsPerTile;
+	float h11 = h[0];
+	float h12 = h[cellsPerTile + 1];
+	float h21 = h[1];
+	float h22 = h[cellsPerTile + 2];
+	
+	//Take a weighted average of the four heights
+	return (1 - fracX) * ((1 - fracZ) * h11 + fracZ * h12) +
+		fracX * ((1 - fracZ) * h21 + fracZ * h22);
+}
+
+void PagedTerrain::setFocus(float x,
+							float z,
+							float velocityX,
+							float velocityZ) {
+	//Find the tiles near the focus, nearest first, followed by the ones near
+	//where the focus is heading, nearest to that first
+	vector<long long> tiles;
+	float points[2][2] = {{x, z},
+						  {x + velocityX * lookAheadTime,
+						   z + velocityZ * lookAheadTime}};
+	for(int i = 0; i < 2; i++) {
+		float px = points[i][0];
+		float pz = points[i][1];
+		int minTileX = max((int)floor((px - focusRadius) / cellsPerTile), 0);
+		int minTileZ = max((int)floor((pz - focusRadius) / cellsPerTile), 0);
+		int maxTileX =
+			min((int)floor((px + focusRadius) / cellsPerTile), tilesX - 1);
+		int maxTileZ =
+			min((int)floor((pz + focusRadius) / cellsPerTile), tilesZ - 1);
+		vector< pair<float, long long> > nearby;
+		for(int tileZ = minTileZ; tileZ <= maxTileZ; tileZ++) {
+			for(int tileX = minTileX; tileX <= maxTileX; tileX++) {
+				float distance = distanceToRect(px,
+												pz,
+												tileX * cellsPerTile,
+												tileZ * cellsPerTile,
+												(tileX + 1) * cellsPerTile,
+												(tileZ + 1) * cellsPerTile);
+				if (distance <= focusRadius) {
+					nearby.push_back(make_pair(distance,
+											   (long long)tileZ * tilesX +
+											   tileX));
+				}
+			}
+		}
+		sort(nearby.begin(), nearby.end());
+		for(unsigned int j = 0; j < nearby.size(); j++) {
+			tiles.push_back(nearby[j].second);
+		}
+	}
+	
+	//Keep the tiles used since the last call and the wanted tiles that are
+	//already in memory, and load as many of the other wanted tiles as there
+	//is room for
+	long long minLastUse = focusUseCount;
+	for(unsigned int i = 0; i < tiles.size(); i++) {
+		unordered_map<long long, int>::iterator it = tileSlots.find(tiles[i]);
+		if (it != tileSlots.end()) {
+			slots[it->second].lastUse = ++useCount;
+		}
+	}
+	for(unsigned int i = 0; i < tiles.size(); i++) {
+		if (tileSlots.find(tiles[i]) != tileSlots.end()) {
+			continue;
+		}
+		
+		int slot = claimSlot(tiles[i], minLastUse);
+		if (slot < 0) {
+			break;
+		}
+		
+		Slot &s = slots[slot];
+		s.lastUse = ++useCount;
+		s.prefetched = true;
+		{
+			lock_guard<mutex> lock(loadingMutex);
+			s.loading = true;
+			numLoading++;
+		}
+		prefetches++;
+		long long tile = tiles[i];
+		defaultThreadPool()->submit([this, tile, slot]() {
+			loadTile(tile, slot);
+			lock_guard<mutex> lock(loadingMutex);
+			slots[slot].loading = false;
+			numLoading--;
+			tileLoaded.notify_all();
+		});
+	}
+	focusUseCount = useCount;
+}
+
+void PagedTerrain::setFocusRadius(float radius) {
+	focusRadius = radius;
+}
+
+void PagedTerrain::setLookAheadTime(float seconds) {
+	lookAheadTime = seconds;
+}
+
+long long PagedTerrain::numHits() const {
+	return hits;
+}
+
+long long PagedTerrain::numMisses() const {
+	return misses;
+}
+
+long long PagedTerrain::numPrefetches() const {
+	return prefetches;
+}
+
+long long PagedTerrain::numPrefetchHits() const {
+	return prefetchHits;
+}
+
+long long PagedTerrain::numWaits() const {
+	return waits;
+}
+
+long long PagedTerrain::numEvictions() const {
+	return evictions;
+}
+
+void PagedTerrain::resetStats() {
+	hits = 0;
+	misses = 0;
+	prefetches = 0;
+	prefetchHits = 0;
+	waits = 0;
+	evictions = 0;
+}
+
+void PagedTerrain::initSlots(int maxTiles) {
+	slots.resize(maxTiles);
+	for(int i = 0; i < maxTiles; i++) {
+		Slot &s = slots[i];
+		s.tile = -1;
+		s.loading = false;
+		s.prefetched = false;
+		s.lastUse = 0;
+	}
+}
+
+PagedTerrain* PagedTerrain::open(const char* filename, int maxTiles) {
+	if (maxTiles < 1 || sizeof(FileHeader) > TILE_ALIGNMENT ||
+		sizeof(Vec3f) != 3 * sizeof(float)) {
+		return NULL;
+	}
+	
+	MappedFile* file = MappedFile::open(filename);
+	if (file == NULL) {
+		return NULL;
+	}
+	
+	//Check the header, and that the file has every tile
+	const FileHeader* header = (const FileHeader*)file->data();
+	if (file->size() < TILE_ALIGNMENT ||
+		memcmp(header->magic, FILE_MAGIC, 8) != 0 ||
+		header->version != FILE_VERSION ||
+		header->byteOrderMark != BYTE_ORDER_MARK ||
+		header->width < 2 || header->length < 2 ||
+		header->tileCells < 1 || header->tileCells > MAX_TILE_CELLS ||
+		file->size() != TILE_ALIGNMENT +
+			(size_t)numTilesFor(header->width, header->tileCells) *
+			numTilesFor(header->length, header->tileCells) *
+			tileSizeFor(header->tileCells)) {
+		delete file;
+		return NULL;
+	}
+	
+	PagedTerrain* terrain = new PagedTerrain();
+	terrain->file = file;
+	terrain->w = header->width;
+	terrain->l = header->length;
+	terrain->cellsPerTile = header->tileCells;
+	terrain->tilesX = numTilesFor(header->width, header->tileCells);
+	terrain->tilesZ = numTilesFor(header->length, header->tileCells);
+	terrain->tileSize = tileSizeFor(header->tileCells);
+	terrain->focusRadius = 2.0f * header->tileCells;
+	terrain->initSlots(maxTiles);
+	return terrain;
+}
+
+PagedTerrain* PagedTerrain::generate(const TerrainNoise &noise,
+									 int numTilesX,
+									 int numTilesZ,
+									 int maxTiles,
+									 int tileCells) {
+	if (maxTiles < 1 || tileCells < 1 || tileCells > MAX_TILE_CELLS ||
+		numTilesX < 1 || numTilesZ < 1 ||
+		(long long)numTilesX * tileCells + 1 > INT_MAX ||
+		(long long)numTilesZ * tileCells + 1 > INT_MAX) {
+		return NULL;
+	}
+	
+	PagedTerrain* terrain = new PagedTerrain();
+	terrain->noise = new TerrainNoise(noise);
+	terrain->w = numTilesX * tileCells + 1;
+	terrain->l = numTilesZ * tileCells + 1;
+	terrain->cellsPerTile = tileCells;
+	terrain->tilesX = numTilesX;
+	terrain->tilesZ = numTilesZ;
+	terrain->tileSize = 0;
+	terrain->focusRadius = 2.0f * tileCells;
+	terrain->initSlots(maxTiles);
+	return terrain;
+}
+
+bool writePagedTerrain(Terrain* terrain, const char* filename, int tileCells) {
+	if (tileCells < 1 || tileCells > MAX_TILE_CELLS ||
+		terrain->width() < 2 || terrain->length() < 2) {
+		return false;
+	}
+	
+	ofstream output;
+	output.open(filename, ios_base::binary | ios_base::trunc);
+	
+	vector<char> headerPage(TILE_ALIGNMENT, 0);
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FILE_MAGIC, 8);
+	header.version = FILE_VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.width = terrain->width();
+	header.length = terrain->length();
+	header.tileCells = tileCells;
+	memcpy(&headerPage[0], &header, sizeof(header));
+	output.write(&headerPage[0], TILE_ALIGNMENT);
+	
+	int tilesX = numTilesFor(terrain->width(), tileCells);
+	int tilesZ = numTilesFor(terrain->length(), tileCells);
+	int numSamples = samplesPerTile(tileCells);
+	vector<float> tile(tileSizeFor(tileCells) / sizeof(float), 0.0f);
+	for(int tileZ = 0; tileZ < tilesZ && output.good(); tileZ++) {
+		for(int tileX = 0; tileX < tilesX; tileX++) {
+			//Past the edges of the terrain, repeat the samples on the edges
+			float* heights = &tile[0];
+			float* normals = heights + numSamples;
+			for(int z = 0; z <= tileCells; z++) {
+				int z2 = min(tileZ * tileCells + z, terrain->length() - 1);
+				for(int x = 0; x <= tileCells; x++) {
+					int x2 = min(tileX * tileCells + x, terrain->width() - 1);
+					*heights = terrain->getHeight(x2, z2);
+					Vec3f normal = terrain->getNormal(x2, z2);
+					normals[0] = normal[0];
+					normals[1] = normal[1];
+					normals[2] = normal[2];
+					heights++;
+					normals += 3;
+				}
+			}
+			output.write((const char*)&tile[0], tile.size() * sizeof(float));
+		}
+	}
+	output.close();
+	
+	if (output.fail()) {
+		//Don't leave a partial file behind
+		remove(filename);
+		return false;
+	}
+	return true;
+}
+
+bool convertHeightmap(const char* heightmapFilename,
+					  float height,
+					  const char* filename,
+					  int tileCells) {
+	Terrain* terrain = loadTerrain(heightmapFilename, height);
+	bool succeeded = writePagedTerrain(terrain, filename, tileCells);
+	delete terrain;
+	return succeeded;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,238 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef PAGED_TERRAIN_H_INCLUDED
+#define PAGED_TERRAIN_H_INCLUDED
+
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedfile.h"
+#include "terrain.h"
+#include "terrainnoise.h"
+#include "vec3f.h"
+
+//The default number of grid cells along each side of a tile in the files
+//written by writePagedTerrain
+const int PAGED_TERRAIN_TILE_CELLS = 64;
+
+/* A terrain that stays on disk, in a file written by writePagedTerrain, and
+ * is read a tile at a time, or that is made up from TerrainNoise a tile at
+ * a time as it is needed.  It keeps at most a fixed number of tiles in
+ * memory, dropping the least recently used one to make room for another, so
+ * its memory use doesn't depend on the size of the terrain.  setFocus loads
+ * the tiles around a moving point, such as the camera, and the tiles it is
+ * heading towards, on worker threads, so that they are usually ready before
+ * they are needed.
+ *
+ * Each tile has the samples on its edges in common with its neighbors, so
+ * every grid cell lies entirely within one tile.
+ *
+ * A PagedTerrain must only be used from one thread at a time.  The pointers
+ * returned by getTile stay valid until the next call to getTile, getHeight,
+ * getNormal, heightAt, or setFocus, any of which may drop a tile.
+ */
+class PagedTerrain {
+	private:
+		//A place in memory for one tile
+		struct Slot {
+			//The index of the tile in the slot, or -1 for none
+			long long tile;
+			//Whether the tile is still being loaded on a worker thread
+			bool loading;
+			//Whether the tile was loaded by setFocus and hasn't been used yet
+			bool prefetched;
+			//The value of useCount when the tile was last used
+			long long lastUse;
+			std::vector<float> heights;
+			std::vector<Vec3f> normals;
+		};
+		
+		MappedFile* file;
+		//The noise for a generated terrain, or NULL for one read from a file
+		TerrainNoise* noise;
+		int w; //Width
+		int l; //Length
+		int cellsPerTile;
+		int tilesX;
+		int tilesZ;
+		//The number of bytes for each tile in the file, or 0 if there is
+		//no file
+		size_t tileSize;
+		std::vector<Slot> slots;
+		//The index in slots of each tile that is in memory
+		std::unordered_map<long long, int> tileSlots;
+		//Guards the loading fields of the slots and numLoading
+		std::mutex loadingMutex;
+		std::condition_variable tileLoaded;
+		int numLoading; //The number of tiles being loaded on worker threads
+		long long useCount; //Increases each time a tile is used
+		long long focusUseCount; //The value of useCount after setFocus
+		float focusRadius;
+		float lookAheadTime;
+		//The statistics since the last call to resetStats
+		long long hits;
+		long long misses;
+		long long prefetches;
+		long long prefetchHits;
+		long long waits;
+		long long evictions;
+		
+		PagedTerrain();
+		//Makes room for the specified number of tiles
+		void initSlots(int maxTiles);
+		
+		//Reads or generates the specified tile into the specified slot
+		void loadTile(long long tile, int slot);
+		//Copies the specified tile from the file to the specified slot
+		void readTile(long long tile, int slot);
+		//Computes the heights and normals of the specified tile from the
+		//noise, in the specified slot
+		void generateTile(long long tile, int slot);
+		/* Returns the index of an empty slot, or else of the least recently
+		 * used slot whose tile isn't loading and wasn't used since
+		 * minLastUse, or -1 if there is no such slot.  loadingMutex must be
+		 * locked.
+		 */
+		int chooseSlot(long long minLastUse);
+		//Gives the specified slot, which chooseSlot returned, to the
+		//specified tile, dropping the tile it held
+		void assignSlot(long long tile, int slot);
+		/* Returns the index of a slot for the specified tile, dropping the
+		 * least recently used tile if all slots are full, or -1 if every
+		 * slot holds a tile that is loading or was used since minLastUse
+		 */
+		int claimSlot(long long tile, long long minLastUse);
+		//Returns the index of the slot holding the specified tile, loading
+		//it or waiting for it to load if necessary
+		int slotFor(int tileX, int tileZ);
+	public:
+		~PagedTerrain();
+		
+		int width() const;
+		int length() const;
+		//Returns the number of grid cells along each side of a tile
+		int tileCells() const;
+		int numTilesX() const;
+		int numTilesZ() const;
+		//Returns the most tiles that are kept in memory at once
+		int maxTiles() const;
+		//Returns the number of bytes used by the tiles kept in memory
+		size_t tileMemory() const;
+		
+		/* Sets heights and normals to point to the (tileCells() + 1) x
+		 * (tileCells() + 1) samples of the specified tile, row by row,
+		 * loading the tile if necessary.  The sample (x, z) of the tile is
+		 * the sample (tileX * tileCells() + x, tileZ * tileCells() + z) of
+		 * the terrain, or the nearest sample on the terrain if that is past
+		 * its edge.
+		 */
+		void getTile(int tileX,
+					 int tileZ,
+					 const float* &heights,
+					 const Vec3f* &normals);
+		//Returns the height at (x, z)
+		float getHeight(int x, int z);
+		//Returns the normal at (x, z)
+		Vec3f getNormal(int x, int z);
+		//Returns the approximate height of the terrain at the specified (x, z)
+		//position, in the same way as heightAt
+		float heightAt(float x, float z);
+		
+		/* Starts loading the tiles within focusRadius of (x, z), and those
+		 * within focusRadius of where (x, z) will be after lookAheadTime
+		 * seconds at the specified velocity, nearest first, on worker
+		 * threads.  This never drops tiles used since the last call to
+		 * setFocus to make room.  Call this once per frame.
+		 */
+		void setFocus(float x, float z, float velocityX, float velocityZ);
+		//Sets the distance from the focus within which setFocus loads tiles.
+		//This is twice tileCells() by default.
+		void setFocusRadius(float radius);
+		//Sets how far ahead setFocus looks, in seconds.  This is 1 by default.
+		void setLookAheadTime(float seconds);
+		
+		//Returns the number of times a tile was used that was already in
+		//memory
+		long long numHits() const;
+		//Returns the number of times a tile had to be loaded as it was used
+		long long numMisses() const;
+		//Returns the number of tiles that setFocus started loading
+		long long numPrefetches() const;
+		//Returns the number of tiles loaded by setFocus that were then used
+		long long numPrefetchHits() const;
+		//Returns the number of times a tile was used while setFocus was still
+		//loading it
+		long long numWaits() const;
+		//Returns the number of tiles dropped to make room for others
+		long long numEvictions() const;
+		void resetStats();
+		
+		/* Opens a file written by writePagedTerrain, keeping at most maxTiles
+		 * tiles in memory at once.  Returns NULL if the file could not be
+		 * opened or isn't a valid paged terrain file.
+		 */
+		static PagedTerrain* open(const char* filename, int maxTiles);
+		/* Makes a terrain of numTilesX x numTilesZ tiles of tileCells x
+		 * tileCells grid cells, whose heights come from the specified
+		 * noise, keeping at most maxTiles tiles in memory at once.  Tiles
+		 * are generated when they are loaded and forgotten when they are
+		 * dropped, so the terrain can be far larger than would fit in
+		 * memory or on disk.  The normals on the edges of the terrain take
+		 * the noise past the edges into account.  Returns NULL if the
+		 * terrain would be too large or too small.
+		 */
+		static PagedTerrain* generate(const TerrainNoise &noise,
+									  int numTilesX,
+									  int numTilesZ,
+									  int maxTiles,
+									  int tileCells = PAGED_TERRAIN_TILE_CELLS);
+};
+
+/* Writes the terrain to the specified file, in tiles of tileCells x
+ * tileCells grid cells, for PagedTerrain.  Returns whether it succeeded.
+ */
+bool writePagedTerrain(Terrain* terrain,
+					   const char* filename,
+					   int tileCells = PAGED_TERRAIN_TILE_CELLS);
+/* Loads a heightmap as loadTerrain does and writes it to the specified file
+ * for PagedTerrain.  Returns whether it succeeded.
+ */
+bool convertHeightmap(const char* heightmapFilename,
+					  float height,
+					  const char* filename,
+					  int tileCells = PAGED_TERRAIN_TILE_CELLS);
+
+
+
+
+
+
+
+
+
+
+#endif
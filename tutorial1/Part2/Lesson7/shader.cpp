@@ -0,0 +1,110 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef __APPLE__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <iostream>
+#include <stdlib.h>
+
+#include "shader.h"
+
+#ifdef __APPLE__
+#include <OpenGL/glext.h>
+#endif
+
+using namespace std;
+
+namespace {
+	//Compiles a shader of the specified type, returning 0 if there was an error
+	GLuint compileShader(GLenum type, const char* source) {
+		GLuint shaderId = glCreateShader(type);
+		glShaderSource(shaderId, 1, &source, NULL);
+		glCompileShader(shaderId);
+		
+		GLint compiled;
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &compiled);
+		if (!compiled) {
+			char log[1024];
+			glGetShaderInfoLog(shaderId, sizeof(log), NULL, log);
+			cerr << "Error compiling shader: " << log << endl;
+			glDeleteShader(shaderId);
+			return 0;
+		}
+		return shaderId;
+	}
+}
+
+bool shadersSupported() {
+	const char* version = (const char*)glGetString(GL_VERSION);
+	return version != NULL && atoi(version) >= 2;
+}
+
+GLuint loadShaderProgram(const char* vertexSource,
+						 const char* fragmentSource,
+						 const char* const* attributeNames) {
+	GLuint vertexShaderId = compileShader(GL_VERTEX_SHADER, vertexSource);
+	if (vertexShaderId == 0) {
+		return 0;
+	}
+	GLuint fragmentShaderId = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if (fragmentShaderId == 0) {
+		glDeleteShader(vertexShaderId);
+		return 0;
+	}
+	
+	GLuint programId = glCreateProgram();
+	glAttachShader(programId, vertexShaderId);
+	glAttachShader(programId, fragmentShaderId);
+	for(int i = 0; attributeNames != NULL && attributeNames[i] != NULL; i++) {
+		glBindAttribLocation(programId, i, attributeNames[i]);
+	}
+	glLinkProgram(programId);
+	
+	//The program keeps the shaders alive for as long as it needs them
+	glDeleteShader(vertexShaderId);
+	glDeleteShader(fragmentShaderId);
+	
+	GLint linked;
+	glGetProgramiv(programId, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[1024];
+		glGetProgramInfoLog(programId, sizeof(log), NULL, log);
+		cerr << "Error linking shader program: " << log << endl;
+		glDeleteProgram(programId);
+		return 0;
+	}
+	return programId;
+}
+
+
+
+
+
+
+
+
+
+
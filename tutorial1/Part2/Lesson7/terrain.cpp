@@ -0,0 +1,925 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "imageloader.h"
+#include "terrain.h"
+#include "threadpool.h"
+
+using namespace std;
+
+Terrain::Terrain(int w2,
+				 int l2,
+				 Layout layout2,
+				 Storage storage2,
+				 float minHeight,
+				 float maxHeight) {
+	w = w2;
+	l = l2;
+	layout_ = layout2;
+	storage_ = storage2;
+	
+	if (layout_ == TILED) {
+		//Round the width and the length up to whole tiles
+		int tilesPerRow = (w + TERRAIN_TILE_SIZE - 1) / TERRAIN_TILE_SIZE;
+		int tilesPerColumn = (l + TERRAIN_TILE_SIZE - 1) / TERRAIN_TILE_SIZE;
+		tileRowOffset = tilesPerRow * TERRAIN_TILE_SIZE * TERRAIN_TILE_SIZE;
+		numSlots = tilesPerColumn * tileRowOffset;
+		
+		//Order the samples in each tile by interleaving the bits of x and z,
+		//with the lowest bit from x
+		for(int i = 0; i < TERRAIN_TILE_SIZE; i++) {
+			int spread = 0;
+			for(int bit = 0; bit < TERRAIN_TILE_SHIFT; bit++) {
+				spread |= ((i >> bit) & 1) << (2 * bit);
+			}
+			xOffsets[i] = spread;
+			zOffsets[i] = 2 * spread;
+		}
+		xOffsets[TERRAIN_TILE_SIZE] = TERRAIN_TILE_SIZE * TERRAIN_TILE_SIZE;
+		zOffsets[TERRAIN_TILE_SIZE] = tileRowOffset;
+	}
+	else {
+		tileRowOffset = 0;
+		numSlots = w * l;
+	}
+	
+	hs = NULL;
+	normals = NULL;
+	quantizedHeights = NULL;
+	packedNormals = NULL;
+	heightOffset = minHeight;
+	heightScale = (maxHeight - minHeight) / 65535;
+	if (storage_ == QUANTIZED) {
+		quantizedHeights = new unsigned short[numSlots];
+		packedNormals = new unsigned short[numSlots];
+		
+		//Start at the level nearest to 0, as for FLOATS
+		setHeight(0, 0, 0);
+		fill(quantizedHeights, quantizedHeights + numSlots,
+			 quantizedHeights[indexOf(0, 0)]);
+	}
+	else {
+		hs = new float[numSlots]();
+		normals = new Vec3f[numSlots];
+	}
+	
+	//None of the normals have been computed yet
+	dirtyMinX = 0;
+	dirtyMinZ = 0;
+	dirtyMaxX = w - 1;
+	dirtyMaxZ = l - 1;
+	changedMinX = 0;
+	changedMinZ = 0;
+	changedMaxX = w - 1;
+	changedMaxZ = l - 1;
+}
+
+Terrain::~Terrain() {
+	delete[] hs;
+	delete[] normals;
+	delete[] quantizedHeights;
+	delete[] packedNormals;
+}
+
+size_t Terrain::memorySize() const {
+	if (storage_ == QUANTIZED) {
+		return (size_t)numSlots * 2 * sizeof(unsigned short);
+	}
+	return (size_t)numSlots * (sizeof(float) + sizeof(Vec3f));
+}
+
+namespace {
+	//The least number of samples for which computeNormals starts a task
+	const int MIN_SAMPLES_PER_TASK = 16384;
+	//The least number of points for which parallelHeightsAt starts a task
+	const int MIN_POINTS_PER_TASK = 4096;
+	//The most rows of normals computeNormals smooths with one set of rough
+	//normals
+	const int NORMAL_BAND_ROWS = 64;
+	
+	static_assert(sizeof(Vec3f) == 3 * sizeof(float),
+				  "Vec3f must hold exactly three floats");
+	
+	/* Returns the coordinates of a vector as an array.  A Vec3f holds
+	 * nothing but its coordinates, and reading them this way avoids calling
+	 * Vec3f's functions, which aren't inline, several times for each point
+	 * in heightsAt.
+	 */
+	inline const float* coordinates(const Vec3f* v) {
+		return (const float*)v;
+	}
+	
+	inline float* coordinates(Vec3f* v) {
+		return (float*)v;
+	}
+	
+	/* Packs the direction of (x, y, z), which must not be the zero vector,
+	 * into 16 bits.  The vector is scaled onto the octahedron |x| + |y| +
+	 * |z| = 1, whose lower half is folded over the upper half, and the x and
+	 * z coordinates of the result are each rounded to 8 bits.
+	 */
+	unsigned short packNormal(float x, float y, float z) {
+		float sum = fabs(x) + fabs(y) + fabs(z);
+		float u = x / sum;
+		float v = z / sum;
+		if (y < 0) {
+			float u2 = (1 - fabs(v)) * (u >= 0 ? 1 : -1);
+			v = (1 - fabs(u)) * (v >= 0 ? 1 : -1);
+			u = u2;
+		}
+		int packedU = (int)((u + 1) * 127.5f + 0.5f);
+		int packedV = (int)((v + 1) * 127.5f + 0.5f);
+		return (unsigned short)(packedU | (packedV << 8));
+	}
+	
+	//Sets normal to the unit vector in the direction that packNormal packed
+	void unpackNormal(unsigned short packed, float* normal) {
+		float u = (packed & 255) / 127.5f - 1;
+		float v = (packed >> 8) / 127.5f - 1;
+		float y = 1 - fabs(u) - fabs(v);
+		if (y < 0) {
+			float u2 = (1 - fabs(v)) * (u >= 0 ? 1 : -1);
+			v = (1 - fabs(u)) * (v >= 0 ? 1 : -1);
+			u = u2;
+		}
+		float m = sqrt(u * u + y * y + v * v);
+		normal[0] = u / m;
+		normal[1] = y / m;
+		normal[2] = v / m;
+	}
+	
+	/* Adds (a, 1, b), normalized, to (sumX, sumY, sumZ).  The cross
+	 * products of the vectors from a sample to its neighbors all have this
+	 * form.
+	 */
+	inline void addNormalized(float a,
+							  float b,
+							  float &sumX,
+							  float &sumY,
+							  float &sumZ) {
+		float m = sqrt(a * a + 1 + b * b);
+		sumX += a / m;
+		sumY += 1 / m;
+		sumZ += b / m;
+	}
+	
+#ifdef __SSE__
+	//Does what addNormalized does for four vectors at once
+	inline void addNormalized4(__m128 a,
+							   __m128 b,
+							   __m128 &sumX,
+							   __m128 &sumY,
+							   __m128 &sumZ) {
+		__m128 one = _mm_set1_ps(1);
+		__m128 m = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), one),
+										  _mm_mul_ps(b, b)));
+		sumX = _mm_add_ps(sumX, _mm_div_ps(a, m));
+		sumY = _mm_add_ps(sumY, _mm_div_ps(one, m));
+		sumZ = _mm_add_ps(sumZ, _mm_div_ps(b, m));
+	}
+#endif
+	
+	/* Computes the rough normals of count samples that have neighbors on
+	 * every side.  row[i] is the height of the ith sample, above[i] and
+	 * below[i] are the heights of its neighbors in the -z and +z
+	 * directions, and row[i - 1] and row[i + 1] are the heights of its
+	 * neighbors in the -x and +x directions.
+	 */
+	void roughNormalKernel(const float* row,
+						   const float* above,
+						   const float* below,
+						   int count,
+						   float* xs,
+						   float* ys,
+						   float* zs) {
+		int i = 0;
+#ifdef __SSE__
+		__m128 signBit = _mm_set1_ps(-0.0f);
+		for(; i + 4 <= count; i += 4) {
+			__m128 h = _mm_loadu_ps(row + i);
+			__m128 left = _mm_sub_ps(_mm_loadu_ps(row + i - 1), h);
+			__m128 right = _mm_sub_ps(_mm_loadu_ps(row + i + 1), h);
+			__m128 out = _mm_sub_ps(_mm_loadu_ps(above + i), h);
+			__m128 in = _mm_sub_ps(_mm_loadu_ps(below + i), h);
+			__m128 negRight = _mm_xor_ps(right, signBit);
+			__m128 negIn = _mm_xor_ps(in, signBit);
+			
+			__m128 sumX = _mm_setzero_ps();
+			__m128 sumY = _mm_setzero_ps();
+			__m128 sumZ = _mm_setzero_ps();
+			addNormalized4(left, out, sumX, sumY, sumZ);
+			addNormalized4(left, negIn, sumX, sumY, sumZ);
+			addNormalized4(negRight, negIn, sumX, sumY, sumZ);
+			addNormalized4(negRight, out, sumX, sumY, sumZ);
+			_mm_storeu_ps(xs + i, sumX);
+			_mm_storeu_ps(ys + i, sumY);
+			_mm_storeu_ps(zs + i, sumZ);
+		}
+#endif
+		
+		for(; i < count; i++) {
+			float h = row[i];
+			float left = row[i - 1] - h;
+			float right = row[i + 1] - h;
+			float out = above[i] - h;
+			float in = below[i] - h;
+			
+			float sumX = 0;
+			float sumY = 0;
+			float sumZ = 0;
+			addNormalized(left, out, sumX, sumY, sumZ);
+			addNormalized(left, -in, sumX, sumY, sumZ);
+			addNormalized(-right, -in, sumX, sumY, sumZ);
+			addNormalized(-right, out, sumX, sumY, sumZ);
+			xs[i] = sumX;
+			ys[i] = sumY;
+			zs[i] = sumZ;
+		}
+	}
+	
+	/* Smooths count rough normals whose samples have neighbors on every
+	 * side, storing the results in outXs, outYs, and outZs.  xs, ys, and zs
+	 * point to the first sample's rough normal in arrays where the rough
+	 * normals of the samples' neighbors in the -z and +z directions are
+	 * stride elements before and after theirs.
+	 */
+	void smoothNormalKernel(const float* xs,
+							const float* ys,
+							const float* zs,
+							int stride,
+							int count,
+							float* outXs,
+							float* outYs,
+							float* outZs) {
+		const float FALLOUT_RATIO = 0.5f;
+		const float* coords[3] = {xs, ys, zs};
+		float* outCoords[3] = {outXs, outYs, outZs};
+		int i = 0;
+#ifdef __SSE__
+		__m128 ratio = _mm_set1_ps(FALLOUT_RATIO);
+		__m128 zero = _mm_setzero_ps();
+		__m128 one = _mm_set1_ps(1);
+		for(; i + 4 <= count; i += 4) {
+			__m128 sums[3];
+			for(int j = 0; j < 3; j++) {
+				const float* c = coords[j] + i;
+				__m128 sum = _mm_loadu_ps(c);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c - 1), ratio));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c + 1), ratio));
+				sum = _mm_add_ps(sum,
+								 _mm_mul_ps(_mm_loadu_ps(c - stride), ratio));
+				sum = _mm_add_ps(sum,
+								 _mm_mul_ps(_mm_loadu_ps(c + stride), ratio));
+				sums[j] = sum;
+			}
+			
+			//Use (0, 1, 0) where the sum is zero
+			__m128 magnitudeSquared = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(sums[0], sums[0]),
+						   _mm_mul_ps(sums[1], sums[1])),
+				_mm_mul_ps(sums[2], sums[2]));
+			__m128 isZero = _mm_cmpeq_ps(magnitudeSquared, zero);
+			sums[0] = _mm_andnot_ps(isZero, sums[0]);
+			sums[1] = _mm_or_ps(_mm_andnot_ps(isZero, sums[1]),
+								_mm_and_ps(isZero, one));
+			sums[2] = _mm_andnot_ps(isZero, sums[2]);
+			for(int j = 0; j < 3; j++) {
+				_mm_storeu_ps(outCoords[j] + i, sums[j]);
+			}
+		}
+#endif
+		
+		for(; i < count; i++) {
+			float sums[3];
+			for(int j = 0; j < 3; j++) {
+				const float* c = coords[j] + i;
+				float sum = c[0];
+				sum += c[-1] * FALLOUT_RATIO;
+				sum += c[1] * FALLOUT_RATIO;
+				sum += c[-stride] * FALLOUT_RATIO;
+				sum += c[stride] * FALLOUT_RATIO;
+				sums[j] = sum;
+			}
+			
+			if (sums[0] * sums[0] + sums[1] * sums[1] + sums[2] * sums[2] ==
+				0) {
+				sums[0] = 0;
+				sums[1] = 1;
+				sums[2] = 0;
+			}
+			for(int j = 0; j < 3; j++) {
+				outCoords[j][i] = sums[j];
+			}
+		}
+	}
+}
+
+void Terrain::getQuantizedCellHeights(int x, int z, float* heights) const {
+	int indices[4];
+	cellIndices(x, z, indices);
+	for(int i = 0; i < 4; i++) {
+		heights[i] = heightOffset + heightScale * quantizedHeights[indices[i]];
+	}
+}
+
+void Terrain::getPackedCellNormals(int x, int z, float* cellNormals) const {
+	int indices[4];
+	cellIndices(x, z, indices);
+	for(int i = 0; i < 4; i++) {
+		unpackNormal(packedNormals[indices[i]], cellNormals + 3 * i);
+	}
+}
+
+void Terrain::normalWithIndex(int i, float* normal) const {
+	if (storage_ == QUANTIZED) {
+		unpackNormal(packedNormals[i], normal);
+		return;
+	}
+	
+	const float* n = coordinates(normals + i);
+	normal[0] = n[0];
+	normal[1] = n[1];
+	normal[2] = n[2];
+}
+
+void Terrain::setNormalWithIndex(int i, float x, float y, float z) {
+	if (storage_ == QUANTIZED) {
+		packedNormals[i] = packNormal(x, y, z);
+	}
+	else {
+		normals[i] = Vec3f(x, y, z);
+	}
+}
+
+const float* Terrain::heightRow(int z,
+								int minX,
+								int maxX,
+								float* buffer) const {
+	if (layout_ == ROW_MAJOR && storage_ == FLOATS) {
+		return hs + z * w + minX;
+	}
+	
+	for(int x = minX; x <= maxX; x++) {
+		buffer[x - minX] = getHeight(x, z);
+	}
+	return buffer;
+}
+
+void Terrain::computeRoughNormal(RoughNormals &rough, int x, int z) {
+	float h = getHeight(x, z);
+	float out = 0;
+	if (z > 0) {
+		out = getHeight(x, z - 1) - h;
+	}
+	float in = 0;
+	if (z < l - 1) {
+		in = getHeight(x, z + 1) - h;
+	}
+	float left = 0;
+	if (x > 0) {
+		left = getHeight(x - 1, z) - h;
+	}
+	float right = 0;
+	if (x < w - 1) {
+		right = getHeight(x + 1, z) - h;
+	}
+	
+	//Add up the normalized cross products of the vectors to adjacent pairs
+	//of neighbors
+	float sumX = 0;
+	float sumY = 0;
+	float sumZ = 0;
+	if (x > 0 && z > 0) {
+		addNormalized(left, out, sumX, sumY, sumZ);
+	}
+	if (x > 0 && z < l - 1) {
+		addNormalized(left, -in, sumX, sumY, sumZ);
+	}
+	if (x < w - 1 && z < l - 1) {
+		addNormalized(-right, -in, sumX, sumY, sumZ);
+	}
+	if (x < w - 1 && z > 0) {
+		addNormalized(-right, out, sumX, sumY, sumZ);
+	}
+	int i = (z - rough.minZ) * rough.stride + x - rough.minX;
+	rough.xs[i] = sumX;
+	rough.ys[i] = sumY;
+	rough.zs[i] = sumZ;
+}
+
+void Terrain::computeRoughNormals(RoughNormals &rough,
+								  int z,
+								  int minX,
+								  int maxX,
+								  float* buffer) {
+	//The samples on the edges of the terrain are missing neighbors
+	int startX = max(minX, 1);
+	int endX = min(maxX, w - 2);
+	if (z == 0 || z == l - 1 || startX > endX) {
+		for(int x = minX; x <= maxX; x++) {
+			computeRoughNormal(rough, x, z);
+		}
+		return;
+	}
+	if (minX < startX) {
+		computeRoughNormal(rough, minX, z);
+	}
+	if (maxX > endX) {
+		computeRoughNormal(rough, maxX, z);
+	}
+	
+	int count = endX - startX + 1;
+	const float* row = heightRow(z, startX - 1, endX + 1, buffer) + 1;
+	const float* above = heightRow(z - 1, startX, endX, buffer + count + 2);
+	const float* below =
+		heightRow(z + 1, startX, endX, buffer + 2 * count + 4);
+	int i = (z - rough.minZ) * rough.stride + startX - rough.minX;
+	roughNormalKernel(row, above, below, count,
+					  rough.xs + i, rough.ys + i, rough.zs + i);
+}
+
+void Terrain::smoothNormal(const RoughNormals &rough, int x, int z) {
+	const float FALLOUT_RATIO = 0.5f;
+	int i = (z - rough.minZ) * rough.stride + x - rough.minX;
+	const float* coords[3] = {rough.xs, rough.ys, rough.zs};
+	float sums[3];
+	for(int j = 0; j < 3; j++) {
+		const float* c = coords[j] + i;
+		float sum = c[0];
+		if (x > 0) {
+			sum += c[-1] * FALLOUT_RATIO;
+		}
+		if (x < w - 1) {
+			sum += c[1] * FALLOUT_RATIO;
+		}
+		if (z > 0) {
+			sum += c[-rough.stride] * FALLOUT_RATIO;
+		}
+		if (z < l - 1) {
+			sum += c[rough.stride] * FALLOUT_RATIO;
+		}
+		sums[j] = sum;
+	}
+	
+	if (sums[0] * sums[0] + sums[1] * sums[1] + sums[2] * sums[2] == 0) {
+		sums[0] = 0;
+		sums[1] = 1;
+		sums[2] = 0;
+	}
+	setNormalWithIndex(indexOf(x, z), sums[0], sums[1], sums[2]);
+}
+
+void Terrain::smoothNormals(const RoughNormals &rough,
+							int z,
+							int minX,
+							int maxX,
+							float* buffer) {
+	//The samples on the edges of the terrain are missing neighbors
+	int startX = max(minX, 1);
+	int endX = min(maxX, w - 2);
+	if (z == 0 || z == l - 1 || startX > endX) {
+		for(int x = minX; x <= maxX; x++) {
+			smoothNormal(rough, x, z);
+		}
+		return;
+	}
+	if (minX < startX) {
+		smoothNormal(rough, minX, z);
+	}
+	if (maxX > endX) {
+		smoothNormal(rough, maxX, z);
+	}
+	
+	int count = endX - startX + 1;
+	int i = (z - rough.minZ) * rough.stride + startX - rough.minX;
+	smoothNormalKernel(rough.xs + i, rough.ys + i, rough.zs + i,
+					   rough.stride, count,
+					   buffer, buffer + count, buffer + 2 * count);
+	for(int x = startX; x <= endX; x++) {
+		int j = x - startX;
+		setNormalWithIndex(indexOf(x, z),
+						   buffer[j],
+						   buffer[count + j],
+						   buffer[2 * count + j]);
+	}
+}
+
+void Terrain::computeNormals(bool useThreads) {
+	if (dirtyMinX > dirtyMaxX) {
+		return;
+	}
+	
+	//A changed height changes the rough normals of its neighbors, which
+	//change the smoothed normals of their neighbors
+	int minX = max(dirtyMinX - 2, 0);
+	int minZ = max(dirtyMinZ - 2, 0);
+	int maxX = min(dirtyMaxX + 2, w - 1);
+	int maxZ = min(dirtyMaxZ + 2, l - 1);
+	int roughMinX = max(minX - 1, 0);
+	int roughMaxX = min(maxX + 1, w - 1);
+	int roughWidth = roughMaxX - roughMinX + 1;
+	
+	/* Split the rows among the threads.  Each thread works through its rows
+	 * in bands, computing the rough normals of a band and of the rows on
+	 * either side of it, and then smoothing out the band's normals, so that
+	 * the rough normals only need memory for a few rows at a time.
+	 */
+	auto computeRows = [&](int begin, int end) {
+		int bandSize = roughWidth * (NORMAL_BAND_ROWS + 2);
+		vector<float> roughCoords(3 * bandSize);
+		vector<float> buffer(3 * (roughWidth + 2));
+		for(int bandMinZ = minZ + begin; bandMinZ < minZ + end;
+			bandMinZ += NORMAL_BAND_ROWS) {
+			int bandMaxZ = min(bandMinZ + NORMAL_BAND_ROWS, minZ + end) - 1;
+			RoughNormals rough;
+			rough.xs = &roughCoords[0];
+			rough.ys = rough.xs + bandSize;
+			rough.zs = rough.ys + bandSize;
+			rough.minX = roughMinX;
+			rough.minZ = max(bandMinZ - 1, 0);
+			rough.stride = roughWidth;
+			for(int z = rough.minZ; z <= min(bandMaxZ + 1, l - 1); z++) {
+				computeRoughNormals(rough, z, roughMinX, roughMaxX,
+									&buffer[0]);
+			}
+			for(int z = bandMinZ; z <= bandMaxZ; z++) {
+				smoothNormals(rough, z, minX, maxX, &buffer[0]);
+			}
+		}
+	};
+	if (useThreads) {
+		int width = maxX - minX + 1;
+		defaultThreadPool()->parallelFor(maxZ - minZ + 1,
+										 computeRows,
+										 max(MIN_SAMPLES_PER_TASK / width, 1));
+	}
+	else {
+		computeRows(0, maxZ - minZ + 1);
+	}
+	
+	changedMinX = min(changedMinX, minX);
+	changedMinZ = min(changedMinZ, minZ);
+	changedMaxX = max(changedMaxX, maxX);
+	changedMaxZ = max(changedMaxZ, maxZ);
+	dirtyMinX = w;
+	dirtyMinZ = l;
+	dirtyMaxX = -1;
+	dirtyMaxZ = -1;
+}
+
+bool Terrain::takeChangedRegion(int &minX, int &minZ, int &maxX, int &maxZ) {
+	computeNormals();
+	if (changedMinX > changedMaxX) {
+		return false;
+	}
+	
+	minX = changedMinX;
+	minZ = changedMinZ;
+	maxX = changedMaxX;
+	maxZ = changedMaxZ;
+	changedMinX = w;
+	changedMinZ = l;
+	changedMaxX = -1;
+	changedMaxZ = -1;
+	return true;
+}
+
+Terrain* loadTerrain(const char* filename,
+					 float height,
+					 Terrain::Layout layout,
+					 Terrain::Storage storage) {
+	size_t length = strlen(filename);
+	GrayImage* image;
+	if (length >= 4 && strcmp(filename + length - 4, ".r16") == 0) {
+		image = loadR16(filename);
+	}
+	else {
+		image = loadGrayBMP(filename);
+	}
+	
+	Terrain* t = new Terrain(image->width,
+							 image->height,
+							 layout,
+							 storage,
+							 -height,
+							 height);
+	for(int y = 0; y < image->height; y++) {
+		for(int x = 0; x < image->width; x++) {
+			unsigned short value = image->pixels[y * image->width + x];
+			float h = height * ((value / 65535.0f) - 0.5f);
+			t->setHeight(x, y, h);
+		}
+	}
+	
+	delete image;
+	t->computeNormals();
+	return t;
+}
+
+namespace {
+	/* Finds the grid cell of the terrain containing (x, z), after moving
+	 * (x, z) to lie within the bounds of the terrain.  Sets (cellX, cellZ)
+	 * to the cell's corner with the smallest coordinates and fracX and fracZ
+	 * to how far (x, z) is across the cell in each direction, from 0 to 1.
+	 */
+	void findCell(const Terrain* terrain,
+				  float x,
+				  float z,
+				  int &cellX,
+				  int &cellZ,
+				  float &fracX,
+				  float &fracZ) {
+		//Make (x, z) lie within the bounds of the terrain
+		if (x < 0) {
+			x = 0;
+		}
+		else if (x > terrain->width() - 1) {
+			x = terrain->width() - 1;
+		}
+		if (z < 0) {
+			z = 0;
+		}
+		else if (z > terrain->length() - 1) {
+			z = terrain->length() - 1;
+		}
+		
+		cellX = (int)x;
+		if (cellX == terrain->width() - 1) {
+			cellX--;
+		}
+		fracX = x - cellX;
+		
+		cellZ = (int)z;
+		if (cellZ == terrain->length() - 1) {
+			cellZ--;
+		}
+		fracZ = z - cellZ;
+	}
+	
+	/* Sets normal to the normal at the point fracX and fracZ of the way
+	 * across the grid cell whose corners have the specified normals.  This
+	 * does the same arithmetic as the SIMD version in heightsAt, so that
+	 * they give exactly the same results.
+	 */
+	void interpolateNormal(const float* cellNormals,
+						   float fracX,
+						   float fracZ,
+						   Vec3f* normal) {
+		float* v = coordinates(normal);
+		for(int i = 0; i < 3; i++) {
+			v[i] = (1 - fracX) * ((1 - fracZ) * cellNormals[i] +
+								  fracZ * cellNormals[6 + i]) +
+				fracX * ((1 - fracZ) * cellNormals[3 + i] +
+						 fracZ * cellNormals[9 + i]);
+		}
+		float m = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		for(int i = 0; i < 3; i++) {
+			v[i] /= m;
+		}
+	}
+	
+#ifdef __SSE2__
+	/* Returns the weighted averages that heightAt takes of the values at the
+	 * corners of grid cells, for four points at once.  Each of v11, v21,
+	 * v12, and v22 holds the values at one corner of the four points' cells,
+	 * in the order of Terrain::getCellHeights.
+	 */
+	inline __m128 interpolate4(__m128 fracX,
+							   __m128 fracZ,
+							   __m128 v11,
+							   __m128 v21,
+							   __m128 v12,
+							   __m128 v22) {
+		__m128 one = _mm_set1_ps(1);
+		__m128 oneMinusFracX = _mm_sub_ps(one, fracX);
+		__m128 oneMinusFracZ = _mm_sub_ps(one, fracZ);
+		return _mm_add_ps(
+			_mm_mul_ps(oneMinusFracX,
+					   _mm_add_ps(_mm_mul_ps(oneMinusFracZ, v11),
+								  _mm_mul_ps(fracZ, v12))),
+			_mm_mul_ps(fracX,
+					   _mm_add_ps(_mm_mul_ps(oneMinusFracZ, v21),
+								  _mm_mul_ps(fracZ, v22))));
+	}
+#endif
+}
+
+float heightAt(Terrain* terrain, float x, float z) {
+	//Compute the grid cell in which (x, z) lies and how close we are to the
+	//left and outward edges
+	int leftX;
+	int outZ;
+	float fracX;
+	float fracZ;
+	findCell(terrain, x, z, leftX, outZ, fracX, fracZ);
+	
+	//Compute the four heights for the grid cell
+	float heights[4];
+	terrain->getCellHeights(leftX, outZ, heights);
+	float h11 = heights[0];
+	float h12 = heights[2];
+	float h21 = heights[1];
+	float h22 = heights[3];
+	
+	//Take a weighted average of the four heights
+	return (1 - fracX) * ((1 - fracZ) * h11 + fracZ * h12) +
+		fracX * ((1 - fracZ) * h21 + fracZ * h22);
+}
+
+void heightsAt(Terrain* terrain,
+			   const float* xs,
+			   const float* zs,
+			   int count,
+			   float* heights,
+			   Vec3f* normals) {
+	if (normals != NULL) {
+		terrain->computeNormals();
+	}
+	
+	int i = 0;
+#ifdef __SSE2__
+	/* Find the cells and interpolate the heights four points at a time.
+	 * There is no SSE instruction for loading from four addresses, so we
+	 * load the corners of each point's cell separately, and then transpose
+	 * them so that each register has the same corner for all four points.
+	 */
+	__m128 zero = _mm_setzero_ps();
+	__m128 maxX = _mm_set1_ps((float)(terrain->width() - 1));
+	__m128 maxZ = _mm_set1_ps((float)(terrain->length() - 1));
+	__m128 maxCellX = _mm_set1_ps((float)(terrain->width() - 2));
+	__m128 maxCellZ = _mm_set1_ps((float)(terrain->length() - 2));
+	for(; i + 4 <= count; i += 4) {
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(xs + i), zero), maxX);
+		__m128 z = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(zs + i), zero), maxZ);
+		__m128 cellX =
+			_mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(x)), maxCellX);
+		__m128 cellZ =
+			_mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(z)), maxCellZ);
+		__m128 fracX = _mm_sub_ps(x, cellX);
+		__m128 fracZ = _mm_sub_ps(z, cellZ);
+		
+		int cellXs[4];
+		int cellZs[4];
+		_mm_storeu_si128((__m128i*)cellXs, _mm_cvttps_epi32(cellX));
+		_mm_storeu_si128((__m128i*)cellZs, _mm_cvttps_epi32(cellZ));
+		float cellHeights[4][4];
+		for(int j = 0; j < 4; j++) {
+			terrain->getCellHeights(cellXs[j], cellZs[j], cellHeights[j]);
+		}
+		__m128 h11 = _mm_loadu_ps(cellHeights[0]);
+		__m128 h21 = _mm_loadu_ps(cellHeights[1]);
+		__m128 h12 = _mm_loadu_ps(cellHeights[2]);
+		__m128 h22 = _mm_loadu_ps(cellHeights[3]);
+		_MM_TRANSPOSE4_PS(h11, h21, h12, h22);
+		
+		//Take the same weighted average as heightAt, in the same order, so
+		//that the results are exactly the same
+		_mm_storeu_ps(heights + i,
+					  interpolate4(fracX, fracZ, h11, h21, h12, h22));
+		
+		if (normals != NULL) {
+			//Interpolate each coordinate of the normals in the same way, and
+			//normalize them as interpolateNormal does
+			float cellNormals[4][12];
+			for(int j = 0; j < 4; j++) {
+				terrain->getCellNormals(cellXs[j], cellZs[j], cellNormals[j]);
+			}
+			__m128 coords[3];
+			for(int k = 0; k < 3; k++) {
+				__m128 corners[4];
+				for(int c = 0; c < 4; c++) {
+					corners[c] = _mm_set_ps(cellNormals[3][3 * c + k],
+											cellNormals[2][3 * c + k],
+											cellNormals[1][3 * c + k],
+											cellNormals[0][3 * c + k]);
+				}
+				coords[k] = interpolate4(fracX, fracZ, corners[0], corners[1],
+										 corners[2], corners[3]);
+			}
+			__m128 m = _mm_sqrt_ps(
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(coords[0], coords[0]),
+									  _mm_mul_ps(coords[1], coords[1])),
+						   _mm_mul_ps(coords[2], coords[2])));
+			float normalCoords[3][4];
+			for(int k = 0; k < 3; k++) {
+				_mm_storeu_ps(normalCoords[k], _mm_div_ps(coords[k], m));
+			}
+			for(int j = 0; j < 4; j++) {
+				float* normal = coordinates(normals + i + j);
+				for(int k = 0; k < 3; k++) {
+					normal[k] = normalCoords[k][j];
+				}
+			}
+		}
+	}
+#endif
+	
+	for(; i < count; i++) {
+		heights[i] = heightAt(terrain, xs[i], zs[i]);
+		if (normals != NULL) {
+			int cellX;
+			int cellZ;
+			float fracX;
+			float fracZ;
+			findCell(terrain, xs[i], zs[i], cellX, cellZ, fracX, fracZ);
+			float cellNormals[12];
+			terrain->getCellNormals(cellX, cellZ, cellNormals);
+			interpolateNormal(cellNormals, fracX, fracZ, normals + i);
+		}
+	}
+}
+
+void parallelHeightsAt(Terrain* terrain,
+					   const float* xs,
+					   const float* zs,
+					   int count,
+					   float* heights,
+					   Vec3f* normals) {
+	//Compute the normals before splitting up the work, so that the threads
+	//only read from the terrain
+	if (normals != NULL) {
+		terrain->computeNormals();
+	}
+	
+	defaultThreadPool()->parallelFor(count, [&](int begin, int end) {
+		heightsAt(terrain,
+				  xs + begin,
+				  zs + begin,
+				  end - begin,
+				  heights + begin,
+				  normals != NULL ? normals + begin : NULL);
+	}, MIN_POINTS_PER_TASK);
+}
+
+void makeCrater(Terrain* terrain, float x, float z, float radius, float depth) {
+	//The rim reaches out to RIM_RADIUS times the radius
+	const float RIM_RADIUS = 1.6f;
+	const float RIM_HEIGHT = 0.3f; //The rim's height, relative to the depth
+	const float RIM_WIDTH = 0.25f; //The rim's width, relative to the radius
+	
+	int minX = max((int)floor(x - RIM_RADIUS * radius), 0);
+	int minZ = max((int)floor(z - RIM_RADIUS * radius), 0);
+	int maxX = min((int)ceil(x + RIM_RADIUS * radius), terrain->width() - 1);
+	int maxZ = min((int)ceil(z + RIM_RADIUS * radius), terrain->length() - 1);
+	for(int z2 = minZ; z2 <= maxZ; z2++) {
+		for(int x2 = minX; x2 <= maxX; x2++) {
+			float dx = x2 - x;
+			float dz = z2 - z;
+			float d = sqrt(dx * dx + dz * dz) / radius;
+			if (d >= RIM_RADIUS) {
+				continue;
+			}
+			
+			float change = 0;
+			if (d < 1) {
+				change = depth * (d * d - 1);
+			}
+			float rim = (d - 1) / RIM_WIDTH;
+			change += RIM_HEIGHT * depth * exp(-rim * rim);
+			terrain->setHeight(x2, z2, terrain->getHeight(x2, z2) + change);
+		}
+	}
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,332 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_DRAWER_H_INCLUDED
+#define TERRAIN_DRAWER_H_INCLUDED
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "terrain.h"
+
+//The greatest number of grid cells along each side of a TerrainDrawer chunk
+const int TERRAIN_CHUNK_SIZE = 64;
+//The number of levels of detail at which TerrainDrawer can draw a chunk.
+//Level i uses every 2^i-th sample.
+const int TERRAIN_NUM_LEVELS = 7;
+
+/* Draws a terrain from vertex buffers, where available, that are uploaded
+ * once and then only updated where the terrain changes.  The terrain is
+ * split into chunks of at most TERRAIN_CHUNK_SIZE x TERRAIN_CHUNK_SIZE grid
+ * cells, each with its own vertex buffer, so that drawing it takes a few
+ * calls per chunk, however many samples the terrain has.
+ *
+ * The chunks are the leaves of a quadtree whose nodes know the range of
+ * heights below them, so that the parts of the terrain outside the view
+ * frustum are skipped a node at a time.  Each visible chunk is drawn at a
+ * level of detail chosen from its distance to the camera, such that skipping
+ * samples moves the surface by at most about maxPixelError pixels on the
+ * screen, or more if that's needed to stay within the triangle budget.
+ * Every chunk has a skirt hanging down from its edges, which hides the
+ * cracks between chunks drawn at different levels of detail.  Chunks with
+ * the same size and level of detail share an index buffer.
+ *
+ * Since the terrain's light usually doesn't move relative to it, the drawer
+ * can bake the lighting into the vertices' colors, optionally with ambient
+ * occlusion, so that the terrain can be drawn without OpenGL's lighting.
+ *
+ * Where shaders can read textures and vertex ids, the drawer can skip the
+ * vertex buffers, which spend 24 bytes on each sample, and keep the heights
+ * in a texture instead, with one float per sample.  A vertex shader then
+ * finds each vertex's x and z from its id and the chunk's position, reads
+ * its height, and computes its normal from the heights of its neighbors.
+ * Every chunk of the same size uses the same indices, so the chunks need no
+ * vertex data of their own.
+ */
+class TerrainDrawer {
+	private:
+		//The indices for drawing chunks of some size at some level of detail,
+		//as one triangle strip
+		struct ChunkIndices {
+			GLuint bufferId; //The index buffer, or 0 if we aren't using one
+			std::vector<GLushort> indices;
+			int numTriangles; //The number of non-degenerate triangles
+		};
+		
+		struct Chunk {
+			//The position of the first sample in the chunk
+			int x;
+			int z;
+			//The number of grid cells across the chunk in each direction
+			int cellsX;
+			int cellsZ;
+			//The vertex buffer, or 0 if we aren't using vertex buffers
+			GLuint bufferId;
+			//The vertices, if we aren't using vertex buffers
+			std::vector<float> vertices;
+			//The vertices that update is about to copy to the chunk, starting
+			//with row updateMinZ, followed by the skirt if updateSkirt is true
+			std::vector<float> newVertices;
+			int updateMinZ;
+			int updateMaxZ;
+			bool updateSkirt;
+			float minHeight;
+			float maxHeight;
+			int numLevels; //The number of levels of detail for the chunk
+			//The greatest distance in y between the terrain and the chunk
+			//drawn at each level of detail
+			float errors[TERRAIN_NUM_LEVELS];
+			ChunkIndices* indices[TERRAIN_NUM_LEVELS];
+		};
+		
+		//A node of the quadtree over the chunks
+		struct Node {
+			//The corners of a box containing the part of the terrain in the
+			//node
+			Vec3f minCorner;
+			Vec3f maxCorner;
+			//The indices in nodes of the children, or -1 for those that the
+			//node doesn't have.  A node with no children is a chunk.
+			int children[4];
+			int chunk; //The index in chunks of the node's chunk, or -1
+		};
+		
+		Terrain* terrain;
+		bool useBuffers; //Whether we are using vertex buffers
+		//Whether we draw the chunks with a shader that reads the heights from
+		//heightTextureId, rather than from the chunks' vertices
+		bool useHeightTexture;
+		GLuint heightTextureId; //The heights, one float per sample
+		//The fraction of the sky visible from each sample as a byte, if we
+		//are using ambient occlusion with the height texture, or 0
+		GLuint occlusionTextureId;
+		GLuint programId; //The shader program for the height texture
+		//The locations of the uniforms of programId that change per chunk
+		GLint originLocation;
+		GLint cellsLocation;
+		GLint skirtDepthsLocation;
+		/* A buffer with a float for each vertex of the largest chunk, which
+		 * the shader ignores.  OpenGL's compatibility profile only draws
+		 * vertices when attribute 0 has an array.
+		 */
+		GLuint dummyBufferId;
+		std::vector<Chunk> chunks; //The chunks, row by row
+		int chunksPerRow;
+		std::vector<Node> nodes; //The quadtree, with the root first
+		//The indices for each size of chunk and level of detail, indexed by
+		//(chunk.cellsX, chunk.cellsZ) and then by the level of detail
+		std::map<std::pair<int, int>, ChunkIndices*> chunkIndices;
+		bool useLevelsOfDetail;
+		float maxPixelError;
+		int triangleBudget; //The most triangles to draw, or 0 for no limit
+		//The chunks and levels of detail chosen by the last call to draw
+		std::vector<int> drawnChunks;
+		std::vector<int> drawnLevels;
+		int trianglesDrawn; //The number of triangles in the last frame
+		//The number of floats uploaded to the vertex buffers since the last
+		//call to resetStats
+		long long floatsUploaded;
+		//Whether the vertices have colors with the lighting baked in rather
+		//than normals
+		bool useBakedLighting;
+		bool useAmbientOcclusion;
+		Vec3f lightDirection; //The unit vector toward the light
+		Vec3f color;
+		float ambient;
+		float diffuse;
+		
+		//Sets out[0], out[1], and out[2] to the normal at (x, z) or, if the
+		//lighting is baked, the color there
+		void shade(int x, int z, float* out);
+		
+		//Returns the indices for chunks with the specified numbers of grid
+		//cells, making them if necessary.  The result is an array with one
+		//element per level of detail.
+		ChunkIndices* indicesFor(int cellsX, int cellsZ);
+		//Sets out to the vertices for rows minZ to maxZ, relative to the
+		//chunk, of the specified chunk
+		void makeVertices(const Chunk &chunk,
+						  int minZ,
+						  int maxZ,
+						  std::vector<float> &out);
+		/* Returns the index in chunks of the chunk across the specified side
+		 * of a chunk, or -1 if that side is on the edge of the terrain.  The
+		 * sides are z = 0, z = cellsZ, x = 0, and x = cellsX, in that order.
+		 */
+		int neighbor(const Chunk &chunk, int side) const;
+		//Returns how far below the edges of the specified chunk its skirt on
+		//the specified side hangs
+		float skirtDepth(const Chunk &chunk, int side) const;
+		//Sets out to the vertices for the skirt of the specified chunk, which
+		//follow the other vertices in its buffer
+		void makeSkirtVertices(const Chunk &chunk, std::vector<float> &out);
+		//Copies numFloats floats of vertices to the specified chunk, starting
+		//at the specified offset in its vertices
+		void copyVertices(Chunk &chunk,
+						  int offset,
+						  const float* vertices,
+						  int numFloats);
+		//Computes the range of heights and the error at each level of detail
+		//for the specified chunk
+		void measureChunk(Chunk &chunk);
+		//Adds a node for the chunks from (minChunkX, minChunkZ) up to but not
+		//including (maxChunkX, maxChunkZ), and returns its index in nodes
+		int addNode(int minChunkX,
+					int minChunkZ,
+					int maxChunkX,
+					int maxChunkZ,
+					int chunksPerRow);
+		//Recomputes the boxes of the specified node and its descendants
+		void updateBoxes(int node);
+		/* Copies the part of the terrain from (minX, minZ) to (maxX, maxZ) to
+		 * the chunks that include it, along with the samples whose ambient
+		 * occlusion it affects.  The terrain's normals must be up to date.
+		 */
+		void update(int minX, int minZ, int maxX, int maxZ);
+		/* Remakes the vertices of the samples from (minX, minZ) to (maxX,
+		 * maxZ) and the skirts that depend on them or on the errors of the
+		 * chunks whose indices in chunks have true in "measured"
+		 */
+		void updateVertices(int minX,
+							int minZ,
+							int maxX,
+							int maxZ,
+							const std::vector<bool> &measured);
+		//Copies the heights or, if occlusion is true, the fraction of the
+		//sky visible from each sample from (minX, minZ) to (maxX, maxZ) to
+		//the specified texture
+		void updateTexture(GLuint textureId,
+						   bool occlusion,
+						   int minX,
+						   int minZ,
+						   int maxX,
+						   int maxZ);
+		//Makes the height texture and the shader program, returning false if
+		//OpenGL can't do it
+		bool initHeightTexture();
+		//Makes occlusionTextureId if make is true and we are using the height
+		//texture, and deletes it otherwise
+		void makeOcclusionTexture(bool make);
+		//Draws the chunks chosen by chooseChunks using the height texture
+		void drawFromHeightTexture();
+		//Sets drawnChunks and drawnLevels to the visible chunks and their
+		//levels of detail, using the current OpenGL matrices and viewport
+		void chooseChunks();
+	public:
+		/* Makes a drawer for the specified terrain.  There must be a current
+		 * OpenGL context.  The drawer keeps the heights in a texture if
+		 * allowHeightTexture is true and heightTextureSupported() returns
+		 * true, and uses vertex buffers otherwise.
+		 */
+		TerrainDrawer(Terrain* terrain2, bool allowHeightTexture = true);
+		~TerrainDrawer();
+		
+		/* Draws the terrain, with the current modelview matrix taking the
+		 * terrain's grid coordinates to the camera's coordinates, first
+		 * copying any parts of the terrain that have changed to the vertex
+		 * buffers
+		 */
+		void draw();
+		
+		//Sets whether distant chunks are drawn with fewer triangles.  This is
+		//on by default.
+		void setLevelsOfDetail(bool useLevelsOfDetail2);
+		bool levelsOfDetail() const;
+		//Sets how far, in pixels, skipping samples may move the surface on the
+		//screen.  This is 1.5 by default.
+		void setMaxPixelError(float maxPixelError2);
+		/* Sets the greatest number of triangles for draw to use, or 0 for no
+		 * limit, which is the default.  When the terrain would need more
+		 * triangles, the chunks whose errors would show least are drawn with
+		 * fewer, so the budget can be exceeded only if every visible chunk is
+		 * at its lowest level of detail.
+		 */
+		void setTriangleBudget(int triangleBudget2);
+		
+		/* Bakes the lighting from a directional light in the specified
+		 * direction, relative to the terrain's grid coordinates, into the
+		 * vertices, which then have colors rather than normals, so the terrain
+		 * should be drawn with GL_LIGHTING disabled.  A sample with normal n
+		 * gets the color
+		 *     color * (ambient * a + diffuse * max(n . l, 0)),
+		 * where l is the normalized light direction, which matches OpenGL's
+		 * lighting with GL_COLOR_MATERIAL and the specified ambient light and
+		 * diffuse light color.  a is 1, or the fraction of the sky not hidden
+		 * by the terrain around the sample if ambientOcclusion is true.  The
+		 * lighting is baked on the default thread pool, and rebaked where the
+		 * terrain changes.  With the height texture, the vertex shader
+		 * computes the same color, and only the ambient occlusion is baked.
+		 */
+		void setBakedLighting(Vec3f lightDirection2,
+							  Vec3f color2,
+							  float ambient2,
+							  float diffuse2,
+							  bool ambientOcclusion);
+		//Goes back to giving the vertices normals, for OpenGL's lighting,
+		//which is the default
+		void clearBakedLighting();
+		bool bakedLighting() const;
+		bool ambientOcclusion() const;
+		
+		/* Returns whether OpenGL can draw the terrain from a texture of its
+		 * heights, which takes shaders with EXT_gpu_shader4, float textures,
+		 * vertex texture fetches, and vertex buffers
+		 */
+		static bool heightTextureSupported();
+		//Returns whether the drawer keeps the heights in a texture rather than
+		//in vertex buffers
+		bool heightTexture() const;
+		//Returns the number of bytes of vertices and textures the drawer keeps
+		//for the terrain, not counting the indices
+		long long memorySize() const;
+		
+		int numChunks() const;
+		//Returns the number of chunks drawn by the last call to draw
+		int numChunksDrawn() const;
+		//Returns the number of triangles drawn by the last call to draw
+		int numTrianglesDrawn() const;
+		//Returns the number of floats that draw has copied to the vertex
+		//buffers since the last call to resetStats
+		long long floatsUploadedSinceReset() const;
+		void resetStats();
+};
+
+
+
+
+
+
+
+
+
+
+#endif
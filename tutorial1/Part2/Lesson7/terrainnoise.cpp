@@ -0,0 +1,295 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "terrainnoise.h"
+
+using namespace std;
+
+namespace {
+	//Constants for hashing the corners of the grid cells of the noise
+	const unsigned int HASH_X = 0x8da6b343u;
+	const unsigned int HASH_Z = 0xd8163841u;
+	const unsigned int HASH_MIX1 = 0x7feb352du;
+	const unsigned int HASH_MIX2 = 0x846ca68bu;
+	//Added to the seed for each octave, so that the octaves are unrelated
+	const unsigned int OCTAVE_SEED_STEP = 0x9e3779b9u;
+	//Mixed into the seed for the two sums that warp the points
+	const unsigned int WARP_SEED_X = 0x5bd1e995u;
+	const unsigned int WARP_SEED_Z = 0x1b873593u;
+	//Converts 16 bits of a hash to a gradient component from -1 to 1
+	const float GRADIENT_SCALE = 2.0f / 65535;
+	
+	//Finishes hashing a corner, given the sum of its hashed coordinates
+	unsigned int mixHash(unsigned int h) {
+		h ^= h >> 16;
+		h *= HASH_MIX1;
+		h ^= h >> 15;
+		h *= HASH_MIX2;
+		h ^= h >> 16;
+		return h;
+	}
+	
+	//Returns the contribution of a corner with the specified hash to the
+	//noise at the offset (dx, dz) from it
+	float cornerNoise(unsigned int h, float dx, float dz) {
+		float gx = (float)(int)(h & 0xffff) * GRADIENT_SCALE - 1;
+		float gz = (float)(int)(h >> 16) * GRADIENT_SCALE - 1;
+		return gx * dx + gz * dz;
+	}
+	
+	//Returns the smooth curve from 0 to 1 used to blend the corners
+	float fade(float t) {
+		return t * t * t * (t * (t * 6 - 15) + 10);
+	}
+	
+	float lerp(float a, float b, float t) {
+		return a + (b - a) * t;
+	}
+	
+	//Returns the gradient noise at (x, z), which is 0 at the corners of
+	//the grid cells and roughly from -1 to 1 between them
+	float gradientNoise(float x, float z, unsigned int seed) {
+		//Round down, in the same way as gradientNoise4
+		int ix = (int)x;
+		float fx = (float)ix;
+		if (fx > x) {
+			ix--;
+			fx -= 1;
+		}
+		int iz = (int)z;
+		float fz = (float)iz;
+		if (fz > z) {
+			iz--;
+			fz -= 1;
+		}
+		float tx = x - fx;
+		float tz = z - fz;
+		
+		unsigned int hx0 = (unsigned int)ix * HASH_X;
+		unsigned int hx1 = hx0 + HASH_X;
+		unsigned int hz0 = (unsigned int)iz * HASH_Z + seed;
+		unsigned int hz1 = hz0 + HASH_Z;
+		float n00 = cornerNoise(mixHash(hx0 + hz0), tx, tz);
+		float n10 = cornerNoise(mixHash(hx1 + hz0), tx - 1, tz);
+		float n01 = cornerNoise(mixHash(hx0 + hz1), tx, tz - 1);
+		float n11 = cornerNoise(mixHash(hx1 + hz1), tx - 1, tz - 1);
+		
+		float u = fade(tx);
+		float v = fade(tz);
+		return lerp(lerp(n00, n10, u), lerp(n01, n11, u), v);
+	}
+	
+	//Returns the sum of numOctaves octaves of noise at (x, z), the first
+	//with the specified frequency and a height of 1
+	float fractal(float x,
+				  float z,
+				  unsigned int seed,
+				  float frequency,
+				  int numOctaves) {
+		float sum = 0;
+		float amplitude = 1;
+		for(int i = 0; i < numOctaves; i++) {
+			sum += amplitude * gradientNoise(x * frequency,
+											 z * frequency,
+											 seed + i * OCTAVE_SEED_STEP);
+			frequency *= 2;
+			amplitude *= 0.5f;
+		}
+		return sum;
+	}
+	
+#ifdef __SSE2__
+	/* The following functions do the same as the ones above, to four points
+	 * at once, with the same operations in the same order, so that they
+	 * give exactly the same results.
+	 */
+	
+	//Returns the low 32 bits of the products of a and b; SSE2 has no
+	//instruction for this
+	__m128i multiply4(__m128i a, __m128i b) {
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+									_mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(
+			_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+	
+	__m128i mixHash4(__m128i h) {
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		h = multiply4(h, _mm_set1_epi32((int)HASH_MIX1));
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+		h = multiply4(h, _mm_set1_epi32((int)HASH_MIX2));
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		return h;
+	}
+	
+	__m128 cornerNoise4(__m128i h, __m128 dx, __m128 dz) {
+		__m128 scale = _mm_set1_ps(GRADIENT_SCALE);
+		__m128 one = _mm_set1_ps(1);
+		__m128 gx = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_and_si128(h, _mm_set1_epi32(0xffff))), scale), one);
+		__m128 gz = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_srli_epi32(h, 16)), scale), one);
+		return _mm_add_ps(_mm_mul_ps(gx, dx), _mm_mul_ps(gz, dz));
+	}
+	
+	__m128 fade4(__m128 t) {
+		__m128 a = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6)), _mm_set1_ps(15));
+		__m128 b = _mm_add_ps(_mm_mul_ps(t, a), _mm_set1_ps(10));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), b);
+	}
+	
+	__m128 lerp4(__m128 a, __m128 b, __m128 t) {
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+	
+	//Rounds x down, setting i to the result as integers and returning it as
+	//floats
+	__m128 floor4(__m128 x, __m128i &i) {
+		i = _mm_cvttps_epi32(x);
+		__m128 f = _mm_cvtepi32_ps(i);
+		__m128 tooHigh = _mm_cmpgt_ps(f, x);
+		//tooHigh is -1 as an integer where it is set
+		i = _mm_add_epi32(i, _mm_castps_si128(tooHigh));
+		return _mm_sub_ps(f, _mm_and_ps(tooHigh, _mm_set1_ps(1)));
+	}
+	
+	__m128 gradientNoise4(__m128 x, __m128 z, unsigned int seed) {
+		__m128i ix;
+		__m128i iz;
+		__m128 tx = _mm_sub_ps(x, floor4(x, ix));
+		__m128 tz = _mm_sub_ps(z, floor4(z, iz));
+		
+		__m128i hashX = _mm_set1_epi32((int)HASH_X);
+		__m128i hashZ = _mm_set1_epi32((int)HASH_Z);
+		__m128i hx0 = multiply4(ix, hashX);
+		__m128i hx1 = _mm_add_epi32(hx0, hashX);
+		__m128i hz0 = _mm_add_epi32(multiply4(iz, hashZ),
+									_mm_set1_epi32((int)seed));
+		__m128i hz1 = _mm_add_epi32(hz0, hashZ);
+		__m128 one = _mm_set1_ps(1);
+		__m128 tx1 = _mm_sub_ps(tx, one);
+		__m128 tz1 = _mm_sub_ps(tz, one);
+		__m128 n00 = cornerNoise4(mixHash4(_mm_add_epi32(hx0, hz0)), tx, tz);
+		__m128 n10 = cornerNoise4(mixHash4(_mm_add_epi32(hx1, hz0)), tx1, tz);
+		__m128 n01 = cornerNoise4(mixHash4(_mm_add_epi32(hx0, hz1)), tx, tz1);
+		__m128 n11 = cornerNoise4(mixHash4(_mm_add_epi32(hx1, hz1)), tx1, tz1);
+		
+		__m128 u = fade4(tx);
+		__m128 v = fade4(tz);
+		return lerp4(lerp4(n00, n10, u), lerp4(n01, n11, u), v);
+	}
+	
+	__m128 fractal4(__m128 x,
+					__m128 z,
+					unsigned int seed,
+					float frequency,
+					int numOctaves) {
+		__m128 sum = _mm_setzero_ps();
+		float amplitude = 1;
+		for(int i = 0; i < numOctaves; i++) {
+			__m128 f = _mm_set1_ps(frequency);
+			__m128 noise = gradientNoise4(_mm_mul_ps(x, f),
+										  _mm_mul_ps(z, f),
+										  seed + i * OCTAVE_SEED_STEP);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), noise));
+			frequency *= 2;
+			amplitude *= 0.5f;
+		}
+		return sum;
+	}
+#endif
+}
+
+TerrainNoise::TerrainNoise(unsigned int seed2,
+						   float height2,
+						   float featureSize2,
+						   int numOctaves2,
+						   float warp2) : seed(seed2),
+										  height(height2),
+										  featureSize(featureSize2),
+										  numOctaves(numOctaves2),
+										  warp(warp2) {
+	
+}
+
+float TerrainNoise::heightAt(float x, float z) const {
+	float frequency = 1 / featureSize;
+	if (warp != 0) {
+		float warpX = fractal(x, z, seed ^ WARP_SEED_X, frequency, numOctaves);
+		float warpZ = fractal(x, z, seed ^ WARP_SEED_Z, frequency, numOctaves);
+		x += warp * warpX;
+		z += warp * warpZ;
+	}
+	return height * fractal(x, z, seed, frequency, numOctaves);
+}
+
+void TerrainNoise::heightRow(int x, int z, int count, float* heights) const {
+	int i = 0;
+#ifdef __SSE2__
+	float frequency = 1 / featureSize;
+	__m128i offsets = _mm_set_epi32(3, 2, 1, 0);
+	__m128 warp4 = _mm_set1_ps(warp);
+	__m128 height4 = _mm_set1_ps(height);
+	for(; i + 4 <= count; i += 4) {
+		__m128 px = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x + i),
+												  offsets));
+		__m128 pz = _mm_set1_ps((float)z);
+		if (warp != 0) {
+			__m128 warpX =
+				fractal4(px, pz, seed ^ WARP_SEED_X, frequency, numOctaves);
+			__m128 warpZ =
+				fractal4(px, pz, seed ^ WARP_SEED_Z, frequency, numOctaves);
+			px = _mm_add_ps(px, _mm_mul_ps(warp4, warpX));
+			pz = _mm_add_ps(pz, _mm_mul_ps(warp4, warpZ));
+		}
+		_mm_storeu_ps(heights + i,
+					  _mm_mul_ps(height4, fractal4(px,
+												   pz,
+												   seed,
+												   frequency,
+												   numOctaves)));
+	}
+#endif
+	for(; i < count; i++) {
+		heights[i] = heightAt((float)(x + i), (float)z);
+	}
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,73 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_NOISE_H_INCLUDED
+#define TERRAIN_NOISE_H_INCLUDED
+
+/* Seeded fractal noise for making up terrains of any size, a piece at a
+ * time.  The height at a point is a sum of octaves of gradient noise, each
+ * with twice the detail and half the height of the one before.  With domain
+ * warping, each point is first pushed aside by two more such sums, which
+ * bends the hills and valleys into less regular shapes.
+ *
+ * The heights depend only on the seed, the settings, and the point, so
+ * pieces that are made separately, on any thread, agree wherever they meet.
+ */
+class TerrainNoise {
+	private:
+		unsigned int seed;
+		float height;
+		float featureSize;
+		int numOctaves;
+		float warp;
+	public:
+		/* Makes noise whose first octave has the specified height and a
+		 * wavelength of featureSize grid cells, and which pushes each
+		 * point aside by up to about warp2 grid cells, or doesn't warp if
+		 * warp2 is 0
+		 */
+		TerrainNoise(unsigned int seed2,
+					 float height2 = 20,
+					 float featureSize2 = 128,
+					 int numOctaves2 = 6,
+					 float warp2 = 0);
+		
+		//Returns the height at (x, z)
+		float heightAt(float x, float z) const;
+		/* Sets heights[i] to heightAt(x + i, z) for i from 0 to count - 1,
+		 * four at a time using SSE2 if available, with the same results
+		 */
+		void heightRow(int x, int z, int count, float* heights) const;
+};
+
+
+
+
+
+
+
+
+
+
+#endif
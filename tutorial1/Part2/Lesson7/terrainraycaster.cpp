@@ -0,0 +1,422 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <algorithm>
+#include <math.h>
+
+#include "terrainraycaster.h"
+#include "threadpool.h"
+
+using namespace std;
+
+namespace {
+	//The fewest rays parallelCastRays gives each task
+	const int MIN_RAYS_PER_TASK = 64;
+	//The most entries castRay's stack can need: three waiting siblings for
+	//each level of the pyramid of a terrain up to 2^31 samples wide, plus one
+	const int MAX_STACK_SIZE = 3 * 32 + 1;
+	
+	//A grid cell whose box of heights a ray passes through
+	struct CellCrossing {
+		float t; //How far along the ray it enters the box
+		int x;
+		int z;
+		float heights[4]; //As returned by Terrain::getCellHeights
+	};
+	
+	/* Narrows [tMin, tMax] to the part of the ray from origin in direction
+	 * that is inside the box from minCorner to maxCorner, and returns false
+	 * if no part of it is.  invDirection holds the reciprocals of the
+	 * nonzero coordinates of direction.
+	 */
+	bool clipToBox(const float* origin,
+				   const float* direction,
+				   const float* invDirection,
+				   const float* minCorner,
+				   const float* maxCorner,
+				   float &tMin,
+				   float &tMax) {
+		for(int i = 0; i < 3; i++) {
+			if (direction[i] == 0) {
+				if (origin[i] < minCorner[i] || origin[i] > maxCorner[i]) {
+					return false;
+				}
+				continue;
+			}
+			
+			float t1 = (minCorner[i] - origin[i]) * invDirection[i];
+			float t2 = (maxCorner[i] - origin[i]) * invDirection[i];
+			if (t1 > t2) {
+				swap(t1, t2);
+			}
+			tMin = max(tMin, t1);
+			tMax = min(tMax, t2);
+			if (tMin > tMax) {
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	/* Returns whether the ray from origin in direction hits either side of
+	 * the triangle (a, b, c) between tMin and tMax, and if so sets t to how
+	 * far along the ray the hit is
+	 */
+	bool castRayAtTriangle(const float* origin,
+						   const float* direction,
+						   const float* a,
+						   const float* b,
+						   const float* c,
+						   float tMin,
+						   float tMax,
+						   float &t) {
+		float edge1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		float edge2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		float p[3] = {direction[1] * edge2[2] - direction[2] * edge2[1],
+					  direction[2] * edge2[0] - direction[0] * edge2[2],
+					  direction[0] * edge2[1] - direction[1] * edge2[0]};
+		float det = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+		if (det == 0) {
+			return false;
+		}
+		
+		//Find the barycentric coordinates (u, v) of the hit
+		float invDet = 1 / det;
+		float s[3] = {origin[0] - a[0], origin[1] - a[1], origin[2] - a[2]};
+		float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+		if (u < 0 || u > 1) {
+			return false;
+		}
+		float q[3] = {s[1] * edge1[2] - s[2] * edge1[1],
+					  s[2] * edge1[0] - s[0] * edge1[2],
+					  s[0] * edge1[1] - s[1] * edge1[0]};
+		float v = (direction[0] * q[0] + direction[1] * q[1] +
+				   direction[2] * q[2]) * invDet;
+		if (v < 0 || u + v > 1) {
+			return false;
+		}
+		
+		float t2 = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) *
+			invDet;
+		if (t2 < tMin || t2 > tMax) {
+			return false;
+		}
+		t = t2;
+		return true;
+	}
+}
+
+TerrainRaycaster::TerrainRaycaster(Terrain* terrain1) : terrain(terrain1) {
+	cellsX = terrain->width() - 1;
+	cellsZ = terrain->length() - 1;
+	
+	int numX = (cellsX + TERRAIN_RAY_BLOCK_SIZE - 1) >> TERRAIN_RAY_BLOCK_SHIFT;
+	int numZ = (cellsZ + TERRAIN_RAY_BLOCK_SIZE - 1) >> TERRAIN_RAY_BLOCK_SHIFT;
+	while (true) {
+		Level level;
+		level.numX = numX;
+		level.numZ = numZ;
+		level.bounds.resize(2 * numX * numZ);
+		levels.push_back(level);
+		if (numX == 1 && numZ == 1) {
+			break;
+		}
+		numX = (numX + 1) / 2;
+		numZ = (numZ + 1) / 2;
+	}
+	
+	computeBounds(0, 0, levels[0].numX - 1, levels[0].numZ - 1);
+}
+
+void TerrainRaycaster::computeBounds(int minX, int minZ, int maxX, int maxZ) {
+	//Find the smallest and largest height of the samples in each block, in
+	//parallel by rows of blocks
+	Level &blocks = levels[0];
+	defaultThreadPool()->parallelFor(maxZ - minZ + 1, [&](int begin, int end) {
+		for(int blockZ = minZ + begin; blockZ < minZ + end; blockZ++) {
+			int startZ = blockZ << TERRAIN_RAY_BLOCK_SHIFT;
+			int endZ = min(startZ + TERRAIN_RAY_BLOCK_SIZE, cellsZ);
+			for(int blockX = minX; blockX <= maxX; blockX++) {
+				int startX = blockX << TERRAIN_RAY_BLOCK_SHIFT;
+				int endX = min(startX + TERRAIN_RAY_BLOCK_SIZE, cellsX);
+				float minHeight = terrain->getHeight(startX, startZ);
+				float maxHeight = minHeight;
+				for(int z = startZ; z <= endZ; z++) {
+					for(int x = startX; x <= endX; x++) {
+						float h = terrain->getHeight(x, z);
+						minHeight = min(minHeight, h);
+						maxHeight = max(maxHeight, h);
+					}
+				}
+				float* bounds =
+					&blocks.bounds[2 * (blockZ * blocks.numX + blockX)];
+				bounds[0] = minHeight;
+				bounds[1] = maxHeight;
+			}
+		}
+	}, 16);
+	
+	//Each part above the blocks gets the bounds of the 2 x 2 parts below it
+	for(unsigned int i = 1; i < levels.size(); i++) {
+		const Level &below = levels[i - 1];
+		Level &level = levels[i];
+		minX /= 2;
+		minZ /= 2;
+		maxX /= 2;
+		maxZ /= 2;
+		for(int z = minZ; z <= maxZ; z++) {
+			for(int x = minX; x <= maxX; x++) {
+				const float* bounds = &below.bounds[4 * (z * below.numX + x)];
+				float minHeight = bounds[0];
+				float maxHeight = bounds[1];
+				bool right = 2 * x + 1 < below.numX;
+				bool down = 2 * z + 1 < below.numZ;
+				if (right) {
+					minHeight = min(minHeight, bounds[2]);
+					maxHeight = max(maxHeight, bounds[3]);
+				}
+				if (down) {
+					const float* bounds2 = bounds + 2 * below.numX;
+					minHeight = min(minHeight, bounds2[0]);
+					maxHeight = max(maxHeight, bounds2[1]);
+					if (right) {
+						minHeight = min(minHeight, bounds2[2]);
+						maxHeight = max(maxHeight, bounds2[3]);
+					}
+				}
+				level.bounds[2 * (z * level.numX + x)] = minHeight;
+				level.bounds[2 * (z * level.numX + x) + 1] = maxHeight;
+			}
+		}
+	}
+}
+
+void TerrainRaycaster::heightsChanged(int minX, int minZ, int maxX, int maxZ) {
+	//A sample is in the blocks of the grid cells on either side of it
+	const Level &blocks = levels[0];
+	int minBlockX = max((minX - 1) >> TERRAIN_RAY_BLOCK_SHIFT, 0);
+	int minBlockZ = max((minZ - 1) >> TERRAIN_RAY_BLOCK_SHIFT, 0);
+	int maxBlockX = min(maxX >> TERRAIN_RAY_BLOCK_SHIFT, blocks.numX - 1);
+	int maxBlockZ = min(maxZ >> TERRAIN_RAY_BLOCK_SHIFT, blocks.numZ - 1);
+	if (minBlockX <= maxBlockX && minBlockZ <= maxBlockZ) {
+		computeBounds(minBlockX, minBlockZ, maxBlockX, maxBlockZ);
+	}
+}
+
+int TerrainRaycaster::numLevels() const {
+	return (int)levels.size();
+}
+
+bool TerrainRaycaster::castRayInBlock(int blockX,
+									  int blockZ,
+									  const float* origin,
+									  const float* direction,
+									  const float* invDirection,
+									  float tMin,
+									  float tMax,
+									  float &t) const {
+	//Find the grid cells whose boxes of heights the ray passes through,
+	//sorted by where the ray enters them
+	CellCrossing crossings[TERRAIN_RAY_BLOCK_SIZE * TERRAIN_RAY_BLOCK_SIZE];
+	int numCrossings = 0;
+	int startX = blockX << TERRAIN_RAY_BLOCK_SHIFT;
+	int startZ = blockZ << TERRAIN_RAY_BLOCK_SHIFT;
+	int endX = min(startX + TERRAIN_RAY_BLOCK_SIZE, cellsX);
+	int endZ = min(startZ + TERRAIN_RAY_BLOCK_SIZE, cellsZ);
+	for(int z = startZ; z < endZ; z++) {
+		for(int x = startX; x < endX; x++) {
+			CellCrossing crossing;
+			float* h = crossing.heights;
+			terrain->getCellHeights(x, z, h);
+			float minCorner[3] = {(float)x,
+								  min(min(h[0], h[1]), min(h[2], h[3])),
+								  (float)z};
+			float maxCorner[3] = {(float)(x + 1),
+								  max(max(h[0], h[1]), max(h[2], h[3])),
+								  (float)(z + 1)};
+			crossing.t = tMin;
+			float tExit = tMax;
+			if (!clipToBox(origin, direction, invDirection, minCorner,
+						   maxCorner, crossing.t, tExit)) {
+				continue;
+			}
+			crossing.x = x;
+			crossing.z = z;
+			
+			int i = numCrossings;
+			while (i > 0 && crossings[i - 1].t > crossing.t) {
+				crossings[i] = crossings[i - 1];
+				i--;
+			}
+			crossings[i] = crossing;
+			numCrossings++;
+		}
+	}
+	
+	//The boxes of the cells don't overlap, so the first cell the ray hits
+	//has the nearest hit
+	for(int i = 0; i < numCrossings; i++) {
+		const CellCrossing &crossing = crossings[i];
+		float x = (float)crossing.x;
+		float z = (float)crossing.z;
+		const float* h = crossing.heights;
+		float corners[4][3] = {{x, h[0], z},
+							   {x + 1, h[1], z},
+							   {x, h[2], z + 1},
+							   {x + 1, h[3], z + 1}};
+		
+		//The cell is split along the diagonal from (x + 1, z) to (x, z + 1)
+		float t1;
+		float t2;
+		bool hit1 = castRayAtTriangle(origin, direction, corners[0],
+									  corners[2], corners[1], tMin, tMax, t1);
+		bool hit2 = castRayAtTriangle(origin, direction, corners[2],
+									  corners[1], corners[3], tMin, tMax, t2);
+		if (hit1 || hit2) {
+			t = hit1 && (!hit2 || t1 < t2) ? t1 : t2;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TerrainRaycaster::castRay(Vec3f origin,
+							   Vec3f direction,
+							   float maxDistance,
+							   float &distance) const {
+	float o[3] = {origin[0], origin[1], origin[2]};
+	float d[3] = {direction[0], direction[1], direction[2]};
+	float invD[3];
+	for(int i = 0; i < 3; i++) {
+		invD[i] = d[i] != 0 ? 1 / d[i] : 0;
+	}
+	
+	/* Walk down the pyramid, keeping the parts that the ray passes through
+	 * on a stack.  The children of each part are pushed furthest first, so
+	 * that we reach the blocks in the order that the ray does and can stop
+	 * at the first hit.
+	 */
+	struct Part {
+		int level;
+		int x;
+		int z;
+		float tMin;
+		float tMax;
+	};
+	Part stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	
+	int top = (int)levels.size() - 1;
+	float minCorner[3] = {0, levels[top].bounds[0], 0};
+	float maxCorner[3] = {(float)cellsX, levels[top].bounds[1], (float)cellsZ};
+	Part root = {top, 0, 0, 0, maxDistance};
+	if (clipToBox(o, d, invD, minCorner, maxCorner, root.tMin, root.tMax)) {
+		stack[stackSize++] = root;
+	}
+	
+	while (stackSize > 0) {
+		Part part = stack[--stackSize];
+		if (part.level == 0) {
+			if (castRayInBlock(part.x, part.z, o, d, invD, part.tMin,
+							   part.tMax, distance)) {
+				return true;
+			}
+			continue;
+		}
+		
+		//Find the children that the ray passes through, furthest first
+		const Level &below = levels[part.level - 1];
+		int shift = part.level - 1 + TERRAIN_RAY_BLOCK_SHIFT;
+		Part children[4];
+		int numChildren = 0;
+		for(int z = 2 * part.z; z <= min(2 * part.z + 1, below.numZ - 1);
+			z++) {
+			for(int x = 2 * part.x; x <= min(2 * part.x + 1, below.numX - 1);
+				x++) {
+				const float* bounds = &below.bounds[2 * (z * below.numX + x)];
+				float childMin[3] = {(float)(x << shift),
+									 bounds[0],
+									 (float)(z << shift)};
+				float childMax[3] = {(float)min((x + 1) << shift, cellsX),
+									 bounds[1],
+									 (float)min((z + 1) << shift, cellsZ)};
+				Part child = {part.level - 1, x, z, part.tMin, part.tMax};
+				if (!clipToBox(o, d, invD, childMin, childMax, child.tMin,
+							   child.tMax)) {
+					continue;
+				}
+				
+				int i = numChildren;
+				while (i > 0 && children[i - 1].tMin < child.tMin) {
+					children[i] = children[i - 1];
+					i--;
+				}
+				children[i] = child;
+				numChildren++;
+			}
+		}
+		for(int i = 0; i < numChildren; i++) {
+			stack[stackSize++] = children[i];
+		}
+	}
+	return false;
+}
+
+void TerrainRaycaster::castRays(const Vec3f* origins,
+								const Vec3f* directions,
+								int count,
+								float maxDistance,
+								float* distances) const {
+	for(int i = 0; i < count; i++) {
+		if (!castRay(origins[i], directions[i], maxDistance, distances[i])) {
+			distances[i] = -1;
+		}
+	}
+}
+
+void TerrainRaycaster::parallelCastRays(const Vec3f* origins,
+										const Vec3f* directions,
+										int count,
+										float maxDistance,
+										float* distances) const {
+	defaultThreadPool()->parallelFor(count, [=](int begin, int end) {
+		castRays(origins + begin, directions + begin, end - begin,
+				 maxDistance, distances + begin);
+	}, MIN_RAYS_PER_TASK);
+}
+
+bool TerrainRaycaster::canSee(Vec3f from, Vec3f to) const {
+	float distance;
+	return !castRay(from, to - from, 1, distance);
+}
+
+
+
+
+
+
+
+
+
+
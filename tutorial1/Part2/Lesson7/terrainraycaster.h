@@ -0,0 +1,136 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_RAYCASTER_H_INCLUDED
+#define TERRAIN_RAYCASTER_H_INCLUDED
+
+#include <vector>
+
+#include "terrain.h"
+#include "vec3f.h"
+
+//The base 2 logarithm of the width and length, in grid cells, of the blocks
+//at the bottom of TerrainRaycaster's pyramid
+const int TERRAIN_RAY_BLOCK_SHIFT = 2;
+const int TERRAIN_RAY_BLOCK_SIZE = 1 << TERRAIN_RAY_BLOCK_SHIFT;
+
+/* Finds where rays hit a terrain, in time logarithmic in the terrain's size.
+ * It keeps a pyramid of the smallest and largest heights of the terrain: the
+ * bottom level has them for each TERRAIN_RAY_BLOCK_SIZE x
+ * TERRAIN_RAY_BLOCK_SIZE block of grid cells, and each level above has them
+ * for 2 x 2 groups of the level below, up to one for the whole terrain.  A
+ * ray walks down the pyramid nearest part first, skipping every part whose
+ * box of heights it misses, and then checks the triangles of each grid cell
+ * in the blocks it reaches, which are the triangles that TerrainDrawer
+ * draws.
+ */
+class TerrainRaycaster {
+	private:
+		//A level of the pyramid
+		struct Level {
+			//The number of parts of the terrain in each direction
+			int numX;
+			int numZ;
+			//The smallest and largest height of each part, one after the
+			//other, row by row
+			std::vector<float> bounds;
+		};
+		
+		Terrain* terrain;
+		//The number of grid cells in each direction
+		int cellsX;
+		int cellsZ;
+		//The levels of the pyramid, from the blocks to the whole terrain
+		std::vector<Level> levels;
+		
+		//Computes the bounds of the blocks from (minX, minZ) to (maxX, maxZ)
+		//and of the parts above them
+		void computeBounds(int minX, int minZ, int maxX, int maxZ);
+		/* Returns whether the ray from origin in direction hits a triangle
+		 * in the specified block between tMin and tMax, where t is the
+		 * distance along the ray in multiples of direction, and if so sets t
+		 * to the nearest hit.  invDirection holds the reciprocals of
+		 * direction's coordinates.
+		 */
+		bool castRayInBlock(int blockX,
+							int blockZ,
+							const float* origin,
+							const float* direction,
+							const float* invDirection,
+							float tMin,
+							float tMax,
+							float &t) const;
+	public:
+		//Builds the pyramid for the specified terrain
+		TerrainRaycaster(Terrain* terrain1);
+		
+		/* Updates the pyramid after the heights of the samples from (minX,
+		 * minZ) to (maxX, maxZ) change.  The rectangle may stick out past the
+		 * edges of the terrain.
+		 */
+		void heightsChanged(int minX, int minZ, int maxX, int maxZ);
+		
+		//Returns the number of levels in the pyramid
+		int numLevels() const;
+		
+		/* Returns whether the ray from origin in direction hits the terrain
+		 * within maxDistance times the length of direction, and if so sets
+		 * distance to how far along the ray the nearest hit is, in multiples
+		 * of the length of direction.  Rays hit both sides of the surface.
+		 * This may be called from several threads at once, as long as the
+		 * terrain doesn't change meanwhile.
+		 */
+		bool castRay(Vec3f origin,
+					 Vec3f direction,
+					 float maxDistance,
+					 float &distance) const;
+		//Casts count rays as castRay does, setting distances[i] to the
+		//distance for the ith ray, or -1 if it misses
+		void castRays(const Vec3f* origins,
+					  const Vec3f* directions,
+					  int count,
+					  float maxDistance,
+					  float* distances) const;
+		//Does what castRays does, splitting the rays among the threads of
+		//the default thread pool
+		void parallelCastRays(const Vec3f* origins,
+							  const Vec3f* directions,
+							  int count,
+							  float maxDistance,
+							  float* distances) const;
+		//Returns whether the segment from one point to another doesn't pass
+		//through the terrain.  The points should be above the surface.
+		bool canSee(Vec3f from, Vec3f to) const;
+};
+
+
+
+
+
+
+
+
+
+
+#endif
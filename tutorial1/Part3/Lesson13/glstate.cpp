@@ -0,0 +1,223 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Particle Systems" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <map>
+
+#include "glstate.h"
+
+using namespace std;
+
+namespace {
+	//The capabilities whose states are tracked
+	const GLenum TRACKED_CAPS[] = {GL_ALPHA_TEST,
+								   GL_BLEND,
+								   GL_COLOR_MATERIAL,
+								   GL_CULL_FACE,
+								   GL_DEPTH_TEST,
+								   GL_LIGHTING,
+								   GL_LIGHT0,
+								   GL_LIGHT1,
+								   GL_LIGHT2,
+								   GL_LIGHT3,
+								   GL_LIGHT4,
+								   GL_LIGHT5,
+								   GL_LIGHT6,
+								   GL_LIGHT7,
+								   GL_NORMALIZE,
+								   GL_TEXTURE_2D};
+	const int NUM_TRACKED_CAPS = sizeof(TRACKED_CAPS) / sizeof(GLenum);
+	
+	//The values of the tracked state.  -1 indicates that a value is unknown.
+	const int UNKNOWN = -1;
+	int capStates[NUM_TRACKED_CAPS];
+	GLint shadeModel = UNKNOWN;
+	GLint frontFace = UNKNOWN;
+	//The minification and magnification filters of each texture
+	map<GLuint, pair<GLint, GLint> > textureFilters;
+	bool isInitialized = false;
+	
+	GLStateCounts counts = {0, 0, 0, 0};
+	
+	//Returns the index of the specified capability in TRACKED_CAPS, or -1 if
+	//it isn't tracked
+	int capIndex(GLenum cap) {
+		for(int i = 0; i < NUM_TRACKED_CAPS; i++) {
+			if (TRACKED_CAPS[i] == cap) {
+				return i;
+			}
+		}
+		return -1;
+	}
+	
+	//Makes the states of all of the capabilities unknown, the first time it
+	//is called
+	void initialize() {
+		if (!isInitialized) {
+			for(int i = 0; i < NUM_TRACKED_CAPS; i++) {
+				capStates[i] = UNKNOWN;
+			}
+			isInitialized = true;
+		}
+	}
+}
+
+void glsEnable(GLenum cap) {
+	glsSetEnabled(cap, true);
+}
+
+void glsDisable(GLenum cap) {
+	glsSetEnabled(cap, false);
+}
+
+void glsSetEnabled(GLenum cap, bool enabled) {
+	initialize();
+	int index = capIndex(cap);
+	if (index >= 0 && capStates[index] == (enabled ? 1 : 0)) {
+		counts.changesSkipped++;
+		return;
+	}
+	
+	if (enabled) {
+		glEnable(cap);
+	}
+	else {
+		glDisable(cap);
+	}
+	counts.changesForwarded++;
+	if (index >= 0) {
+		capStates[index] = enabled ? 1 : 0;
+	}
+}
+
+bool glsIsEnabled(GLenum cap) {
+	initialize();
+	int index = capIndex(cap);
+	if (index >= 0 && capStates[index] != UNKNOWN) {
+		counts.queriesAnswered++;
+		return capStates[index] != 0;
+	}
+	
+	bool enabled = glIsEnabled(cap) == GL_TRUE;
+	counts.queriesForwarded++;
+	if (index >= 0) {
+		capStates[index] = enabled ? 1 : 0;
+	}
+	return enabled;
+}
+
+void glsShadeModel(GLenum mode) {
+	if (shadeModel == (GLint)mode) {
+		counts.changesSkipped++;
+		return;
+	}
+	glShadeModel(mode);
+	counts.changesForwarded++;
+	shadeModel = mode;
+}
+
+GLenum glsGetShadeModel() {
+	if (shadeModel != UNKNOWN) {
+		counts.queriesAnswered++;
+	}
+	else {
+		glGetIntegerv(GL_SHADE_MODEL, &shadeModel);
+		counts.queriesForwarded++;
+	}
+	return shadeModel;
+}
+
+void glsFrontFace(GLenum mode) {
+	if (frontFace == (GLint)mode) {
+		counts.changesSkipped++;
+		return;
+	}
+	glFrontFace(mode);
+	counts.changesForwarded++;
+	frontFace = mode;
+}
+
+GLenum glsGetFrontFace() {
+	if (frontFace != UNKNOWN) {
+		counts.queriesAnswered++;
+	}
+	else {
+		glGetIntegerv(GL_FRONT_FACE, &frontFace);
+		counts.queriesForwarded++;
+	}
+	return frontFace;
+}
+
+void glsTextureFilters(GLuint textureId, GLint minFilter, GLint magFilter) {
+	map<GLuint, pair<GLint, GLint> >::iterator it =
+		textureFilters.find(textureId);
+	if (it != textureFilters.end() &&
+		it->second.first == minFilter && it->second.second == magFilter) {
+		counts.changesSkipped += 2;
+		return;
+	}
+	
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+	counts.changesForwarded += 2;
+	textureFilters[textureId] = make_pair(minFilter, magFilter);
+}
+
+void glsForget(GLenum cap) {
+	initialize();
+	int index = capIndex(cap);
+	if (index >= 0) {
+		capStates[index] = UNKNOWN;
+	}
+}
+
+void glsForgetTexture(GLuint textureId) {
+	textureFilters.erase(textureId);
+}
+
+void glsInvalidate() {
+	isInitialized = false;
+	initialize();
+	shadeModel = UNKNOWN;
+	frontFace = UNKNOWN;
+	textureFilters.clear();
+}
+
+GLStateCounts glsCounts() {
+	return counts;
+}
+
+void glsResetCounts() {
+	GLStateCounts zero = {0, 0, 0, 0};
+	counts = zero;
+}
+
+
+
+
+
+
+
+
+
+
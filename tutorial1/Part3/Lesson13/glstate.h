@@ -0,0 +1,99 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Particle Systems" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef GL_STATE_H_INCLUDED
+#define GL_STATE_H_INCLUDED
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+/* A cache of some of the OpenGL state, which answers queries about it without
+ * asking OpenGL and drops changes that wouldn't change anything.  The cache
+ * tracks whether GL_ALPHA_TEST, GL_BLEND, GL_COLOR_MATERIAL, GL_CULL_FACE,
+ * GL_DEPTH_TEST, GL_LIGHTING, GL_LIGHT0 to GL_LIGHT7, GL_NORMALIZE, and
+ * GL_TEXTURE_2D are enabled, the shade model, the front face, and the
+ * minification and magnification filters of each texture.  Each of these
+ * starts out unknown, in which case the first query asks OpenGL.
+ * 
+ * Code that changes the tracked state without going through these functions,
+ * for example by calling a display list or glPopAttrib, must call glsForget or
+ * glsInvalidate afterwards.
+ */
+
+//Enables or disables the specified capability, as with glEnable and glDisable
+void glsEnable(GLenum cap);
+void glsDisable(GLenum cap);
+void glsSetEnabled(GLenum cap, bool enabled);
+//Returns whether the specified capability is enabled, as with glIsEnabled
+bool glsIsEnabled(GLenum cap);
+//Sets or returns the shade model, as with glShadeModel
+void glsShadeModel(GLenum mode);
+GLenum glsGetShadeModel();
+//Sets or returns which winding order is the front face, as with glFrontFace
+void glsFrontFace(GLenum mode);
+GLenum glsGetFrontFace();
+/* Sets the minification and magnification filters of the specified texture,
+ * which must be bound to GL_TEXTURE_2D in the active texture unit, as with
+ * glTexParameteri.
+ */
+void glsTextureFilters(GLuint textureId, GLint minFilter, GLint magFilter);
+
+//Makes the state of the specified capability unknown
+void glsForget(GLenum cap);
+//Forgets the filters of the specified texture.  Must be called when a
+//texture is deleted, since OpenGL may reuse its id.
+void glsForgetTexture(GLuint textureId);
+//Makes all of the tracked state unknown
+void glsInvalidate();
+
+//The number of calls that the cache has handled
+struct GLStateCounts {
+	//Queries answered from the cache
+	long long queriesAnswered;
+	//Queries that had to ask OpenGL
+	long long queriesForwarded;
+	//Changes dropped because the state already had the new value
+	long long changesSkipped;
+	//Changes passed on to OpenGL
+	long long changesForwarded;
+};
+
+//Returns the number of calls handled since the last call to glsResetCounts
+GLStateCounts glsCounts();
+void glsResetCounts();
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -37,6 +37,7 @@
 #include <GL/glut.h>
 #endif
 
+#include "glstate.h"
 #include "imageloader.h"
 #include "vec3f.h"
 
@@ -210,10 +211,9 @@ class ParticleEngine {
 			}
 			sort(ps.begin(), ps.end(), compareParticles);
 			
-			glEnable(GL_TEXTURE_2D);
+			glsEnable(GL_TEXTURE_2D);
 			glBindTexture(GL_TEXTURE_2D, textureId);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glsTextureFilters(textureId, GL_LINEAR, GL_LINEAR);
 			
 			glBegin(GL_QUADS);
 			for(unsigned int i = 0; i < ps.size(); i++) {
@@ -299,9 +299,9 @@ GLuint loadAlphaTexture(Image* image, Image* alphaChannel) {
 }
 
 void initRendering() {
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_COLOR_MATERIAL);
-	glEnable(GL_BLEND);
+	glsEnable(GL_DEPTH_TEST);
+	glsEnable(GL_COLOR_MATERIAL);
+	glsEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
 	Image* image = loadBMP("circle.bmp");
@@ -35,6 +35,7 @@
 
 #include "game.h"
 #include "gamedrawer.h"
+#include "glstate.h"
 #include "imageloader.h"
 #include "md2model.h"
 #include "text3d.h"
@@ -365,7 +366,7 @@ void GameDrawer::setupLighting() {
 	int index = 0;
 	for(float z = 0; z < 2; z += 1) {
 		for(float x = 0; x < 2; x += 1) {
-			glEnable(GL_LIGHT0 + index);
+			glsEnable(GL_LIGHT0 + index);
 			GLfloat lightColor[] = {0.2f, 0.2f, 0.2f, 1};
 			GLfloat lightPos[] = {x, 1.5f, z, 1};
 			glLightfv(GL_LIGHT0 + index, GL_DIFFUSE, lightColor);
@@ -378,7 +379,7 @@ void GameDrawer::setupLighting() {
 
 void GameDrawer::drawCrabsAndPoles(bool isReflected) {
 	if (crabModel != NULL) {
-		glEnable(GL_NORMALIZE);
+		glsEnable(GL_NORMALIZE);
 		for(int i = 0; i < 4; i++) {
 			Crab* crab = game->crabs()[i];
 			
@@ -439,11 +440,13 @@ void GameDrawer::drawCrabsAndPoles(bool isReflected) {
 			if (crab == NULL) {
 				//Draw the pole
 				if (isReflected) {
-					glDisable(GL_NORMALIZE);
+					glsDisable(GL_NORMALIZE);
 				}
 				glCallList(poleDisplayListId);
+				//The display list disables texturing
+				glsForget(GL_TEXTURE_2D);
 				if (isReflected) {
-					glEnable(GL_NORMALIZE);
+					glsEnable(GL_NORMALIZE);
 				}
 			}
 			
@@ -454,12 +457,15 @@ void GameDrawer::drawCrabsAndPoles(bool isReflected) {
 
 void GameDrawer::drawBarriers(bool isReflected) {
 	if (isReflected) {
-		glEnable(GL_NORMALIZE);
+		glsEnable(GL_NORMALIZE);
 	}
 	else {
-		glDisable(GL_NORMALIZE);
+		glsDisable(GL_NORMALIZE);
 	}
 	glCallList(barriersDisplayListId);
+	//The display list changes these without going through the state cache
+	glsForget(GL_TEXTURE_2D);
+	glsForget(GL_COLOR_MATERIAL);
 }
 
 void GameDrawer::drawScores(bool isReflected) {
@@ -506,21 +512,21 @@ void GameDrawer::drawScores(bool isReflected) {
 
 void GameDrawer::drawBalls(bool isReflected) {
 	if (isReflected) {
-		glEnable(GL_NORMALIZE);
+		glsEnable(GL_NORMALIZE);
 	}
 	else {
-		glDisable(GL_NORMALIZE);
+		glsDisable(GL_NORMALIZE);
 	}
 	
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
+	glsDisable(GL_TEXTURE_2D);
+	glsDisable(GL_BLEND);
 	
 	vector<Ball*> balls = game->balls();
 	for(unsigned int i = 0; i < balls.size(); i++) {
 		Ball* ball = balls[i];
 		
 		if (ball->fadeAmount() < 1) {
-			glEnable(GL_BLEND);
+			glsEnable(GL_BLEND);
 			glColor4f(0.75f, 0.75f, 0.75f, ball->fadeAmount());
 		}
 		else {
@@ -533,7 +539,7 @@ void GameDrawer::drawBalls(bool isReflected) {
 		glPopMatrix();
 		
 		if (ball->fadeAmount() < 1) {
-			glDisable(GL_BLEND);
+			glsDisable(GL_BLEND);
 		}
 	}
 }
@@ -549,11 +555,10 @@ void GameDrawer::drawSand() {
 	//The height of the sand above the water
 	float height = 0.01f;
 	
-	glEnable(GL_TEXTURE_2D);
+	glsEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, sandTextureId);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glDisable(GL_NORMALIZE);
+	glsTextureFilters(sandTextureId, GL_LINEAR, GL_LINEAR);
+	glsDisable(GL_NORMALIZE);
 	glColor3f(1, 1, 1);
 	glNormal3f(0, 1, 0);
 	glBegin(GL_QUADS);
@@ -569,13 +574,12 @@ void GameDrawer::drawSand() {
 }
 
 void GameDrawer::drawWater() {
-	glDisable(GL_LIGHTING);
-	glEnable(GL_TEXTURE_2D);
+	glsDisable(GL_LIGHTING);
+	glsEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, waterTextureId);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glDisable(GL_NORMALIZE);
-	glEnable(GL_BLEND);
+	glsTextureFilters(waterTextureId, GL_LINEAR, GL_LINEAR);
+	glsDisable(GL_NORMALIZE);
+	glsEnable(GL_BLEND);
 	glColor4f(1, 1, 1, WATER_ALPHA);
 	glNormal3f(0, 1, 0);
 	
@@ -592,8 +596,8 @@ void GameDrawer::drawWater() {
 	glVertex3f(100, 0, -100);
 	glEnd();
 	
-	glDisable(GL_BLEND);
-	glEnable(GL_LIGHTING);
+	glsDisable(GL_BLEND);
+	glsEnable(GL_LIGHTING);
 }
 
 void GameDrawer::drawWinner() {
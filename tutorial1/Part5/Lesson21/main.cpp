@@ -36,6 +36,7 @@
 #endif
 
 #include "gamedrawer.h"
+#include "glstate.h"
 
 using namespace std;
 
@@ -118,12 +119,12 @@ void handleSpecialKeyReleased(int key, int x, int y) {
 }
 
 void initRendering() {
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_COLOR_MATERIAL);
-	glEnable(GL_LIGHTING);
-	glEnable(GL_NORMALIZE);
-	glEnable(GL_CULL_FACE);
-	glShadeModel(GL_SMOOTH);
+	glsEnable(GL_DEPTH_TEST);
+	glsEnable(GL_COLOR_MATERIAL);
+	glsEnable(GL_LIGHTING);
+	glsEnable(GL_NORMALIZE);
+	glsEnable(GL_CULL_FACE);
+	glsShadeModel(GL_SMOOTH);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	initGameDrawer();
 }
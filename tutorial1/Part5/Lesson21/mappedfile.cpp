@@ -0,0 +1,103 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "A Sample Game: Crab Pong" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile() : data0(NULL), size0(0), modificationTime0(0) {
+	
+}
+
+MappedFile::~MappedFile() {
+	if (size0 > 0) {
+		munmap((void*)data0, size0);
+	}
+}
+
+const char* MappedFile::data() {
+	return data0;
+}
+
+size_t MappedFile::size() {
+	return size0;
+}
+
+long long MappedFile::modificationTime() {
+	return modificationTime0;
+}
+
+MappedFile* MappedFile::open(const char* filename) {
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return NULL;
+	}
+	
+	MappedFile* file = new MappedFile();
+	file->modificationTime0 = (long long)info.st_mtime;
+	if (info.st_size > 0) {
+		void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+						  fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			delete file;
+			return NULL;
+		}
+		file->data0 = (const char*)data;
+		file->size0 = (size_t)info.st_size;
+	}
+	
+	//The mapping stays valid after the file is closed
+	close(fd);
+	return file;
+}
+
+bool fileStats(const char* filename, size_t &size, long long &modificationTime) {
+	struct stat info;
+	if (stat(filename, &info) != 0) {
+		return false;
+	}
+	size = (size_t)info.st_size;
+	modificationTime = (long long)info.st_mtime;
+	return true;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,66 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "A Sample Game: Crab Pong" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <stddef.h>
+
+//A read-only memory mapping of an entire file
+class MappedFile {
+	private:
+		const char* data0;
+		size_t size0;
+		long long modificationTime0;
+		
+		MappedFile();
+	public:
+		~MappedFile();
+		
+		//Returns the contents of the file
+		const char* data();
+		//Returns the number of bytes in the file
+		size_t size();
+		//Returns the time at which the file was last modified, in seconds
+		long long modificationTime();
+		
+		//Maps the specified file into memory.  Returns NULL if the file could
+		//not be opened or mapped.
+		static MappedFile* open(const char* filename);
+};
+
+//Sets size and modificationTime to those of the specified file.  Returns false
+//if the file could not be found.
+bool fileStats(const char* filename, size_t &size, long long &modificationTime);
+
+
+
+
+
+
+
+
+
+
+#endif
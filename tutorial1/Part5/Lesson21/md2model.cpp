@@ -25,6 +25,7 @@
 #include <fstream>
 #include <vector>
 #include <string.h>
+#include "glstate.h"
 #include "imageloader.h"
 #include "md2model.h"
 
@@ -464,11 +465,10 @@ void MD2Model::draw(int textureNum, float time) {
 		time = 0;
 	}
 	
-	glEnable(GL_TEXTURE_2D);
+	glsEnable(GL_TEXTURE_2D);
 	//Use the appropriate texture
 	glBindTexture(GL_TEXTURE_2D, textureIds[textureNum]);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glsTextureFilters(textureIds[textureNum], GL_LINEAR, GL_LINEAR);
 	
 	//Figure out the two frames between which we are interpolating
 	int frameIndex1 = (int)(time * (endFrame - startFrame + 1)) + startFrame;
@@ -26,12 +26,15 @@
 #define TEXT_3D_H_INCLUDED
 
 #include <string>
+#include <vector>
 
 //Initializes 3D text.  Must be called before other functions in this header.
 void t3dInit();
 //Frees memory allocated for 3D text.  No other functions in this header may be
 //called after this one.
 void t3dCleanup();
+//t3dDraw2D and t3dDraw3D keep the triangles for the 64 most recently drawn
+//strings, so drawing the same string every frame is cheap.
 /* Draws the specified string, using OpenGL, as a set of polygons in the x-y
  * plane, with the top of the letters having the greatest y coordinate.  The
  * normals point in the positive z direction.  (If you need the normals to point
@@ -92,6 +95,13 @@ float t3dDrawWidth(std::string str);
  * fewer than the number of lines in the string, plus 1.
  */
 float t3dDrawHeight(std::string str, float lineHeight = 1.5f);
+/* Stores the triangles that t3dDraw2D uses for the specified character in
+ * vertices, as the x and y coordinates of three vertices per triangle, and
+ * returns the width of the character.  The character is centered at (0, 0),
+ * and its size is relative to the height of the font.  Unprintable characters
+ * have no triangles.
+ */
+float t3dCharTriangles(char c, std::vector<float> &vertices);
 
 //Indicates that an exception occurred when setting up 3D text
 class T3DLoadException {